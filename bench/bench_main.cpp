@@ -0,0 +1,35 @@
+/**
+ * webkin_bench: micro-benchmark suites.
+ *
+ *   webkin_bench                      all suites with default sizes
+ *   webkin_bench core [--k3d FILE]    tree, serialization and decoding
+ *   webkin_bench fk [configurations] [nodes]
+ *
+ * A leading number selects fk, as before the suites were split.
+ */
+
+#include <nos/print.h>
+
+#include <cctype>
+#include <cstring>
+
+int run_core_bench(int argc, char *argv[]);
+int run_fk_bench(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        int rc = run_core_bench(0, nullptr);
+        return rc != 0 ? rc : run_fk_bench(0, nullptr);
+    }
+    if (std::strcmp(argv[1], "core") == 0)
+        return run_core_bench(argc - 2, argv + 2);
+    if (std::strcmp(argv[1], "fk") == 0)
+        return run_fk_bench(argc - 2, argv + 2);
+    if (std::isdigit(static_cast<unsigned char>(argv[1][0])))
+        return run_fk_bench(argc - 1, argv + 1);
+
+    nos::println("Usage: webkin_bench [core [--k3d FILE] | fk [configurations] [nodes]]");
+    return 1;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * Shared helpers of the benchmarks: synthetic trees and timing.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace webkin::bench
+{
+
+inline const char *axis_of(size_t i)
+{
+    return i % 3 == 0 ? "[0,0,1]" : i % 3 == 1 ? "[0,1,0]" : "[1,0,0]";
+}
+
+// Serial arm of rotators about x, y or z, actuators and static links
+inline std::string make_chain(size_t nodes)
+{
+    std::string json;
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        json += "{\"name\":\"j" + std::to_string(i) + "\",\"type\":\"" +
+                (i % 4 == 3 ? "actuator" : i % 3 == 2 ? "transform" : "rotator") + "\",\"axis\":" + axis_of(i) +
+                ",\"pose\":{\"position\":[0,0,10],\"orientation\":[0,0,0.38268343236509,0.923879532511287]}";
+        if (i + 1 < nodes)
+            json += ",\"children\":[";
+    }
+    for (size_t i = 0; i < nodes; ++i)
+        json += i + 1 < nodes ? "}]" : "}";
+    return json;
+}
+
+// Static base with nodes - 1 rotator children, e.g. the fingers of a gripper
+// rack or a fleet of independent axes
+inline std::string make_fan(size_t nodes)
+{
+    std::string json = "{\"name\":\"base\",\"type\":\"transform\",\"pose\":{\"position\":[0,0,0]}";
+    if (nodes > 1)
+    {
+        json += ",\"children\":[";
+        for (size_t i = 1; i < nodes; ++i)
+        {
+            if (i > 1)
+                json += ',';
+            json += "{\"name\":\"j" + std::to_string(i) + "\",\"type\":\"rotator\",\"axis\":" + axis_of(i) +
+                    ",\"pose\":{\"position\":[" + std::to_string(i) + ",0,1]}}";
+        }
+        json += ']';
+    }
+    json += '}';
+    return json;
+}
+
+template <class F> double best_ms(F &&f, int repeats = 5)
+{
+    double best = 1e300;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+inline volatile double g_sink;
+
+} // namespace webkin::bench
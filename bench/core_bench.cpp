@@ -0,0 +1,154 @@
+/**
+ * Server hot path micro-benchmarks on synthetic trees.
+ *
+ * For chains and wide fans of 10 to 1000 nodes: KinematicTree::load(),
+ * update() of all nodes, the scene as a trent (get_scene_data() + JSON,
+ * the former broadcast path), scene_update from a snapshot
+ * (SceneJsonWriter, the current one), and decoding one joint message of
+ * all joints through the JSON fast path, the trent parser and a binary
+ * joint frame. With --k3d, also K3DLoader::load_file() of an archive
+ * (extraction and mesh preprocessing).
+ *
+ *   webkin_bench core [--k3d FILE]
+ */
+
+#include "bench_util.hpp"
+#include "joint_decoder.hpp"
+#include "k3d_loader.hpp"
+#include "kinematic.hpp"
+#include "scene_json.hpp"
+#include "scene_snapshot.hpp"
+
+#include <nos/print.h>
+#include <nos/trent/json.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace webkin;
+using namespace webkin::bench;
+
+namespace
+{
+    struct Shape
+    {
+        const char *name;
+        std::string (*make)(size_t nodes);
+    };
+
+    std::string joints_message(const std::vector<std::string> &names, double value)
+    {
+        std::string json = "{\"joints\":{";
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            if (i > 0)
+                json += ',';
+            json += '"' + names[i] + "\":" + std::to_string(value + 0.001 * i);
+        }
+        json += "}}";
+        return json;
+    }
+
+    // Microseconds per call of f, best of 5 runs of `rounds` calls
+    template <class F> double us_per_call(size_t rounds, F &&f)
+    {
+        return best_ms([&]()
+                       {
+            for (size_t r = 0; r < rounds; ++r)
+                f(); }) *
+               1e3 / rounds;
+    }
+
+    void bench_tree(const Shape &shape, size_t nodes)
+    {
+        std::string json = shape.make(nodes);
+        nos::trent data = nos::json::parse(json);
+        size_t rounds = std::max<size_t>(10, 20000 / nodes);
+
+        double load = us_per_call(rounds / 10 + 1, [&]()
+                                  {
+            KinematicTree t;
+            t.load(data);
+            g_sink = static_cast<double>(t.nodes.size()); });
+
+        KinematicTree tree;
+        tree.load(data);
+        double update = us_per_call(rounds, [&]()
+                                    {
+            tree.flat.mark_all_dirty();
+            tree.update();
+            g_sink = tree.flat.global_pose.back().position.x; });
+
+        double scene_trent = us_per_call(rounds / 10 + 1, [&]()
+                                         { g_sink = static_cast<double>(nos::json::to_string(tree.get_scene_data()).size()); });
+
+        ScenePublisher publisher;
+        publisher.reset(tree);
+        publisher.publish(tree);
+        auto snapshot = publisher.current();
+        SceneJsonWriter writer;
+        double scene_writer = us_per_call(rounds, [&]()
+                                          { g_sink = static_cast<double>(writer.scene_update(*snapshot).size()); });
+
+        std::vector<std::string> names = tree.get_joint_names();
+        std::string message = joints_message(names, 0.25);
+        double decode_fast = us_per_call(rounds, [&]()
+                                         { g_sink = apply_joint_update(message, tree); });
+        double decode_trent = us_per_call(rounds / 10 + 1, [&]()
+                                          {
+            nos::trent parsed = nos::json::parse(message);
+            for (const auto &[name, value] : parsed["joints"].as_dict())
+                tree.set_joint_coord(name, value.as_numer_default(0));
+            g_sink = tree.flat.coord.back(); });
+
+        JointSchema schema = JointSchema::from_tree(data, tree);
+        std::string frame = encode_joint_frame(schema, std::vector<double>(schema.names.size(), 0.5));
+        double decode_binary = us_per_call(rounds, [&]()
+                                           { g_sink = static_cast<double>(apply_joint_frame(frame, schema, tree)); });
+
+        nos::println("  ", shape.name, " ", nodes, " nodes, ", names.size(), " joints (us/op): load ", load,
+                     ", update ", update, ", scene trent+json ", scene_trent, ", scene_update writer ",
+                     scene_writer, ", decode fast ", decode_fast, ", trent ", decode_trent, ", binary ",
+                     decode_binary);
+    }
+}
+
+int run_core_bench(int argc, char *argv[])
+{
+    const char *k3d = nullptr;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--k3d") == 0 && i + 1 < argc)
+            k3d = argv[++i];
+    }
+
+    nos::println("core:");
+    const Shape shapes[] = {{"chain", make_chain}, {"fan", make_fan}};
+    for (const auto &shape : shapes)
+    {
+        for (size_t nodes : {10, 100, 1000})
+            bench_tree(shape, nodes);
+    }
+
+    if (k3d)
+    {
+        try
+        {
+            double ms = best_ms([&]()
+                                {
+                K3DLoader loader;
+                g_sink = loader.load_file(k3d).is_dict(); },
+                                3);
+            nos::println("  K3DLoader::load_file ", k3d, ": ", ms, " ms");
+        }
+        catch (const std::exception &e)
+        {
+            nos::println("  K3DLoader::load_file ", k3d, ": ", e.what());
+            return 1;
+        }
+    }
+    return 0;
+}
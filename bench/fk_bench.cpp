@@ -0,0 +1,216 @@
+/**
+ * Forward kinematics micro-benchmarks.
+ *
+ * Compares the pose math of kinematic.hpp before the cross-product
+ * rotate_vec and the folded joint kinds (kept below as the reference)
+ * with the current FlatTree::update() and the vectorized batch kernels of
+ * pose_kernels.hpp, and the generic update with the generated FK of
+ * fk_model.hpp (fk_chain24.hpp, the default 24-node chain).
+ *
+ *   webkin_bench fk [configurations] [nodes]
+ */
+
+#include "bench_util.hpp"
+#include "fk_chain24.hpp"
+#include "kinematic.hpp"
+#include "pose_kernels.hpp"
+
+#include <nos/print.h>
+#include <nos/trent/json.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace webkin;
+using namespace webkin::bench;
+
+namespace
+{
+    // Pose math as of the previous kinematic.hpp: rotate_vec as q * v * conj(q)
+    Vec3 reference_rotate(const Quat &q, const Vec3 &v)
+    {
+        Quat qv(v.x, v.y, v.z, 0);
+        Quat conj(-q.x, -q.y, -q.z, q.w);
+        Quat r = q * qv * conj;
+        return Vec3(r.x, r.y, r.z);
+    }
+
+    Pose reference_compose(const Pose &a, const Pose &b)
+    {
+        return Pose(a.position + reference_rotate(a.orientation, b.position), a.orientation * b.orientation);
+    }
+
+    // Row-by-row batch FK with the reference math
+    void reference_batch(const FlatTree &flat, const std::vector<uint32_t> &joints, const double *coords,
+                         size_t count, Pose *out)
+    {
+        std::vector<double> c = flat.coord;
+        for (size_t k = 0; k < count; ++k)
+        {
+            for (size_t j = 0; j < joints.size(); ++j)
+                c[joints[j]] = coords[k * joints.size() + j];
+            Pose *poses = out + k * flat.size();
+            for (size_t i = 0; i < flat.size(); ++i)
+            {
+                Pose joint = flat.joint_transform(i, c[i]);
+                Pose local = reference_compose(flat.local_pose[i], joint);
+                poses[i] = flat.parent[i] < 0 ? local : reference_compose(poses[flat.parent[i]], local);
+            }
+        }
+    }
+
+    double max_error(const std::vector<Pose> &a, const std::vector<Pose> &b)
+    {
+        double err = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            err = std::max(err, std::abs(a[i].position.x - b[i].position.x));
+            err = std::max(err, std::abs(a[i].position.y - b[i].position.y));
+            err = std::max(err, std::abs(a[i].position.z - b[i].position.z));
+            err = std::max(err, std::abs(a[i].orientation.w - b[i].orientation.w));
+        }
+        return err;
+    }
+}
+
+int run_fk_bench(int argc, char *argv[])
+{
+    size_t count = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 20000;
+    size_t nodes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 24;
+
+    KinematicTree tree;
+    tree.load(nos::json::parse(make_chain(nodes)));
+
+    std::vector<uint32_t> joints = tree.joint_nodes;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> angle(-3.0, 3.0);
+    std::vector<double> coords(count * joints.size());
+    for (auto &c : coords)
+        c = angle(rng);
+
+    nos::println("fk: ", count, " configurations x ", nodes, " nodes");
+
+    // Single composition throughput
+    {
+        std::vector<Pose> chain(4096);
+        for (size_t i = 0; i < chain.size(); ++i)
+            chain[i] = Pose(Vec3(angle(rng), angle(rng), angle(rng)),
+                            Quat::from_axis_angle(Vec3(0, 0, 1), angle(rng)));
+        const size_t rounds = 200;
+        double ref = best_ms([&]()
+                             {
+            Pose acc;
+            for (size_t r = 0; r < rounds; ++r)
+                for (const auto &p : chain)
+                    acc = reference_compose(acc, p);
+            g_sink = acc.position.x; });
+        double cur = best_ms([&]()
+                             {
+            Pose acc;
+            for (size_t r = 0; r < rounds; ++r)
+                for (const auto &p : chain)
+                    acc = acc * p;
+            g_sink = acc.position.x; });
+        double n = double(rounds * chain.size());
+        nos::println("  Pose::operator*    reference ", ref * 1e6 / n, " ns, cross-product ", cur * 1e6 / n,
+                     " ns, x", ref / cur);
+    }
+
+    // Full tree update: reference per-node local * joint, parent * local
+    // against folded base poses and specialized joint kinds
+    {
+        const size_t rounds = 2000;
+        std::vector<Pose> poses(tree.flat.size());
+        double ref = best_ms([&]()
+                             {
+            for (size_t r = 0; r < rounds; ++r)
+            {
+                const FlatTree &flat = tree.flat;
+                for (size_t i = 0; i < flat.size(); ++i)
+                {
+                    Pose local = reference_compose(flat.local_pose[i], flat.joint_transform(i));
+                    poses[i] = flat.parent[i] < 0 ? local : reference_compose(poses[flat.parent[i]], local);
+                }
+            }
+            g_sink = poses.back().position.x; });
+        double cur = best_ms([&]()
+                             {
+            for (size_t r = 0; r < rounds; ++r)
+            {
+                tree.flat.mark_all_dirty();
+                tree.update();
+            }
+            g_sink = tree.flat.global_pose.back().position.x; });
+        nos::println("  FlatTree::update   reference ", ref * 1e6 / rounds, " ns, folded ", cur * 1e6 / rounds,
+                     " ns, x", ref / cur);
+    }
+
+    // Full tree update: generic loop against the generated, unrolled FK
+    if (tree.flat.fingerprint() != fk_models::chain24::fingerprint)
+    {
+        nos::println("  generated FK       skipped, fk_chain24.hpp is for 24 nodes");
+    }
+    else
+    {
+        const size_t rounds = 2000;
+        auto run = [&](CompiledUpdate compiled)
+        {
+            tree.flat.compiled = compiled;
+            return best_ms([&]()
+                           {
+                for (size_t r = 0; r < rounds; ++r)
+                {
+                    tree.flat.mark_all_dirty();
+                    tree.update();
+                }
+                g_sink = tree.flat.global_pose.back().position.x; });
+        };
+        double generic = run(nullptr);
+        double generated = run(&fk::update<fk_models::chain24>);
+
+        std::vector<Pose> expected;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            tree.flat.compiled = pass ? &fk::update<fk_models::chain24> : nullptr;
+            for (size_t j = 0; j < joints.size(); ++j)
+                tree.flat.set_coord(joints[j], coords[j]);
+            tree.flat.mark_all_dirty();
+            tree.update();
+            if (!pass)
+                expected = tree.flat.global_pose;
+        }
+        nos::println("  generated FK       generic ", generic * 1e6 / rounds, " ns, unrolled ",
+                     generated * 1e6 / rounds, " ns, x", generic / generated, ", max error ",
+                     max_error(expected, tree.flat.global_pose));
+        tree.flat.compiled = nullptr;
+    }
+
+    // Batch FK, one thread
+    std::vector<Pose> expected(count * tree.flat.size());
+    double ref = best_ms([&]()
+                         { reference_batch(tree.flat, joints, coords.data(), count, expected.data()); });
+    nos::println("  batch reference    ", ref * 1e6 / count, " ns/configuration");
+
+    std::vector<Pose> out(count * tree.flat.size());
+    for (const char *name : pose_kernel_names())
+    {
+        select_pose_kernel(name);
+        double ms = best_ms([&]()
+                            { tree.flat.evaluate_batch(joints, coords.data(), count, out.data(), 1); });
+        nos::println("  batch ", name, "       ", ms * 1e6 / count, " ns/configuration, x", ref / ms,
+                     ", max error ", max_error(expected, out));
+    }
+
+    // All cores, best kernel
+    select_pose_kernel(pose_kernel_names().front());
+    double ms = best_ms([&]()
+                        { tree.flat.evaluate_batch(joints, coords.data(), count, out.data()); });
+    nos::println("  batch ", pose_kernel_name(), " x", std::thread::hardware_concurrency(), " threads ",
+                 ms * 1e6 / count, " ns/configuration, x", ref / ms);
+    return 0;
+}
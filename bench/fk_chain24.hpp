@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+ * Compile-time forward kinematics of chain24, see fk_model.hpp.
+ * Generated by webkin --generate-fk from bench_util.hpp make_chain(24); do not edit.
+ */
+
+#include "fk_model.hpp"
+
+namespace webkin::fk_models
+{
+
+struct chain24
+{
+    static constexpr const char *name = "chain24";
+    static constexpr uint64_t fingerprint = 0xcda937937cb62706ull;
+
+    // anchor, kind, base position, base orientation, axis
+    static constexpr std::array<fk::Node, 24> nodes{{
+        {-1, JointKind::RotateZ, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 0.0, 1.0},
+        {0, JointKind::RotateY, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {1, JointKind::Fixed, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {1, JointKind::Translate, 0.0, 0.0, 20.0, 0.0, 0.0, 0.7071067811865481, 0.7071067811865478, 0.0, 0.0, 1.0},
+        {3, JointKind::RotateY, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {4, JointKind::Fixed, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {4, JointKind::RotateZ, 0.0, 0.0, 20.0, 0.0, 0.0, 0.7071067811865481, 0.7071067811865478, 0.0, 0.0, 1.0},
+        {6, JointKind::Translate, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {7, JointKind::Fixed, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {7, JointKind::RotateZ, 0.0, 0.0, 20.0, 0.0, 0.0, 0.7071067811865481, 0.7071067811865478, 0.0, 0.0, 1.0},
+        {9, JointKind::RotateY, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {10, JointKind::Translate, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {11, JointKind::RotateZ, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 0.0, 1.0},
+        {12, JointKind::RotateY, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {13, JointKind::Fixed, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {13, JointKind::Translate, 0.0, 0.0, 20.0, 0.0, 0.0, 0.7071067811865481, 0.7071067811865478, 0.0, 0.0, 1.0},
+        {15, JointKind::RotateY, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {16, JointKind::Fixed, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {16, JointKind::RotateZ, 0.0, 0.0, 20.0, 0.0, 0.0, 0.7071067811865481, 0.7071067811865478, 0.0, 0.0, 1.0},
+        {18, JointKind::Translate, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {19, JointKind::Fixed, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+        {19, JointKind::RotateZ, 0.0, 0.0, 20.0, 0.0, 0.0, 0.7071067811865481, 0.7071067811865478, 0.0, 0.0, 1.0},
+        {21, JointKind::RotateY, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 0.0, 1.0, 0.0},
+        {22, JointKind::Translate, 0.0, 0.0, 10.0, 0.0, 0.0, 0.38268343236509, 0.923879532511287, 1.0, 0.0, 0.0},
+    }};
+
+    static constexpr std::array<const char *, 24> names{{
+        "j0",
+        "j1",
+        "j2",
+        "j3",
+        "j4",
+        "j5",
+        "j6",
+        "j7",
+        "j8",
+        "j9",
+        "j10",
+        "j11",
+        "j12",
+        "j13",
+        "j14",
+        "j15",
+        "j16",
+        "j17",
+        "j18",
+        "j19",
+        "j20",
+        "j21",
+        "j22",
+        "j23",
+    }};
+};
+
+} // namespace webkin::fk_models
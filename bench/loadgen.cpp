@@ -0,0 +1,350 @@
+/**
+ * Load generator for a running webkin server.
+ *
+ * Publishes joint updates at a fixed rate, as joint_update over WebSocket
+ * or on an MQTT topic, while N clients stay connected to /ws. Updates
+ * carry "ts" and "seq", and the server forwards them as "trace" of the
+ * pose messages, so every client measures latency from publish to
+ * receipt on this host's clock. Reports throughput every second and
+ * latency percentiles at the end.
+ *
+ *   webkin_loadgen [--host HOST] [--port PORT] [--path /ws] [--clients N]
+ *                  [--rate HZ] [--duration SECONDS]
+ *                  [--mqtt HOST[:PORT]] [--topic robot/joints]
+ *
+ * Clients do not offer permessage-deflate or a subprotocol, so they get
+ * JSON messages uncompressed. Joint names come from scene_init.
+ */
+
+#include "metrics.hpp"
+#include "ws_client.hpp"
+
+#include <nos/print.h>
+
+#include <poll.h>
+
+#ifdef HAVE_MOSQUITTO
+#include <mosquitto.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    double now_ms()
+    {
+        using namespace std::chrono;
+        return duration<double, std::milli>(system_clock::now().time_since_epoch()).count();
+    }
+
+    // "joints" of scene_init
+    std::vector<std::string> parse_joint_names(std::string_view message)
+    {
+        std::vector<std::string> names;
+        size_t pos = message.find("\"joints\":[");
+        if (pos == std::string_view::npos)
+            return names;
+        pos += 10;
+        while (pos < message.size() && message[pos] == '"')
+        {
+            size_t end = message.find('"', pos + 1);
+            if (end == std::string_view::npos)
+                break;
+            names.emplace_back(message.substr(pos + 1, end - pos - 1));
+            pos = end + 1;
+            if (pos < message.size() && message[pos] == ',')
+                ++pos;
+        }
+        return names;
+    }
+
+    // "source_ts" of a pose message's trace; 0 if untraced
+    double parse_source_ts(std::string_view message)
+    {
+        size_t trace = message.rfind("\"trace\":{");
+        if (trace == std::string_view::npos)
+            return 0;
+        size_t pos = message.find("\"source_ts\":", trace);
+        if (pos == std::string_view::npos)
+            return 0;
+        pos += 12;
+        double value = 0;
+        std::from_chars(message.data() + pos, message.data() + message.size(), value);
+        return value;
+    }
+
+    struct Stats
+    {
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> traced{0};
+        webkin::Histogram latency;
+    };
+
+    // Receives on a share of the clients until `running` clears
+    void receive_loop(std::vector<std::unique_ptr<webkin::ws_client>> &clients, size_t first, size_t step, Stats &stats,
+                      const std::atomic<bool> &running)
+    {
+        std::vector<pollfd> fds;
+        std::vector<webkin::ws_client *> owners;
+        for (size_t i = first; i < clients.size(); i += step)
+        {
+            fds.push_back({clients[i]->fd(), POLLIN, 0});
+            owners.push_back(clients[i].get());
+        }
+        auto on_text = [&stats](std::string_view message, bool)
+        {
+            stats.received.fetch_add(1, std::memory_order_relaxed);
+            stats.bytes.fetch_add(message.size(), std::memory_order_relaxed);
+            double source = parse_source_ts(message);
+            if (source > 0)
+            {
+                stats.traced.fetch_add(1, std::memory_order_relaxed);
+                stats.latency.record(static_cast<uint64_t>(std::max(0.0, now_ms() - source) * 1e6));
+            }
+        };
+        while (running.load(std::memory_order_relaxed))
+        {
+            if (::poll(fds.data(), fds.size(), 100) <= 0)
+                continue;
+            for (size_t i = 0; i < fds.size(); ++i)
+            {
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                {
+                    if (!owners[i]->read(on_text))
+                        fds[i].fd = -1; // poll() skips it
+                }
+            }
+        }
+    }
+
+    std::string make_update(const std::vector<std::string> &joints, double t_s, uint64_t seq, bool ws)
+    {
+        std::string json = ws ? "{\"type\":\"joint_update\",\"joints\":{" : "{\"joints\":{";
+        for (size_t i = 0; i < joints.size(); ++i)
+        {
+            if (i > 0)
+                json += ',';
+            char value[32];
+            auto res = std::to_chars(value, value + sizeof(value), std::sin(t_s + 0.3 * double(i)), std::chars_format::fixed, 6);
+            json += '"' + joints[i] + "\":";
+            json.append(value, res.ptr);
+        }
+        char ts[32];
+        auto res = std::to_chars(ts, ts + sizeof(ts), now_ms(), std::chars_format::fixed, 3);
+        json += "},\"ts\":";
+        json.append(ts, res.ptr);
+        json += ",\"seq\":" + std::to_string(seq) + "}";
+        return json;
+    }
+
+    double ms_of(const webkin::Histogram &h, double q)
+    {
+        return static_cast<double>(h.quantile(q)) / 1e6;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string host = "127.0.0.1";
+    int port = 8000;
+    std::string path = "/ws";
+    size_t client_count = 10;
+    double rate = 100;
+    double duration = 10;
+    std::string mqtt;
+    std::string topic = "robot/joints";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--host" && has_value)
+            host = argv[++i];
+        else if (arg == "--port" && has_value)
+            port = std::atoi(argv[++i]);
+        else if (arg == "--path" && has_value)
+            path = argv[++i];
+        else if (arg == "--clients" && has_value)
+            client_count = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--rate" && has_value)
+            rate = std::atof(argv[++i]);
+        else if (arg == "--duration" && has_value)
+            duration = std::atof(argv[++i]);
+        else if (arg == "--mqtt" && has_value)
+            mqtt = argv[++i];
+        else if (arg == "--topic" && has_value)
+            topic = argv[++i];
+        else
+        {
+            nos::println("Usage: webkin_loadgen [--host HOST] [--port PORT] [--path /ws] [--clients N]");
+            nos::println("                      [--rate HZ] [--duration SECONDS]");
+            nos::println("                      [--mqtt HOST[:PORT]] [--topic robot/joints]");
+            return 1;
+        }
+    }
+    if (rate <= 0)
+    {
+        nos::println("--rate must be positive");
+        return 1;
+    }
+
+    // Publisher connection: joint names from scene_init, then joint_update
+    webkin::ws_client publisher;
+    if (!publisher.connect(host, port, path))
+    {
+        nos::println("Cannot connect to ws://", host, ":", port, path);
+        return 1;
+    }
+    std::vector<std::string> joints;
+    while (joints.empty() && publisher.read([&joints](std::string_view message, bool)
+                                            {
+        if (joints.empty())
+            joints = parse_joint_names(message); }))
+    {
+    }
+    if (joints.empty())
+    {
+        nos::println("No joints in scene_init");
+        return 1;
+    }
+
+#ifdef HAVE_MOSQUITTO
+    mosquitto *mosq = nullptr;
+    if (!mqtt.empty())
+    {
+        std::string broker = mqtt;
+        int broker_port = 1883;
+        if (auto colon = broker.rfind(':'); colon != std::string::npos)
+        {
+            broker_port = std::atoi(broker.c_str() + colon + 1);
+            broker.resize(colon);
+        }
+        mosquitto_lib_init();
+        mosq = mosquitto_new(nullptr, true, nullptr);
+        if (!mosq || mosquitto_connect(mosq, broker.c_str(), broker_port, 60) != MOSQ_ERR_SUCCESS ||
+            mosquitto_loop_start(mosq) != MOSQ_ERR_SUCCESS)
+        {
+            nos::println("Cannot connect to MQTT broker ", mqtt);
+            return 1;
+        }
+    }
+#else
+    if (!mqtt.empty())
+    {
+        nos::println("webkin_loadgen: not compiled with mosquitto support");
+        return 1;
+    }
+#endif
+
+    std::vector<std::unique_ptr<webkin::ws_client>> clients;
+    for (size_t i = 0; i < client_count; ++i)
+    {
+        auto client = std::make_unique<webkin::ws_client>();
+        if (!client->connect(host, port, path))
+        {
+            nos::println("Client ", i, " failed to connect");
+            return 1;
+        }
+        clients.push_back(std::move(client));
+    }
+    nos::println("webkin_loadgen: ", joints.size(), " joints at ", rate, " Hz over ",
+                 mqtt.empty() ? "WebSocket" : "MQTT " + mqtt, ", ", client_count, " clients, ", duration, " s");
+
+    Stats stats;
+    std::atomic<bool> running{true};
+    std::vector<std::thread> receivers;
+    size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(1, client_count));
+    for (size_t t = 0; t < threads && client_count > 0; ++t)
+    {
+        receivers.emplace_back([&, t]()
+                               { receive_loop(clients, t, threads, stats, running); });
+    }
+
+    // The publisher's own broadcasts are read and discarded by its thread
+    std::thread publisher_drain([&]()
+                                {
+        while (running.load(std::memory_order_relaxed) && publisher.read([](std::string_view, bool) {}))
+        {
+        } });
+
+    auto publish = [&](const std::string &update)
+    {
+#ifdef HAVE_MOSQUITTO
+        if (mosq)
+            return mosquitto_publish(mosq, nullptr, topic.c_str(), static_cast<int>(update.size()), update.data(),
+                                     0, false) == MOSQ_ERR_SUCCESS;
+#endif
+        return publisher.send_text(update);
+    };
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    auto next = start;
+    auto report = start + std::chrono::seconds(1);
+    uint64_t seq = 0;
+    uint64_t last_sent = 0, last_received = 0, last_bytes = 0;
+    while (clock::now() - start < std::chrono::duration<double>(duration))
+    {
+        double t_s = std::chrono::duration<double>(clock::now() - start).count();
+        if (!publish(make_update(joints, t_s, seq++, mqtt.empty())))
+        {
+            nos::println("Publishing failed");
+            break;
+        }
+        stats.sent.fetch_add(1, std::memory_order_relaxed);
+
+        if (clock::now() >= report)
+        {
+            uint64_t sent = stats.sent, received = stats.received, bytes = stats.bytes;
+            nos::println("  sent ", sent - last_sent, "/s, received ", received - last_received, " msgs/s (",
+                         (bytes - last_bytes) / 1024, " KiB/s), latency p50 ", ms_of(stats.latency, 0.5),
+                         " ms, p99 ", ms_of(stats.latency, 0.99), " ms");
+            last_sent = sent;
+            last_received = received;
+            last_bytes = bytes;
+            report += std::chrono::seconds(1);
+        }
+
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+
+    // Let the last broadcasts arrive
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    running = false;
+    for (auto &thread : receivers)
+        thread.join();
+    publisher.shutdown();
+    publisher_drain.join();
+#ifdef HAVE_MOSQUITTO
+    if (mosq)
+    {
+        mosquitto_loop_stop(mosq, true);
+        mosquitto_destroy(mosq);
+        mosquitto_lib_cleanup();
+    }
+#endif
+
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    nos::println("Sent ", stats.sent.load(), " updates (", stats.sent / elapsed, "/s); received ",
+                 stats.received.load(), " messages (", stats.received / elapsed / std::max<size_t>(1, client_count),
+                 "/s per client), ", stats.bytes / 1024 / 1024, " MiB, ", stats.traced.load(), " traced");
+    nos::println("Latency publish -> receipt: p50 ", ms_of(stats.latency, 0.5), " ms, p90 ",
+                 ms_of(stats.latency, 0.9), " ms, p99 ", ms_of(stats.latency, 0.99), " ms, p99.9 ",
+                 ms_of(stats.latency, 0.999), " ms, max ", ms_of(stats.latency, 1.0), " ms");
+    return 0;
+}
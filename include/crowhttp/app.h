@@ -233,6 +233,12 @@ namespace crowhttp
             return router_.handle_initial(req, res);
         }
 
+        /// \brief The rule a result of handle_initial() dispatches to, null if none
+        const BaseRule* rule_for(const routing_handle_result& found) const
+        {
+            return router_.rule_for(found);
+        }
+
         /// \brief Process the fully parsed request and generate a response for it
         void handle(request& req, response& res, std::unique_ptr<routing_handle_result>& found)
         {
@@ -522,6 +528,13 @@ namespace crowhttp
             router_.validate();
         }
 
+        /// \brief Call f(const BaseRule&) for every rule, e.g. after validate() to set up per-route state
+        template<typename F>
+        void for_each_rule(F f) const
+        {
+            router_.for_each_rule(std::move(f));
+        }
+
         /// \brief Run the server
         void run()
         {
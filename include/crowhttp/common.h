@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <iostream>
 #include "crowhttp/utility.h"
@@ -229,7 +230,7 @@ namespace crowhttp
         std::vector<int64_t> int_params;
         std::vector<uint64_t> uint_params;
         std::vector<double> double_params;
-        std::vector<std::string> string_params;
+        std::vector<std::string_view> string_params; ///< Views into the URL passed to Trie::find() (the request's url).
 
         void debug_print() const
         {
@@ -272,6 +273,12 @@ namespace crowhttp
 
     template<>
     inline std::string routing_params::get<std::string>(unsigned index) const
+    {
+        return std::string(string_params[index]);
+    }
+
+    template<>
+    inline std::string_view routing_params::get<std::string_view>(unsigned index) const
     {
         return string_params[index];
     }
@@ -289,13 +296,13 @@ namespace crowhttp
 
         routing_handle_result(size_t rule_index_, std::vector<size_t> blueprint_indices_, routing_params r_params_):
           rule_index(rule_index_),
-          blueprint_indices(blueprint_indices_),
-          r_params(r_params_) {}
+          blueprint_indices(std::move(blueprint_indices_)),
+          r_params(std::move(r_params_)) {}
 
         routing_handle_result(size_t rule_index_, std::vector<size_t> blueprint_indices_, routing_params r_params_, HTTPMethod method_):
           rule_index(rule_index_),
-          blueprint_indices(blueprint_indices_),
-          r_params(r_params_),
+          blueprint_indices(std::move(blueprint_indices_)),
+          r_params(std::move(r_params_)),
           method(method_) {}
     };
 } // namespace crowhttp
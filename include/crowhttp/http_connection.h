@@ -11,10 +11,20 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #include "crowhttp/http_parser_merged.h"
 #include "crowhttp/common.h"
 #include "crowhttp/compression.h"
@@ -127,6 +137,7 @@ namespace crowhttp
             if (req_.http_ver_major == 1 && req_.http_ver_minor == 1 && get_header_value(req_.headers, "expect") == "100-continue")
             {
                 continue_requested = true;
+                flush_batch();
                 buffers_.clear();
                 static const std::string expect_100_continue = "HTTP/1.1 100 Continue\r\n\r\n";
                 buffers_.emplace_back(expect_100_continue.data(), expect_100_continue.size());
@@ -136,6 +147,13 @@ namespace crowhttp
                     CROW_LOG_ERROR << ec << " buffer write error happened while handling sending continuation buffer header";
                 }
             }
+
+            // Rules with stream_body() get the body as it arrives
+            if (const BaseRule* rule = handler_->rule_for(*routing_handle_result_))
+            {
+                if (rule->body_stream_factory())
+                    req_.body_stream = rule->body_stream_factory()();
+            }
         }
 
         void handle()
@@ -292,24 +310,16 @@ namespace crowhttp
 
         void do_write_static()
         {
-            asio::write(adaptor_.socket(), buffers_);
+            flush_batch();
+            error_code ec;
+            asio::write(adaptor_.socket(), buffers_, ec);
 
-            if (res.file_info.statResult == 0)
+            if (!ec && res.file_info.statResult == 0)
             {
-                std::ifstream is(res.file_info.path.c_str(), std::ios::in | std::ios::binary);
-                std::vector<asio::const_buffer> buffers{1};
-                char buf[16384];
-                is.read(buf, sizeof(buf));
-                while (is.gcount() > 0)
+                if (!write_static_file(res.file_info.path, res.file_info.offset, res.file_info.length))
                 {
-                    buffers[0] = asio::buffer(buf, is.gcount());
-                    error_code ec = do_write_sync(buffers);
-                    if (ec) {
-                        CROW_LOG_ERROR << ec << " - buffer write error happened while sending content of file "
-                                       << res.file_info.path << ". Writing stopped premature.";
-                        break;
-                    }
-                    is.read(buf, sizeof(buf));
+                    CROW_LOG_ERROR << "write error happened while sending content of file "
+                                   << res.file_info.path << ". Writing stopped premature.";
                 }
             }
             if (close_connection_)
@@ -325,27 +335,108 @@ namespace crowhttp
             parser_.clear();
         }
 
+        /// Send `length` bytes of a file from `offset`: sendfile(2) straight from the page cache on
+        /// plain TCP and Unix sockets, mapped chunks through the adaptor otherwise (SSL).
+        bool write_static_file(const std::string& path, size_t offset, size_t length)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            bool ok = true;
+#ifdef __linux__
+            if constexpr (std::is_same<Adaptor, SocketAdaptor>::value || std::is_same<Adaptor, UnixSocketAdaptor>::value)
+            {
+                // asio keeps its sockets non-blocking, so wait for room on EAGAIN
+                int out = adaptor_.raw_socket().native_handle();
+                off_t pos = static_cast<off_t>(offset);
+                size_t left = length;
+                while (left > 0)
+                {
+                    ssize_t sent = ::sendfile(out, fd, &pos, CROW_MIN(left, size_t(1) << 30));
+                    if (sent > 0)
+                    {
+                        left -= sent;
+                    }
+                    else if (sent < 0 && (errno == EAGAIN || errno == EINTR))
+                    {
+                        pollfd p{out, POLLOUT, 0};
+                        if (::poll(&p, 1, 30000) <= 0)
+                        {
+                            ok = false;
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        ok = false;
+                        break;
+                    }
+                }
+                ::close(fd);
+                return ok;
+            }
+#endif
+            // Map a window at a time so long files do not take address space at once
+            const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            const size_t window = size_t(8) << 20;
+            size_t pos = offset;
+            const size_t end = offset + length;
+            while (ok && pos < end)
+            {
+                size_t base = pos - pos % page;
+                size_t map_length = CROW_MIN(window, end - base);
+                void* map = ::mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(base));
+                if (map == MAP_FAILED)
+                {
+                    ok = false;
+                    break;
+                }
+                error_code ec;
+                asio::write(adaptor_.socket(), asio::buffer(static_cast<const char*>(map) + (pos - base), map_length - (pos - base)), ec);
+                ::munmap(map, map_length);
+                ok = !ec;
+                pos = base + map_length;
+            }
+            ::close(fd);
+            return ok;
+        }
+
         void do_write_general()
         {
             error_code ec;
-            if (res.body.length() < res_stream_threshold_)
+            if (res.has_body_view())
+            {
+                // Headers and the viewed body in one gather write, no copy
+                if (!res.body_view.empty())
+                    buffers_.emplace_back(res.body_view.data(), res.body_view.size());
+                ec = write_or_batch(buffers_, res.body_view.size());
+                if (ec) {
+                    CROW_LOG_ERROR << ec << " - buffer write error happened while sending response. Writing stopped premature.";
+                }
+                if (need_to_start_read_after_complete_)
+                {
+                    need_to_start_read_after_complete_ = false;
+                    resume_read();
+                }
+            }
+            else if (res.body.length() < res_stream_threshold_)
             {
                 res_body_copy_.swap(res.body);
                 buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
 
-                ec = do_write_sync(buffers_);
+                ec = write_or_batch(buffers_, res_body_copy_.size());
                 if (ec) {
                     CROW_LOG_ERROR << ec << " - buffer write error happened while sending response. Writing stopped premature.";
                 }
                 if (need_to_start_read_after_complete_)
                 {
                     need_to_start_read_after_complete_ = false;
-                    start_deadline();
-                    do_read();
+                    resume_read();
                 }
             }
             else
             {
+                flush_batch();
                 asio::write(adaptor_.socket(), buffers_,ec); // Write the response start / headers
                 if (ec) {
                     CROW_LOG_ERROR << ec << "- buffer write error happened while sending response start / headers. Writing stopped premature.";
@@ -388,43 +479,90 @@ namespace crowhttp
             adaptor_.socket().async_read_some(
               asio::buffer(buffer_),
               [self](const error_code& ec, std::size_t bytes_transferred) {
-                  bool error_while_reading = true;
-                  if (!ec)
-                  {
-                      bool ret = self->parser_.feed(self->buffer_.data(), bytes_transferred);
-                      if (ret && self->adaptor_.is_open())
-                      {
-                          error_while_reading = false;
-                      }
-                  }
-
-                  if (error_while_reading)
-                  {
-                      self->cancel_deadline_timer();
-                      self->parser_.done();
-                      self->adaptor_.shutdown_read();
-                      self->adaptor_.close();
-                      CROW_LOG_DEBUG << self << " from read(1) with description: \"" << http_errno_description(static_cast<http_errno>(self->parser_.http_errno)) << '\"';
-                  }
-                  else if (self->close_connection_)
-                  {
-                      self->cancel_deadline_timer();
-                      self->parser_.done();
-                      // adaptor will close after write
-                  }
-                  else if (!self->need_to_call_after_handlers_)
-                  {
-                      self->start_deadline();
-                      self->do_read();
-                  }
-                  else
-                  {
-                      // res will be completed later by user
-                      self->need_to_start_read_after_complete_ = true;
-                  }
+                  bool parsed = !ec && self->parser_.feed(self->buffer_.data(), bytes_transferred);
+                  self->after_feed(parsed);
               });
         }
 
+        /// Send the responses batched while parsing, then read on unless a response is still pending.
+        void after_feed(bool parsed)
+        {
+            flush_batch();
+            if (!parsed || !adaptor_.is_open())
+            {
+                cancel_deadline_timer();
+                parser_.done();
+                adaptor_.shutdown_read();
+                adaptor_.close();
+                CROW_LOG_DEBUG << this << " from read(1) with description: \"" << http_errno_description(static_cast<http_errno>(parser_.http_errno)) << '\"';
+            }
+            else if (close_connection_)
+            {
+                cancel_deadline_timer();
+                parser_.done();
+                // adaptor will close after write
+            }
+            else if (!need_to_call_after_handlers_)
+            {
+                start_deadline();
+                do_read();
+            }
+            else
+            {
+                // res will be completed later by user
+                need_to_start_read_after_complete_ = true;
+            }
+        }
+
+        /// Go on after a response completed later by the user: first the requests pipelined behind it.
+        void resume_read()
+        {
+            if (parser_.has_pending_input())
+            {
+                // On the connection's thread, the response may have been completed on any
+                auto self = this->shared_from_this();
+                asio::post(adaptor_.get_io_context(), [self] {
+                    self->after_feed(self->parser_.resume());
+                });
+            }
+            else
+            {
+                start_deadline();
+                do_read();
+            }
+        }
+
+        /// do_write_sync(), or hold the response in batch_ while more pipelined requests are
+        /// buffered, so that their responses go out in one write.
+        error_code write_or_batch(std::vector<asio::const_buffer>& buffers, size_t body_size)
+        {
+            if (parser_.more_buffered() && !close_connection_ && batch_.size() + body_size < batch_limit)
+            {
+                for (const auto& buffer : buffers)
+                    batch_.append(static_cast<const char*>(buffer.data()), buffer.size());
+                finish_response();
+                return {};
+            }
+            if (!batch_.empty())
+                buffers.insert(buffers.begin(), asio::buffer(batch_));
+            error_code ec = do_write_sync(buffers);
+            batch_.clear();
+            return ec;
+        }
+
+        void flush_batch()
+        {
+            if (batch_.empty())
+                return;
+            error_code ec;
+            asio::write(adaptor_.socket(), asio::buffer(batch_), ec);
+            if (ec)
+            {
+                CROW_LOG_DEBUG << this << " from write (batch)";
+            }
+            batch_.clear();
+        }
+
         void do_write()
         {
             auto self = this->shared_from_this();
@@ -468,6 +606,12 @@ namespace crowhttp
                 CROW_LOG_DEBUG << this << " from write (sync)(2)";
             }
 
+            finish_response();
+            return ec;
+        }
+
+        void finish_response()
+        {
             this->res.clear();
             this->res_body_copy_.clear();
             if (this->continue_requested)
@@ -478,8 +622,6 @@ namespace crowhttp
             {
                 this->parser_.clear();
             }
-
-            return ec;
         }
 
         void cancel_deadline_timer()
@@ -523,6 +665,9 @@ namespace crowhttp
         std::string content_length_;
         std::string date_str_;
         std::string res_body_copy_;
+        std::string batch_; ///< Responses to pipelined requests, not written yet
+
+        static constexpr size_t batch_limit = 64 * 1024;
 
         detail::task_timer::identifier_type task_id_{};
 
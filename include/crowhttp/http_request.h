@@ -9,6 +9,9 @@
 #include <asio.hpp>
 #endif
 
+#include <memory>
+#include <string_view>
+
 #include "crowhttp/common.h"
 #include "crowhttp/ci_map.h"
 #include "crowhttp/query_string.h"
@@ -31,6 +34,15 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
         return empty;
     }
 
+    class BaseRule;
+
+    /// Receiver of a request body as it arrives, for rules with `stream_body<T>()`.
+    struct request_body_stream
+    {
+        virtual ~request_body_stream() = default;
+        virtual void write(std::string_view chunk) = 0;
+    };
+
     /// An HTTP request.
     struct request
     {
@@ -49,6 +61,8 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
         void* middleware_context{};
         void* middleware_container{};
         asio::io_context* io_context{};
+        const BaseRule* matched_rule{}; ///< The rule handling this request, set by the router; null if none matched.
+        std::shared_ptr<request_body_stream> body_stream; ///< Receives the body instead of `body` if the rule streams it.
 
         /// Construct an empty request. (sets the method to `GET`)
         request():
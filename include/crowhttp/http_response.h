@@ -1,5 +1,7 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <ios>
 #include <fstream>
@@ -54,6 +56,11 @@ namespace crowhttp
         bool compressed = true; ///< If compression is enabled and this is false, the individual response will not be compressed.
 #endif
         bool skip_body = false;            ///< Whether this is a response to a HEAD request.
+
+        /// Non-owning body sent instead of `body` when set, see set_body_view().
+        std::string_view body_view;
+        /// Keeps the memory of body_view alive until the response is written, may be null for static data.
+        std::shared_ptr<const void> body_owner;
         bool manual_length_header = false; ///< Whether Crow should automatically add a "Content-Length" header.
 
         /// Set the value of an existing header in the response.
@@ -175,6 +182,8 @@ namespace crowhttp
         response& operator=(response&& r) noexcept
         {
             body = std::move(r.body);
+            body_view = r.body_view;
+            body_owner = std::move(r.body_owner);
             code = r.code;
             headers = std::move(r.headers);
             completed_ = r.completed_;
@@ -191,6 +200,8 @@ namespace crowhttp
         void clear()
         {
             body.clear();
+            body_view = {};
+            body_owner.reset();
             code = 200;
             headers.clear();
             completed_ = false;
@@ -237,6 +248,31 @@ namespace crowhttp
             set_header("Location", location);
         }
 
+        /// Send `data` as the body without copying it; `owner` keeps it alive
+        /// while the response is written (null for data that lives as long as
+        /// the program, such as embedded resources). Not compressed by Crow.
+        void set_body_view(std::string_view data, std::shared_ptr<const void> owner = nullptr)
+        {
+            body.clear();
+            body_view = data;
+            body_owner = std::move(owner);
+#ifdef CROW_ENABLE_COMPRESSION
+            compressed = false;
+#endif
+        }
+
+        /// Whether the body is a view set by set_body_view().
+        bool has_body_view() const noexcept
+        {
+            return body_view.data() != nullptr;
+        }
+
+        /// Size of the body that will be sent.
+        size_t body_size() const noexcept
+        {
+            return has_body_view() ? body_view.size() : body.size();
+        }
+
         void write(const std::string& body_part)
         {
             body += body_part;
@@ -250,13 +286,18 @@ namespace crowhttp
                 completed_ = true;
                 if (skip_body)
                 {
-                    set_header("Content-Length", std::to_string(body.size()));
+                    set_header("Content-Length", std::to_string(body_size()));
                     body = "";
+                    body_view = {};
+                    body_owner.reset();
                     manual_length_header = true;
                 }
                 if (complete_request_handler_)
                 {
-                    complete_request_handler_();
+                    // The handler resets itself and may hold the last
+                    // reference to the connection that owns this response
+                    auto handler = complete_request_handler_;
+                    handler();
                     manual_length_header = false;
                     skip_body = false;
                 }
@@ -291,6 +332,8 @@ namespace crowhttp
             std::string path = "";
             struct stat statbuf;
             int statResult;
+            size_t offset = 0; ///< First byte to send
+            size_t length = 0; ///< Bytes to send, the whole file unless set_static_file_range() was called
         };
 
         /// Return a static file as the response body, the content_type may be specified explicitly.
@@ -312,6 +355,8 @@ namespace crowhttp
             if (file_info.statResult == 0 && S_ISREG(file_info.statbuf.st_mode))
             {
                 code = 200;
+                file_info.offset = 0;
+                file_info.length = file_info.statbuf.st_size;
                 this->add_header("Content-Length", std::to_string(file_info.statbuf.st_size));
 
                 if (content_type.empty())
@@ -336,6 +381,15 @@ namespace crowhttp
             }
         }
 
+        /// Send only `length` bytes of the static file starting at `offset`, e.g. for a Range request.
+        /// The status code and Content-Range are up to the caller.
+        void set_static_file_range(size_t offset, size_t length)
+        {
+            file_info.offset = offset;
+            file_info.length = length;
+            set_header("Content-Length", std::to_string(length));
+        }
+
     private:
         void write_header_into_buffer(std::vector<asio::const_buffer>& buffers, std::string& content_length_buffer, bool add_keep_alive, const std::string& server_name)
         {
@@ -402,7 +456,7 @@ namespace crowhttp
             auto& status = statusCodes.find(code)->second;
             buffers.emplace_back(status.data(), status.size());
 
-            if (code >= 400 && body.empty())
+            if (code >= 400 && body.empty() && !has_body_view())
                 body = statusCodes[code].substr(9);
 
             for (auto& kv : headers)
@@ -415,7 +469,7 @@ namespace crowhttp
 
             if (!manual_length_header && !headers.count("content-length"))
             {
-                content_length_buffer = std::to_string(body.size());
+                content_length_buffer = std::to_string(body_size());
                 static std::string content_length_tag = "Content-Length: ";
                 buffers.emplace_back(content_length_tag.data(), content_length_tag.size());
                 buffers.emplace_back(content_length_buffer.data(), content_length_buffer.size());
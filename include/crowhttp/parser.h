@@ -88,7 +88,10 @@ namespace crowhttp
         static int on_body(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
-            self->req.body.insert(self->req.body.end(), at, at + length);
+            if (self->req.body_stream)
+                self->req.body_stream->write(std::string_view(at, length));
+            else
+                self->req.body.insert(self->req.body.end(), at, at + length);
             return 0;
         }
         static int on_message_complete(http_parser* self_)
@@ -96,8 +99,8 @@ namespace crowhttp
             HTTPParser* self = static_cast<HTTPParser*>(self_);
 
             self->message_complete = true;
-            self->process_message();
-            return 0;
+            // Stop after the message: feed() handles it before parsing a pipelined one
+            return 1;
         }
         HTTPParser(Handler* handler):
           http_parser(),
@@ -108,10 +111,18 @@ namespace crowhttp
 
         // return false on error
         /// Parse a buffer into the different sections of an HTTP request.
+        ///
+        /// Requests are handled one by one as they complete, so one buffer may hold several
+        /// pipelined requests. If a response is completed later by the user, the bytes behind
+        /// its request are kept and parsed by resume() once it is written.
         bool feed(const char* buffer, int length)
         {
             if (message_complete)
+            {
+                // Behind a response that is not written yet
+                pending_input_.append(buffer, length);
                 return true;
+            }
 
             const static http_parser_settings settings_{
               on_message_begin,
@@ -124,12 +135,34 @@ namespace crowhttp
               on_message_complete,
             };
 
-            int nparsed = http_parser_execute(this, &settings_, buffer, length);
-            if (http_errno != CHPE_OK)
+            int offset = 0;
+            for (;;)
             {
-                return false;
+                int nparsed = http_parser_execute(this, &settings_, buffer + offset, length - offset);
+                offset += nparsed;
+                if (http_errno == CHPE_CB_message_complete)
+                {
+                    // Stopped by on_message_complete
+                    http_errno = CHPE_OK;
+                    more_buffered_ = offset < length;
+                    process_message();
+                    more_buffered_ = false;
+                    if (message_complete)
+                    {
+                        // The response is pending (or the connection was upgraded)
+                        pending_input_.assign(buffer + offset, length - offset);
+                        return true;
+                    }
+                    if (offset < length)
+                        continue;
+                    return true;
+                }
+                if (http_errno != CHPE_OK)
+                {
+                    return false;
+                }
+                return offset == length;
             }
-            return nparsed == length;
         }
 
         bool done()
@@ -137,6 +170,26 @@ namespace crowhttp
             return feed(nullptr, 0);
         }
 
+        /// Parse the input kept behind a response that has been written since.
+        bool resume()
+        {
+            std::string input = std::move(pending_input_);
+            pending_input_.clear();
+            return feed(input.data(), static_cast<int>(input.size()));
+        }
+
+        /// Whether resume() has input to parse.
+        bool has_pending_input() const
+        {
+            return !pending_input_.empty();
+        }
+
+        /// While a request is handled: whether more requests are already buffered behind it.
+        bool more_buffered() const
+        {
+            return more_buffered_;
+        }
+
         void clear()
         {
             req = crowhttp::request();
@@ -190,8 +243,10 @@ namespace crowhttp
     private:
         int header_building_state = 0;
         bool message_complete = false;
+        bool more_buffered_ = false;
         std::string header_field;
         std::string header_value;
+        std::string pending_input_; ///< Pipelined input behind a pending response
 
         Handler* handler_; ///< This is currently an HTTP connection object (\ref crow.Connection).
     };
@@ -135,13 +135,13 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
         }
 #endif
 
-        uint32_t get_methods()
+        uint32_t get_methods() const
         {
             return methods_;
         }
 
         template<typename F>
-        void foreach_method(F f)
+        void foreach_method(F f) const
         {
             for (uint32_t method = 0, method_bit = 1; method < static_cast<uint32_t>(HTTPMethod::InternalMethodCount); method++, method_bit <<= 1)
             {
@@ -152,7 +152,13 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
 
         std::string custom_templates_base;
 
-        const std::string& rule() { return rule_; }
+        const std::string& rule() const { return rule_; }
+
+        /// Creates the body_stream of a request, empty if the body is buffered in req.body.
+        const std::function<std::shared_ptr<request_body_stream>()>& body_stream_factory() const
+        {
+            return body_stream_factory_;
+        }
 
     protected:
         uint32_t methods_{1 << static_cast<int>(HTTPMethod::Get)};
@@ -162,6 +168,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
         bool added_{false};
 
         std::unique_ptr<BaseRule> rule_to_upgrade_;
+        std::function<std::shared_ptr<request_body_stream>()> body_stream_factory_;
 
         detail::middleware_indices mw_indices_;
 
@@ -236,6 +243,16 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                 }
             };
 
+            template<typename F, int NInt, int NUint, int NDouble, int NString, typename... Args1, typename... Args2>
+            struct call<F, NInt, NUint, NDouble, NString, black_magic::S<std::string_view, Args1...>, black_magic::S<Args2...>>
+            {
+                void operator()(F cparams)
+                {
+                    using pushed = typename black_magic::S<Args2...>::template push_back<call_pair<std::string_view, NString>>;
+                    call<F, NInt, NUint, NDouble, NString + 1, black_magic::S<Args1...>, pushed>()(cparams);
+                }
+            };
+
             template<typename F, int NInt, int NUint, int NDouble, int NString, typename... Args1>
             struct call<F, NInt, NUint, NDouble, NString, black_magic::S<>, black_magic::S<Args1...>>
             {
@@ -446,19 +463,19 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
         void handle_upgrade(const request& req, response&, SocketAdaptor&& adaptor) override
         {
             max_payload_ = max_payload_override_ ? max_payload_ : app_->websocket_max_payload();
-            crowhttp::websocket::Connection<SocketAdaptor, App>::create(req, std::move(adaptor), app_, max_payload_, subprotocols_, open_handler_, message_handler_, close_handler_, error_handler_, accept_handler_, mirror_protocols_);
+            crowhttp::websocket::Connection<SocketAdaptor, App>::create(req, std::move(adaptor), app_, max_payload_, subprotocols_, open_handler_, message_handler_, close_handler_, error_handler_, accept_handler_, mirror_protocols_, permessage_deflate_);
         }
 
         void handle_upgrade(const request& req, response&, UnixSocketAdaptor&& adaptor) override
         {
             max_payload_ = max_payload_override_ ? max_payload_ : app_->websocket_max_payload();
-            crowhttp::websocket::Connection<UnixSocketAdaptor, App>::create(req, std::move(adaptor), app_, max_payload_, subprotocols_, open_handler_, message_handler_, close_handler_, error_handler_, accept_handler_, mirror_protocols_);
+            crowhttp::websocket::Connection<UnixSocketAdaptor, App>::create(req, std::move(adaptor), app_, max_payload_, subprotocols_, open_handler_, message_handler_, close_handler_, error_handler_, accept_handler_, mirror_protocols_, permessage_deflate_);
         }
 
 #ifdef CROW_ENABLE_SSL
         void handle_upgrade(const request& req, response&, SSLAdaptor&& adaptor) override
         {
-            crowhttp::websocket::Connection<SSLAdaptor, App>::create(req, std::move(adaptor), app_, max_payload_, subprotocols_, open_handler_, message_handler_, close_handler_, error_handler_, accept_handler_, mirror_protocols_);
+            crowhttp::websocket::Connection<SSLAdaptor, App>::create(req, std::move(adaptor), app_, max_payload_, subprotocols_, open_handler_, message_handler_, close_handler_, error_handler_, accept_handler_, mirror_protocols_, permessage_deflate_);
         }
 #endif
 
@@ -528,6 +545,13 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             return *this;
         }
 
+        /// Accept permessage-deflate (RFC 7692) when the client offers it
+        self_t& permessage_deflate(bool enabled = true)
+        {
+            permessage_deflate_ = enabled;
+            return *this;
+        }
+
     protected:
         App* app_;
         std::function<void(crowhttp::websocket::connection&)> open_handler_;
@@ -536,6 +560,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
         std::function<void(crowhttp::websocket::connection&, const std::string&)> error_handler_;
         std::function<void(const crowhttp::request&, std::optional<crowhttp::response>&, void**)> accept_handler_;
         bool mirror_protocols_ = false;
+        bool permessage_deflate_ = false;
         uint64_t max_payload_;
         bool max_payload_override_ = false;
         std::vector<std::string> subprotocols_;
@@ -578,6 +603,19 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             return static_cast<self_t&>(*this);
         }
 
+        /// Pass the body to a new Stream per request as it arrives, instead of collecting it in req.body.
+
+        ///
+        /// The handler finds the stream in req.body_stream once the whole body was written to it.
+        template<typename Stream>
+        self_t& stream_body()
+        {
+            static_cast<self_t*>(this)->body_stream_factory_ = [] {
+                return std::make_shared<Stream>();
+            };
+            return static_cast<self_t&>(*this);
+        }
+
         /// Enable local middleware for this handler
         template<typename App, typename... Middlewares>
         self_t& middlewares()
@@ -849,6 +887,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             if (!head_.IsSimpleNode())
                 throw std::runtime_error("Internal error: Trie header should be simple!");
             optimize();
+            build_static_table();
         }
 
         //Rule_index, Blueprint_index, routing_params
@@ -964,7 +1003,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                         if (epos != pos)
                         {
                             found_fragment = true;
-                            params->string_params.push_back(req_url.substr(pos, epos - pos));
+                            params->string_params.push_back(std::string_view(req_url).substr(pos, epos - pos));
                             if (child.blueprint_index != INVALID_BP_ID) blueprints->push_back(child.blueprint_index);
                             auto ret = find(req_url, child, epos, params, blueprints);
                             update_found(ret);
@@ -980,7 +1019,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                         if (epos != pos)
                         {
                             found_fragment = true;
-                            params->string_params.push_back(req_url.substr(pos, epos - pos));
+                            params->string_params.push_back(std::string_view(req_url).substr(pos, epos - pos));
                             if (child.blueprint_index != INVALID_BP_ID) blueprints->push_back(child.blueprint_index);
                             auto ret = find(req_url, child, epos, params, blueprints);
                             update_found(ret);
@@ -1012,9 +1051,27 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
 
         routing_handle_result find(const std::string& req_url) const
         {
+            // Parameterless routes first: one hash and one compare
+            if (size_t rule_index = find_static(req_url))
+                return routing_handle_result{rule_index, {}, {}};
             return find(req_url, head_);
         }
 
+        /// Rule index of a URL in the static route table, 0 if it is not there.
+        size_t find_static(const std::string& req_url) const
+        {
+            if (static_table_.empty() || req_url.size() < static_min_size_ || req_url.size() > static_max_size_)
+                return 0;
+            const StaticRoute& slot = static_table_[static_hash(req_url, static_seed_) & (static_table_.size() - 1)];
+            return slot.rule_index && slot.url == req_url ? slot.rule_index : 0;
+        }
+
+        /// Routes in the static route table.
+        size_t static_route_count() const
+        {
+            return static_count_;
+        }
+
         //This functions assumes any blueprint info passed is valid
         void add(const std::string& url, size_t rule_index, unsigned bp_prefix_length = 0, size_t blueprint_index = INVALID_BP_ID)
         {
@@ -1099,10 +1156,90 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             if (idx->rule_index)
                 throw std::runtime_error("handler already exists for " + url);
             idx->rule_index = rule_index;
+
+            if (!has_blueprint && url.find('<') == std::string::npos)
+                static_routes_.push_back({url, rule_index});
+            static_table_.clear(); // Rebuilt by validate()
         }
 
     private:
+        struct StaticRoute
+        {
+            std::string url;
+            size_t rule_index{};
+        };
+
+        static uint64_t static_hash(const std::string& url, uint64_t seed)
+        {
+            uint64_t h = 14695981039346656037ull ^ seed;
+            for (unsigned char c : url)
+                h = (h ^ c) * 1099511628211ull;
+            return h ^ (h >> 29);
+        }
+
+        /// Perfect hash of the parameterless routes: the table size and seed
+        /// are searched until every route has a slot of its own. A route is
+        /// left to the trie unless the trie resolves its URL to it alone,
+        /// e.g. "/api/x" goes to the trie if an earlier "/api/<string>" wins.
+        void build_static_table()
+        {
+            static_table_.clear();
+            static_count_ = 0;
+            std::vector<const StaticRoute*> routes;
+            for (const auto& route : static_routes_)
+            {
+                routing_handle_result generic = find(route.url, head_);
+                if (generic.rule_index == route.rule_index && generic.blueprint_indices.empty())
+                    routes.push_back(&route);
+            }
+            if (routes.empty())
+                return;
+
+            size_t size = 1;
+            while (size < 2 * routes.size())
+                size <<= 1;
+            for (; size <= 16 * routes.size(); size <<= 1)
+            {
+                for (uint64_t seed = 0; seed < 256; seed++)
+                {
+                    std::vector<StaticRoute> table(size);
+                    bool collision = false;
+                    for (const StaticRoute* route : routes)
+                    {
+                        StaticRoute& slot = table[static_hash(route->url, seed) & (size - 1)];
+                        if (slot.rule_index)
+                        {
+                            collision = true;
+                            break;
+                        }
+                        slot = *route;
+                    }
+                    if (collision)
+                        continue;
+
+                    static_table_ = std::move(table);
+                    static_seed_ = seed;
+                    static_count_ = routes.size();
+                    static_min_size_ = SIZE_MAX;
+                    static_max_size_ = 0;
+                    for (const StaticRoute* route : routes)
+                    {
+                        static_min_size_ = std::min(static_min_size_, route->url.size());
+                        static_max_size_ = std::max(static_max_size_, route->url.size());
+                    }
+                    return;
+                }
+            }
+            CROW_LOG_WARNING << "No perfect hash for " << routes.size() << " static routes, using the trie";
+        }
+
         Node head_;
+        std::vector<StaticRoute> static_routes_; // Parameterless routes as added
+        std::vector<StaticRoute> static_table_;  // Slot of every routed URL, empty until validate()
+        uint64_t static_seed_{};
+        size_t static_count_{};
+        size_t static_min_size_{};
+        size_t static_max_size_{};
     };
 
     /// A blueprint can be considered a smaller section of a Crow app, specifically where the router is concerned.
@@ -1696,9 +1833,19 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             }
         }
 
+        /// The rule a result of handle_initial() dispatches to; null for catch-all, redirects and errors.
+        const BaseRule* rule_for(const routing_handle_result& found) const
+        {
+            if (found.catch_all || found.rule_index <= RULE_SPECIAL_REDIRECT_SLASH || found.method >= HTTPMethod::InternalMethodCount)
+                return nullptr;
+            const auto& rules = per_methods_[static_cast<int>(found.method)].rules;
+            return found.rule_index < rules.size() ? rules[found.rule_index] : nullptr;
+        }
+
         template<typename App>
         void handle(request& req, response& res, routing_handle_result found)
         {
+            req.matched_rule = nullptr;
             if (found.catch_all) {
                 auto catch_all = get_catch_all(found);
                 if (catch_all.has_handler()) {
@@ -1730,6 +1877,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
 
                     try {
                         BaseRule &rule = *rules[rule_index];
+                        req.matched_rule = &rule;
                         handle_rule<App>(rule, req, res, found.r_params);
                     } catch (...) {
                         exception_handler_(res);
@@ -1800,6 +1948,17 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             return blueprints_;
         }
 
+        /// Call f(rule) for every rule added by validate(), once per rule.
+        template<typename F>
+        void for_each_rule(F f) const
+        {
+            for (const auto& rule : all_rules_)
+            {
+                if (rule)
+                    f(static_cast<const BaseRule&>(*rule));
+            }
+        }
+
         std::function<void(crowhttp::response&)>& exception_handler()
         {
             return exception_handler_;
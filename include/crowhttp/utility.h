@@ -158,6 +158,7 @@ namespace crowhttp
         CROW_INTERNAL_PARAMETER_TAG(unsigned long long, 2);
         CROW_INTERNAL_PARAMETER_TAG(double, 3);
         CROW_INTERNAL_PARAMETER_TAG(std::string, 4);
+        CROW_INTERNAL_PARAMETER_TAG(std::string_view, 4);
 #undef CROW_INTERNAL_PARAMETER_TAG
         template<typename... Args>
         struct compute_parameter_tag_from_args_list;
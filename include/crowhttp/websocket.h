@@ -1,8 +1,11 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <thread>
 #include "crowhttp/http_response.h"
 #include "crowhttp/logging.h"
@@ -10,6 +13,9 @@
 #include "crowhttp/http_request.h"
 #include "crowhttp/TinySHA1.hpp"
 #include "crowhttp/utility.h"
+#ifdef CROW_ENABLE_COMPRESSION
+#include <zlib.h>
+#endif
 
 namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
 {
@@ -62,11 +68,276 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             EndStatusCodes = 4999,
         };
 
+        /// Generate the websocket headers using an opcode and the message size (in bytes).
+
+        ///
+        /// `compressed` sets RSV1, marking a permessage-deflate message (RFC 7692).
+        inline std::string build_frame_header(int opcode, size_t size, bool compressed = false)
+        {
+            char buf[2 + 8] = "\x80\x00";
+            buf[0] += opcode;
+            if (compressed)
+                buf[0] |= 0x40;
+            if (size < 126)
+            {
+                buf[1] += static_cast<char>(size);
+                return {buf, buf + 2};
+            }
+            else if (size < 0x10000)
+            {
+                buf[1] += 126;
+                *(uint16_t*)(buf + 2) = htons(static_cast<uint16_t>(size));
+                return {buf, buf + 4};
+            }
+            else
+            {
+                buf[1] += 127;
+                *reinterpret_cast<uint64_t*>(buf + 2) = ((1 == htonl(1)) ? static_cast<uint64_t>(size) : (static_cast<uint64_t>(htonl((size)&0xFFFFFFFF)) << 32) | htonl(static_cast<uint64_t>(size) >> 32));
+                return {buf, buf + 10};
+            }
+        }
+
+        /// Compress one message for permessage-deflate without context takeover.
+
+        ///
+        /// Returns false if compression is unavailable or would not make the message smaller.
+        inline bool deflate_message(std::string_view payload, int window_bits, std::string& out)
+        {
+#ifdef CROW_ENABLE_COMPRESSION
+            // One raw deflate stream per window size and thread, reset for every message
+            struct Deflaters
+            {
+                std::array<z_stream, 16> streams{};
+                std::array<bool, 16> ready{};
+
+                ~Deflaters()
+                {
+                    for (size_t i = 0; i < streams.size(); i++)
+                        if (ready[i])
+                            deflateEnd(&streams[i]);
+                }
+            };
+            thread_local Deflaters deflaters;
+
+            if (window_bits < 9 || window_bits > 15 || payload.size() < 64 || payload.size() >= (1u << 30))
+                return false;
+            z_stream& stream = deflaters.streams[window_bits];
+            if (!deflaters.ready[window_bits])
+            {
+                if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return false;
+                deflaters.ready[window_bits] = true;
+            }
+            else
+                deflateReset(&stream);
+
+            out.resize(deflateBound(&stream, payload.size()) + 16);
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data()));
+            stream.avail_in = static_cast<uInt>(payload.size());
+            stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+            stream.avail_out = static_cast<uInt>(out.size());
+            if (deflate(&stream, Z_SYNC_FLUSH) != Z_OK || stream.avail_in != 0)
+                return false;
+
+            // The sync flush ends with an empty stored block (00 00 ff ff) that the receiver appends back
+            size_t length = out.size() - stream.avail_out;
+            if (length < 4 || length - 4 >= payload.size())
+                return false;
+            out.resize(length - 4);
+            return true;
+#else
+            (void)payload;
+            (void)window_bits;
+            (void)out;
+            return false;
+#endif
+        }
+
+        /// A complete websocket frame (header + payload), built once and shared between connections.
+
+        ///
+        /// Data frames also have permessage-deflate variants, compressed on first use once per
+        /// window size, so all clients that negotiated the same parameters share one compressed frame.
+        class frame
+        {
+        public:
+            frame(int opcode, std::string_view payload):
+              opcode_(opcode)
+            {
+                std::string header = build_frame_header(opcode, payload.size());
+                header_size_ = header.size();
+                plain_.reserve(header.size() + payload.size());
+                plain_.append(header);
+                plain_.append(payload);
+            }
+
+            /// The uncompressed frame.
+            const std::string& plain() const
+            {
+                return plain_;
+            }
+
+            size_t size() const
+            {
+                return plain_.size();
+            }
+
+            /// The frame for a connection whose server window is `window_bits` (9..15);
+            /// the plain frame if compressing does not pay off.
+            const std::string& deflated(int window_bits) const
+            {
+                // Control frames are never compressed
+                if (opcode_ != 0x1 && opcode_ != 0x2)
+                    return plain_;
+                auto& variant = deflated_[static_cast<size_t>(window_bits - 8) % deflated_.size()];
+                std::call_once(variant.once, [&] {
+                    std::string body;
+                    if (deflate_message(std::string_view(plain_).substr(header_size_), window_bits, body))
+                    {
+                        variant.data = build_frame_header(opcode_, body.size(), true);
+                        variant.data += body;
+                        variant.compressed = true;
+                    }
+                });
+                return variant.compressed ? variant.data : plain_;
+            }
+
+        private:
+            struct Variant
+            {
+                std::once_flag once;
+                std::string data;
+                bool compressed = false;
+            };
+
+            int opcode_;
+            size_t header_size_;
+            std::string plain_;
+            mutable std::array<Variant, 8> deflated_;
+        };
+
+        using shared_frame = std::shared_ptr<const frame>;
+
+        /// Frame a payload once so it can be sent to many connections without copying.
+        inline shared_frame make_shared_frame(int opcode, std::string_view payload)
+        {
+            return std::make_shared<frame>(opcode, payload);
+        }
+
+        /// Negotiated permessage-deflate parameters (RFC 7692).
+        struct deflate_params
+        {
+            int server_window_bits = 0; ///< 0 if permessage-deflate is off
+            bool client_no_context_takeover = false;
+        };
+
+        /// Accept the first acceptable permessage-deflate offer of a Sec-WebSocket-Extensions header.
+
+        ///
+        /// The server always compresses without context takeover, so that a message can be
+        /// compressed once for every client; hence offers requiring a window of 8 bits, which
+        /// zlib cannot produce, are declined.
+        inline deflate_params negotiate_deflate(std::string_view header)
+        {
+#ifdef CROW_ENABLE_COMPRESSION
+            auto trim = [](std::string_view v) {
+                while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+                    v.remove_prefix(1);
+                while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+                    v.remove_suffix(1);
+                return v;
+            };
+            auto split = [](std::string_view& v, char c) {
+                size_t pos = v.find(c);
+                std::string_view item = v.substr(0, pos);
+                v = pos == std::string_view::npos ? std::string_view() : v.substr(pos + 1);
+                return item;
+            };
+            auto window_bits = [](std::string_view v) {
+                if (v.size() >= 2 && v.front() == '"' && v.back() == '"')
+                    v = v.substr(1, v.size() - 2);
+                if (v.empty() || v.size() > 2)
+                    return -1;
+                int bits = 0;
+                for (char c : v)
+                {
+                    if (c < '0' || c > '9')
+                        return -1;
+                    bits = bits * 10 + (c - '0');
+                }
+                return bits >= 8 && bits <= 15 ? bits : -1;
+            };
+
+            while (!header.empty())
+            {
+                std::string_view offer = split(header, ',');
+                if (trim(split(offer, ';')) != "permessage-deflate")
+                    continue;
+
+                deflate_params params{15, false};
+                bool server_no_context_takeover = false, client_max_window_bits = false, server_max_window_bits = false;
+                bool valid = true;
+                while (valid && !offer.empty())
+                {
+                    std::string_view value = trim(split(offer, ';'));
+                    std::string_view name = trim(split(value, '='));
+                    value = trim(value);
+                    if (name == "server_no_context_takeover" && !server_no_context_takeover && value.empty())
+                        server_no_context_takeover = true;
+                    else if (name == "client_no_context_takeover" && !params.client_no_context_takeover && value.empty())
+                        params.client_no_context_takeover = true;
+                    else if (name == "server_max_window_bits" && !server_max_window_bits)
+                    {
+                        server_max_window_bits = true;
+                        params.server_window_bits = window_bits(value);
+                        valid = params.server_window_bits > 8;
+                    }
+                    else if (name == "client_max_window_bits" && !client_max_window_bits)
+                    {
+                        // The client may use any window: messages are inflated with the largest one
+                        client_max_window_bits = true;
+                        valid = value.empty() || window_bits(value) > 0;
+                    }
+                    else
+                        valid = false;
+                }
+                if (valid)
+                    return params;
+            }
+#else
+            (void)header;
+#endif
+            return {};
+        }
+
+        inline shared_frame make_text_frame(std::string_view payload)
+        {
+            return make_shared_frame(0x1, payload);
+        }
+
+        inline shared_frame make_binary_frame(std::string_view payload)
+        {
+            return make_shared_frame(0x2, payload);
+        }
+
         /// A base class for websocket connection.
         struct connection
         {
             virtual void send_binary(std::string msg) = 0;
             virtual void send_text(std::string msg) = 0;
+            /// Queue a pre-framed message; the frame is referenced, not copied.
+            virtual void send_frame(shared_frame frame) = 0;
+            /// Queue a frame that supersedes any still unsent frame queued the same way (latest value wins).
+            virtual void send_latest(shared_frame frame) = 0;
+            /// Limit the send queue: above high_water bytes send_latest() frames are dropped,
+            /// above max_queued bytes the connection is closed. 0 disables a limit.
+            virtual void set_send_limits(size_t high_water, size_t max_queued) = 0;
+            /// Bytes queued or in flight, not yet accepted by the socket.
+            virtual size_t queued_bytes() const = 0;
+            /// Number of send_latest() frames replaced or dropped before being sent.
+            virtual uint64_t dropped_frames() const = 0;
+            /// True once after send_latest() dropped a frame, so stateful (delta) streams can resync.
+            virtual bool take_dropped() = 0;
             virtual void send_ping(std::string msg) = 0;
             virtual void send_pong(std::string msg) = 0;
             virtual void close(std::string const& msg = "quit", uint16_t status_code = CloseStatusCode::NormalClosure) = 0;
@@ -121,7 +392,7 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                                std::function<void(crowhttp::websocket::connection&, const std::string&, uint16_t)> close_handler,
                                std::function<void(crowhttp::websocket::connection&, const std::string&)> error_handler,
                                std::function<void(const crowhttp::request&, std::optional<crowhttp::response>&, void**)> accept_handler,
-                               bool mirror_protocols)
+                               bool mirror_protocols, bool permessage_deflate = false)
             {
                 auto conn = std::shared_ptr<Connection>(new Connection(std::move(adaptor), 
                                                                        handler, max_payload,
@@ -154,6 +425,11 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                     conn->subprotocol_ = requested_subprotocols_header;
                 }
 
+                if (permessage_deflate)
+                {
+                    conn->deflate_ = negotiate_deflate(req.get_header_value("Sec-WebSocket-Extensions"));
+                }
+
                 if (conn->accept_handler_)
                 {
                     void* ud = nullptr;
@@ -186,7 +462,13 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                 conn->start(crowhttp::utility::base64encode((unsigned char*)digest, 20));
             }
 
-            ~Connection() noexcept override = default;
+            ~Connection() noexcept override
+            {
+#ifdef CROW_ENABLE_COMPRESSION
+                if (inflater_ready_)
+                    inflateEnd(&inflater_);
+#endif
+            }
 
             template<typename Callable>
             struct WeakWrappedMessage
@@ -251,6 +533,62 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                 send_data(0x1, std::move(msg));
             }
 
+            /// Send a frame made by make_shared_frame().
+            void send_frame(shared_frame frame) override
+            {
+                post([this, frame = std::move(frame)]() mutable {
+                    enqueue(frame_buffer(std::move(frame)));
+                    do_write();
+                });
+            }
+
+            /// Send a frame that replaces the previous unsent send_latest() frame.
+
+            ///
+            /// A slow client thus keeps at most one stale frame queued instead of a growing backlog.
+            void send_latest(shared_frame frame) override
+            {
+                post([this, frame = std::move(frame)]() mutable {
+                    if (latest_frame_)
+                    {
+                        count_dropped();
+                        queued_bytes_ -= frame_data(*latest_frame_).size();
+                        latest_frame_.reset();
+                    }
+                    // Backlogged above the high-water mark: any pose would be stale by the
+                    // time it is sent, so drop it and let the caller resync later
+                    if (high_water_bytes_ && queued_bytes_ > high_water_bytes_)
+                    {
+                        count_dropped();
+                        return;
+                    }
+                    queued_bytes_ += frame_data(*frame).size();
+                    latest_frame_ = std::move(frame);
+                    do_write();
+                });
+            }
+
+            void set_send_limits(size_t high_water, size_t max_queued) override
+            {
+                high_water_bytes_ = high_water;
+                max_queued_bytes_ = max_queued;
+            }
+
+            size_t queued_bytes() const override
+            {
+                return queued_bytes_;
+            }
+
+            uint64_t dropped_frames() const override
+            {
+                return dropped_frames_;
+            }
+
+            bool take_dropped() override
+            {
+                return dropped_since_take_.exchange(false);
+            }
+
             /// Send a close signal.
 
             ///
@@ -269,9 +607,9 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                     char status_buf[2];
                     *(uint16_t*)(status_buf) = htons(status_code);
 
-                    shared_this->write_buffers_.emplace_back(std::move(header));
-                    shared_this->write_buffers_.emplace_back(std::string(status_buf, 2));
-                    shared_this->write_buffers_.emplace_back(msg);
+                    shared_this->enqueue(std::move(header));
+                    shared_this->enqueue(std::string(status_buf, 2));
+                    shared_this->enqueue(msg);
                     shared_this->do_write();
                 });
             }
@@ -293,28 +631,44 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             }
 
         protected:
-            /// Generate the websocket headers using an opcode and the message size (in bytes).
-            std::string build_header(int opcode, size_t size)
+            /// An entry of the write queue: either an owned string or a variant of a shared frame.
+            struct WriteBuffer
             {
-                char buf[2 + 8] = "\x80\x00";
-                buf[0] += opcode;
-                if (size < 126)
-                {
-                    buf[1] += static_cast<char>(size);
-                    return {buf, buf + 2};
-                }
-                else if (size < 0x10000)
+                std::string owned;
+                shared_frame shared;
+                const std::string* data = nullptr; ///< The variant of `shared` to send
+
+                WriteBuffer(std::string s): owned(std::move(s)) {}
+                WriteBuffer(const char* s): owned(s) {}
+                WriteBuffer(shared_frame f, const std::string& d): shared(std::move(f)), data(&d) {}
+
+                asio::const_buffer buffer() const
                 {
-                    buf[1] += 126;
-                    *(uint16_t*)(buf + 2) = htons(static_cast<uint16_t>(size));
-                    return {buf, buf + 4};
+                    return shared ? asio::buffer(*data) : asio::buffer(owned);
                 }
-                else
+
+                size_t size() const
                 {
-                    buf[1] += 127;
-                    *reinterpret_cast<uint64_t*>(buf + 2) = ((1 == htonl(1)) ? static_cast<uint64_t>(size) : (static_cast<uint64_t>(htonl((size)&0xFFFFFFFF)) << 32) | htonl(static_cast<uint64_t>(size) >> 32));
-                    return {buf, buf + 10};
+                    return shared ? data->size() : owned.size();
                 }
+            };
+
+            /// The variant of a shared frame this connection sends.
+            const std::string& frame_data(const frame& f) const
+            {
+                return deflate_.server_window_bits ? f.deflated(deflate_.server_window_bits) : f.plain();
+            }
+
+            WriteBuffer frame_buffer(shared_frame f) const
+            {
+                const std::string& data = frame_data(*f);
+                return WriteBuffer(std::move(f), data);
+            }
+
+            /// Generate the websocket headers using an opcode and the message size (in bytes).
+            std::string build_header(int opcode, size_t size)
+            {
+                return build_frame_header(opcode, size);
             }
 
             /// Send the HTTP upgrade response.
@@ -328,16 +682,24 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                   "Upgrade: websocket\r\n"
                   "Connection: Upgrade\r\n"
                   "Sec-WebSocket-Accept: ";
-                write_buffers_.emplace_back(header);
-                write_buffers_.emplace_back(std::move(hello));
-                write_buffers_.emplace_back(crlf);
+                enqueue(header);
+                enqueue(std::move(hello));
+                enqueue(crlf);
                 if (!subprotocol_.empty())
                 {
-                    write_buffers_.emplace_back("Sec-WebSocket-Protocol: ");
-                    write_buffers_.emplace_back(subprotocol_);
-                    write_buffers_.emplace_back(crlf);
+                    enqueue("Sec-WebSocket-Protocol: ");
+                    enqueue(subprotocol_);
+                    enqueue(crlf);
+                }
+                if (deflate_.server_window_bits)
+                {
+                    std::string extension = "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover";
+                    if (deflate_.server_window_bits < 15)
+                        extension += "; server_max_window_bits=" + std::to_string(deflate_.server_window_bits);
+                    enqueue(std::move(extension));
+                    enqueue(crlf);
                 }
-                write_buffers_.emplace_back(crlf);
+                enqueue(crlf);
                 do_write();
                 if (open_handler_)
                     open_handler_(*this);
@@ -619,41 +981,38 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                         fragment_[i] ^= ((char*)&mask_)[i % 4];
                     }
                 }
+                // RSV1 marks a compressed message and is only valid on its first frame after negotiation
+                bool rsv1 = mini_header_ & 0x4000;
+                if (rsv1 && (opcode() == 0x0 || opcode() >= 0x8 || !deflate_.server_window_bits))
+                {
+                    fail("Unexpected RSV1 bit", ProtocolError);
+                    return false;
+                }
                 switch (opcode())
                 {
                     case 0: // Continuation
                     {
                         message_ += fragment_;
                         if (is_FIN())
-                        {
-                            if (message_handler_)
-                                message_handler_(*this, message_, is_binary_);
-                            message_.clear();
-                        }
+                            return finish_message();
                     }
                     break;
                     case 1: // Text
                     {
                         is_binary_ = false;
+                        message_compressed_ = rsv1;
                         message_ += fragment_;
                         if (is_FIN())
-                        {
-                            if (message_handler_)
-                                message_handler_(*this, message_, is_binary_);
-                            message_.clear();
-                        }
+                            return finish_message();
                     }
                     break;
                     case 2: // Binary
                     {
                         is_binary_ = true;
+                        message_compressed_ = rsv1;
                         message_ += fragment_;
                         if (is_FIN())
-                        {
-                            if (message_handler_)
-                                message_handler_(*this, message_, is_binary_);
-                            message_.clear();
-                        }
+                            return finish_message();
                     }
                     break;
                     case 0x8: // Close
@@ -710,6 +1069,93 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                 return true;
             }
 
+            /// Deliver the complete message in message_, inflating it first if it was compressed.
+            bool finish_message()
+            {
+                fragment_.clear();
+                if (message_compressed_)
+                {
+                    std::string inflated;
+                    if (!inflate_message(inflated))
+                    {
+                        message_.clear();
+                        return false;
+                    }
+                    message_.swap(inflated);
+                }
+                if (message_handler_)
+                    message_handler_(*this, message_, is_binary_);
+                message_.clear();
+                return true;
+            }
+
+            /// Inflate message_ into `out`; on failure the connection is closed.
+            bool inflate_message(std::string& out)
+            {
+#ifdef CROW_ENABLE_COMPRESSION
+                if (!inflater_ready_)
+                {
+                    // Any client window up to 15 bits inflates with the largest one
+                    if (inflateInit2(&inflater_, -15) != Z_OK)
+                    {
+                        fail("Cannot initialize inflate", UnexpectedCondition);
+                        return false;
+                    }
+                    inflater_ready_ = true;
+                }
+                else if (deflate_.client_no_context_takeover)
+                    inflateReset(&inflater_);
+
+                // Restore the empty stored block the sender stripped (RFC 7692 7.2.2)
+                message_.append("\x00\x00\xff\xff", 4);
+                inflater_.next_in = reinterpret_cast<Bytef*>(&message_[0]);
+                inflater_.avail_in = static_cast<uInt>(message_.size());
+                char chunk[16384];
+                for (;;)
+                {
+                    inflater_.next_out = reinterpret_cast<Bytef*>(chunk);
+                    inflater_.avail_out = sizeof(chunk);
+                    int ret = inflate(&inflater_, Z_SYNC_FLUSH);
+                    if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+                    {
+                        fail("Invalid compressed message", InconsistentData);
+                        return false;
+                    }
+                    size_t produced = sizeof(chunk) - inflater_.avail_out;
+                    if (out.size() + produced > max_payload_bytes_)
+                    {
+                        fail("Message length exceeds maximum payload.", MessageTooBig);
+                        return false;
+                    }
+                    out.append(chunk, produced);
+                    // A final block ends the stream; the next message starts a new one
+                    if (ret == Z_STREAM_END)
+                    {
+                        inflateReset(&inflater_);
+                        break;
+                    }
+                    // Output left over means the input is used up
+                    if (inflater_.avail_out != 0)
+                        break;
+                }
+                return true;
+#else
+                fail("Compression is not supported", ProtocolError);
+                return false;
+#endif
+            }
+
+            /// Close the connection because of a protocol violation by the peer.
+            void fail(const char* reason, websocket::CloseStatusCode code)
+            {
+                close_connection_ = true;
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+                if (error_handler_)
+                    error_handler_(*this, reason);
+                check_destroy(code);
+            }
+
             /// Send the buffers' data through the socket.
 
             ///
@@ -717,14 +1163,19 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             void do_write()
             {
                 if (sending_buffers_.empty()) {
-                    if (write_buffers_.empty()) return;
+                    if (write_buffers_.empty() && !latest_frame_) return;
 
                     sending_buffers_.swap(write_buffers_);
+                    if (latest_frame_)
+                    {
+                        sending_buffers_.emplace_back(frame_buffer(std::move(latest_frame_)));
+                        latest_frame_.reset();
+                    }
                     std::vector<asio::const_buffer> buffers;
                     buffers.reserve(sending_buffers_.size());
                     for (auto &s: sending_buffers_)
                     {
-                        buffers.emplace_back(asio::buffer(s));
+                        buffers.emplace_back(s.buffer());
                     }
                     auto watch = std::weak_ptr<void>{anchor_};
                     asio::async_write(
@@ -734,10 +1185,11 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
                             if (anchor == nullptr)
                                 return;
 
+                            shared_this->queued_bytes_ -= shared_this->sending_bytes();
                             if (!ec && !shared_this->close_connection_)
                             {
                                 shared_this->sending_buffers_.clear();
-                                if (!shared_this->write_buffers_.empty())
+                                if (!shared_this->write_buffers_.empty() || shared_this->latest_frame_)
                                     shared_this->do_write();
                                 if (shared_this->has_sent_close_)
                                     shared_this->close_connection_ = true;
@@ -783,12 +1235,56 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
 
             void send_data_impl(SendMessageType* s)
             {
+                std::string compressed;
+                if (deflate_.server_window_bits && (s->opcode == 0x1 || s->opcode == 0x2) &&
+                    deflate_message(s->payload, deflate_.server_window_bits, compressed))
+                {
+                    enqueue(build_frame_header(s->opcode, compressed.size(), true));
+                    enqueue(std::move(compressed));
+                    do_write();
+                    return;
+                }
                 auto header = build_header(s->opcode, s->payload.size());
-                write_buffers_.emplace_back(std::move(header));
-                write_buffers_.emplace_back(std::move(s->payload));
+                enqueue(std::move(header));
+                enqueue(std::move(s->payload));
                 do_write();
             }
 
+            /// Append to the write queue, keeping order with a pending send_latest() frame.
+            void enqueue(WriteBuffer buffer)
+            {
+                if (latest_frame_)
+                {
+                    write_buffers_.emplace_back(frame_buffer(std::move(latest_frame_)));
+                    latest_frame_.reset();
+                }
+                queued_bytes_ += buffer.size();
+                write_buffers_.emplace_back(std::move(buffer));
+
+                if (max_queued_bytes_ && queued_bytes_ > max_queued_bytes_ && !close_connection_)
+                {
+                    // The peer is not reading; pending reads/writes fail and destroy the connection
+                    CROW_LOG_WARNING << "Websocket send queue overflow (" << queued_bytes_ << " bytes), closing connection";
+                    close_connection_ = true;
+                    adaptor_.shutdown_readwrite();
+                    adaptor_.close();
+                }
+            }
+
+            size_t sending_bytes() const
+            {
+                size_t total = 0;
+                for (auto& b : sending_buffers_)
+                    total += b.size();
+                return total;
+            }
+
+            void count_dropped()
+            {
+                dropped_frames_++;
+                dropped_since_take_ = true;
+            }
+
             void send_data(int opcode, std::string&& msg)
             {
                 SendMessageType event_arg{
@@ -819,8 +1315,14 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             Adaptor adaptor_;
             Handler* handler_;
 
-            std::vector<std::string> sending_buffers_;
-            std::vector<std::string> write_buffers_;
+            std::vector<WriteBuffer> sending_buffers_;
+            std::vector<WriteBuffer> write_buffers_;
+            shared_frame latest_frame_;
+            std::atomic<size_t> queued_bytes_{0};
+            std::atomic<uint64_t> dropped_frames_{0};
+            std::atomic<bool> dropped_since_take_{false};
+            size_t high_water_bytes_{0};
+            size_t max_queued_bytes_{0};
 
             std::array<char, 4096> buffer_;
             bool is_binary_;
@@ -831,6 +1333,12 @@ namespace crowhttp // NOTE: Already documented in "crowhttp/app.h"
             uint64_t remaining_length_{0};
             uint64_t max_payload_bytes_{UINT64_MAX};
             std::string subprotocol_;
+            deflate_params deflate_;
+            bool message_compressed_{false};
+#ifdef CROW_ENABLE_COMPRESSION
+            z_stream inflater_{};
+            bool inflater_ready_{false};
+#endif
             bool close_connection_{false};
             bool is_reading{false};
             bool has_mask_{false};
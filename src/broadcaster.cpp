@@ -0,0 +1,76 @@
+/**
+ * Fixed-rate broadcast scheduler implementation
+ */
+
+#include "broadcaster.hpp"
+
+#include <chrono>
+
+namespace webkin
+{
+
+broadcaster::~broadcaster()
+{
+    stop();
+}
+
+void broadcaster::start(double rate_hz)
+{
+    if (_running || rate_hz <= 0)
+        return;
+
+    _rate_hz = rate_hz;
+    _running = true;
+    _thread = std::thread([this]()
+                          { loop(); });
+}
+
+void broadcaster::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_running)
+            return;
+        _running = false;
+    }
+    _cv.notify_all();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void broadcaster::loop()
+{
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / _rate_hz));
+
+    auto next_tick = clock::now() + period;
+    while (_running)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait_until(lock, next_tick, [this]()
+                           { return !_running; });
+        }
+        if (!_running)
+            break;
+
+        // Skip missed ticks instead of bursting to catch up
+        next_tick += period;
+        auto now = clock::now();
+        if (next_tick < now)
+        {
+            next_tick = now + period;
+        }
+
+        if (_dirty.exchange(false, std::memory_order_acq_rel) && _on_tick)
+        {
+            _ticks.fetch_add(1, std::memory_order_relaxed);
+            _on_tick();
+        }
+    }
+}
+
+} // namespace webkin
@@ -0,0 +1,69 @@
+#pragma once
+
+/**
+ * Fixed-rate broadcast scheduler for WebSocket scene updates.
+ *
+ * Joint ingest only marks the scene dirty with request(); a dedicated
+ * thread calls the tick callback at most once per period, and only if
+ * something changed since the previous tick. This decouples the ingest
+ * rate (MQTT/Crow/HTTP) from the fan-out rate to browsers.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace webkin
+{
+
+class broadcaster
+{
+public:
+    using tick_callback_t = std::function<void()>;
+
+    broadcaster() = default;
+    ~broadcaster();
+
+    void set_tick_callback(tick_callback_t cb) { _on_tick = std::move(cb); }
+
+    /// Start the scheduler thread. rate_hz must be positive.
+    void start(double rate_hz);
+    void stop();
+
+    bool is_running() const { return _running; }
+    double rate_hz() const { return _rate_hz; }
+
+    /// Mark the scene dirty; the next tick sends one coalesced update.
+    void request()
+    {
+        _requests.fetch_add(1, std::memory_order_relaxed);
+        _dirty.store(true, std::memory_order_release);
+    }
+
+    /// Tick again next period without counting a request, for updates
+    /// that were held back (e.g. by a client's rate limit).
+    void retry() { _dirty.store(true, std::memory_order_release); }
+
+    /// Number of updates requested and actually broadcast so far.
+    uint64_t requests() const { return _requests.load(std::memory_order_relaxed); }
+    uint64_t ticks() const { return _ticks.load(std::memory_order_relaxed); }
+
+private:
+    double _rate_hz = 0.0;
+    std::atomic<bool> _running{false};
+    std::atomic<bool> _dirty{false};
+    std::atomic<uint64_t> _requests{0};
+    std::atomic<uint64_t> _ticks{0};
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    tick_callback_t _on_tick;
+
+    void loop();
+};
+
+} // namespace webkin
@@ -50,6 +50,23 @@ bool crow_listener::connect()
     if (!_config.enabled)
         return false;
 
+    crow::hostaddr addr(_config.crowker_addr);
+
+    // Publishers are bound here, before the tower runs, never lazily from a
+    // publishing thread
+    {
+        std::lock_guard<std::mutex> lock(_publish_mutex);
+        for (const auto &topic : _config.publish_topics)
+        {
+            auto &node = _publishers[topic];
+            if (!node)
+            {
+                node = std::make_unique<crow::publisher_node>(addr.view(), topic);
+                node->bind(_tower);
+            }
+        }
+    }
+
     // Start tower executor
     if (!_spin_started)
     {
@@ -58,8 +75,6 @@ bool crow_listener::connect()
         _spin_started = true;
     }
 
-    crow::hostaddr addr(_config.crowker_addr);
-
     // Create tree subscriber
     _tree_subscriber = std::make_unique<crow::subscriber_node>(
         addr.view(),
@@ -98,7 +113,10 @@ bool crow_listener::connect()
     _joints_subscriber->install_keepalive(2000); // Re-subscribe every 2 seconds
     nos::println("Crow: subscribed to ", _config.joints_topic);
 
-    _connected = true;
+    {
+        std::lock_guard<std::mutex> lock(_publish_mutex);
+        _connected = true;
+    }
     nos::println("Crow: connected to crowker at ", _config.crowker_addr);
     return true;
 #else
@@ -109,6 +127,12 @@ bool crow_listener::connect()
 void crow_listener::disconnect()
 {
 #ifdef HAVE_CROW
+    {
+        // No publish gets past this point to a node torn down below
+        std::lock_guard<std::mutex> lock(_publish_mutex);
+        _connected = false;
+    }
+
     if (_spin_started)
     {
         if (_executor)
@@ -121,12 +145,34 @@ void crow_listener::disconnect()
 
     _tree_subscriber.reset();
     _joints_subscriber.reset();
+    {
+        std::lock_guard<std::mutex> lock(_publish_mutex);
+        _publishers.clear();
+    }
 
-    _connected = false;
     nos::println("Crow: disconnected");
 #endif
 }
 
+bool crow_listener::publish(const std::string &topic, std::string_view payload, bool retain)
+{
+    (void)retain;
+#ifdef HAVE_CROW
+    std::lock_guard<std::mutex> lock(_publish_mutex);
+    if (!_connected)
+        return false;
+    auto it = _publishers.find(topic);
+    if (it == _publishers.end())
+        return false;
+    it->second->publish(nos::buffer(payload.data(), payload.size()));
+    return true;
+#else
+    (void)topic;
+    (void)payload;
+    return false;
+#endif
+}
+
 #ifdef HAVE_CROW
 
 void crow_listener::handle_tree_message(nos::buffer data)
@@ -168,6 +214,10 @@ void crow_listener::handle_joints_message(nos::buffer data)
         nos::println("[DEBUG] crow_listener::handle_joints_message, size=", data.size());
     }
 
+    // Decode in place when possible
+    if (_on_joints_payload && _on_joints_payload(std::string_view(data.data(), data.size())))
+        return;
+
     std::string payload(data.data(), data.size());
 
     try
@@ -3,13 +3,18 @@
 /**
  * Crow Protocol Listener for WebKin
  *
- * Receives kinematic tree configuration and joint updates via Crow pub/sub.
+ * Receives kinematic tree configuration and joint updates via Crow pub/sub,
+ * and publishes through the same crowker.
  */
 
 #include <string>
+#include <string_view>
 #include <functional>
 #include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <nos/trent/trent.h>
 
 #ifdef HAVE_CROW
@@ -18,6 +23,7 @@
 #include <crow/tower_thread_executor.h>
 #include <crow/gates/udpgate.h>
 #include <crow/nodes/subscriber_node.h>
+#include <crow/nodes/publisher_node.h>
 #include <crow/hostaddr.h>
 #endif
 
@@ -30,6 +36,7 @@ struct crow_config
     std::string crowker_addr = ".12.127.0.0.1:10009";
     std::string joints_topic = "robot/joints";
     std::string tree_topic = "robot/joints/tree";
+    std::vector<std::string> publish_topics; // Publishers made by connect()
 };
 
 class crow_listener
@@ -37,6 +44,8 @@ class crow_listener
 public:
     using tree_callback_t = std::function<void(const nos::trent &)>;
     using joints_callback_t = std::function<void(const nos::trent &)>;
+    // Raw joints payload; returns false to fall back to the trent callback
+    using joints_payload_callback_t = std::function<bool(std::string_view)>;
 
     crow_listener() = default;
     ~crow_listener();
@@ -47,6 +56,12 @@ public:
 
     void set_tree_callback(tree_callback_t cb) { _on_tree = std::move(cb); }
     void set_joints_callback(joints_callback_t cb) { _on_joints = std::move(cb); }
+    void set_joints_payload_callback(joints_payload_callback_t cb) { _on_joints_payload = std::move(cb); }
+
+    /// Publish through the crowker on one of config.publish_topics; false if
+    /// not connected or the topic was not configured. The crowker keeps no
+    /// retained messages, `retain` is ignored. Safe from any thread.
+    bool publish(const std::string &topic, std::string_view payload, bool retain = false);
 
     bool is_connected() const { return _connected; }
 
@@ -57,6 +72,7 @@ private:
 
     tree_callback_t _on_tree;
     joints_callback_t _on_joints;
+    joints_payload_callback_t _on_joints_payload;
 
 #ifdef HAVE_CROW
     crow::Tower _tower;
@@ -64,6 +80,8 @@ private:
     std::shared_ptr<crow::udpgate> _udpgate;
     std::unique_ptr<crow::subscriber_node> _tree_subscriber;
     std::unique_ptr<crow::subscriber_node> _joints_subscriber;
+    std::mutex _publish_mutex;
+    std::map<std::string, std::unique_ptr<crow::publisher_node>> _publishers; // By topic, under _publish_mutex
 
     void handle_tree_message(nos::buffer data);
     void handle_joints_message(nos::buffer data);
@@ -0,0 +1,176 @@
+/**
+ * Background, debounced file persistence
+ */
+
+#include "debounced_writer.hpp"
+
+#include <nos/print.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace webkin
+{
+
+debounced_writer::debounced_writer(clock::duration debounce, clock::duration max_delay)
+    : _debounce(debounce), _max_delay(max_delay)
+{
+    _thread = std::thread([this]()
+                          { loop(); });
+}
+
+debounced_writer::~debounced_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void debounced_writer::submit(const std::string &path, std::string content)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto now = clock::now();
+        auto [it, inserted] = _pending.try_emplace(path);
+        if (inserted)
+            it->second.first = now;
+        it->second.last = now;
+        it->second.content = std::move(content);
+    }
+    _wake.notify_all();
+}
+
+void debounced_writer::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_pending.empty() && !_writing)
+        return;
+    _flush = true;
+    _wake.notify_all();
+    _idle.wait(lock, [this]()
+               { return _pending.empty() && !_writing; });
+    _flush = false;
+}
+
+uint64_t debounced_writer::writes() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _writes;
+}
+
+debounced_writer::clock::time_point debounced_writer::due(const Pending &p) const
+{
+    return std::min(p.last + _debounce, p.first + _max_delay);
+}
+
+void debounced_writer::loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        if (_pending.empty())
+        {
+            if (_stop)
+                break;
+            _wake.wait(lock);
+            continue;
+        }
+
+        bool all = _stop || _flush;
+        auto now = clock::now();
+        auto next = clock::time_point::max();
+        std::vector<std::pair<std::string, std::string>> batch;
+        for (auto it = _pending.begin(); it != _pending.end();)
+        {
+            auto when = due(it->second);
+            if (all || when <= now)
+            {
+                batch.emplace_back(it->first, std::move(it->second.content));
+                it = _pending.erase(it);
+            }
+            else
+            {
+                next = std::min(next, when);
+                ++it;
+            }
+        }
+        if (batch.empty())
+        {
+            _wake.wait_until(lock, next);
+            continue;
+        }
+
+        // Edits arriving meanwhile become the next pending content
+        _writing = true;
+        lock.unlock();
+        size_t written = 0;
+        for (const auto &[path, content] : batch)
+        {
+            if (write_file(path, content))
+                ++written;
+        }
+        lock.lock();
+        _writing = false;
+        _writes += written;
+        _idle.notify_all();
+    }
+}
+
+bool debounced_writer::write_file(const std::string &path, const std::string &content)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::path parent = fs::path(path).parent_path();
+    if (!parent.empty())
+        fs::create_directories(parent, ec);
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        nos::println("Failed to save ", path, ": ", std::strerror(errno));
+        return false;
+    }
+    const char *data = content.data();
+    size_t left = content.size();
+    while (left > 0)
+    {
+        ssize_t n = ::write(fd, data, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            nos::println("Failed to save ", path, ": ", std::strerror(errno));
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+    ::fsync(fd);
+    ::close(fd);
+
+    fs::rename(tmp, path, ec);
+    if (ec)
+    {
+        nos::println("Failed to save ", path, ": ", ec.message());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace webkin
@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * Background, debounced file persistence.
+ *
+ * submit() hands over the complete new content of a file and returns
+ * without touching the disk. A writer thread waits until a file has had
+ * no new content for the debounce delay, or until max_delay has passed
+ * since its first unsaved change during a steady stream of edits, and
+ * then writes only the latest content. A burst of edits thus costs one
+ * write. Each write is atomic: the content goes to "<path>.tmp", is
+ * fsync'ed and renamed over the file, so readers and crashes see either
+ * the old or the new file, never a partial one.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace webkin
+{
+
+class debounced_writer
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    debounced_writer(clock::duration debounce, clock::duration max_delay);
+    ~debounced_writer(); // Writes everything pending
+
+    /// Replace the pending content of `path`.
+    void submit(const std::string &path, std::string content);
+
+    /// Write everything pending now; returns when it is on disk.
+    void flush();
+
+    uint64_t writes() const;
+
+private:
+    struct Pending
+    {
+        std::string content;
+        clock::time_point first; // First unsaved change
+        clock::time_point last;  // Latest change
+    };
+
+    clock::duration _debounce;
+    clock::duration _max_delay;
+    std::map<std::string, Pending> _pending; // By path
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    bool _writing = false;
+    bool _flush = false;
+    bool _stop = false;
+    uint64_t _writes = 0;
+    std::thread _thread;
+
+    clock::time_point due(const Pending &p) const;
+    void loop();
+    static bool write_file(const std::string &path, const std::string &content);
+};
+
+} // namespace webkin
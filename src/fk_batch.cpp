@@ -0,0 +1,152 @@
+/**
+ * Batch forward kinematics request and response encoding
+ */
+
+#include "fk_batch.hpp"
+
+#include <bit>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little,
+              "fk batch frames are encoded by memcpy and require a little-endian host");
+
+namespace webkin
+{
+
+bool is_fk_batch_binary(std::string_view body)
+{
+    return body.size() >= sizeof(FK_BATCH_MAGIC) &&
+           std::memcmp(body.data(), FK_BATCH_MAGIC, sizeof(FK_BATCH_MAGIC)) == 0;
+}
+
+bool decode_fk_batch(std::string_view body, const JointSchema &schema, FkBatch &out, std::string &error)
+{
+    if (!is_fk_batch_binary(body) || body.size() < FK_BATCH_HEADER_SIZE)
+    {
+        error = "Malformed batch header";
+        return false;
+    }
+
+    uint32_t count;
+    uint64_t hash;
+    std::memcpy(&count, body.data() + 4, 4);
+    std::memcpy(&hash, body.data() + 8, 8);
+    if (hash != schema.hash)
+    {
+        error = "Joint schema mismatch, expected hash " + schema.hash_hex();
+        return false;
+    }
+
+    size_t row_size = schema.flat_index.size() * sizeof(double);
+    size_t payload = body.size() - FK_BATCH_HEADER_SIZE;
+    if ((row_size == 0 && payload != 0) || (row_size != 0 && payload != size_t(count) * row_size))
+    {
+        error = "Batch size does not match count";
+        return false;
+    }
+
+    out.joints = schema.flat_index;
+    out.count = count;
+    out.coords.resize(size_t(count) * schema.flat_index.size());
+    std::memcpy(out.coords.data(), body.data() + FK_BATCH_HEADER_SIZE, payload);
+    return true;
+}
+
+bool decode_fk_batch(const nos::trent &body, const KinematicTree &tree, FkBatch &out, std::string &error)
+{
+    const auto &names = body["joints"];
+    const auto &rows = body["coords"];
+    if (!names.is_list() || !rows.is_list())
+    {
+        error = "Expected {\"joints\": [...], \"coords\": [[...], ...]}";
+        return false;
+    }
+
+    out.joints.clear();
+    for (const auto &name : names.as_list())
+    {
+        out.joints.push_back(tree.joint_index(name.as_string_default("")));
+    }
+
+    size_t width = out.joints.size();
+    out.count = rows.as_list().size();
+    out.coords.clear();
+    out.coords.reserve(out.count * width);
+    for (const auto &row : rows.as_list())
+    {
+        if (!row.is_list() || row.as_list().size() != width)
+        {
+            error = "Every row of coords needs one value per joint";
+            return false;
+        }
+        for (const auto &value : row.as_list())
+        {
+            out.coords.push_back(value.as_numer_default(0));
+        }
+    }
+    return true;
+}
+
+std::string encode_fk_poses(const std::vector<Pose> &poses, size_t count, size_t nodes)
+{
+    std::string frame(FK_POSES_HEADER_SIZE + count * nodes * 7 * sizeof(float), '\0');
+    uint32_t header[3] = {static_cast<uint32_t>(count), static_cast<uint32_t>(nodes), 0};
+    std::memcpy(frame.data(), FK_POSES_MAGIC, 4);
+    std::memcpy(frame.data() + 4, header, sizeof(header));
+
+    char *out = frame.data() + FK_POSES_HEADER_SIZE;
+    for (size_t i = 0; i < count * nodes; ++i, out += 7 * sizeof(float))
+    {
+        const Pose &pose = poses[i];
+        float values[7] = {
+            static_cast<float>(pose.position.x),
+            static_cast<float>(pose.position.y),
+            static_cast<float>(pose.position.z),
+            static_cast<float>(pose.orientation.x),
+            static_cast<float>(pose.orientation.y),
+            static_cast<float>(pose.orientation.z),
+            static_cast<float>(pose.orientation.w)};
+        std::memcpy(out, values, sizeof(values));
+    }
+    return frame;
+}
+
+nos::trent fk_poses_to_trent(const std::vector<Pose> &poses, size_t count,
+                             const std::vector<std::string> &names)
+{
+    size_t nodes = names.size();
+    nos::trent result, order, positions, orientations;
+    result.init(nos::trent::type::dict);
+    order.init(nos::trent::type::list);
+    positions.init(nos::trent::type::dict);
+    orientations.init(nos::trent::type::dict);
+
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        nos::trent position, orientation;
+        position.init(nos::trent::type::list);
+        orientation.init(nos::trent::type::list);
+        for (size_t k = 0; k < count; ++k)
+        {
+            const Pose &pose = poses[k * nodes + i];
+            position.push_back(pose.position.x);
+            position.push_back(pose.position.y);
+            position.push_back(pose.position.z);
+            orientation.push_back(pose.orientation.x);
+            orientation.push_back(pose.orientation.y);
+            orientation.push_back(pose.orientation.z);
+            orientation.push_back(pose.orientation.w);
+        }
+        order.push_back(names[i]);
+        positions[names[i]] = std::move(position);
+        orientations[names[i]] = std::move(orientation);
+    }
+
+    result["count"] = static_cast<double>(count);
+    result["nodeOrder"] = std::move(order);
+    result["position"] = std::move(positions);
+    result["orientation"] = std::move(orientations);
+    return result;
+}
+
+} // namespace webkin
@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * Batch forward kinematics for POST /api/fk/batch.
+ *
+ * JSON request (rows of coordinates, column order given by "joints"):
+ *
+ *   {"joints": ["name", ...], "coords": [[c0, c1, ...], ...]}
+ *
+ * Binary request (little-endian, Content-Type application/octet-stream):
+ *
+ *   char[4] magic            "WKFB"
+ *   uint32  count            number of configurations N
+ *   uint64  schema_hash      JointSchema::hash, as in joint frames
+ *   float64 coords[N][J]     rows in joint schema order
+ *
+ * Joints not given keep their current coordinate. The live scene is not
+ * modified.
+ *
+ * Binary response (for binary requests or Accept: application/octet-stream):
+ *
+ *   char[4] magic            "WKFP"
+ *   uint32  count            N
+ *   uint32  nodes            M, in scene_init "nodeOrder"
+ *   uint32  reserved
+ *   float32 poses[N][M][7]   px, py, pz, qx, qy, qz, qw
+ *
+ * JSON response, columnar per node:
+ *
+ *   {"count": N, "nodeOrder": [...],
+ *    "position": {"node": [x0, y0, z0, x1, ...]},
+ *    "orientation": {"node": [qx0, qy0, qz0, qw0, ...]}}
+ */
+
+#include "joint_decoder.hpp"
+#include "kinematic.hpp"
+
+#include <nos/trent/trent.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+constexpr char FK_BATCH_MAGIC[4] = {'W', 'K', 'F', 'B'};
+constexpr char FK_POSES_MAGIC[4] = {'W', 'K', 'F', 'P'};
+constexpr size_t FK_BATCH_HEADER_SIZE = 16;
+constexpr size_t FK_POSES_HEADER_SIZE = 16;
+
+// Upper bound on N * nodes per request, about 230 MB of poses
+constexpr size_t FK_BATCH_MAX_POSES = size_t(1) << 22;
+
+/// Decoded batch: row-major coords[count][joints.size()].
+struct FkBatch
+{
+    std::vector<uint32_t> joints; // Flat index per column; UINT32_MAX if unknown
+    std::vector<double> coords;
+    size_t count = 0;
+};
+
+/// True if the body starts with the binary request magic.
+bool is_fk_batch_binary(std::string_view body);
+
+/// Decode a binary request. On failure returns false and sets `error`.
+bool decode_fk_batch(std::string_view body, const JointSchema &schema, FkBatch &out, std::string &error);
+
+/// Decode a JSON request against the tree. On failure returns false and sets `error`.
+bool decode_fk_batch(const nos::trent &body, const KinematicTree &tree, FkBatch &out, std::string &error);
+
+/// Binary response for count rows of `nodes` poses each.
+std::string encode_fk_poses(const std::vector<Pose> &poses, size_t count, size_t nodes);
+
+/// Columnar JSON response; names are the node names in flat index order.
+nos::trent fk_poses_to_trent(const std::vector<Pose> &poses, size_t count,
+                             const std::vector<std::string> &names);
+
+} // namespace webkin
@@ -0,0 +1,131 @@
+/**
+ * Compile-time forward kinematics generator implementation
+ */
+
+#include "fk_codegen.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+namespace webkin
+{
+
+namespace
+{
+
+const char *kind_name(JointKind kind)
+{
+    switch (kind)
+    {
+    case JointKind::Fixed:
+        return "Fixed";
+    case JointKind::RotateX:
+        return "RotateX";
+    case JointKind::RotateY:
+        return "RotateY";
+    case JointKind::RotateZ:
+        return "RotateZ";
+    case JointKind::Rotate:
+        return "Rotate";
+    case JointKind::Translate:
+        return "Translate";
+    }
+    return "Fixed";
+}
+
+// Shortest text that reads back as the same double
+std::string number(double v)
+{
+    char buf[32];
+    for (int precision = 15; precision <= 17; ++precision)
+    {
+        std::snprintf(buf, sizeof(buf), "%.*g", precision, v);
+        if (std::strtod(buf, nullptr) == v)
+            break;
+    }
+    std::string text = buf;
+    if (text.find_first_of(".en") == std::string::npos)
+        text += ".0";
+    return text;
+}
+
+std::string string_literal(std::string_view s)
+{
+    std::string out = "\"";
+    for (unsigned char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x20 || c == 0x7f)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\%03o", c);
+            out += buf;
+        }
+        else
+        {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+bool is_fk_model_name(const std::string &name)
+{
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+        return false;
+    for (unsigned char c : name)
+    {
+        if (!std::isalnum(c) && c != '_')
+            return false;
+    }
+    return true;
+}
+
+std::string generate_fk_header(const KinematicTree &tree, const std::string &model, const std::string &source)
+{
+    const FlatTree &flat = tree.flat;
+    const size_t n = flat.size();
+    const std::string fingerprint = "0x" + hash_hex(flat.fingerprint()) + "ull";
+
+    std::string out;
+    out += "#pragma once\n\n";
+    out += "/**\n * Compile-time forward kinematics of " + model + ", see fk_model.hpp.\n";
+    out += " * Generated by webkin --generate-fk";
+    if (!source.empty())
+        out += " from " + source;
+    out += "; do not edit.\n */\n\n";
+    out += "#include \"fk_model.hpp\"\n\n";
+    out += "namespace webkin::fk_models\n{\n\n";
+    out += "struct " + model + "\n{\n";
+    out += "    static constexpr const char *name = " + string_literal(model) + ";\n";
+    out += "    static constexpr uint64_t fingerprint = " + fingerprint + ";\n\n";
+    out += "    // anchor, kind, base position, base orientation, axis\n";
+    out += "    static constexpr std::array<fk::Node, " + std::to_string(n) + "> nodes{{\n";
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Pose &b = flat.base[i];
+        const Vec3 &a = flat.axis[i];
+        out += "        {" + std::to_string(flat.anchor[i]) + ", JointKind::" + kind_name(flat.kind[i]) + ", " +
+               number(b.position.x) + ", " + number(b.position.y) + ", " + number(b.position.z) + ", " +
+               number(b.orientation.x) + ", " + number(b.orientation.y) + ", " + number(b.orientation.z) + ", " +
+               number(b.orientation.w) + ", " + number(a.x) + ", " + number(a.y) + ", " + number(a.z) + "},\n";
+    }
+    out += "    }};\n\n";
+    out += "    static constexpr std::array<const char *, " + std::to_string(n) + "> names{{\n";
+    for (size_t i = 0; i < n; ++i)
+        out += "        " + string_literal(tree.nodes[i]->name) + ",\n";
+    out += "    }};\n";
+    out += "};\n\n";
+    out += "} // namespace webkin::fk_models\n";
+    return out;
+}
+
+} // namespace webkin
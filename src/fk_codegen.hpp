@@ -0,0 +1,27 @@
+#pragma once
+
+/**
+ * Generator of compile-time forward kinematics (fk_model.hpp).
+ *
+ * Writes the C++ model header of a loaded tree; `webkin --generate-fk`
+ * runs it on the tree of the default robot. The header holds the folded
+ * structure of tree.flat and its fingerprint, so it only matches trees
+ * with the same joints, axes and static poses; coords and axis overrides
+ * stay free.
+ */
+
+#include "kinematic.hpp"
+
+#include <string>
+
+namespace webkin
+{
+
+/// Header declaring webkin::fk_models::`model`; `source` is noted in its
+/// comment. `model` must be a C++ identifier.
+std::string generate_fk_header(const KinematicTree &tree, const std::string &model, const std::string &source);
+
+/// True if `name` can be used as the model name.
+bool is_fk_model_name(const std::string &name);
+
+} // namespace webkin
@@ -0,0 +1,42 @@
+#pragma once
+
+/**
+ * Compile-time forward kinematics of example_tree, see fk_model.hpp.
+ * Generated by webkin --generate-fk from example_tree.json; do not edit.
+ */
+
+#include "fk_model.hpp"
+
+namespace webkin::fk_models
+{
+
+struct example_tree
+{
+    static constexpr const char *name = "example_tree";
+    static constexpr uint64_t fingerprint = 0x404422af89660c65ull;
+
+    // anchor, kind, base position, base orientation, axis
+    static constexpr std::array<fk::Node, 8> nodes{{
+        {-1, JointKind::Fixed, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0},
+        {-1, JointKind::RotateY, 1.0, 15.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 1.0, 0.0},
+        {1, JointKind::RotateZ, 0.0, 30.0, 0.0, 0.707, 0.0, 0.0, 0.707, 0.0, 0.0, 1.0},
+        {2, JointKind::Fixed, 0.0, 50.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0},
+        {2, JointKind::RotateZ, 0.0, 110.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0},
+        {4, JointKind::Fixed, 0.0, 40.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0},
+        {4, JointKind::RotateY, 0.0, 90.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 1.0, 0.0},
+        {6, JointKind::Fixed, 0.0, 20.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0},
+    }};
+
+    static constexpr std::array<const char *, 8> names{{
+        "robot_base",
+        "shoulder_yaw",
+        "shoulder_pitch",
+        "upper_arm",
+        "elbow",
+        "forearm",
+        "wrist",
+        "end_effector",
+    }};
+};
+
+} // namespace webkin::fk_models
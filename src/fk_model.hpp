@@ -0,0 +1,139 @@
+#pragma once
+
+/**
+ * Forward kinematics specialized at compile time for one tree structure.
+ *
+ * fk_codegen.cpp writes a model header from a loaded tree (webkin
+ * --generate-fk): a struct with the structure fingerprint and a constexpr
+ * array of nodes holding the anchor, joint kind, axis and folded base pose
+ * of every FlatTree node. update<Model>() expands into one straight-line
+ * pass over all nodes: the kind dispatch, identity bases and world
+ * anchors are resolved by `if constexpr`, the constants are folded into
+ * the arithmetic, and only coord, axis_offset and axis_scale are read
+ * at run time. The poses are those FlatTree::update() computes.
+ *
+ * Registered models (fk_models.cpp) replace the generic update of every
+ * tree with the same fingerprint, see FlatTree::compiled.
+ */
+
+#include "kinematic.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace webkin::fk
+{
+
+struct Node
+{
+    int32_t anchor; // -1 for the world
+    JointKind kind;
+    double px, py, pz;     // Base position
+    double qx, qy, qz, qw; // Base orientation
+    double ax, ay, az;     // Joint axis
+};
+
+/// Same as FlatTree::apply_joint(), with the kind and axis known.
+template <class Model, size_t I>
+inline Pose apply_joint(const Pose &frame, double e)
+{
+    static constexpr const Node &N = Model::nodes[I];
+    const Quat &q = frame.orientation;
+    if constexpr (N.kind == JointKind::Fixed)
+    {
+        return frame;
+    }
+    else if constexpr (N.kind == JointKind::Translate)
+    {
+        return Pose(frame.position + q.rotate_vec(Vec3(N.ax, N.ay, N.az) * e), q);
+    }
+    else
+    {
+        double s = std::sin(e / 2);
+        double c = std::cos(e / 2);
+        if constexpr (N.kind == JointKind::RotateX)
+        {
+            s *= N.ax;
+            return Pose(frame.position, Quat(q.w * s + q.x * c, q.y * c + q.z * s, q.z * c - q.y * s, q.w * c - q.x * s));
+        }
+        else if constexpr (N.kind == JointKind::RotateY)
+        {
+            s *= N.ay;
+            return Pose(frame.position, Quat(q.x * c - q.z * s, q.w * s + q.y * c, q.z * c + q.x * s, q.w * c - q.y * s));
+        }
+        else if constexpr (N.kind == JointKind::RotateZ)
+        {
+            s *= N.az;
+            return Pose(frame.position, Quat(q.x * c + q.y * s, q.y * c - q.x * s, q.w * s + q.z * c, q.w * c - q.z * s));
+        }
+        else
+        {
+            return Pose(frame.position, q * Quat(N.ax * s, N.ay * s, N.az * s, c));
+        }
+    }
+}
+
+/// Global pose of node I, as FlatTree::compute_pose().
+template <class Model, size_t I>
+inline void evaluate_node(FlatTree &flat)
+{
+    static constexpr const Node &n = Model::nodes[I];
+    constexpr bool identity = n.px == 0 && n.py == 0 && n.pz == 0 && n.qx == 0 && n.qy == 0 && n.qz == 0 &&
+                              n.qw == 1;
+
+    Pose frame;
+    if constexpr (n.anchor < 0)
+        frame = Pose(Vec3(n.px, n.py, n.pz), Quat(n.qx, n.qy, n.qz, n.qw));
+    else if constexpr (identity)
+        frame = flat.global_pose[n.anchor];
+    else
+        frame = flat.global_pose[n.anchor] * Pose(Vec3(n.px, n.py, n.pz), Quat(n.qx, n.qy, n.qz, n.qw));
+
+    Pose pose;
+    if constexpr (n.kind == JointKind::Fixed)
+        pose = frame;
+    else
+        pose = apply_joint<Model, I>(frame, (flat.coord[I] + flat.axis_offset[I]) * flat.axis_scale[I]);
+
+    if (!(pose == flat.global_pose[I]))
+    {
+        flat.global_pose[I] = pose;
+        flat.mark_changed(I);
+    }
+}
+
+/// All global poses of a tree with Model's structure.
+template <class Model>
+void update(FlatTree &flat)
+{
+    [&flat]<size_t... I>(std::index_sequence<I...>)
+    {
+        (evaluate_node<Model, I>(flat), ...);
+    }(std::make_index_sequence<Model::nodes.size()>());
+}
+
+struct CompiledFk
+{
+    const char *name;
+    uint64_t fingerprint;
+    size_t size;
+    CompiledUpdate update;
+};
+
+template <class Model>
+constexpr CompiledFk compiled_fk()
+{
+    return {Model::name, Model::fingerprint, Model::nodes.size(), &update<Model>};
+}
+
+/// Models linked into the server (fk_models.cpp).
+const std::vector<CompiledFk> &compiled_models();
+
+/// Off: every tree uses the generic FlatTree::update(), e.g. as the
+/// baseline of a generated model. Affects trees compiled afterwards.
+void set_compiled_fk_enabled(bool enabled);
+
+} // namespace webkin::fk
@@ -0,0 +1,57 @@
+/**
+ * Registry of the generated forward kinematics linked into the server.
+ *
+ * To add a robot: generate its header with
+ *
+ *   webkin --k3d robot.k3d --generate-fk src/fk_robot.hpp --fk-name robot
+ *
+ * include it here and list fk::compiled_fk<fk_models::robot>() below.
+ */
+
+#include "fk_model.hpp"
+
+#include "fk_example_tree.hpp"
+
+#include <atomic>
+
+namespace webkin
+{
+
+namespace
+{
+
+std::atomic<bool> g_enabled{true};
+
+} // namespace
+
+namespace fk
+{
+
+const std::vector<CompiledFk> &compiled_models()
+{
+    static const std::vector<CompiledFk> models = {
+        compiled_fk<fk_models::example_tree>(),
+    };
+    return models;
+}
+
+void set_compiled_fk_enabled(bool enabled)
+{
+    g_enabled = enabled;
+}
+
+} // namespace fk
+
+CompiledUpdate find_compiled_update(uint64_t fingerprint)
+{
+    if (!g_enabled)
+        return nullptr;
+    for (const auto &model : fk::compiled_models())
+    {
+        if (model.fingerprint == fingerprint)
+            return model.update;
+    }
+    return nullptr;
+}
+
+} // namespace webkin
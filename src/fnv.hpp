@@ -0,0 +1,43 @@
+#pragma once
+
+/**
+ * FNV-1a 64, the one hash used for ETags, mesh and joint schema hashes,
+ * name lookup and tree fingerprints, and its hex form.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace webkin
+{
+
+constexpr uint64_t FNV1A64_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV1A64_PRIME = 1099511628211ull;
+
+/// FNV-1a 64 of `data`. Pass a previous result as `seed` to hash pieces
+/// as one sequence of bytes.
+constexpr uint64_t fnv1a64(std::string_view data, uint64_t seed = FNV1A64_BASIS)
+{
+    uint64_t h = seed;
+    for (char c : data)
+        h = (h ^ static_cast<unsigned char>(c)) * FNV1A64_PRIME;
+    return h;
+}
+
+/// FNV-1a 64 of an object's bytes, continuing from `seed`.
+inline uint64_t fnv1a64_bytes(const void *data, size_t size, uint64_t seed = FNV1A64_BASIS)
+{
+    return fnv1a64(std::string_view(static_cast<const char *>(data), size), seed);
+}
+
+/// A 64-bit hash as 16 lowercase hex digits.
+inline std::string hash_hex(uint64_t h)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+} // namespace webkin
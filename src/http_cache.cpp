@@ -0,0 +1,200 @@
+/**
+ * Precompressed response bodies with ETags
+ */
+
+#include "http_cache.hpp"
+#include "fnv.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <zlib.h>
+
+namespace webkin
+{
+
+namespace
+{
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    // Calls fn for each comma separated item of a header value
+    template <class F> void for_each_item(std::string_view value, F &&fn)
+    {
+        while (!value.empty())
+        {
+            size_t comma = value.find(',');
+            fn(trim(value.substr(0, comma)));
+            if (comma == std::string_view::npos)
+                break;
+            value.remove_prefix(comma + 1);
+        }
+    }
+
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                                                  { return std::tolower(static_cast<unsigned char>(x)) ==
+                                                           std::tolower(static_cast<unsigned char>(y)); });
+    }
+
+    std::string gzip(std::string_view data)
+    {
+        z_stream stream{};
+        // 16 + MAX_WBITS writes a gzip header and trailer
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return {};
+        std::string out(deflateBound(&stream, data.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef *>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+        int ret = deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return ret == Z_STREAM_END ? out : std::string();
+    }
+}
+
+bool etag_matches(std::string_view if_none_match, std::string_view etag)
+{
+    // If-None-Match compares weakly
+    if (etag.substr(0, 2) == "W/")
+        etag.remove_prefix(2);
+    bool match = false;
+    for_each_item(if_none_match, [&](std::string_view tag)
+                  {
+        if (tag.substr(0, 2) == "W/")
+            tag.remove_prefix(2);
+        if (tag == "*" || tag == etag)
+            match = true; });
+    return match;
+}
+
+bool CachedBody::matches(std::string_view if_none_match) const
+{
+    return etag_matches(if_none_match, etag) || (!gzip.empty() && etag_matches(if_none_match, gzip_etag));
+}
+
+std::string content_hash(std::string_view data)
+{
+    return hash_hex(fnv1a64(data));
+}
+
+namespace
+{
+    void prepare(CachedBody &body, std::string content_type, bool compress)
+    {
+        std::string_view data = body.content;
+        std::string hash = content_hash(data);
+        body.etag = "\"" + hash + "\"";
+        body.gzip_etag = "\"" + hash + "-gz\"";
+        // zlib takes one uInt of input here; larger bodies go uncompressed
+        if (compress && data.size() > 256 && data.size() < (1u << 31))
+        {
+            body.gzip = gzip(data);
+            if (body.gzip.size() > data.size() - data.size() / 10)
+                body.gzip.clear();
+        }
+        body.content_type = std::move(content_type);
+    }
+}
+
+std::shared_ptr<const CachedBody> make_cached_body(std::string data, std::string content_type, bool compress)
+{
+    auto body = std::make_shared<CachedBody>();
+    body->data = std::move(data);
+    body->content = body->data;
+    prepare(*body, std::move(content_type), compress);
+    return body;
+}
+
+std::shared_ptr<const CachedBody> make_static_body(std::string_view data, std::string content_type, bool compress)
+{
+    auto body = std::make_shared<CachedBody>();
+    body->content = data;
+    prepare(*body, std::move(content_type), compress);
+    return body;
+}
+
+bool accepts_gzip(std::string_view accept_encoding)
+{
+    bool accepted = false;
+    for_each_item(accept_encoding, [&](std::string_view item)
+                  {
+        size_t semi = item.find(';');
+        std::string_view coding = trim(item.substr(0, semi));
+        if (!iequals(coding, "gzip") && !iequals(coding, "x-gzip"))
+            return;
+        accepted = true;
+        // gzip;q=0 refuses it
+        if (semi != std::string_view::npos)
+        {
+            std::string_view param = trim(item.substr(semi + 1));
+            if (param.substr(0, 2) == "q=" || param.substr(0, 2) == "Q=")
+                accepted = std::strtod(std::string(param.substr(2)).c_str(), nullptr) > 0;
+        } });
+    return accepted;
+}
+
+RangeStatus parse_range(std::string_view header, size_t size, ByteRange &range)
+{
+    header = trim(header);
+    if (header.substr(0, 6) != "bytes=")
+        return RangeStatus::Full;
+    header = trim(header.substr(6));
+    if (header.empty() || header.find(',') != std::string_view::npos)
+        return RangeStatus::Full;
+
+    size_t dash = header.find('-');
+    if (dash == std::string_view::npos)
+        return RangeStatus::Full;
+    auto number = [](std::string_view s, size_t &out)
+    {
+        s = trim(s);
+        if (s.empty() || s.size() > 19)
+            return false;
+        out = 0;
+        for (char c : s)
+        {
+            if (c < '0' || c > '9')
+                return false;
+            out = out * 10 + (c - '0');
+        }
+        return true;
+    };
+
+    size_t first = 0, last = 0;
+    bool has_first = number(header.substr(0, dash), first);
+    bool has_last = number(header.substr(dash + 1), last);
+    if (!has_first && !trim(header.substr(0, dash)).empty())
+        return RangeStatus::Full;
+    if (!has_last && !trim(header.substr(dash + 1)).empty())
+        return RangeStatus::Full;
+
+    if (!has_first)
+    {
+        // Suffix: the last `last` bytes
+        if (!has_last || last == 0 || size == 0)
+            return RangeStatus::Unsatisfiable;
+        range.length = std::min(last, size);
+        range.offset = size - range.length;
+        return RangeStatus::Partial;
+    }
+    if (has_last && last < first)
+        return RangeStatus::Full;
+    if (first >= size)
+        return RangeStatus::Unsatisfiable;
+    range.offset = first;
+    range.length = (has_last ? std::min(last, size - 1) : size - 1) - first + 1;
+    return RangeStatus::Partial;
+}
+
+} // namespace webkin
@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * Response bodies prepared once and served many times.
+ *
+ * A CachedBody holds the content with its strong ETag (FNV-1a 64 of the
+ * bytes) and, when worth it, a gzip variant compressed ahead of time, so
+ * requests for static files and K3D models cost neither hashing nor
+ * compression. The gzip variant has its own ETag ("<hash>-gz"), as the
+ * two are different representations.
+ *
+ * Bodies are sent as views (crowhttp::response::set_body_view) with the
+ * CachedBody as owner, so serving one copies nothing. Embedded resources
+ * are not copied at all: make_static_body() views the binary's data.
+ */
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace webkin
+{
+
+struct CachedBody
+{
+    std::string_view content; // The identity body: data, or memory outliving the body
+    std::string data;         // Owned content, empty for static bodies
+    std::string gzip;         // Empty if not precompressed or not smaller
+    std::string content_type;
+    std::string etag;      // Quoted, for content
+    std::string gzip_etag; // Quoted, for gzip
+
+    /// Whether an If-None-Match header value matches either variant.
+    bool matches(std::string_view if_none_match) const;
+};
+
+/**
+ * Hash the content and, if `compress`, precompress it; the gzip variant
+ * is kept only if it saves at least a tenth of the size.
+ */
+std::shared_ptr<const CachedBody> make_cached_body(std::string data, std::string content_type, bool compress);
+
+/// As make_cached_body() for memory that lives as long as the program.
+std::shared_ptr<const CachedBody> make_static_body(std::string_view data, std::string content_type, bool compress);
+
+/// FNV-1a 64 of the bytes, as 16 hex digits.
+std::string content_hash(std::string_view data);
+
+/// Whether an Accept-Encoding header value allows gzip.
+bool accepts_gzip(std::string_view accept_encoding);
+
+/// Whether an If-None-Match header value matches `etag` (weak comparison).
+bool etag_matches(std::string_view if_none_match, std::string_view etag);
+
+struct ByteRange
+{
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+enum class RangeStatus
+{
+    Full,          // No usable Range header: send everything
+    Partial,       // Send `range` with 206
+    Unsatisfiable, // 416
+};
+
+/**
+ * Parse a Range header for a body of `size` bytes. A single range of
+ * bytes is supported ("a-b", "a-" and "-n"); several ranges are served
+ * as the full body, which RFC 9110 allows.
+ */
+RangeStatus parse_range(std::string_view header, size_t size, ByteRange &range);
+
+} // namespace webkin
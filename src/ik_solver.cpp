@@ -0,0 +1,240 @@
+/**
+ * Damped least squares inverse kinematics
+ */
+
+#include "ik_solver.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace webkin
+{
+
+namespace
+{
+    Vec3 sub(const Vec3 &a, const Vec3 &b)
+    {
+        return Vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+    }
+
+    Vec3 cross(const Vec3 &a, const Vec3 &b)
+    {
+        return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    double norm(const Vec3 &v)
+    {
+        return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    }
+
+    Quat normalized(const Quat &q)
+    {
+        double n = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        return n > 0 ? Quat(q.x / n, q.y / n, q.z / n, q.w / n) : Quat();
+    }
+
+    // Rotation taking `from` to `to` as a rotation vector (axis * angle)
+    Vec3 rotation_error(const Quat &to, const Quat &from)
+    {
+        Quat e = to * Quat(-from.x, -from.y, -from.z, from.w);
+        if (e.w < 0)
+            e = Quat(-e.x, -e.y, -e.z, -e.w);
+        Vec3 v(e.x, e.y, e.z);
+        double s = norm(v);
+        if (s < 1e-12)
+            return v * 2;
+        return v * (2 * std::atan2(s, e.w) / s);
+    }
+
+    // Solve A y = b in place for a symmetric positive definite m x m matrix
+    bool cholesky_solve(double *A, double *b, size_t m)
+    {
+        for (size_t j = 0; j < m; ++j)
+        {
+            double d = A[j * m + j];
+            for (size_t k = 0; k < j; ++k)
+                d -= A[j * m + k] * A[j * m + k];
+            if (d <= 0)
+                return false;
+            d = std::sqrt(d);
+            A[j * m + j] = d;
+            for (size_t i = j + 1; i < m; ++i)
+            {
+                double v = A[i * m + j];
+                for (size_t k = 0; k < j; ++k)
+                    v -= A[i * m + k] * A[j * m + k];
+                A[i * m + j] = v / d;
+            }
+        }
+        for (size_t i = 0; i < m; ++i)
+        {
+            for (size_t k = 0; k < i; ++k)
+                b[i] -= A[i * m + k] * b[k];
+            b[i] /= A[i * m + i];
+        }
+        for (size_t i = m; i-- > 0;)
+        {
+            for (size_t k = i + 1; k < m; ++k)
+                b[i] -= A[k * m + i] * b[k];
+            b[i] /= A[i * m + i];
+        }
+        return true;
+    }
+}
+
+void chain_joints(const FlatTree &flat, uint32_t node, std::vector<uint32_t> &joints)
+{
+    // Anchors are exactly the moving ancestors
+    joints.clear();
+    if (flat.kind[node] != JointKind::Fixed)
+        joints.push_back(node);
+    for (int32_t i = flat.anchor[node]; i >= 0; i = flat.anchor[i])
+        joints.push_back(static_cast<uint32_t>(i));
+    std::reverse(joints.begin(), joints.end());
+}
+
+void geometric_jacobian(const FlatTree &flat, const Pose *poses, const std::vector<uint32_t> &joints,
+                        uint32_t node, double *J)
+{
+    const size_t n = joints.size();
+    const Vec3 &p = poses[node].position;
+    for (size_t c = 0; c < n; ++c)
+    {
+        uint32_t j = joints[c];
+        // A joint's own transform leaves its axis in place, so the axis can
+        // be taken from the pose after the joint
+        Vec3 axis = poses[j].orientation.rotate_vec(flat.axis[j]);
+        double len = norm(axis);
+        if (len > 0)
+            axis = axis * (1 / len);
+        axis = axis * flat.axis_scale[j];
+
+        Vec3 linear, angular;
+        if (flat.kind[j] == JointKind::Translate)
+        {
+            linear = axis;
+        }
+        else
+        {
+            linear = cross(axis, sub(p, poses[j].position));
+            angular = axis;
+        }
+        J[0 * n + c] = linear.x;
+        J[1 * n + c] = linear.y;
+        J[2 * n + c] = linear.z;
+        J[3 * n + c] = angular.x;
+        J[4 * n + c] = angular.y;
+        J[5 * n + c] = angular.z;
+    }
+}
+
+void IkSolver::evaluate_chain(const FlatTree &flat)
+{
+    for (uint32_t i : _path)
+    {
+        int32_t a = flat.anchor[i];
+        _poses[i] = flat.apply_joint(i, a < 0 ? flat.base[i] : _poses[a] * flat.base[i], _coord[i]);
+    }
+}
+
+IkResult IkSolver::solve(const KinematicTree &tree, uint32_t node, const IkTarget &target,
+                         const IkOptions &options)
+{
+    const FlatTree &flat = tree.flat;
+    IkResult result;
+
+    chain_joints(flat, node, _joints);
+    _path = _joints;
+    if (_path.empty() || _path.back() != node)
+        _path.push_back(node);
+
+    const size_t n = _joints.size();
+    _q.resize(n);
+    _lo.resize(n);
+    _hi.resize(n);
+    _dq.resize(n);
+    _J.resize(6 * n);
+    for (size_t c = 0; c < n; ++c)
+    {
+        uint32_t j = _joints[c];
+        _q[c] = flat.coord[j];
+        _lo[c] = tree.nodes[j]->slider_min;
+        _hi[c] = tree.nodes[j]->slider_max;
+    }
+    _coord = flat.coord;
+    _poses.resize(flat.size());
+    evaluate_chain(flat);
+
+    const Quat goal = normalized(target.orientation);
+    const size_t m = target.use_orientation ? 6 : 3;
+    double reach = n > 0 ? norm(sub(_poses[node].position, _poses[_joints.front()].position)) : 0;
+    reach = std::max(reach, 1.0);
+    const double lambda = options.damping * reach;
+
+    for (;;)
+    {
+        const Pose &pose = _poses[node];
+        Vec3 ep = sub(target.position, pose.position);
+        Vec3 er = target.use_orientation ? rotation_error(goal, pose.orientation) : Vec3();
+        result.position_error = norm(ep);
+        result.orientation_error = norm(er);
+        if (result.position_error <= options.position_tolerance &&
+            (!target.use_orientation || result.orientation_error <= options.orientation_tolerance))
+        {
+            result.converged = true;
+            break;
+        }
+        if (n == 0 || result.iterations >= options.max_iterations)
+            break;
+
+        // Orientation rows are weighted by the reach to compare with lengths
+        geometric_jacobian(flat, _poses.data(), _joints, node, _J.data());
+        std::array<double, 6> e = {ep.x, ep.y, ep.z, er.x * reach, er.y * reach, er.z * reach};
+        for (size_t r = 3; r < m; ++r)
+            for (size_t c = 0; c < n; ++c)
+                _J[r * n + c] *= reach;
+
+        // (J J^T + lambda^2 I) y = e, dq = J^T y
+        std::array<double, 36> A;
+        for (size_t r = 0; r < m; ++r)
+        {
+            for (size_t s = 0; s <= r; ++s)
+            {
+                double v = 0;
+                for (size_t c = 0; c < n; ++c)
+                    v += _J[r * n + c] * _J[s * n + c];
+                A[r * m + s] = A[s * m + r] = v;
+            }
+            A[r * m + r] += lambda * lambda;
+        }
+        if (!cholesky_solve(A.data(), e.data(), m))
+            break;
+
+        double factor = 1;
+        for (size_t c = 0; c < n; ++c)
+        {
+            double v = 0;
+            for (size_t r = 0; r < m; ++r)
+                v += _J[r * n + c] * e[r];
+            _dq[c] = v;
+
+            uint32_t j = _joints[c];
+            double step = std::abs(v * flat.axis_scale[j]);
+            double limit = flat.kind[j] == JointKind::Translate ? options.max_step * reach : options.max_step;
+            if (step > limit)
+                factor = std::min(factor, limit / step);
+        }
+
+        for (size_t c = 0; c < n; ++c)
+        {
+            _q[c] = std::min(std::max(_q[c] + _dq[c] * factor, _lo[c]), _hi[c]);
+            _coord[_joints[c]] = _q[c];
+        }
+        evaluate_chain(flat);
+        ++result.iterations;
+    }
+    return result;
+}
+
+} // namespace webkin
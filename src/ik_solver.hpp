@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * Inverse kinematics: geometric Jacobian and damped least squares.
+ *
+ * The solver works on the chain of moving joints between the root and a
+ * target node. Each iteration evaluates only that chain (through the
+ * folded base poses of FlatTree), builds the geometric Jacobian and takes
+ * the step dq = J^T (J J^T + lambda^2 I)^-1 e, clamped to the joints'
+ * slider_min/slider_max. Buffers live in the solver and keep their
+ * capacity, so once warmed up for a tree a solve allocates nothing.
+ *
+ * Lengths are scene units: damping and the orientation weight are scaled
+ * by the chain's reach (distance from its first joint to the target).
+ */
+
+#include "kinematic.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace webkin
+{
+
+struct IkTarget
+{
+    Vec3 position;
+    Quat orientation;
+    bool use_orientation = false;
+};
+
+struct IkOptions
+{
+    int max_iterations = 64;
+    double position_tolerance = 0.1;     // Scene units
+    double orientation_tolerance = 1e-3; // Radians
+    double damping = 0.05;               // lambda as a fraction of the reach
+    double max_step = 0.25;              // Per joint and iteration: radians, or reach fraction for actuators
+};
+
+// Bounds for options taken from a client: a solve holds the robot's lock
+constexpr int IK_MAX_ITERATIONS = 256;
+constexpr double IK_MIN_DAMPING = 1e-4, IK_MAX_DAMPING = 1.0;
+constexpr double IK_MIN_POSITION_TOLERANCE = 1e-6, IK_MAX_POSITION_TOLERANCE = 100.0;
+constexpr double IK_MIN_ORIENTATION_TOLERANCE = 1e-6, IK_MAX_ORIENTATION_TOLERANCE = 0.5;
+
+struct IkResult
+{
+    bool converged = false;
+    int iterations = 0;
+    double position_error = 0;
+    double orientation_error = 0;
+};
+
+/// Moving joints on the path from the root to `node` (inclusive), root first.
+void chain_joints(const FlatTree &flat, uint32_t node, std::vector<uint32_t> &joints);
+
+/**
+ * Geometric Jacobian of `node` with respect to `joints`, at the given
+ * global poses (indexed like flat). Writes 6 x joints.size() values to J,
+ * row-major, rows vx vy vz wx wy wz, per unit of joint coordinate.
+ */
+void geometric_jacobian(const FlatTree &flat, const Pose *poses, const std::vector<uint32_t> &joints,
+                        uint32_t node, double *J);
+
+class IkSolver
+{
+public:
+    /**
+     * Solve for `node` (flat index) starting from the tree's current
+     * coordinates. The tree is not modified; the result is joints() and
+     * coords(), ready for KinematicTree::set_joint_coord_at().
+     */
+    IkResult solve(const KinematicTree &tree, uint32_t node, const IkTarget &target,
+                   const IkOptions &options = {});
+
+    const std::vector<uint32_t> &joints() const { return _joints; }
+    const std::vector<double> &coords() const { return _q; }
+
+private:
+    std::vector<uint32_t> _path; // Moving ancestors and the node itself, root first
+    std::vector<uint32_t> _joints;
+    std::vector<double> _q, _lo, _hi, _dq;
+    std::vector<double> _coord; // Flat coords with the chain's trial values
+    std::vector<Pose> _poses;   // Global poses, valid on the path only
+    std::vector<double> _J;     // 6 x n
+
+    void evaluate_chain(const FlatTree &flat);
+};
+
+} // namespace webkin
@@ -0,0 +1,129 @@
+/**
+ * Lock-free joint payload queue implementation
+ */
+
+#include "ingest_queue.hpp"
+
+namespace webkin
+{
+
+ingest_queue::ingest_queue(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    _slots = std::make_unique<Slot[]>(size);
+    _mask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+    {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _batch.reserve(MAX_BATCH);
+}
+
+ingest_queue::~ingest_queue()
+{
+    stop();
+}
+
+void ingest_queue::start()
+{
+    if (_running)
+        return;
+    _running = true;
+    _thread = std::thread([this]()
+                          { loop(); });
+}
+
+void ingest_queue::stop()
+{
+    if (!_running.exchange(false))
+        return;
+    _signal.fetch_add(1, std::memory_order_release);
+    _signal.notify_one();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+bool ingest_queue::push(std::string_view payload, double received_ms)
+{
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &_slots[pos & _mask];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0)
+        {
+            // The slot is free for this position: claim it
+            if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The consumer has not released this slot yet: full
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->data.assign(payload.data(), payload.size());
+    slot->received_ms = received_ms;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+    _signal.fetch_add(1, std::memory_order_release);
+    _signal.notify_one();
+    return true;
+}
+
+bool ingest_queue::drain()
+{
+    // Collect the published slots in order; they stay claimed until the
+    // callback is done with their data
+    _batch.clear();
+    size_t pos = _head;
+    while (_batch.size() < MAX_BATCH)
+    {
+        Slot &slot = _slots[pos & _mask];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            break;
+        _batch.push_back({slot.data, slot.received_ms});
+        ++pos;
+    }
+    if (_batch.empty())
+        return false;
+
+    _batches.fetch_add(1, std::memory_order_relaxed);
+    if (_on_batch)
+        _on_batch(_batch);
+
+    for (; _head != pos; ++_head)
+    {
+        _slots[_head & _mask].sequence.store(_head + _mask + 1, std::memory_order_release);
+    }
+    return true;
+}
+
+void ingest_queue::loop()
+{
+    while (_running.load(std::memory_order_acquire))
+    {
+        uint32_t seen = _signal.load(std::memory_order_acquire);
+        if (drain())
+            continue;
+        // Sleeps until a push (or stop) changes the signal after `seen`
+        _signal.wait(seen, std::memory_order_acquire);
+    }
+    while (drain())
+    {
+    }
+}
+
+} // namespace webkin
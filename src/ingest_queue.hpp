@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * Hand-off of joint payloads from network threads to a compute thread.
+ *
+ * Transport delivery threads (the mosquitto loop, the Crow executor) and
+ * WebSocket workers push raw joint payloads and return at once; they
+ * never take the robot lock, run forward kinematics or wait for a
+ * broadcast. One robot's compute thread drains everything queued so far
+ * as a batch, applies it in arrival order and publishes once, so a burst
+ * of messages costs one FK pass.
+ *
+ * The queue is a bounded multi-producer ring (after D. Vyukov): every slot
+ * carries a sequence number that tells producers and the consumer whose
+ * turn it is, so push() is lock-free and a producer only contends on one
+ * atomic counter. Slots keep their string buffers, so steady traffic
+ * copies payloads without allocating. Payloads pushed into a full queue
+ * are dropped and counted.
+ *
+ * Payloads are queued undecoded because resolving joint names needs the
+ * tree, which only the compute side may touch.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+class ingest_queue
+{
+public:
+    struct entry
+    {
+        std::string_view payload;
+        double received_ms; // As given to push()
+    };
+
+    /// Called on the compute thread with the payloads of one batch, oldest first.
+    using batch_callback_t = std::function<void(const std::vector<entry> &)>;
+
+    /// `capacity` is rounded up to a power of two.
+    explicit ingest_queue(size_t capacity = 1024);
+    ~ingest_queue();
+
+    void set_batch_callback(batch_callback_t cb) { _on_batch = std::move(cb); }
+
+    void start();
+    /// Process what is queued, then stop the compute thread.
+    void stop();
+
+    bool is_running() const { return _running.load(std::memory_order_acquire); }
+
+    /// Queue a copy of the payload with its arrival time; safe from any
+    /// thread. False if full.
+    bool push(std::string_view payload, double received_ms = 0);
+
+    uint64_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    uint64_t batches() const { return _batches.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<size_t> sequence{0};
+        std::string data;
+        double received_ms = 0;
+    };
+
+    static constexpr size_t MAX_BATCH = 256;
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _tail{0}; // Next position for producers
+    alignas(64) size_t _head = 0;             // Next position for the consumer
+    std::atomic<uint32_t> _signal{0};         // Bumped by push(), waited on when idle
+
+    std::atomic<bool> _running{false};
+    std::atomic<uint64_t> _pushed{0};
+    std::atomic<uint64_t> _dropped{0};
+    std::atomic<uint64_t> _batches{0};
+    std::vector<entry> _batch;
+    std::thread _thread;
+
+    batch_callback_t _on_batch;
+
+    void loop();
+    /// Hand one batch to the callback; false if the queue was empty.
+    bool drain();
+};
+
+} // namespace webkin
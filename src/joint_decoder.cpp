@@ -0,0 +1,335 @@
+/**
+ * In-place joint update decoder
+ */
+
+#include "joint_decoder.hpp"
+#include "fnv.hpp"
+
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little,
+              "joint frames are decoded by memcpy and require a little-endian host");
+
+namespace webkin
+{
+
+namespace
+{
+    class Cursor
+    {
+    public:
+        explicit Cursor(std::string_view s) : _p(s.data()), _end(s.data() + s.size()) {}
+
+        void skip_ws()
+        {
+            while (_p != _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+                ++_p;
+        }
+
+        bool peek(char c)
+        {
+            skip_ws();
+            return _p != _end && *_p == c;
+        }
+
+        bool consume(char c)
+        {
+            if (!peek(c))
+                return false;
+            ++_p;
+            return true;
+        }
+
+        // String without escape sequences, returned as a view into the payload
+        bool string(std::string_view &out)
+        {
+            if (!consume('"'))
+                return false;
+            const char *begin = _p;
+            while (_p != _end && *_p != '"')
+            {
+                if (*_p == '\\')
+                    return false;
+                ++_p;
+            }
+            if (_p == _end)
+                return false;
+            out = std::string_view(begin, _p - begin);
+            ++_p;
+            return true;
+        }
+
+        bool number(double &out)
+        {
+            skip_ws();
+            auto [ptr, ec] = std::from_chars(_p, _end, out);
+            // from_chars also takes nan and inf, which are not JSON
+            if (ec != std::errc() || !std::isfinite(out))
+                return false;
+            _p = ptr;
+            return true;
+        }
+
+        // Skip any JSON value, including nested objects and arrays
+        bool skip_value()
+        {
+            skip_ws();
+            if (_p == _end)
+                return false;
+
+            if (*_p != '{' && *_p != '[')
+            {
+                if (*_p == '"')
+                    return skip_string();
+                // Number or literal
+                while (_p != _end && *_p != ',' && *_p != '}' && *_p != ']' &&
+                       *_p != ' ' && *_p != '\t' && *_p != '\n' && *_p != '\r')
+                    ++_p;
+                return true;
+            }
+
+            int depth = 0;
+            while (_p != _end)
+            {
+                char c = *_p;
+                if (c == '"')
+                {
+                    if (!skip_string())
+                        return false;
+                    continue;
+                }
+                ++_p;
+                if (c == '{' || c == '[')
+                    ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0)
+                    return true;
+            }
+            return false;
+        }
+
+    private:
+        const char *_p;
+        const char *_end;
+
+        bool skip_string()
+        {
+            ++_p; // Opening quote
+            while (_p != _end && *_p != '"')
+            {
+                if (*_p == '\\' && ++_p == _end)
+                    return false;
+                ++_p;
+            }
+            if (_p == _end)
+                return false;
+            ++_p;
+            return true;
+        }
+    };
+
+    // Coordinates of one payload, written to the tree only once all of it
+    // has parsed, so a malformed payload changes nothing
+    struct JointWrites
+    {
+        static constexpr size_t capacity = 256; // More joints go to the fallback parser
+        std::array<std::pair<uint32_t, double>, capacity> writes;
+        size_t size = 0;
+    };
+
+    bool parse_joints(Cursor &in, const KinematicTree &tree, JointWrites &out)
+    {
+        if (!in.consume('{'))
+            return false;
+        if (in.consume('}'))
+            return true;
+
+        do
+        {
+            std::string_view name;
+            double value;
+            if (!in.string(name) || !in.consume(':') || !in.number(value))
+                return false;
+            uint32_t index = tree.joint_index(name);
+            if (index == UINT32_MAX)
+                continue;
+            if (out.size == JointWrites::capacity)
+                return false;
+            out.writes[out.size++] = {index, value};
+        } while (in.consume(','));
+
+        return in.consume('}');
+    }
+}
+
+JointStamp joint_stamp(const nos::trent &message)
+{
+    JointStamp stamp;
+    stamp.source_ts = message["ts"].as_numer_default(0);
+    stamp.seq = static_cast<int64_t>(message["seq"].as_numer_default(-1));
+    return stamp;
+}
+
+bool apply_joint_update(std::string_view payload, KinematicTree &tree, size_t *matched, JointStamp *stamp)
+{
+    Cursor in(payload);
+    JointWrites writes;
+    bool found = false;
+    JointStamp stamps;
+
+    if (!in.consume('{'))
+        return false;
+    if (!in.peek('}'))
+    {
+        do
+        {
+            std::string_view key;
+            if (!in.string(key) || !in.consume(':'))
+                return false;
+            if (key == "joints")
+            {
+                if (!parse_joints(in, tree, writes))
+                    return false;
+                found = true;
+            }
+            else if (key == "ts" || key == "seq")
+            {
+                // Non-numeric stamps are left to the fallback parser
+                double value;
+                if (!in.number(value))
+                    return false;
+                if (key == "ts")
+                    stamps.source_ts = value;
+                else
+                    stamps.seq = static_cast<int64_t>(value);
+            }
+            else if (!in.skip_value())
+            {
+                return false;
+            }
+        } while (in.consume(','));
+    }
+    if (!in.consume('}'))
+        return false;
+
+    for (size_t i = 0; i < writes.size; ++i)
+        tree.set_joint_coord_at(writes.writes[i].first, writes.writes[i].second);
+    if (matched)
+        *matched = writes.size;
+    if (stamp)
+        *stamp = stamps;
+    return found;
+}
+
+JointSchema JointSchema::from_tree(const nos::trent &tree_data, const KinematicTree &tree)
+{
+    JointSchema schema;
+    const auto &announced = tree_data["joint_schema"];
+    if (announced.is_list())
+    {
+        for (const auto &name : announced.as_list())
+        {
+            schema.names.push_back(name.as_string_default(""));
+        }
+    }
+    else
+    {
+        schema.names = tree.get_joint_names();
+    }
+
+    schema.flat_index.reserve(schema.names.size());
+    for (const auto &name : schema.names)
+    {
+        schema.flat_index.push_back(tree.joint_index(name));
+    }
+    schema.hash = compute_hash(schema.names);
+    return schema;
+}
+
+uint64_t JointSchema::compute_hash(const std::vector<std::string> &names)
+{
+    uint64_t h = FNV1A64_BASIS;
+    for (const auto &name : names)
+    {
+        h = fnv1a64(name, h);
+        h = fnv1a64(std::string_view("", 1), h); // Terminating zero byte
+    }
+    return h;
+}
+
+std::string JointSchema::hash_hex() const
+{
+    return webkin::hash_hex(hash);
+}
+
+nos::trent JointSchema::to_trent() const
+{
+    nos::trent t;
+    t.init(nos::trent::type::dict);
+    nos::trent list;
+    list.init(nos::trent::type::list);
+    for (const auto &name : names)
+    {
+        list.push_back(name);
+    }
+    t["names"] = std::move(list);
+    t["hash"] = hash_hex();
+    return t;
+}
+
+JointFrameStatus apply_joint_frame(std::string_view payload, const JointSchema &schema, KinematicTree &tree)
+{
+    if (payload.size() < sizeof(JOINT_FRAME_MAGIC) ||
+        std::memcmp(payload.data(), JOINT_FRAME_MAGIC, sizeof(JOINT_FRAME_MAGIC)) != 0)
+        return JointFrameStatus::NotAFrame;
+    if (payload.size() < JOINT_FRAME_HEADER_SIZE)
+        return JointFrameStatus::Malformed;
+
+    uint32_t count;
+    uint64_t hash;
+    std::memcpy(&count, payload.data() + 4, 4);
+    std::memcpy(&hash, payload.data() + 8, 8);
+    if (payload.size() != JOINT_FRAME_HEADER_SIZE + size_t(count) * sizeof(double))
+        return JointFrameStatus::Malformed;
+    if (hash != schema.hash || count != schema.flat_index.size())
+        return JointFrameStatus::SchemaMismatch;
+
+    // Validate every value first, as the JSON path does: a NaN or inf
+    // rejects the frame before anything is applied
+    const char *values = payload.data() + JOINT_FRAME_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        double value;
+        std::memcpy(&value, values + size_t(i) * sizeof(double), sizeof(double));
+        if (!std::isfinite(value))
+            return JointFrameStatus::Malformed;
+    }
+
+    const char *in = values;
+    for (uint32_t i = 0; i < count; ++i, in += sizeof(double))
+    {
+        uint32_t index = schema.flat_index[i];
+        if (index == UINT32_MAX)
+            continue;
+        double value;
+        std::memcpy(&value, in, sizeof(double));
+        tree.set_joint_coord_at(index, value);
+    }
+    return JointFrameStatus::Applied;
+}
+
+std::string encode_joint_frame(const JointSchema &schema, const std::vector<double> &coords)
+{
+    uint32_t count = static_cast<uint32_t>(coords.size());
+    std::string frame(JOINT_FRAME_HEADER_SIZE + count * sizeof(double), '\0');
+    std::memcpy(frame.data(), JOINT_FRAME_MAGIC, 4);
+    std::memcpy(frame.data() + 4, &count, 4);
+    std::memcpy(frame.data() + 8, &schema.hash, 8);
+    std::memcpy(frame.data() + JOINT_FRAME_HEADER_SIZE, coords.data(), count * sizeof(double));
+    return frame;
+}
+
+} // namespace webkin
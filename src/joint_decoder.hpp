@@ -0,0 +1,101 @@
+#pragma once
+
+/**
+ * Fast paths for joint update payloads on the transport topics.
+ *
+ * JSON: {"joints": {"name": number, ...}} is parsed in place, straight
+ * from the transport buffer, and written to the tree once the whole
+ * payload has parsed, so a malformed one changes nothing. Non-finite
+ * numbers (nan, inf) are rejected. No DOM is built and nothing is
+ * allocated per message. Optional top-level "ts" (source timestamp, ms
+ * since the epoch) and "seq" (source sequence number) are read for latency
+ * tracing; other top-level keys are skipped.
+ *
+ * Binary joint frame (little-endian):
+ *
+ *   char[4] magic            "WKJ1"
+ *   uint32  count            number of coordinates
+ *   uint64  schema_hash      JointSchema::hash the frame was built for
+ *   float64 coords[count]    in schema order
+ *
+ * The schema is the ordered list of joint names. The robot announces it
+ * with the tree as "joint_schema": ["name", ...]; without it the schema is
+ * the tree's joint names in sorted order. The hash is FNV-1a 64 over the
+ * names, each followed by a zero byte. Frames whose hash or count do not
+ * match the current schema are dropped.
+ */
+
+#include "kinematic.hpp"
+
+#include <nos/trent/trent.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+/// Source stamps of a joint message, for latency tracing.
+struct JointStamp
+{
+    double source_ts = 0; // "ts", ms since the epoch; 0 if absent
+    int64_t seq = -1;     // "seq"; -1 if absent
+};
+
+/// Stamps of a parsed joint message.
+JointStamp joint_stamp(const nos::trent &message);
+
+/**
+ * Apply a joint update payload to the tree. Unknown joint names are
+ * ignored; `matched` (optional) receives the number of joints set and
+ * `stamp` (optional) the message's "ts" and "seq".
+ *
+ * Returns false if the payload is not handled by the fast path: malformed
+ * JSON, no "joints" object, escaped names or non-numeric values. The
+ * caller then falls back to the generic trent parser. Nothing is written
+ * to the tree unless the whole payload parses; more than 256 known joints
+ * in one payload are also left to the fallback.
+ */
+bool apply_joint_update(std::string_view payload, KinematicTree &tree, size_t *matched = nullptr,
+                        JointStamp *stamp = nullptr);
+
+constexpr char JOINT_FRAME_MAGIC[4] = {'W', 'K', 'J', '1'};
+constexpr size_t JOINT_FRAME_HEADER_SIZE = 16;
+
+/// Joint order of binary joint frames, resolved against a loaded tree.
+struct JointSchema
+{
+    std::vector<std::string> names;
+    std::vector<uint32_t> flat_index; // Per name; UINT32_MAX if not in the tree
+    uint64_t hash = 0;
+
+    /// Schema from "joint_schema" of the tree JSON, or the sorted joint names.
+    static JointSchema from_tree(const nos::trent &tree_data, const KinematicTree &tree);
+
+    static uint64_t compute_hash(const std::vector<std::string> &names);
+
+    /// Hash as 16 hex digits; JSON numbers cannot hold 64 bits.
+    std::string hash_hex() const;
+
+    nos::trent to_trent() const;
+};
+
+enum class JointFrameStatus
+{
+    NotAFrame,      // No magic: not a binary frame, try the JSON paths
+    Applied,
+    SchemaMismatch, // Built for another schema (hash or count differ)
+    Malformed       // Truncated, inconsistent size or a non-finite value
+};
+
+/// Apply a binary joint frame through the schema's flat indices. Nothing is
+/// applied unless every value is finite.
+JointFrameStatus apply_joint_frame(std::string_view payload, const JointSchema &schema, KinematicTree &tree);
+
+/// Encode a frame for `schema` (robot side, tools).
+std::string encode_joint_frame(const JointSchema &schema, const std::vector<double> &coords);
+
+} // namespace webkin
@@ -0,0 +1,250 @@
+/**
+ * Joint history ring buffer and playback
+ */
+
+#include "joint_history.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace webkin
+{
+
+void JointHistory::reset(const KinematicTree &tree)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _names = tree.get_joint_names();
+    _flat_index = tree.joint_nodes;
+    _joints = _names.size();
+    _head = 0;
+    _size = 0;
+    _time.assign(_capacity, 0.0);
+    _coords.assign(_capacity * _joints, 0.0);
+}
+
+void JointHistory::set_capacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capacity = capacity;
+}
+
+void JointHistory::record(double time_ms, const KinematicTree &tree)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_time.size() != _capacity || _capacity == 0)
+        return;
+
+    // Keep time non-decreasing for binary search
+    if (_size > 0)
+        time_ms = std::max(time_ms, time_at(_size - 1));
+
+    _time[_head] = time_ms;
+    double *out = _coords.data() + _head * _joints;
+    for (size_t j = 0; j < _joints; ++j)
+    {
+        out[j] = tree.flat.coord[_flat_index[j]];
+    }
+    _head = (_head + 1) % _capacity;
+    if (_size < _capacity)
+        ++_size;
+}
+
+size_t JointHistory::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _size;
+}
+
+void JointHistory::resolve(double &from_ms, double &to_ms) const
+{
+    double newest = _size > 0 ? time_at(_size - 1) : 0.0;
+    if (from_ms <= 0)
+        from_ms += newest;
+    if (to_ms <= 0)
+        to_ms += newest;
+}
+
+size_t JointHistory::lower_bound(double t) const
+{
+    size_t lo = 0, hi = _size;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (time_at(mid) < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+size_t JointHistory::upper_bound(double t) const
+{
+    size_t lo = 0, hi = _size;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (time_at(mid) <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+nos::trent JointHistory::query(double from_ms, double to_ms, size_t points) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    resolve(from_ms, to_ms);
+    size_t begin = lower_bound(from_ms);
+    size_t end = std::max(begin, upper_bound(to_ms));
+    size_t count = end - begin;
+
+    // Evenly spaced frames, first and last of the window included
+    std::vector<size_t> picks;
+    if (points == 0 || count <= points)
+    {
+        for (size_t i = begin; i < end; ++i)
+            picks.push_back(i);
+    }
+    else if (points == 1)
+    {
+        picks.push_back(end - 1);
+    }
+    else
+    {
+        for (size_t k = 0; k < points; ++k)
+            picks.push_back(begin + k * (count - 1) / (points - 1));
+    }
+
+    // Times go out relative to the newest frame: absolute epoch ms do not
+    // survive JSON number formatting with full precision
+    double newest = _size > 0 ? time_at(_size - 1) : 0.0;
+    nos::trent result;
+    result.init(nos::trent::type::dict);
+    result["newest"] = std::to_string(static_cast<int64_t>(newest));
+    result["from"] = from_ms - newest;
+    result["to"] = to_ms - newest;
+    result["count"] = static_cast<double>(count);
+
+    nos::trent names, times, values;
+    names.init(nos::trent::type::list);
+    times.init(nos::trent::type::list);
+    values.init(nos::trent::type::dict);
+    for (size_t i : picks)
+    {
+        times.push_back(time_at(i) - newest);
+    }
+    for (size_t j = 0; j < _joints; ++j)
+    {
+        names.push_back(_names[j]);
+        nos::trent column;
+        column.init(nos::trent::type::list);
+        for (size_t i : picks)
+        {
+            column.push_back(_coords[slot(i) * _joints + j]);
+        }
+        values[_names[j]] = std::move(column);
+    }
+    result["joints"] = std::move(names);
+    result["t"] = std::move(times);
+    result["values"] = std::move(values);
+    return result;
+}
+
+HistoryWindow JointHistory::copy_window(double from_ms, double to_ms) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    resolve(from_ms, to_ms);
+    size_t begin = lower_bound(from_ms);
+    size_t end = std::max(begin, upper_bound(to_ms));
+
+    HistoryWindow window;
+    window.joints = _joints;
+    window.flat_index = _flat_index;
+    window.time.reserve(end - begin);
+    window.coords.reserve((end - begin) * _joints);
+    for (size_t i = begin; i < end; ++i)
+    {
+        window.time.push_back(time_at(i));
+        const double *frame = _coords.data() + slot(i) * _joints;
+        window.coords.insert(window.coords.end(), frame, frame + _joints);
+    }
+    return window;
+}
+
+history_player::~history_player()
+{
+    stop();
+}
+
+void history_player::start(HistoryWindow window, double speed)
+{
+    std::lock_guard<std::mutex> control(_control_mutex);
+    join();
+    if (window.size() == 0 || speed <= 0)
+        return;
+
+    _stop = false;
+    _playing = true;
+    _thread = std::thread([this, window = std::move(window), speed]() mutable
+                          { loop(std::move(window), speed); });
+}
+
+void history_player::request_stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+}
+
+void history_player::stop()
+{
+    std::lock_guard<std::mutex> control(_control_mutex);
+    join();
+}
+
+void history_player::join()
+{
+    request_stop();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void history_player::loop(HistoryWindow window, double speed)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const double t0 = window.time.front();
+    auto due = [&](size_t i)
+    {
+        return start + std::chrono::duration_cast<clock::duration>(
+                           std::chrono::duration<double, std::milli>((window.time[i] - t0) / speed));
+    };
+
+    for (size_t i = 0; i < window.size(); ++i)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait_until(lock, due(i), [this]()
+                           { return _stop.load(); });
+        }
+        if (_stop)
+            break;
+
+        // Frames closer together than we can apply are skipped, the newest wins
+        auto now = clock::now();
+        while (i + 1 < window.size() && due(i + 1) <= now)
+            ++i;
+
+        if (_on_frame)
+            _on_frame(window, i);
+    }
+    _playing = false;
+}
+
+} // namespace webkin
@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * Joint history: a bounded ring buffer of timestamped joint vectors.
+ *
+ * Storage for `capacity` frames is allocated once per tree, so recording
+ * is a copy into the ring without allocation. Frames are recorded on
+ * every live ingest, in joint-name order; timestamps are ms since the Unix
+ * epoch, like pose frame timestamps, and kept non-decreasing so windows
+ * can be found by binary search.
+ *
+ * history_player replays a copied window through a frame callback at 1x
+ * or faster.
+ */
+
+#include "kinematic.hpp"
+
+#include <nos/trent/trent.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+/// Contiguous copy of a history window: time[i] and coords[i * joints...].
+struct HistoryWindow
+{
+    std::vector<double> time;
+    std::vector<double> coords;
+    std::vector<uint32_t> flat_index; // Per joint column
+    size_t joints = 0;
+
+    size_t size() const { return time.size(); }
+    const double *frame(size_t i) const { return coords.data() + i * joints; }
+};
+
+class JointHistory
+{
+public:
+    explicit JointHistory(size_t capacity = 0) : _capacity(capacity) {}
+
+    /// Drop all frames and allocate storage for the tree's joints.
+    void reset(const KinematicTree &tree);
+
+    /// Number of frames kept, applies on the next reset().
+    void set_capacity(size_t capacity);
+
+    /// Copy the tree's current joint coordinates as one frame.
+    void record(double time_ms, const KinematicTree &tree);
+
+    size_t size() const;
+    size_t capacity() const { return _capacity; }
+
+    /**
+     * Frames with from_ms <= time <= to_ms, decimated to at most `points`
+     * frames, as {newest, from, to, count, joints: [...], t: [...],
+     * values: {name: [...]}}. Bounds <= 0 count back from the newest frame
+     * (from_ms = -60000: the last minute). Reported times are relative to
+     * the newest frame, whose epoch ms is given as the string "newest".
+     */
+    nos::trent query(double from_ms, double to_ms, size_t points) const;
+
+    /// Copy of every frame in the window for playback (bounds as in query()).
+    HistoryWindow copy_window(double from_ms, double to_ms) const;
+
+private:
+    mutable std::mutex _mutex;
+    size_t _capacity;
+    size_t _joints = 0;
+    size_t _head = 0; // Slot of the next frame
+    size_t _size = 0;
+    std::vector<std::string> _names;
+    std::vector<uint32_t> _flat_index;
+    std::vector<double> _time;
+    std::vector<double> _coords;
+
+    // Logical index 0 is the oldest frame. Caller holds _mutex.
+    size_t slot(size_t i) const { return (_head + _capacity - _size + i) % _capacity; }
+    double time_at(size_t i) const { return _time[slot(i)]; }
+    void resolve(double &from_ms, double &to_ms) const;
+    size_t lower_bound(double t) const;
+    size_t upper_bound(double t) const;
+};
+
+class history_player
+{
+public:
+    using frame_callback_t = std::function<void(const HistoryWindow &, size_t)>;
+
+    history_player() = default;
+    ~history_player();
+
+    void set_frame_callback(frame_callback_t cb) { _on_frame = std::move(cb); }
+
+    /// Replay the window at `speed` x real time, replacing a running playback.
+    void start(HistoryWindow window, double speed);
+
+    /// Stop and join the playback thread.
+    void stop();
+
+    /**
+     * Ask a running playback to end without joining. Safe to call from
+     * code that holds locks the frame callback takes.
+     */
+    void request_stop();
+
+    bool is_playing() const { return _playing; }
+    bool stop_requested() const { return _stop; }
+
+private:
+    std::atomic<bool> _playing{false};
+    std::atomic<bool> _stop{false};
+    std::thread _thread;
+    std::mutex _control_mutex; // Serializes start() and stop()
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    frame_callback_t _on_frame;
+
+    void join();
+    void loop(HistoryWindow window, double speed);
+};
+
+} // namespace webkin
@@ -0,0 +1,154 @@
+/**
+ * Interpolated and dead-reckoned display coordinates
+ */
+
+#include "joint_smoother.hpp"
+
+#include <algorithm>
+
+namespace webkin
+{
+
+bool parse_smooth_mode(const std::string &name, SmoothMode &mode)
+{
+    if (name == "interpolate")
+        mode = SmoothMode::Interpolate;
+    else if (name == "extrapolate")
+        mode = SmoothMode::Extrapolate;
+    else if (name == "off")
+        mode = SmoothMode::Off;
+    else
+        return false;
+    return true;
+}
+
+void JointSmoother::reset(const KinematicTree &tree)
+{
+    _display = tree.flat;
+    _joints = tree.joint_nodes;
+    _time.assign(SAMPLES, 0);
+    _value.assign(_joints.size() * SAMPLES, 0);
+    _head = 0;
+    _count = 0;
+    _interval = 0;
+    _error.assign(_joints.size(), 0);
+    _trace = {};
+}
+
+void JointSmoother::record(double now_ms, const KinematicTree &tree, const SceneTrace &trace)
+{
+    if (_joints.size() != tree.joint_nodes.size())
+        return;
+
+    size_t slot = _head;
+    if (_count > 0)
+    {
+        double dt = now_ms - sample_time(0);
+        if (dt <= 0)
+        {
+            // Same instant: replace the newest sample
+            slot = (_head + SAMPLES - 1) % SAMPLES;
+        }
+        else
+        {
+            _interval = _interval > 0 ? 0.8 * _interval + 0.2 * dt : dt;
+        }
+    }
+
+    for (size_t j = 0; j < _joints.size(); ++j)
+    {
+        double value = tree.flat.coord[_joints[j]];
+        _error[j] = _mode == SmoothMode::Extrapolate && _count > 0 ? dead_reckon(j, now_ms) - value : 0;
+        _value[j * SAMPLES + slot] = value;
+    }
+    _time[slot] = now_ms;
+    if (slot == _head)
+    {
+        _head = (_head + 1) % SAMPLES;
+        _count = std::min(_count + 1, SAMPLES);
+    }
+    if (trace.valid())
+        _trace = trace;
+}
+
+double JointSmoother::velocity(size_t joint) const
+{
+    if (_count < 2 || !(sample_time(0) > sample_time(1)))
+        return 0;
+    return (sample_value(joint, 0) - sample_value(joint, 1)) / (sample_time(0) - sample_time(1));
+}
+
+double JointSmoother::dead_reckon(size_t joint, double t) const
+{
+    double t1 = sample_time(0);
+    double value = sample_value(joint, 0) + velocity(joint) * std::clamp(t - t1, 0.0, 2 * _interval);
+    if (_error[joint] != 0 && _interval > 0)
+        value += _error[joint] * std::max(0.0, 1 - (t - t1) / _interval);
+    return value;
+}
+
+bool JointSmoother::evaluate(double now_ms, const KinematicTree &tree)
+{
+    if (_joints.size() != tree.joint_nodes.size())
+        return false;
+
+    // Axis overrides change the flat tree's parameters
+    if (_display.axis_offset != tree.flat.axis_offset || _display.axis_scale != tree.flat.axis_scale)
+    {
+        _display.axis_offset = tree.flat.axis_offset;
+        _display.axis_scale = tree.flat.axis_scale;
+        _display.mark_all_dirty();
+    }
+
+    bool moving = false;
+    double horizon = 2 * _interval;
+    for (size_t j = 0; j < _joints.size(); ++j)
+    {
+        uint32_t node = _joints[j];
+        double value = tree.flat.coord[node];
+        if (_count > 0)
+        {
+            double t1 = sample_time(0);
+            double q1 = sample_value(j, 0);
+            double v = velocity(j);
+
+            double t = _mode == SmoothMode::Interpolate ? now_ms - _delay_ms : now_ms;
+            if (_mode == SmoothMode::Extrapolate)
+            {
+                value = dead_reckon(j, t);
+                moving |= (v != 0 && t - t1 < horizon) || (_error[j] != 0 && t - t1 < _interval);
+            }
+            else if (t >= t1)
+            {
+                value = q1 + v * std::min(t - t1, horizon);
+                moving |= v != 0 && t - t1 < horizon;
+            }
+            else
+            {
+                // Between two samples, or before the oldest
+                value = sample_value(j, _count - 1);
+                for (size_t age = 0; age + 1 < _count; ++age)
+                {
+                    double t0 = sample_time(age + 1);
+                    if (t >= t0)
+                    {
+                        double q0 = sample_value(j, age + 1);
+                        double span = sample_time(age) - t0;
+                        value = q0 + (sample_value(j, age) - q0) * (span > 0 ? (t - t0) / span : 1);
+                        break;
+                    }
+                }
+                moving |= value != q1 || v != 0;
+            }
+
+            const KinematicNode *joint = tree.nodes[node];
+            if (joint->slider_min < joint->slider_max)
+                value = std::clamp(value, joint->slider_min, joint->slider_max);
+        }
+        _display.set_coord(node, value);
+    }
+    _display.update();
+    return moving;
+}
+
+} // namespace webkin
@@ -0,0 +1,116 @@
+#pragma once
+
+/**
+ * Smoothing of low-rate joint feeds for display.
+ *
+ * The tree keeps the coordinates as received. JointSmoother keeps the last
+ * SAMPLES received values of every joint node with their arrival times
+ * and, on every broadcast tick, evaluates display coordinates into its own
+ * copy of the flat tree, whose poses are published instead of the tree's:
+ *
+ *   Interpolate  Show the feed `delay` ms in the past, linearly between
+ *                the samples around that time. Smooth at any rate as long
+ *                as the delay covers the sample interval.
+ *   Extrapolate  Dead reckoning: the newest sample moved on at the
+ *                velocity of the last two. When a sample arrives, the
+ *                display error decays over one sample interval instead of
+ *                jumping. No added delay.
+ *
+ * Both extrapolate past the newest sample (a dropped packet) for at most
+ * two sample intervals, then hold. Display values are clamped to the
+ * joint's slider_min/slider_max. History, recording, IK and proximity use
+ * the received coordinates.
+ *
+ * Not thread safe: the writer calls it under its lock.
+ */
+
+#include "kinematic.hpp"
+#include "scene_snapshot.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace webkin
+{
+
+enum class SmoothMode : uint8_t
+{
+    Off,
+    Interpolate,
+    Extrapolate
+};
+
+/// "interpolate", "extrapolate" or "off"; false for anything else.
+bool parse_smooth_mode(const std::string &name, SmoothMode &mode);
+
+class JointSmoother
+{
+public:
+    static constexpr size_t SAMPLES = 4;
+
+    void configure(SmoothMode mode, double delay_ms)
+    {
+        _mode = mode;
+        _delay_ms = delay_ms;
+    }
+
+    bool enabled() const { return _mode != SmoothMode::Off; }
+
+    /// A new tree was loaded: drop the samples and copy its flat tree.
+    void reset(const KinematicTree &tree);
+
+    /// The tree's current coordinates as received at `now_ms`. `trace`
+    /// goes with the next evaluated poses.
+    void record(double now_ms, const KinematicTree &tree, const SceneTrace &trace = {});
+
+    /**
+     * Display coordinates at `now_ms` written to display() and its poses
+     * updated. Returns true while they keep changing without new samples,
+     * i.e. another tick is needed.
+     */
+    bool evaluate(double now_ms, const KinematicTree &tree);
+
+    FlatTree &display() { return _display; }
+
+    /// Trace of the newest sample, once.
+    SceneTrace take_trace()
+    {
+        SceneTrace trace = _trace;
+        _trace = {};
+        return trace;
+    }
+
+    /// Estimated sample interval (ms), 0 before two samples
+    double interval() const { return _interval; }
+
+private:
+    SmoothMode _mode = SmoothMode::Off;
+    double _delay_ms = 100;
+
+    FlatTree _display;
+    std::vector<uint32_t> _joints; // Flat indices
+
+    // Per joint, SAMPLES slots each, newest at _head - 1
+    std::vector<double> _time;
+    std::vector<double> _value;
+    size_t _head = 0;
+    size_t _count = 0;
+    double _interval = 0;
+
+    // Extrapolate: display error at the newest sample, decaying
+    std::vector<double> _error;
+
+    SceneTrace _trace;
+
+    double velocity(size_t joint) const; // Of the last two samples
+    double dead_reckon(size_t joint, double t) const;
+
+    double sample_time(size_t age) const { return _time[(_head + SAMPLES - 1 - age) % SAMPLES]; }
+    double sample_value(size_t joint, size_t age) const
+    {
+        return _value[joint * SAMPLES + (_head + SAMPLES - 1 - age) % SAMPLES];
+    }
+};
+
+} // namespace webkin
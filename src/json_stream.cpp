@@ -0,0 +1,368 @@
+/**
+ * Incremental JSON parser implementation
+ */
+
+#include "json_stream.hpp"
+
+#include <cstdlib>
+
+namespace webkin
+{
+
+namespace
+{
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void append_utf8(std::string &out, uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        out += static_cast<char>(cp);
+    }
+    else if (cp < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+} // namespace
+
+bool JsonStreamParser::feed(std::string_view chunk)
+{
+    for (size_t i = 0; i < chunk.size() && !failed();)
+    {
+        if (step(chunk[i]))
+        {
+            ++i;
+            ++_consumed;
+        }
+    }
+    return !failed();
+}
+
+bool JsonStreamParser::finish()
+{
+    if (failed())
+        return false;
+    // A number or literal at the very end has no terminator
+    if (_state == State::Number)
+        end_number();
+    else if (_state == State::Literal)
+        end_literal();
+    if (!failed() && _state != State::Done)
+        fail("unexpected end of input");
+    return !failed();
+}
+
+bool JsonStreamParser::step(char c)
+{
+    switch (_state)
+    {
+    case State::Value:
+    case State::FirstValue:
+        if (is_space(c))
+            return true;
+        if (c == ']' && _state == State::FirstValue)
+        {
+            close();
+            return true;
+        }
+        if (c == '{' || c == '[')
+        {
+            open(c == '{');
+        }
+        else if (c == '"')
+        {
+            _key = false;
+            _token.clear();
+            _state = State::String;
+        }
+        else if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            _token.assign(1, c);
+            _state = State::Number;
+        }
+        else if (c == 't' || c == 'f' || c == 'n')
+        {
+            _token.assign(1, c);
+            _state = State::Literal;
+        }
+        else
+        {
+            fail("unexpected character");
+        }
+        return true;
+
+    case State::Key:
+    case State::FirstKey:
+        if (is_space(c))
+            return true;
+        if (c == '}' && _state == State::FirstKey)
+        {
+            close();
+        }
+        else if (c == '"')
+        {
+            _key = true;
+            _token.clear();
+            _state = State::String;
+        }
+        else
+        {
+            fail("expected a key");
+        }
+        return true;
+
+    case State::Colon:
+        if (is_space(c))
+            return true;
+        if (c == ':')
+            _state = State::Value;
+        else
+            fail("expected ':'");
+        return true;
+
+    case State::AfterValue:
+        if (is_space(c))
+            return true;
+        if (c == ',')
+            _state = _stack.back().dict ? State::Key : State::Value;
+        else if (c == (_stack.back().dict ? '}' : ']'))
+            close();
+        else
+            fail("expected ',' or the end of the container");
+        return true;
+
+    case State::String:
+        if (c == '"')
+        {
+            if (_high)
+            {
+                fail("unpaired surrogate");
+            }
+            else if (_key)
+            {
+                _pending_key = std::move(_token);
+                _state = State::Colon;
+            }
+            else
+            {
+                slot() = _token;
+                value_done();
+            }
+        }
+        else if (c == '\\')
+        {
+            _state = State::Escape;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            fail("control character in a string");
+        }
+        else if (_high)
+        {
+            fail("unpaired surrogate");
+        }
+        else
+        {
+            _token += c;
+        }
+        return true;
+
+    case State::Escape:
+        if (_high && c != 'u')
+        {
+            fail("unpaired surrogate");
+            return true;
+        }
+        _state = State::String;
+        switch (c)
+        {
+        case '"': _token += '"'; break;
+        case '\\': _token += '\\'; break;
+        case '/': _token += '/'; break;
+        case 'b': _token += '\b'; break;
+        case 'f': _token += '\f'; break;
+        case 'n': _token += '\n'; break;
+        case 'r': _token += '\r'; break;
+        case 't': _token += '\t'; break;
+        case 'u':
+            _code = 0;
+            _digits = 0;
+            _state = State::Unicode;
+            break;
+        default:
+            fail("bad escape");
+        }
+        return true;
+
+    case State::Unicode:
+    {
+        int v = hex_value(c);
+        if (v < 0)
+        {
+            fail("bad \\u escape");
+            return true;
+        }
+        _code = _code << 4 | static_cast<uint32_t>(v);
+        if (++_digits == 4)
+            end_unicode();
+        return true;
+    }
+
+    case State::Literal:
+        if (c >= 'a' && c <= 'z')
+        {
+            _token += c;
+            return true;
+        }
+        end_literal();
+        return false;
+
+    case State::Number:
+        if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+        {
+            _token += c;
+            return true;
+        }
+        end_number();
+        return false;
+
+    case State::Done:
+        if (!is_space(c))
+            fail("data after the document");
+        return true;
+    }
+    return true;
+}
+
+nos::trent &JsonStreamParser::slot()
+{
+    if (_stack.empty())
+        return _root;
+    Frame &top = _stack.back();
+    if (top.dict)
+        return (*top.node)[_pending_key];
+    // Ancestors on the stack stay put: only the innermost list grows
+    top.node->push_back(nos::trent());
+    return top.node->as_list().back();
+}
+
+void JsonStreamParser::open(bool dict)
+{
+    if (_stack.size() >= _max_depth)
+    {
+        fail("nesting too deep");
+        return;
+    }
+    nos::trent &node = slot();
+    node.init(dict ? nos::trent::type::dict : nos::trent::type::list);
+    _stack.push_back({&node, dict});
+    _state = dict ? State::FirstKey : State::FirstValue;
+}
+
+void JsonStreamParser::close()
+{
+    _stack.pop_back();
+    value_done();
+}
+
+void JsonStreamParser::value_done()
+{
+    _state = _stack.empty() ? State::Done : State::AfterValue;
+}
+
+bool JsonStreamParser::end_literal()
+{
+    nos::trent &node = slot();
+    if (_token == "true")
+        node = true;
+    else if (_token == "false")
+        node = false;
+    else if (_token != "null")
+    {
+        fail("bad literal");
+        return false;
+    }
+    value_done();
+    return true;
+}
+
+bool JsonStreamParser::end_number()
+{
+    char *end = nullptr;
+    double value = std::strtod(_token.c_str(), &end);
+    if (end != _token.c_str() + _token.size() || _token == "-")
+    {
+        fail("bad number");
+        return false;
+    }
+    slot() = value;
+    value_done();
+    return true;
+}
+
+bool JsonStreamParser::end_unicode()
+{
+    _state = State::String;
+    uint32_t cp = _code;
+    if (_high)
+    {
+        if (cp < 0xDC00 || cp > 0xDFFF)
+        {
+            fail("unpaired surrogate");
+            return false;
+        }
+        cp = 0x10000 + ((_high - 0xD800) << 10) + (cp - 0xDC00);
+        _high = 0;
+    }
+    else if (cp >= 0xD800 && cp <= 0xDBFF)
+    {
+        _high = cp; // The low half follows as another \u escape
+        return true;
+    }
+    else if (cp >= 0xDC00 && cp <= 0xDFFF)
+    {
+        fail("unpaired surrogate");
+        return false;
+    }
+    append_utf8(_token, cp);
+    return true;
+}
+
+void JsonStreamParser::fail(const char *what)
+{
+    if (_error.empty())
+        _error = std::string(what) + " at byte " + std::to_string(_consumed);
+}
+
+} // namespace webkin
@@ -0,0 +1,93 @@
+#pragma once
+
+/**
+ * Incremental JSON parser building a nos::trent.
+ *
+ * The document is fed in chunks as they arrive (a request body streamed
+ * by the HTTP server, see the stream_body rule of POST /api/tree), so a
+ * large upload is never held as text: memory is the resulting trent plus
+ * the token being read. Chunks may split a document anywhere, inside
+ * strings, escapes and numbers too. Accepts what nos::json::parse accepts
+ * for valid JSON: strings with all escapes (\uXXXX with surrogate pairs,
+ * written as UTF-8), numbers as doubles, true/false/null. Nesting deeper
+ * than max_depth is an error.
+ */
+
+#include <nos/trent/trent.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+class JsonStreamParser
+{
+public:
+    explicit JsonStreamParser(size_t max_depth = 256) : _max_depth(max_depth) {}
+
+    /// Parse the next chunk; false once the input is malformed.
+    bool feed(std::string_view chunk);
+
+    /// End of input; false if the document is malformed or incomplete.
+    bool finish();
+
+    bool failed() const { return !_error.empty(); }
+    /// What is wrong and at which byte offset, empty if nothing.
+    const std::string &error() const { return _error; }
+    size_t consumed() const { return _consumed; }
+
+    /// The document, complete after finish() returned true.
+    nos::trent &result() { return _root; }
+
+private:
+    enum class State : uint8_t
+    {
+        Value,      // Expecting a value
+        FirstValue, // A value or ']' of an empty list
+        Key,        // Expecting a key
+        FirstKey,   // A key or '}' of an empty dict
+        Colon,
+        AfterValue, // ',' or the end of the container
+        String,
+        Escape,
+        Unicode,
+        Literal,
+        Number,
+        Done
+    };
+
+    struct Frame
+    {
+        nos::trent *node;
+        bool dict;
+    };
+
+    size_t _max_depth;
+    nos::trent _root;
+    std::vector<Frame> _stack;
+    State _state = State::Value;
+    bool _key = false; // The string being read is a key
+    std::string _token;
+    std::string _pending_key;
+    uint32_t _code = 0;  // \uXXXX being read
+    int _digits = 0;     // Of _code
+    uint32_t _high = 0;  // High surrogate waiting for its pair
+    size_t _consumed = 0;
+    std::string _error;
+
+    bool step(char c); // false: c was not consumed, feed it again
+    nos::trent &slot();
+    void open(bool dict);
+    void close();
+    void value_done();
+    bool end_literal();
+    bool end_number();
+    bool end_unicode();
+    void fail(const char *what);
+};
+
+} // namespace webkin
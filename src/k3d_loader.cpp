@@ -3,6 +3,8 @@
  */
 
 #include "k3d_loader.hpp"
+#include "http_cache.hpp"
+#include "mesh_lod.hpp"
 #include <nos/trent/json.h>
 #include <nos/print.h>
 #include <fstream>
@@ -11,143 +13,400 @@
 #include <cstring>
 #include <zlib.h>
 
-// Simple ZIP reading (central directory at end of file)
-// For production, consider using libzip or miniz
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <thread>
 #include <vector>
 #include <cstdint>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace webkin
 {
 
 namespace
 {
-    // ZIP local file header signature
+    // ZIP record signatures
     constexpr uint32_t ZIP_LOCAL_HEADER_SIG = 0x04034b50;
     constexpr uint32_t ZIP_CENTRAL_DIR_SIG = 0x02014b50;
     constexpr uint32_t ZIP_END_CENTRAL_SIG = 0x06054b50;
-
-    struct ZipLocalHeader
+    constexpr size_t ZIP_LOCAL_HEADER_SIZE = 30;
+    constexpr size_t ZIP_CENTRAL_HEADER_SIZE = 46;
+    constexpr size_t ZIP_END_CENTRAL_SIZE = 22;
+    constexpr size_t ZIP_MAX_COMMENT = 0xffff;
+
+    // Limits on what an archive inflates to, taken from its central
+    // directory before anything is allocated. Uploads go through here too.
+    constexpr size_t K3D_MAX_ENTRY_SIZE = size_t(256) << 20;
+    constexpr size_t K3D_MAX_INFLATED_SIZE = size_t(1) << 30;
+    constexpr const char *SIZE_MISMATCH = "inflated size does not match the header";
+
+    uint16_t read_u16(const unsigned char *p)
     {
-        uint32_t signature;
-        uint16_t version;
-        uint16_t flags;
-        uint16_t compression;
-        uint16_t mod_time;
-        uint16_t mod_date;
-        uint32_t crc32;
-        uint32_t compressed_size;
-        uint32_t uncompressed_size;
-        uint16_t filename_len;
-        uint16_t extra_len;
-    } __attribute__((packed));
-
-    // Decompress raw deflate data using zlib
-    bool inflate_data(const std::vector<char> &compressed, std::vector<char> &decompressed, size_t uncompressed_size)
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t read_u32(const unsigned char *p)
     {
-        decompressed.resize(uncompressed_size);
-        
-        z_stream stream{};
-        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
-        stream.avail_in = compressed.size();
-        stream.next_out = reinterpret_cast<Bytef*>(decompressed.data());
-        stream.avail_out = uncompressed_size;
-        
-        // Use -MAX_WBITS for raw deflate (no zlib/gzip header)
-        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
-            return false;
-        
-        int ret = inflate(&stream, Z_FINISH);
-        inflateEnd(&stream);
-        
-        return (ret == Z_STREAM_END);
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
     }
 
-    bool extract_zip_file(const fs::path &zip_path, const fs::path &dest_dir,
-                          std::string &k3d_json_content)
+    // Read-only mapping of a whole file
+    class MappedFile
     {
-        std::ifstream file(zip_path, std::ios::binary);
-        if (!file)
-            return false;
+    public:
+        explicit MappedFile(const fs::path &path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED)
+                {
+                    _data = static_cast<const unsigned char *>(map);
+                    _size = st.st_size;
+                    ::madvise(map, _size, MADV_WILLNEED);
+                }
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (_data)
+                ::munmap(const_cast<unsigned char *>(_data), _size);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const unsigned char *data() const { return _data; }
+        size_t size() const { return _size; }
+
+    private:
+        const unsigned char *_data = nullptr;
+        size_t _size = 0;
+    };
+
+    // Bytes of a whole archive, mapped or in memory
+    struct ZipView
+    {
+        const unsigned char *bytes = nullptr;
+        size_t length = 0;
+
+        const unsigned char *data() const { return bytes; }
+        size_t size() const { return length; }
+    };
 
-        while (file)
+    struct ZipEntry
+    {
+        std::string name;
+        uint16_t compression = 0;
+        uint32_t crc32 = 0;
+        size_t compressed_size = 0;
+        size_t uncompressed_size = 0;
+        size_t data_offset = 0; // Start of the entry data in the archive
+    };
+
+    // Entries from the central directory, which has the final sizes even
+    // for entries written with data descriptors
+    bool read_central_directory(const ZipView &zip, std::vector<ZipEntry> &entries, std::string &error)
+    {
+        const unsigned char *data = zip.data();
+        const size_t size = zip.size();
+        if (size < ZIP_END_CENTRAL_SIZE)
         {
-            ZipLocalHeader header;
-            file.read(reinterpret_cast<char *>(&header), sizeof(header));
+            error = "not a zip archive";
+            return false;
+        }
 
-            if (!file || header.signature != ZIP_LOCAL_HEADER_SIG)
+        // End of central directory record, followed by at most 64 KiB of comment
+        size_t end = SIZE_MAX;
+        size_t lowest = size > ZIP_END_CENTRAL_SIZE + ZIP_MAX_COMMENT ? size - ZIP_END_CENTRAL_SIZE - ZIP_MAX_COMMENT : 0;
+        for (size_t pos = size - ZIP_END_CENTRAL_SIZE + 1; pos-- > lowest;)
+        {
+            if (read_u32(data + pos) == ZIP_END_CENTRAL_SIG)
+            {
+                end = pos;
                 break;
+            }
+        }
+        if (end == SIZE_MAX)
+        {
+            error = "end of central directory not found";
+            return false;
+        }
+
+        size_t count = read_u16(data + end + 10);
+        size_t dir_size = read_u32(data + end + 12);
+        size_t dir_offset = read_u32(data + end + 16);
+        if (count == 0xffff || dir_size == 0xffffffff || dir_offset == 0xffffffff)
+        {
+            error = "ZIP64 archives are not supported";
+            return false;
+        }
+        if (dir_offset > end || dir_size > end - dir_offset)
+        {
+            error = "central directory out of bounds";
+            return false;
+        }
 
-            // Read filename
-            std::string filename(header.filename_len, '\0');
-            file.read(filename.data(), header.filename_len);
+        entries.clear();
+        entries.reserve(count);
+        size_t pos = dir_offset;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (pos + ZIP_CENTRAL_HEADER_SIZE > end || read_u32(data + pos) != ZIP_CENTRAL_DIR_SIG)
+            {
+                error = "malformed central directory";
+                return false;
+            }
+            const unsigned char *h = data + pos;
+            ZipEntry entry;
+            entry.compression = read_u16(h + 10);
+            entry.crc32 = read_u32(h + 16);
+            entry.compressed_size = read_u32(h + 20);
+            entry.uncompressed_size = read_u32(h + 24);
+            size_t name_len = read_u16(h + 28);
+            size_t extra_len = read_u16(h + 30);
+            size_t comment_len = read_u16(h + 32);
+            size_t local_offset = read_u32(h + 42);
+            if (pos + ZIP_CENTRAL_HEADER_SIZE + name_len > end)
+            {
+                error = "malformed central directory";
+                return false;
+            }
+            entry.name.assign(reinterpret_cast<const char *>(h + ZIP_CENTRAL_HEADER_SIZE), name_len);
+            pos += ZIP_CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len;
 
-            // Skip extra field
-            file.seekg(header.extra_len, std::ios::cur);
+            // The local header may carry a different extra field
+            if (local_offset + ZIP_LOCAL_HEADER_SIZE > size ||
+                read_u32(data + local_offset) != ZIP_LOCAL_HEADER_SIG)
+            {
+                error = "bad local header for " + entry.name;
+                return false;
+            }
+            entry.data_offset = local_offset + ZIP_LOCAL_HEADER_SIZE + read_u16(data + local_offset + 26) +
+                                read_u16(data + local_offset + 28);
+            if (entry.data_offset > size || entry.compressed_size > size - entry.data_offset)
+            {
+                error = "entry data out of bounds for " + entry.name;
+                return false;
+            }
+            entries.push_back(std::move(entry));
+        }
+        return true;
+    }
 
-            // Read file data
-            std::vector<char> data;
-            if (header.compression == 0)
+    // Inflate or copy one entry and check its CRC
+    bool extract_entry(const ZipView &zip, const ZipEntry &entry, std::string &out, std::string &error)
+    {
+        const unsigned char *src = zip.data() + entry.data_offset;
+        if (entry.compression == 0)
+        {
+            if (entry.compressed_size != entry.uncompressed_size)
             {
-                // Stored (no compression)
-                data.resize(header.uncompressed_size);
-                file.read(data.data(), header.uncompressed_size);
+                error = SIZE_MISMATCH;
+                return false;
             }
-            else if (header.compression == 8)
+            out.assign(reinterpret_cast<const char *>(src), entry.compressed_size);
+        }
+        else if (entry.compression == 8)
+        {
+            if (entry.uncompressed_size > K3D_MAX_ENTRY_SIZE)
             {
-                // DEFLATE compression
-                std::vector<char> compressed(header.compressed_size);
-                file.read(compressed.data(), header.compressed_size);
-                
-                if (!inflate_data(compressed, data, header.uncompressed_size))
-                {
-                    nos::println("  Failed to decompress: ", filename);
-                    continue;
-                }
+                error = "entry too large";
+                return false;
             }
-            else
+            out.resize(entry.uncompressed_size);
+            z_stream stream{};
+            // Use -MAX_WBITS for raw deflate (no zlib/gzip header)
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
             {
-                // Skip unsupported compression methods
-                nos::println("  Unsupported compression method ", header.compression, " for: ", filename);
-                file.seekg(header.compressed_size, std::ios::cur);
-                continue;
+                error = "inflateInit failed";
+                return false;
             }
+            // zlib counts in uInt; feed large entries in pieces
+            size_t in_left = entry.compressed_size;
+            stream.next_in = const_cast<Bytef *>(src);
+            stream.next_out = reinterpret_cast<Bytef *>(out.data());
+            size_t out_left = out.size();
+            int ret = Z_OK;
+            while (ret == Z_OK)
+            {
+                uInt in_chunk = static_cast<uInt>(std::min<size_t>(in_left, 1u << 30));
+                uInt out_chunk = static_cast<uInt>(std::min<size_t>(out_left, 1u << 30));
+                stream.avail_in = in_chunk;
+                stream.avail_out = out_chunk;
+                ret = inflate(&stream, Z_NO_FLUSH);
+                in_left -= in_chunk - stream.avail_in;
+                out_left -= out_chunk - stream.avail_out;
+                if (ret == Z_BUF_ERROR && in_left > 0 && out_left > 0)
+                    ret = Z_OK;
+            }
+            inflateEnd(&stream);
+            if ((ret == Z_STREAM_END) != (out_left == 0))
+            {
+                error = SIZE_MISMATCH; // The stream ends before or after the declared size
+                return false;
+            }
+            if (ret != Z_STREAM_END)
+            {
+                error = "corrupt deflate stream";
+                return false;
+            }
+        }
+        else
+        {
+            error = "unsupported compression method " + std::to_string(entry.compression);
+            return false;
+        }
+
+        uLong crc = 0;
+        for (size_t done = 0; done < out.size();)
+        {
+            uInt chunk = static_cast<uInt>(std::min<size_t>(out.size() - done, 1u << 30));
+            crc = crc32(crc, reinterpret_cast<const Bytef *>(out.data() + done), chunk);
+            done += chunk;
+        }
+        if (crc != entry.crc32)
+        {
+            error = "CRC mismatch";
+            return false;
+        }
+        return true;
+    }
+
+    // Run fn(i) for i in [0, count) on a pool of threads; returns the pool size
+    template <class F> size_t parallel_for(size_t count, F &&fn)
+    {
+        std::atomic<size_t> next{0};
+        auto worker = [&]()
+        {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;)
+                fn(i);
+        };
+        size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; ++t)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &thread : pool)
+            thread.join();
+        return threads;
+    }
+
+    bool is_stl(const std::string &basename)
+    {
+        return basename.size() > 4 &&
+               (basename.substr(basename.size() - 4) == ".stl" ||
+                basename.substr(basename.size() - 4) == ".STL");
+    }
 
-            // Get just the filename without path
-            std::string basename = fs::path(filename).filename().string();
+    // Read k3d.json and all STL models of an archive into memory. Entries
+    // are inflated by a pool of threads, largest first so one big model
+    // does not end up last on a single thread.
+    bool extract_zip(const ZipView &zip, const std::string &label, std::string &k3d_json_content,
+                     std::map<std::string, std::string> &models)
+    {
+        std::vector<ZipEntry> entries;
+        std::string error;
+        if (!read_central_directory(zip, entries, error))
+        {
+            nos::println("  Bad archive ", label, ": ", error);
+            return false;
+        }
 
+        // Models are served by basename, k3d.json may sit in a subdirectory
+        std::vector<const ZipEntry *> wanted;
+        int json_entry = -1;
+        for (const auto &entry : entries)
+        {
+            std::string basename = fs::path(entry.name).filename().string();
             if (basename == "k3d.json")
             {
-                k3d_json_content = std::string(data.begin(), data.end());
+                json_entry = static_cast<int>(wanted.size());
+                wanted.push_back(&entry);
             }
-            else if (basename.size() > 4 &&
-                     (basename.substr(basename.size() - 4) == ".stl" ||
-                      basename.substr(basename.size() - 4) == ".STL"))
+            else if (is_stl(basename))
             {
-                fs::path out_path = dest_dir / basename;
-                std::ofstream out(out_path, std::ios::binary);
-                out.write(data.data(), data.size());
-                nos::println("  Extracted: ", basename);
+                wanted.push_back(&entry);
             }
         }
+        if (json_entry < 0)
+            return false;
+        const ZipEntry *json = wanted[json_entry];
 
+        size_t inflated = 0;
+        for (const ZipEntry *entry : wanted)
+        {
+            if (entry->uncompressed_size > K3D_MAX_ENTRY_SIZE)
+            {
+                nos::println("  Bad archive ", label, ": ", entry->name, " inflates to ",
+                             entry->uncompressed_size >> 20, " MiB, the limit is ", K3D_MAX_ENTRY_SIZE >> 20);
+                return false;
+            }
+            inflated += entry->uncompressed_size;
+        }
+        if (inflated > K3D_MAX_INFLATED_SIZE)
+        {
+            nos::println("  Bad archive ", label, ": inflates to ", inflated >> 20, " MiB, the limit is ",
+                         K3D_MAX_INFLATED_SIZE >> 20);
+            return false;
+        }
+        std::stable_sort(wanted.begin(), wanted.end(), [](const ZipEntry *a, const ZipEntry *b)
+                         { return a->uncompressed_size > b->uncompressed_size; });
+
+        std::vector<std::string> data(wanted.size());
+        std::vector<std::string> errors(wanted.size());
+        size_t threads = parallel_for(wanted.size(), [&](size_t i)
+                                      {
+            if (!extract_entry(zip, *wanted[i], data[i], errors[i]) && errors[i].empty())
+                errors[i] = "failed"; });
+
+        size_t bytes = 0;
+        for (size_t i = 0; i < wanted.size(); ++i)
+        {
+            if (errors[i] == SIZE_MISMATCH)
+            {
+                nos::println("  Bad archive ", label, ": ", wanted[i]->name, ": ", errors[i]);
+                return false;
+            }
+            if (!errors[i].empty())
+            {
+                nos::println("  Failed to extract ", wanted[i]->name, ": ", errors[i]);
+                continue;
+            }
+            if (wanted[i] == json)
+            {
+                k3d_json_content = std::move(data[i]);
+                continue;
+            }
+            bytes += data[i].size();
+            models[fs::path(wanted[i]->name).filename().string()] = std::move(data[i]);
+        }
+        nos::println("  Extracted ", models.size(), " models (", bytes / 1024, " KiB) with ", threads, " threads");
         return !k3d_json_content.empty();
     }
 
-    std::string generate_temp_dir()
+    bool extract_zip_file(const fs::path &zip_path, std::string &k3d_json_content,
+                          std::map<std::string, std::string> &models)
     {
-        const char *tmpdir = std::getenv("TMPDIR");
-        if (!tmpdir)
-            tmpdir = "/tmp";
-
-        std::string path = std::string(tmpdir) + "/webkin_k3d_XXXXXX";
-        std::vector<char> buf(path.begin(), path.end());
-        buf.push_back('\0');
-
-        if (mkdtemp(buf.data()) == nullptr)
+        MappedFile zip(zip_path);
+        if (!zip.data())
         {
-            return "";
+            nos::println("  Cannot map ", zip_path.string(), ": ", std::strerror(errno));
+            return false;
         }
-        return std::string(buf.data());
+        return extract_zip({zip.data(), zip.size()}, zip_path.string(), k3d_json_content, models);
     }
 }
 
@@ -156,7 +415,7 @@ K3DLoader::~K3DLoader()
     cleanup();
 }
 
-nos::trent K3DLoader::load_file(const fs::path &k3d_path)
+nos::trent K3DLoader::load_file(const fs::path &k3d_path, const K3DLoader *previous)
 {
     fs::path resolved = fs::weakly_canonical(k3d_path);
 
@@ -165,27 +424,38 @@ nos::trent K3DLoader::load_file(const fs::path &k3d_path)
         throw std::runtime_error("K3D file not found: " + resolved.string());
     }
 
-    // Clean up previous temp dir
+    // Drop models of the previous file
     cleanup();
 
-    // Create temp directory
-    std::string temp_str = generate_temp_dir();
-    if (temp_str.empty())
+    // Models stay in memory, served from there
+    std::string k3d_json_content;
+    std::map<std::string, std::string> raw;
+    if (!extract_zip_file(resolved, k3d_json_content, raw))
     {
-        throw std::runtime_error("Failed to create temp directory");
+        throw std::runtime_error("Bad archive: no k3d.json, or an entry fails the size checks");
     }
-    _temp_dir = temp_str;
-    _models_dir = _temp_dir / "models";
-    fs::create_directories(_models_dir);
+    prepare_models(std::move(raw), previous);
+
+    // Parse JSON
+    nos::trent raw_data = nos::json::parse(k3d_json_content);
+    parse_k3d_json(raw_data);
+
+    return _tree_data;
+}
+
+nos::trent K3DLoader::load_archive(const std::string &data, const K3DLoader *previous)
+{
+    cleanup();
 
-    // Extract zip
     std::string k3d_json_content;
-    if (!extract_zip_file(resolved, _models_dir, k3d_json_content))
+    std::map<std::string, std::string> raw;
+    ZipView zip{reinterpret_cast<const unsigned char *>(data.data()), data.size()};
+    if (!extract_zip(zip, "upload", k3d_json_content, raw))
     {
-        throw std::runtime_error("k3d.json not found in archive");
+        throw std::runtime_error("Not a K3D archive: no k3d.json, or an entry fails the size checks");
     }
+    prepare_models(std::move(raw), previous);
 
-    // Parse JSON
     nos::trent raw_data = nos::json::parse(k3d_json_content);
     parse_k3d_json(raw_data);
 
@@ -207,12 +477,10 @@ nos::trent K3DLoader::load_directory(const fs::path &dir_path)
         throw std::runtime_error("k3d.json not found in " + resolved.string());
     }
 
-    // Clean up previous temp dir
     cleanup();
 
     // Use directory directly
     _models_dir = resolved;
-    _temp_dir.clear();
 
     // Read and parse k3d.json
     std::ifstream file(k3d_json_path);
@@ -225,6 +493,71 @@ nos::trent K3DLoader::load_directory(const fs::path &dir_path)
     return _tree_data;
 }
 
+void K3DLoader::prepare_models(std::map<std::string, std::string> raw, const K3DLoader *previous)
+{
+    // Models with the same bytes as in the previous archive keep their
+    // bodies and levels, and so their hashes and URLs
+    size_t reused = 0;
+    std::vector<std::pair<const std::string *, std::string *>> work;
+    for (auto &[name, data] : raw)
+    {
+        if (previous)
+        {
+            auto body = previous->_models.find(name);
+            if (body != previous->_models.end() && body->second->content == data)
+            {
+                _models[name] = body->second;
+                auto lods = previous->_lods.find(name);
+                if (lods != previous->_lods.end())
+                    _lods[name] = lods->second;
+                ++reused;
+                continue;
+            }
+        }
+        work.emplace_back(&name, &data);
+    }
+    if (reused > 0)
+        nos::println("  Unchanged models: ", reused);
+    // Largest first, as for inflating
+    std::stable_sort(work.begin(), work.end(), [](const auto &a, const auto &b)
+                     { return a.second->size() > b.second->size(); });
+
+    // Levels of detail, then everything hashed and gzipped once
+    std::vector<std::shared_ptr<const CachedBody>> bodies(work.size());
+    std::vector<std::vector<Level>> levels(work.size());
+    std::vector<char> valid(work.size());
+    parallel_for(work.size(), [&](size_t i)
+                 {
+        std::vector<MeshLod> lods = build_mesh_lods(*work[i].second);
+        valid[i] = !lods.empty();
+        for (auto &lod : lods)
+            levels[i].push_back({make_cached_body(std::move(lod.data), "application/octet-stream", true),
+                                 lod.triangles, lod.hash});
+        bodies[i] = make_cached_body(std::move(*work[i].second), "application/octet-stream", true); });
+
+    size_t stl = 0, gzipped = 0, finest = 0, coarsest = 0, meshes = 0;
+    for (size_t i = 0; i < work.size(); ++i)
+    {
+        const CachedBody &body = *bodies[i];
+        stl += body.content.size();
+        gzipped += body.gzip.empty() ? body.content.size() : body.gzip.size();
+        _models[*work[i].first] = std::move(bodies[i]);
+        if (!valid[i])
+        {
+            nos::println("  No levels of detail for ", *work[i].first, ": not a valid STL");
+            continue;
+        }
+        finest += levels[i].front().body->content.size();
+        coarsest += levels[i].back().body->content.size();
+        _lods[*work[i].first] = std::move(levels[i]);
+        ++meshes;
+    }
+    nos::println("  Models: ", stl / 1024, " KiB STL, ", gzipped / 1024, " KiB gzipped");
+    if (meshes > 0)
+        nos::println("  Meshes for ", meshes, " models: ", finest / 1024, " KiB full, ", coarsest / 1024,
+                     " KiB coarsest");
+}
+
 void K3DLoader::parse_k3d_json(const nos::trent &raw_data)
 {
     // Extract scale dict
@@ -294,8 +627,27 @@ nos::trent K3DLoader::convert_node(const nos::trent &node)
             }
 
             model_out["type"] = "stl";
-            model_out["path"] = "/k3d/models/" + stl_path;
+            model_out["path"] = _models_url + stl_path;
             model_out["scale"] = scale;
+
+            // Preprocessed meshes, finest first; the hash keeps URLs cacheable
+            auto lods = _lods.find(stl_path);
+            if (lods != _lods.end())
+            {
+                nos::trent list;
+                list.init(nos::trent::type::list);
+                for (size_t i = 0; i < lods->second.size(); ++i)
+                {
+                    const Level &lod = lods->second[i];
+                    nos::trent entry;
+                    entry.init(nos::trent::type::dict);
+                    entry["path"] = _models_url + stl_path + "?lod=" + std::to_string(i) + "&v=" + lod.hash;
+                    entry["triangles"] = static_cast<double>(lod.triangles);
+                    entry["hash"] = lod.hash;
+                    list.push_back(std::move(entry));
+                }
+                model_out["lods"] = std::move(list);
+            }
         }
         else if (model_type == "none")
         {
@@ -391,23 +743,49 @@ double K3DLoader::parse_number(const nos::trent &value)
     return 0.0;
 }
 
-fs::path K3DLoader::get_model_path(const std::string &filename) const
+std::shared_ptr<const CachedBody> K3DLoader::model(const std::string &filename) const
 {
-    if (_models_dir.empty())
-        return {};
+    if (filename.find("..") != std::string::npos)
+        return nullptr;
+    auto it = _models.find(filename);
+    return it != _models.end() ? it->second : nullptr;
+}
 
+fs::path K3DLoader::model_file(const std::string &filename) const
+{
+    if (_models_dir.empty() || filename.find("..") != std::string::npos)
+        return {};
     fs::path path = _models_dir / filename;
-    return fs::exists(path) ? path : fs::path{};
+    std::error_code ec;
+    return fs::is_regular_file(path, ec) ? path : fs::path();
+}
+
+bool K3DLoader::model_triangles(const std::string &filename, std::vector<float> &triangles) const
+{
+    if (auto content = model(filename))
+        return parse_stl(content->content, triangles);
+    fs::path file = model_file(filename);
+    if (file.empty())
+        return false;
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return parse_stl(buffer.str(), triangles);
+}
+
+std::shared_ptr<const CachedBody> K3DLoader::model_lod(const std::string &filename, size_t level) const
+{
+    auto it = _lods.find(filename);
+    if (it == _lods.end() || level >= it->second.size())
+        return nullptr;
+    return it->second[level].body;
 }
 
 void K3DLoader::cleanup()
 {
-    if (!_temp_dir.empty() && fs::exists(_temp_dir))
-    {
-        fs::remove_all(_temp_dir);
-        _temp_dir.clear();
-        _models_dir.clear();
-    }
+    _models.clear();
+    _lods.clear();
+    _models_dir.clear();
 }
 
 } // namespace webkin
@@ -3,18 +3,29 @@
 /**
  * K3D file loader - loads kinematic tree from .k3d files
  * (zip archives with k3d.json and STL models)
+ *
+ * Archives are mapped and read through their central directory; entries
+ * are inflated in parallel and the models kept in memory, so serving a
+ * model never touches the disk. Archive STL models are also preprocessed
+ * into indexed, quantized meshes with levels of detail (mesh_lod.hpp),
+ * listed under "lods" in the model entries of the tree. Models and levels
+ * are hashed and gzipped once at load (http_cache.hpp).
  */
 
 #include <string>
 #include <map>
+#include <memory>
 #include <filesystem>
 #include <nos/trent/trent.h>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 namespace webkin
 {
 
+struct CachedBody;
+
 class K3DLoader
 {
 public:
@@ -22,10 +33,17 @@ public:
     ~K3DLoader();
 
     /**
-     * Load a .k3d file (zip archive) and extract its contents.
-     * Returns the kinematic tree in webkin format.
+     * Load a .k3d file (zip archive) with its models.
+     * Returns the kinematic tree in webkin format. Models whose bytes equal
+     * those of the `previous` loader reuse its meshes instead of being
+     * preprocessed again.
      */
-    nos::trent load_file(const fs::path &k3d_path);
+    nos::trent load_file(const fs::path &k3d_path, const K3DLoader *previous = nullptr);
+
+    /**
+     * Load a .k3d archive held in memory, e.g. an upload, as load_file().
+     */
+    nos::trent load_archive(const std::string &data, const K3DLoader *previous = nullptr);
 
     /**
      * Load from an already extracted directory containing k3d.json and STL files.
@@ -33,37 +51,75 @@ public:
     nos::trent load_directory(const fs::path &dir_path);
 
     /**
-     * Get the full path to a model file
+     * Contents of an archive model, null if there is no such model
+     */
+    std::shared_ptr<const CachedBody> model(const std::string &filename) const;
+
+    /**
+     * Path of a model of load_directory(), empty if there is no such file.
+     * These are streamed from disk on every request, so edits show up.
+     */
+    fs::path model_file(const std::string &filename) const;
+
+    /**
+     * Triangles of a model from the archive or the models directory, as
+     * parse_stl() returns them; false if there is no such valid STL
      */
-    fs::path get_model_path(const std::string &filename) const;
+    bool model_triangles(const std::string &filename, std::vector<float> &triangles) const;
 
     /**
-     * Check if models directory is set
+     * WKM1 mesh of a model at a level of detail (0 is the finest), null if
+     * there is no such level. Only archive models are preprocessed.
      */
-    bool has_models() const { return !_models_dir.empty(); }
+    std::shared_ptr<const CachedBody> model_lod(const std::string &filename, size_t level) const;
 
     /**
-     * Get models directory
+     * Check if models are available (from an archive or a directory)
+     */
+    bool has_models() const { return !_models.empty() || !_models_dir.empty(); }
+
+    /**
+     * Models directory of load_directory(), empty for archives
      */
     const fs::path &models_dir() const { return _models_dir; }
 
+    /**
+     * Number of models held in memory
+     */
+    size_t model_count() const { return _models.size(); }
+
     /**
      * Get camera pose (if present in k3d.json)
      */
     const nos::trent &camera_pose() const { return _camera_pose; }
 
     /**
-     * Clean up temporary files
+     * URL prefix written to model paths of loaded trees (default /k3d/models/)
+     */
+    void set_models_url(const std::string &prefix) { _models_url = prefix; }
+
+    /**
+     * Drop the models of the loaded file
      */
     void cleanup();
 
 private:
     fs::path _models_dir;
-    fs::path _temp_dir;
+    struct Level
+    {
+        std::shared_ptr<const CachedBody> body; // WKM1 mesh
+        uint32_t triangles = 0;
+        std::string hash;
+    };
+
+    std::map<std::string, std::shared_ptr<const CachedBody>> _models; // By file name
+    std::map<std::string, std::vector<Level>> _lods;                  // Finest first
+    std::string _models_url = "/k3d/models/";
     nos::trent _tree_data;
     nos::trent _camera_pose;
     std::map<std::string, double> _scale_dict;
 
+    void prepare_models(std::map<std::string, std::string> raw, const K3DLoader *previous);
     void parse_k3d_json(const nos::trent &raw_data);
     nos::trent convert_node(const nos::trent &node);
     nos::trent convert_vec3(const nos::trent &vec);
@@ -5,13 +5,22 @@
  * C++ port of kinematic.py
  */
 
+#include "fnv.hpp"
+
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <nos/trent/trent.h>
 
+#include "name_table.hpp"
+#include "worker_pool.hpp"
+
 namespace webkin
 {
 
@@ -34,6 +43,11 @@ struct Vec3
         return Vec3(x * scalar, y * scalar, z * scalar);
     }
 
+    bool operator==(const Vec3 &other) const
+    {
+        return x == other.x && y == other.y && z == other.z;
+    }
+
     nos::trent to_trent() const
     {
         nos::trent t;
@@ -74,12 +88,22 @@ struct Quat
             w * other.w - x * other.x - y * other.y - z * other.z);
     }
 
+    bool operator==(const Quat &other) const
+    {
+        return x == other.x && y == other.y && z == other.z && w == other.w;
+    }
+
     Vec3 rotate_vec(const Vec3 &v) const
     {
-        Quat qv(v.x, v.y, v.z, 0);
-        Quat conj(-x, -y, -z, w);
-        Quat result = (*this) * qv * conj;
-        return Vec3(result.x, result.y, result.z);
+        // Same as (q * v * conj(q)) for a unit quaternion, with half the
+        // arithmetic: t = 2 (q x v), v' = v + w t + q x t
+        double tx = 2 * (y * v.z - z * v.y);
+        double ty = 2 * (z * v.x - x * v.z);
+        double tz = 2 * (x * v.y - y * v.x);
+        return Vec3(
+            v.x + w * tx + (y * tz - z * ty),
+            v.y + w * ty + (z * tx - x * tz),
+            v.z + w * tz + (x * ty - y * tx));
     }
 
     nos::trent to_trent() const
@@ -127,6 +151,11 @@ struct Pose
             orientation * other.orientation);
     }
 
+    bool operator==(const Pose &other) const
+    {
+        return position == other.position && orientation == other.orientation;
+    }
+
     nos::trent to_trent() const
     {
         nos::trent t;
@@ -137,13 +166,497 @@ struct Pose
     }
 };
 
+enum class JointType : uint8_t
+{
+    Transform,
+    Rotator,
+    Actuator
+};
+
+inline JointType joint_type_from_string(std::string_view type)
+{
+    if (type == "rotator")
+        return JointType::Rotator;
+    if (type == "actuator")
+        return JointType::Actuator;
+    return JointType::Transform;
+}
+
+/**
+ * Joint transform specialized at load time from the joint type and axis.
+ * Rotators about a signed coordinate axis multiply by a quaternion with a
+ * single non-zero vector component.
+ */
+enum class JointKind : uint8_t
+{
+    Fixed, // Transform node: folded into the base pose of its descendants
+    RotateX,
+    RotateY,
+    RotateZ,
+    Rotate, // Rotator about any other axis
+    Translate
+};
+
+inline JointKind joint_kind(JointType type, const Vec3 &axis)
+{
+    switch (type)
+    {
+    case JointType::Transform:
+        return JointKind::Fixed;
+    case JointType::Actuator:
+        return JointKind::Translate;
+    case JointType::Rotator:
+        break;
+    }
+    auto unit = [](double v)
+    { return v == 1.0 || v == -1.0; };
+    if (unit(axis.x) && axis.y == 0 && axis.z == 0)
+        return JointKind::RotateX;
+    if (axis.x == 0 && unit(axis.y) && axis.z == 0)
+        return JointKind::RotateY;
+    if (axis.x == 0 && axis.y == 0 && unit(axis.z))
+        return JointKind::RotateZ;
+    return JointKind::Rotate;
+}
+
+struct FlatTree;
+
+/// Rows [begin, end) of FlatTree::evaluate_batch(); vectorized, see pose_kernels.hpp.
+void evaluate_rows(const FlatTree &flat, const std::vector<uint32_t> &joints, const double *coords,
+                   size_t begin, size_t end, Pose *out);
+
+/// Generated forward kinematics of one tree structure, see fk_model.hpp.
+using CompiledUpdate = void (*)(FlatTree &flat);
+
+/// Generated FK registered for a structure fingerprint (fk_models.cpp),
+/// null if there is none or generated FK is turned off.
+CompiledUpdate find_compiled_update(uint64_t fingerprint);
+
+/**
+ * Compiled, structure-of-arrays form of the kinematic tree.
+ *
+ * Nodes are stored in depth-first pre-order, so every parent precedes its
+ * children and all global poses are computed in one linear pass over
+ * contiguous arrays. Built from the pointer tree by KinematicTree::load().
+ *
+ * Static transform nodes are folded: base[i] is the constant pose of node
+ * i's joint frame relative to its anchor, the nearest ancestor with a
+ * moving joint (or the world for anchor -1), so every node costs one pose
+ * composition plus its joint transform however long the static chain.
+ *
+ * Because of the pre-order layout the subtree of node i is the contiguous
+ * range [i, subtree_end[i]). Nodes whose coord or axis parameters change
+ * are marked dirty, and update() recomputes only the subtrees below the
+ * topmost dirty nodes. Nodes whose global pose actually changed are
+ * collected in changed_list until the consumer clears them.
+ *
+ * A tree whose structure has generated FK (fk_model.hpp) is updated by
+ * that function instead: one unrolled pass over all nodes, with the
+ * joint kinds and base poses compiled in.
+ */
+struct FlatTree
+{
+    std::vector<int32_t> parent; // -1 for root
+    std::vector<uint32_t> subtree_end;
+    std::vector<JointType> joint_type;
+    std::vector<Pose> local_pose;
+    std::vector<Vec3> axis;
+    std::vector<double> axis_offset;
+    std::vector<double> axis_scale;
+    std::vector<double> coord;
+    std::vector<Pose> global_pose;
+
+    // Filled by finalize()
+    std::vector<JointKind> kind;
+    std::vector<int32_t> anchor;
+    std::vector<Pose> base;
+
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> dirty_list;
+    bool all_dirty = true;
+
+    std::vector<uint8_t> changed;
+    std::vector<uint32_t> changed_list;
+
+    CompiledUpdate compiled = nullptr; // Generated FK of this structure, if any
+
+    size_t size() const { return parent.size(); }
+
+    void clear()
+    {
+        parent.clear();
+        subtree_end.clear();
+        joint_type.clear();
+        local_pose.clear();
+        axis.clear();
+        axis_offset.clear();
+        axis_scale.clear();
+        coord.clear();
+        global_pose.clear();
+        kind.clear();
+        anchor.clear();
+        base.clear();
+        dirty.clear();
+        dirty_list.clear();
+        all_dirty = true;
+        changed.clear();
+        changed_list.clear();
+        compiled = nullptr;
+    }
+
+    void reserve(size_t n)
+    {
+        parent.reserve(n);
+        subtree_end.reserve(n);
+        joint_type.reserve(n);
+        local_pose.reserve(n);
+        axis.reserve(n);
+        axis_offset.reserve(n);
+        axis_scale.reserve(n);
+        coord.reserve(n);
+        global_pose.reserve(n);
+        kind.reserve(n);
+        anchor.reserve(n);
+        base.reserve(n);
+        dirty.reserve(n);
+        dirty_list.reserve(n);
+        changed.reserve(n);
+        changed_list.reserve(n);
+    }
+
+    /// Fill subtree_end, kinds and folded base poses. Call after all nodes are pushed.
+    void finalize()
+    {
+        kind.resize(size());
+        anchor.resize(size());
+        base.resize(size());
+        for (size_t i = 0; i < size(); ++i)
+        {
+            kind[i] = joint_kind(joint_type[i], axis[i]);
+            int32_t p = parent[i];
+            if (p < 0 || kind[p] != JointKind::Fixed)
+            {
+                anchor[i] = p;
+                base[i] = local_pose[i];
+            }
+            else
+            {
+                anchor[i] = anchor[p];
+                base[i] = base[p] * local_pose[i];
+            }
+        }
+
+        subtree_end.resize(size());
+        for (size_t i = 0; i < size(); ++i)
+        {
+            subtree_end[i] = static_cast<uint32_t>(i + 1);
+        }
+        for (size_t i = size(); i-- > 1;)
+        {
+            int32_t p = parent[i];
+            subtree_end[p] = std::max(subtree_end[p], subtree_end[i]);
+        }
+        dirty.assign(size(), 0);
+        dirty_list.clear();
+        all_dirty = true;
+        changed.assign(size(), 0);
+        changed_list.clear();
+    }
+
+    /**
+     * FNV-1a 64 of what forward kinematics depends on besides coords and
+     * axis parameters: parents, joint kinds, axes and folded base poses.
+     * Identifies the generated FK of a structure.
+     */
+    uint64_t fingerprint() const
+    {
+        uint64_t hash = FNV1A64_BASIS;
+        auto add = [&hash](const void *data, size_t size)
+        { hash = fnv1a64_bytes(data, size, hash); };
+        uint64_t n = size();
+        add(&n, sizeof(n));
+        for (size_t i = 0; i < size(); ++i)
+        {
+            const double values[10] = {axis[i].x,
+                                       axis[i].y,
+                                       axis[i].z,
+                                       base[i].position.x,
+                                       base[i].position.y,
+                                       base[i].position.z,
+                                       base[i].orientation.x,
+                                       base[i].orientation.y,
+                                       base[i].orientation.z,
+                                       base[i].orientation.w};
+            add(&parent[i], sizeof(parent[i]));
+            add(&kind[i], sizeof(kind[i]));
+            add(values, sizeof(values));
+        }
+        return hash;
+    }
+
+    void mark_dirty(size_t i)
+    {
+        if (!dirty[i])
+        {
+            dirty[i] = 1;
+            dirty_list.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    void mark_all_dirty()
+    {
+        all_dirty = true;
+    }
+
+    void mark_changed(size_t i)
+    {
+        if (!changed[i])
+        {
+            changed[i] = 1;
+            changed_list.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    /// Set a global pose computed elsewhere, e.g. received from another
+    /// server, and record the change. update() would overwrite it.
+    void set_global_pose(size_t i, const Pose &pose)
+    {
+        if (!(global_pose[i] == pose))
+        {
+            global_pose[i] = pose;
+            mark_changed(i);
+        }
+    }
+
+    void clear_changed()
+    {
+        for (uint32_t i : changed_list)
+        {
+            changed[i] = 0;
+        }
+        changed_list.clear();
+    }
+
+    void set_coord(size_t i, double value)
+    {
+        if (coord[i] != value)
+        {
+            coord[i] = value;
+            mark_dirty(i);
+        }
+    }
+
+    Pose joint_transform(size_t i) const
+    {
+        return joint_transform(i, coord[i]);
+    }
+
+    Pose joint_transform(size_t i, double value) const
+    {
+        // Apply offset and scale: effective_coord = (coord + offset) * axis_scale
+        double effective_coord = (value + axis_offset[i]) * axis_scale[i];
+        switch (joint_type[i])
+        {
+        case JointType::Rotator:
+            return Pose(Vec3(), Quat::from_axis_angle(axis[i], effective_coord));
+        case JointType::Actuator:
+            return Pose(axis[i] * effective_coord, Quat());
+        case JointType::Transform:
+            break;
+        }
+        return Pose();
+    }
+
+    /// frame * joint_transform(i), specialized by kind.
+    Pose apply_joint(size_t i, const Pose &frame) const
+    {
+        return apply_joint(i, frame, coord[i]);
+    }
+
+    /// frame * joint_transform(i, value).
+    Pose apply_joint(size_t i, const Pose &frame, double value) const
+    {
+        if (kind[i] == JointKind::Fixed)
+            return frame;
+
+        double effective_coord = (value + axis_offset[i]) * axis_scale[i];
+        const Quat &q = frame.orientation;
+        const Vec3 &ax = axis[i];
+        if (kind[i] == JointKind::Translate)
+            return Pose(frame.position + q.rotate_vec(ax * effective_coord), q);
+
+        double s = std::sin(effective_coord / 2);
+        double c = std::cos(effective_coord / 2);
+        switch (kind[i])
+        {
+        case JointKind::RotateX:
+            s *= ax.x;
+            return Pose(frame.position, Quat(q.w * s + q.x * c, q.y * c + q.z * s, q.z * c - q.y * s, q.w * c - q.x * s));
+        case JointKind::RotateY:
+            s *= ax.y;
+            return Pose(frame.position, Quat(q.x * c - q.z * s, q.w * s + q.y * c, q.z * c + q.x * s, q.w * c - q.y * s));
+        case JointKind::RotateZ:
+            s *= ax.z;
+            return Pose(frame.position, Quat(q.x * c + q.y * s, q.y * c - q.x * s, q.w * s + q.z * c, q.w * c - q.z * s));
+        case JointKind::Rotate:
+            return Pose(frame.position, q * Quat(ax.x * s, ax.y * s, ax.z * s, c));
+        case JointKind::Translate:
+        case JointKind::Fixed:
+            break;
+        }
+        return frame;
+    }
+
+    void compute_pose(size_t i)
+    {
+        // Global = anchor * base * joint, base folding the static chain in between
+        int32_t a = anchor[i];
+        Pose pose = apply_joint(i, a < 0 ? base[i] : global_pose[a] * base[i]);
+        if (!(pose == global_pose[i]))
+        {
+            global_pose[i] = pose;
+            mark_changed(i);
+        }
+    }
+
+    void update()
+    {
+        if (compiled && (all_dirty || !dirty_list.empty()))
+        {
+            compiled(*this);
+        }
+        else if (all_dirty)
+        {
+            for (size_t i = 0; i < size(); ++i)
+            {
+                compute_pose(i);
+            }
+        }
+        else if (!dirty_list.empty())
+        {
+            // Sorted pre-order indices: a dirty node inside an already
+            // recomputed subtree is covered by its dirty ancestor.
+            std::sort(dirty_list.begin(), dirty_list.end());
+            size_t covered_end = 0;
+            for (uint32_t root : dirty_list)
+            {
+                if (root < covered_end)
+                    continue;
+                covered_end = subtree_end[root];
+                for (size_t i = root; i < covered_end; ++i)
+                {
+                    compute_pose(i);
+                }
+            }
+        }
+
+        for (uint32_t i : dirty_list)
+        {
+            dirty[i] = 0;
+        }
+        dirty_list.clear();
+        all_dirty = false;
+    }
+
+    /**
+     * Global poses for `count` joint configurations, leaving the tree's own
+     * state untouched. coords is row-major [count][joints.size()], joints
+     * the flat index of each column (UINT32_MAX columns are ignored);
+     * nodes not listed keep their current coord. Row k is written to
+     * out[k * size() ...]. Rows are split into `threads` parts, 0 for one
+     * per core, run on the shared WorkerPool.
+     */
+    void evaluate_batch(const std::vector<uint32_t> &joints, const double *coords, size_t count,
+                        Pose *out, unsigned threads = 0) const
+    {
+        auto run = [&](size_t begin, size_t end)
+        {
+            evaluate_rows(*this, joints, coords, begin, end, out);
+        };
+
+        // Small batches are not worth a hand-off
+        constexpr size_t rows_per_thread = 64;
+        WorkerPool &pool = WorkerPool::shared();
+        if (threads == 0)
+            threads = pool.concurrency();
+        threads = static_cast<unsigned>(std::min<size_t>(threads, (count + rows_per_thread - 1) / rows_per_thread));
+        if (threads <= 1)
+        {
+            run(0, count);
+            return;
+        }
+
+        pool.run(threads, [&](unsigned t)
+                 { run(count * t / threads, count * (t + 1) / threads); });
+    }
+};
+
+/**
+ * Monotonic storage for the objects of one tree. Objects, and the pmr
+ * containers they build on resource(), are placed in growing blocks and
+ * released together by clear(). Members that take no allocator (the
+ * nodes' nos::trent models) still allocate on the heap and are freed by
+ * the destructor pass. The storage lives on the heap, so swapping two
+ * arenas leaves every object and resource pointer valid.
+ */
+template <class T>
+class Arena
+{
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { clear(); }
+
+    template <class... Args>
+    T *create(Args &&...args)
+    {
+        void *p = _memory->allocate(sizeof(T), alignof(T));
+        T *object = new (p) T(std::forward<Args>(args)...);
+        _objects.push_back(object);
+        return object;
+    }
+
+    void clear()
+    {
+        for (T *object : _objects)
+            object->~T();
+        _objects.clear();
+        _memory->release();
+    }
+
+    void swap(Arena &other) noexcept
+    {
+        _memory.swap(other._memory);
+        _objects.swap(other._objects);
+    }
+
+    /// For containers owned by the arena's objects.
+    std::pmr::memory_resource *resource() { return _memory.get(); }
+
+private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> _memory =
+        std::make_unique<std::pmr::monotonic_buffer_resource>(64 * 1024);
+    std::vector<T *> _objects;
+};
+
+/// Axis parameters that overrides replace.
+struct AxisParams
+{
+    double axis_offset = 0.0;
+    double axis_scale = 1.0;
+    double slider_min = -180.0;
+    double slider_max = 180.0;
+};
+
 class KinematicNode
 {
 public:
-    std::string name;
-    std::string type; // "transform", "rotator", "actuator"
+    std::pmr::string name; // Name and type strings live in the tree's arena
+    std::pmr::string type; // "transform", "rotator", "actuator"
+    size_t index = 0; // Position in KinematicTree::flat
     KinematicNode *parent = nullptr;
-    std::vector<std::unique_ptr<KinematicNode>> children;
+    std::pmr::vector<KinematicNode *> children; // Owned by the tree's arena
 
     Pose local_pose;
     Vec3 axis{0, 0, 1};
@@ -153,13 +666,17 @@ public:
     double slider_max = 180.0;   // Slider maximum in user units
     double coord = 0.0;
 
-    nos::trent model; // Pass through to client
+    nos::trent model; // Pass through to client, on the heap: trent takes no allocator
 
-    Pose global_pose;
+    AxisParams loaded; // Axis parameters as loaded, before overrides
 
-    KinematicNode() = default;
+    explicit KinematicNode(std::pmr::memory_resource *memory = std::pmr::get_default_resource())
+        : name(memory), type(memory), children(memory)
+    {
+    }
 
-    void load(const nos::trent &data, KinematicNode *parent_node = nullptr)
+    /// Load the node and its subtree, allocating children from `arena`.
+    void load(const nos::trent &data, Arena<KinematicNode> &arena, KinematicNode *parent_node = nullptr)
     {
         parent = parent_node;
         name = data["name"].as_string_default("unnamed");
@@ -223,6 +740,8 @@ public:
             slider_max = slider_max_data.as_numer_default(slider_max);
         }
 
+        loaded = {axis_offset, axis_scale, slider_min, slider_max};
+
         // Model data (pass through to client)
         model = data["model"];
 
@@ -230,77 +749,35 @@ public:
         const auto &children_data = data["children"];
         if (children_data.is_list())
         {
+            children.reserve(children_data.as_list().size());
             for (const auto &child_data : children_data.as_list())
             {
-                auto child = std::make_unique<KinematicNode>();
-                child->load(child_data, this);
-                children.push_back(std::move(child));
+                KinematicNode *child = arena.create(arena.resource());
+                child->load(child_data, arena, this);
+                children.push_back(child);
             }
         }
     }
 
-    void set_coord(double value)
+    /// Drop overrides: restore the axis parameters the node was loaded with.
+    void reset_axis()
     {
-        coord = value;
+        axis_offset = loaded.axis_offset;
+        axis_scale = loaded.axis_scale;
+        slider_min = loaded.slider_min;
+        slider_max = loaded.slider_max;
     }
 
-    Pose get_joint_transform() const
-    {
-        // Apply offset and scale: effective_coord = (coord + offset) * axis_scale
-        double effective_coord = (coord + axis_offset) * axis_scale;
-        if (type == "rotator")
-        {
-            Quat q = Quat::from_axis_angle(axis, effective_coord);
-            return Pose(Vec3(), q);
-        }
-        else if (type == "actuator")
-        {
-            Vec3 offset = axis * effective_coord;
-            return Pose(offset, Quat());
-        }
-        return Pose();
-    }
-
-    void compute_global_poses(const Pose &parent_pose = Pose())
-    {
-        // Global = parent * local * joint
-        global_pose = parent_pose * local_pose * get_joint_transform();
-
-        for (auto &child : children)
-        {
-            child->compute_global_poses(global_pose);
-        }
-    }
-
-    nos::trent get_scene_data() const
+    void set_coord(double value)
     {
-        nos::trent result;
-        result.init(nos::trent::type::dict);
-
-        nos::trent node_data;
-        node_data.init(nos::trent::type::dict);
-        node_data["pose"] = global_pose.to_trent();
-        node_data["model"] = model;
-
-        result[name] = std::move(node_data);
-
-        for (const auto &child : children)
-        {
-            nos::trent child_data = child->get_scene_data();
-            for (const auto &p : child_data.as_dict())
-            {
-                result[p.first] = p.second;
-            }
-        }
-
-        return result;
+        coord = value;
     }
 
     KinematicNode *find_by_name(const std::string &search_name)
     {
-        if (name == search_name)
+        if (std::string_view(name) == search_name)
             return this;
-        for (auto &child : children)
+        for (auto *child : children)
         {
             KinematicNode *found = child->find_by_name(search_name);
             if (found)
@@ -309,13 +786,23 @@ public:
         return nullptr;
     }
 
+    size_t count_nodes() const
+    {
+        size_t count = 1;
+        for (const auto *child : children)
+        {
+            count += child->count_nodes();
+        }
+        return count;
+    }
+
     void get_all_joints(std::vector<KinematicNode *> &joints)
     {
         if (type == "rotator" || type == "actuator")
         {
             joints.push_back(this);
         }
-        for (auto &child : children)
+        for (auto *child : children)
         {
             child->get_all_joints(joints);
         }
@@ -325,66 +812,222 @@ public:
 class KinematicTree
 {
 public:
-    std::unique_ptr<KinematicNode> root;
-    std::map<std::string, KinematicNode *> joints;
+    KinematicNode *root = nullptr; // Owned by the arena
+
+    FlatTree flat;
+    std::vector<KinematicNode *> nodes; // Indexed like flat
+
+    // Names interned at load. A name belongs to the first node (in flat
+    // order) carrying it, as with a depth-first search, and to the first
+    // joint carrying it. Joint ids number
+    // the joints by name, the order of get_joint_names() and of "joints"
+    // in scene_init, so clients can address joints by position.
+    NameTable names;
+    std::vector<uint32_t> name_node;   // Name id -> flat index
+    std::vector<uint32_t> name_joint;  // Name id -> joint id, NameTable::npos if not a joint
+    std::vector<uint32_t> joint_nodes; // Joint id -> flat index
 
     void load(const nos::trent &data)
     {
-        root = std::make_unique<KinematicNode>();
-        root->load(data);
+        // The previous tree goes in one bulk free
+        nodes.clear();
+        _arena.clear();
+        root = _arena.create(_arena.resource());
+        root->load(data, _arena);
+        compile();
+        intern_names();
+        update();
+    }
 
-        // Build joints map
-        joints.clear();
-        std::vector<KinematicNode *> joint_list;
-        root->get_all_joints(joint_list);
-        for (auto *j : joint_list)
-        {
-            joints[j->name] = j;
-        }
+    /**
+     * Exchange contents with another tree, e.g. one loaded off the writer
+     * thread. Nodes stay where they are, node pointers follow their tree.
+     */
+    void swap(KinematicTree &other) noexcept
+    {
+        std::swap(root, other.root);
+        std::swap(flat, other.flat);
+        nodes.swap(other.nodes);
+        std::swap(names, other.names);
+        name_node.swap(other.name_node);
+        name_joint.swap(other.name_joint);
+        joint_nodes.swap(other.joint_nodes);
+        _arena.swap(other._arena);
+    }
 
-        update();
+    /// Node by name, nullptr if there is none.
+    KinematicNode *find_node(std::string_view name) const
+    {
+        uint32_t id = names.find(name);
+        return id != NameTable::npos ? nodes[name_node[id]] : nullptr;
+    }
+
+    /// Joint id of a name, NameTable::npos for unknown names and non-joints.
+    uint32_t joint_id(std::string_view name) const
+    {
+        uint32_t id = names.find(name);
+        return id != NameTable::npos ? name_joint[id] : NameTable::npos;
+    }
+
+    /// Flat index of a joint, UINT32_MAX for unknown names.
+    uint32_t joint_index(std::string_view name) const
+    {
+        uint32_t id = joint_id(name);
+        return id != NameTable::npos ? joint_nodes[id] : UINT32_MAX;
+    }
+
+    /// Joint node by name, nullptr for unknown names.
+    KinematicNode *find_joint(std::string_view name) const
+    {
+        uint32_t index = joint_index(name);
+        return index != UINT32_MAX ? nodes[index] : nullptr;
     }
 
+    size_t joint_count() const { return joint_nodes.size(); }
+
     void set_joint_coords(const std::map<std::string, double> &coords)
     {
         for (const auto &[name, value] : coords)
         {
-            auto it = joints.find(name);
-            if (it != joints.end())
-            {
-                it->second->set_coord(value);
-            }
+            set_joint_coord(name, value);
         }
     }
 
-    void update()
+    /// Set one joint by name without allocating. Returns false for unknown names.
+    bool set_joint_coord(std::string_view name, double value)
+    {
+        uint32_t index = joint_index(name);
+        if (index == UINT32_MAX)
+            return false;
+        set_joint_coord_at(index, value);
+        return true;
+    }
+
+    /// Set a joint by joint id. Returns false for ids out of range.
+    bool set_joint_coord_by_id(uint32_t id, double value)
+    {
+        if (id >= joint_nodes.size())
+            return false;
+        set_joint_coord_at(joint_nodes[id], value);
+        return true;
+    }
+
+    /// Set a joint by flat index (a value from joint_index()).
+    void set_joint_coord_at(uint32_t index, double value)
+    {
+        nodes[index]->set_coord(value);
+        flat.set_coord(index, value);
+    }
+
+    /**
+     * Copy coord and axis parameters of a joint node into the flat layout.
+     * Must be called after the node's fields are modified directly
+     * (e.g. by axis overrides). Marks the joint's subtree for recomputation.
+     */
+    void refresh_joint(const KinematicNode *joint)
+    {
+        size_t i = joint->index;
+        flat.coord[i] = joint->coord;
+        flat.axis_offset[i] = joint->axis_offset;
+        flat.axis_scale[i] = joint->axis_scale;
+        flat.mark_dirty(i);
+    }
+
+    /// Restore a joint's loaded axis parameters in place.
+    void reset_axis(KinematicNode *joint)
+    {
+        joint->reset_axis();
+        refresh_joint(joint);
+    }
+
+    /// Restore the loaded axis parameters of all joints in place.
+    void reset_axes()
     {
-        if (root)
+        for (uint32_t index : joint_nodes)
         {
-            root->compute_global_poses();
+            reset_axis(nodes[index]);
         }
     }
 
+    /// Recompute global poses of the subtrees below changed joints.
+    void update()
+    {
+        flat.update();
+    }
+
+    /**
+     * Forward kinematics for many configurations (see
+     * FlatTree::evaluate_batch()), without touching the live poses.
+     * Returns count * nodes.size() poses, row by row in flat index order.
+     */
+    std::vector<Pose> evaluate_batch(const std::vector<uint32_t> &joint_indices, const double *coords,
+                                     size_t count, unsigned threads = 0) const
+    {
+        std::vector<Pose> poses(count * flat.size());
+        flat.evaluate_batch(joint_indices, coords, count, poses.data(), threads);
+        return poses;
+    }
+
+    const Pose &global_pose(const KinematicNode *node) const
+    {
+        return flat.global_pose[node->index];
+    }
+
     nos::trent get_scene_data() const
     {
-        if (root)
+        nos::trent result;
+        result.init(nos::trent::type::dict);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            nos::trent node_data;
+            node_data.init(nos::trent::type::dict);
+            node_data["pose"] = flat.global_pose[i].to_trent();
+            node_data["model"] = nodes[i]->model;
+            result[std::string(nodes[i]->name)] = std::move(node_data);
+        }
+        return result;
+    }
+
+    /**
+     * Poses of the nodes whose global pose changed since the change set was
+     * last cleared (flat.clear_changed()), as {name: {pose}}.
+     */
+    nos::trent get_changed_poses() const
+    {
+        nos::trent result;
+        result.init(nos::trent::type::dict);
+        for (uint32_t i : flat.changed_list)
         {
-            return root->get_scene_data();
+            nos::trent node_data;
+            node_data.init(nos::trent::type::dict);
+            node_data["pose"] = flat.global_pose[i].to_trent();
+            result[std::string(nodes[i]->name)] = std::move(node_data);
         }
-        nos::trent empty;
-        empty.init(nos::trent::type::dict);
-        return empty;
+        return result;
     }
 
+    /// Node names in flat index order (the order of binary pose records).
+    nos::trent get_node_order_trent() const
+    {
+        nos::trent t;
+        t.init(nos::trent::type::list);
+        for (const auto *node : nodes)
+        {
+            t.push_back(std::string(node->name));
+        }
+        return t;
+    }
+
+    /// Joint names by joint id.
     std::vector<std::string> get_joint_names() const
     {
-        std::vector<std::string> names;
-        names.reserve(joints.size());
-        for (const auto &[name, _] : joints)
+        std::vector<std::string> result;
+        result.reserve(joint_nodes.size());
+        for (uint32_t index : joint_nodes)
         {
-            names.push_back(name);
+            result.emplace_back(nodes[index]->name);
         }
-        return names;
+        return result;
     }
 
     nos::trent get_joint_names_trent() const
@@ -402,19 +1045,100 @@ public:
     {
         nos::trent result;
         result.init(nos::trent::type::dict);
-        for (const auto &[name, joint] : joints)
+        for (uint32_t index : joint_nodes)
         {
+            const KinematicNode *joint = nodes[index];
             nos::trent info;
             info.init(nos::trent::type::dict);
-            info["type"] = joint->type;
+            info["type"] = std::string(joint->type);
             info["slider_min"] = joint->slider_min;
             info["slider_max"] = joint->slider_max;
             info["axis_scale"] = joint->axis_scale;
             info["axis_offset"] = joint->axis_offset;
-            result[name] = std::move(info);
+            result[std::string(joint->name)] = std::move(info);
         }
         return result;
     }
+
+private:
+    Arena<KinematicNode> _arena;
+
+    void intern_names()
+    {
+        names.clear();
+        name_node.clear();
+        // On duplicate names the last node in flat order wins, as with the
+        // name maps this replaced
+        for (uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            uint32_t id = names.intern(nodes[i]->name);
+            if (id == name_node.size())
+                name_node.push_back(i);
+            else
+                name_node[id] = i;
+        }
+
+        // A joint name may also be used by an earlier non-joint node.
+        // name_joint holds positions in joint_nodes until it is sorted.
+        name_joint.assign(names.size(), NameTable::npos);
+        joint_nodes.clear();
+        for (uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            if (flat.joint_type[i] == JointType::Transform)
+                continue;
+            uint32_t id = names.find(nodes[i]->name);
+            if (name_joint[id] == NameTable::npos)
+            {
+                name_joint[id] = static_cast<uint32_t>(joint_nodes.size());
+                joint_nodes.push_back(i);
+            }
+            else
+            {
+                joint_nodes[name_joint[id]] = i;
+            }
+        }
+        std::sort(joint_nodes.begin(), joint_nodes.end(), [this](uint32_t a, uint32_t b)
+                  { return nodes[a]->name < nodes[b]->name; });
+        for (uint32_t j = 0; j < joint_nodes.size(); ++j)
+        {
+            name_joint[names.find(nodes[joint_nodes[j]]->name)] = j;
+        }
+    }
+
+    void compile()
+    {
+        flat.clear();
+        nodes.clear();
+        size_t count = root->count_nodes();
+        flat.reserve(count);
+        nodes.reserve(count);
+
+        std::vector<KinematicNode *> stack{root};
+        while (!stack.empty())
+        {
+            KinematicNode *node = stack.back();
+            stack.pop_back();
+
+            node->index = nodes.size();
+            nodes.push_back(node);
+            flat.parent.push_back(node->parent ? static_cast<int32_t>(node->parent->index) : -1);
+            flat.joint_type.push_back(joint_type_from_string(node->type));
+            flat.local_pose.push_back(node->local_pose);
+            flat.axis.push_back(node->axis);
+            flat.axis_offset.push_back(node->axis_offset);
+            flat.axis_scale.push_back(node->axis_scale);
+            flat.coord.push_back(node->coord);
+            flat.global_pose.emplace_back();
+
+            // Push in reverse so children are visited in declaration order
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it)
+            {
+                stack.push_back(*it);
+            }
+        }
+        flat.finalize();
+        flat.compiled = find_compiled_update(flat.fingerprint());
+    }
 };
 
 } // namespace webkin
@@ -9,6 +9,30 @@
 #include "mqtt_listener.hpp"
 #include "crow_listener.hpp"
 #include "k3d_loader.hpp"
+#include "pose_frame.hpp"
+#include "broadcaster.hpp"
+#include "scene_snapshot.hpp"
+#include "scene_json.hpp"
+#include "joint_decoder.hpp"
+#include "joint_history.hpp"
+#include "fk_batch.hpp"
+#include "ik_solver.hpp"
+#include "recording.hpp"
+#include "replay_listener.hpp"
+#include "relay_listener.hpp"
+#include "subscription.hpp"
+#include "http_cache.hpp"
+#include "debounced_writer.hpp"
+#include "ingest_queue.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "proximity.hpp"
+#include "joint_smoother.hpp"
+#include "tree_loader.hpp"
+#include "pose_publisher.hpp"
+#include "fk_codegen.hpp"
+#include "fk_model.hpp"
+#include "json_stream.hpp"
 
 #include <crowhttp.h>
 
@@ -16,300 +40,2054 @@
 #include <nos/trent/json_print.h>
 #include <nos/print.h>
 
+#include <algorithm>
 #include <mutex>
-#include <set>
+#include <map>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <csignal>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <cmath>
 #include <cstdlib>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include <sys/stat.h>
+
 namespace fs = std::filesystem;
+#ifdef CROW_USE_BOOST
+namespace asio = boost::asio; // As in crowhttp
+#endif
 
 // IRCC embedded resources
-extern std::string ircc_string(const std::string &key);
 extern std::vector<std::string> ircc_keys();
+extern const char *ircc_c_string(const char *key, size_t *sizeptr); // Points into the binary's data
+
+// Handling time per route, filled before the server starts and only read
+// afterwards
+std::unordered_map<const crowhttp::BaseRule *, std::unique_ptr<webkin::Histogram>> g_route_times;
+
+// Every HTTP request timed for its route, and as an "http" trace span from
+// routing to the finished response, with the URL as detail
+struct HttpTraceMiddleware
+{
+    struct context
+    {
+        uint64_t start = 0;
+    };
+
+    void before_handle(crowhttp::request &, crowhttp::response &, context &ctx)
+    {
+        ctx.start = webkin::trace::now_ns();
+    }
+
+    void after_handle(crowhttp::request &req, crowhttp::response &, context &ctx)
+    {
+        uint64_t end = webkin::trace::now_ns();
+        if (req.matched_rule)
+        {
+            auto it = g_route_times.find(req.matched_rule);
+            if (it != g_route_times.end())
+                it->second->record(end - ctx.start);
+        }
+        if (webkin::trace::active())
+            webkin::trace::record("http", ctx.start, end, req.url);
+    }
+};
+
+using WebApp = crowhttp::App<HttpTraceMiddleware>;
+
+// Clients with equal subscriptions: payloads are built once per broadcast
+// and shared, the rate limit and the delta base are common to the group.
+// Guarded by the robot's clients_mutex.
+struct ClientGroup
+{
+    webkin::Subscription subscription;
+    std::vector<uint32_t> indices; // Selected nodes, for tree_version
+    uint64_t tree_version = UINT64_MAX;
+    uint64_t sent_version = 0;
+    uint64_t sent_info_version = 0;
+    double last_sent_ms = 0;
+
+    // State of the current broadcast
+    bool due = false;
+    bool info_changed = false;
+    std::vector<uint32_t> changed; // Selected nodes changed since the last update
+    crowhttp::websocket::shared_frame text, full_text, binary, full_binary, info;
+};
+
+// End-to-end latency of rendered frames, from the frame_ack messages of
+// browsers. Stages follow a joint message: broker and client compare
+// different clocks and need them synchronized, round_trip uses the server
+// clock only.
+struct LatencyStats
+{
+    enum Stage
+    {
+        BROKER,     // Robot timestamp to server ingest
+        COMPUTE,    // Ingest to forward kinematics done (queue, decode, FK)
+        DISPATCH,   // FK done to send (broadcast coalescing)
+        CLIENT,     // Send to render
+        ROUND_TRIP, // Send to ack arrival
+        TOTAL,      // Robot timestamp, or ingest without one, to render
+        STAGES
+    };
+    static constexpr const char *NAMES[STAGES] = {"broker", "compute", "dispatch",
+                                                  "client", "round_trip", "glass_to_glass"};
+
+    webkin::Histogram stages[STAGES];
+
+    // Negative spans, from clock skew, are not recorded
+    void record(Stage stage, double from_ms, double to_ms)
+    {
+        double span = to_ms - from_ms;
+        if (from_ms > 0 && to_ms > 0 && span >= 0)
+            stages[stage].record(static_cast<uint64_t>(span * 1e6));
+    }
+
+    // frame_ack: the message's trace echoed with render_ts
+    void record(const nos::trent &ack, double now)
+    {
+        double source = ack["source_ts"].as_numer_default(0);
+        double ingest = ack["ingest_ts"].as_numer_default(0);
+        double fk = ack["fk_ts"].as_numer_default(0);
+        double send = ack["send_ts"].as_numer_default(0);
+        double render = ack["render_ts"].as_numer_default(0);
+        record(BROKER, source, ingest);
+        record(COMPUTE, ingest, fk);
+        record(DISPATCH, fk, send);
+        record(CLIENT, send, render);
+        record(ROUND_TRIP, send, now);
+        record(TOTAL, source > 0 ? source : ingest, render);
+    }
+
+    // {stage: {count, p50, p90, p99}}, in ms
+    nos::trent to_trent() const
+    {
+        nos::trent out;
+        out.init(nos::trent::type::dict);
+        for (int i = 0; i < STAGES; ++i)
+        {
+            const auto &h = stages[i];
+            nos::trent &stage = out[NAMES[i]];
+            stage.init(nos::trent::type::dict);
+            stage["count"] = static_cast<double>(h.count());
+            stage["p50"] = static_cast<double>(h.quantile(0.5)) / 1e6;
+            stage["p90"] = static_cast<double>(h.quantile(0.9)) / 1e6;
+            stage["p99"] = static_cast<double>(h.quantile(0.99)) / 1e6;
+        }
+        return out;
+    }
+};
+
+// Per-connection state of a /ws client
+struct ClientInfo
+{
+    bool binary = false;                // Negotiated webkin.binary.v1: poses as binary frames
+    std::shared_ptr<ClientGroup> group; // Null without a subscription
+    std::shared_ptr<LatencyStats> latency;
+};
 
-// Global state
-webkin::KinematicTree g_tree;
-nos::trent g_tree_data_json;
-std::mutex g_mutex;
-std::set<crowhttp::websocket::connection *> g_clients;
+// Serialized messages and responses, rebuilt only when their key (derived
+// from snapshot versions) changes, so reconnecting clients share bytes
+struct CachedFrame
+{
+    uint64_t key = UINT64_MAX;
+    crowhttp::websocket::shared_frame frame;
+};
+
+// Hot-path metrics of one robot, exported on /metrics
+struct RobotMetrics
+{
+    webkin::Histogram decode;    // One joint payload written to the tree
+    webkin::Histogram fk;        // Forward kinematics of one committed batch
+    webkin::Histogram serialize; // One broadcast message, serialized and framed
+    webkin::Histogram broadcast; // Fan-out of one broadcast to all clients
+    webkin::Histogram proximity; // Proximity re-test of one published update
+    webkin::Counter mqtt_messages;
+    webkin::Counter crow_messages;
+    webkin::Counter ws_messages;
+    webkin::Counter broadcasts;
+    webkin::Counter closed_dropped_frames; // Frames dropped by clients since disconnected
+    LatencyStats latency;                  // frame_ack of all clients
+};
+
+// One hosted robot. Robots share no mutable state: each has its own locks,
+// broadcaster thread and transport subscription, so ingest and broadcasts
+// of one robot never wait on another. No code holds locks of two robots.
+struct Robot
+{
+    std::string id;
+    std::string topic; // Transport topic of joint data; tree on <topic>/tree
+
+    // mutex is the writer lock: it protects the tree, its source JSON and
+    // the axis overrides. Readers use scene snapshots.
+    webkin::KinematicTree tree;
+    nos::trent tree_data_json;
+    std::mutex mutex;
+    webkin::ScenePublisher scene;
+    webkin::JointSchema joint_schema; // Layout of binary joint frames
+    uint64_t warned_schema_hash = 0;  // Last schema a mismatch was reported for
+
+    // Broadcast state, protected by clients_mutex. Lock order when both are
+    // needed: mutex, then clients_mutex.
+    std::mutex clients_mutex;
+    std::map<crowhttp::websocket::connection *, ClientInfo> clients;
+    std::map<std::string, std::weak_ptr<ClientGroup>> groups; // By subscription key
+    uint32_t frame_sequence = 0;
+    uint64_t sent_version = 0; // Snapshot versions already broadcast
+    uint64_t sent_tree_version = 0;
+    uint64_t sent_info_version = 0;
+    uint64_t sent_proximity_version = 0;
+
+    std::mutex cache_mutex;     // Protects the frames below; innermost lock
+    CachedFrame init_frame;     // scene_init, keyed by tree and info versions
+    CachedFrame poses_frame;    // All poses as scene_delta, keyed by version
+    CachedFrame poses_binary;   // All poses as a binary frame, keyed by version
+    CachedFrame proximity_msg;  // proximity message, keyed by report version
+    std::mutex tree_body_mutex; // Protects tree_body*; taken before mutex
+    std::shared_ptr<const webkin::CachedBody> tree_body; // GET /api/tree, of tree_body_version
+    uint64_t tree_body_version = UINT64_MAX;
+
+    // Fixed-rate broadcaster: ingest marks the scene dirty, each tick sends
+    // at most one coalesced update
+    webkin::broadcaster broadcaster;
+
+    // Joint payloads from transports and WebSocket clients, applied in
+    // batches by the robot's compute thread
+    webkin::ingest_queue ingest;
+
+    // Joint history of live ingest and its playback
+    webkin::JointHistory history;
+    webkin::history_player player;
+
+    // ik_target solver, workspace reused between messages; guarded by mutex
+    webkin::IkSolver ik;
+
+    // --proximity: link distances, updated under mutex with every publish
+    webkin::ProximityMonitor proximity;
+
+    // --smooth: display coordinates published by the broadcaster tick
+    // instead of the received ones; guarded by mutex
+    webkin::JointSmoother smoother;
+
+    // --record: live ingest is appended to a recording file by a writer thread
+    webkin::recording_writer recorder;
+
+    // --replay: recorded joint names and their flat indices in the current tree
+    std::vector<std::string> replay_joints;
+    std::vector<uint32_t> replay_index;
+
+    // --relay-from: the primary's stream, its node order and the flat
+    // indices of those nodes in the current tree
+    webkin::relay_listener relay;
+    std::vector<std::string> relay_nodes;
+    std::vector<uint32_t> relay_index;
+    // Model files fetched from the primary by URL, dropped with the tree
+    std::mutex relay_models_mutex;
+    std::map<std::string, std::shared_ptr<const webkin::CachedBody>> relay_models;
+
+    // Models of the current tree. A reload replaces them whole, so readers
+    // take the pointer and need no lock.
+    std::atomic<std::shared_ptr<const webkin::K3DLoader>> k3d_loader;
+    std::string models_url; // URL prefix of the K3D model files
+    std::string tree_file;  // From --k3d or --robot ID=PATH, for --watch
+
+    // Tree files and uploads, loaded off the writer lock
+    webkin::tree_loader loader;
+
+    // Axis overrides: {axis_name: {axis_offset, axis_scale, slider_min, slider_max}}
+    fs::path axis_overrides_file;
+    std::map<std::string, std::map<std::string, double>> axis_overrides;
+
+    webkin::mqtt_listener mqtt;
+    webkin::crow_listener crow;
+
+    // --publish-poses: computed poses out on the transport connection
+    webkin::pose_publisher pose_out;
+
+    RobotMetrics metrics;
+};
+
+// Robots by id, filled before the server starts and not modified after,
+// so lookups need no lock. The default robot serves the unprefixed
+// endpoints (/ws, robot/joints).
+std::map<std::string, std::unique_ptr<Robot>> g_robots;
+Robot *g_default_robot = nullptr;
+const std::string g_default_robot_id = "default";
+
+double g_broadcast_hz = 60.0;  // Rate 0 broadcasts on every change
+double g_proximity = 0;        // Warning distance between links, 0 = off
+webkin::SmoothMode g_smooth_mode = webkin::SmoothMode::Off;
+double g_smooth_delay = 100; // Interpolation delay, ms
+bool g_watch = false;        // Reload tree files when they change
+bool g_publish_poses = false; // Publish computed poses on robot/<id>/poses
+webkin::Subscription g_publish_selection; // Nodes of --publish-poses, none = all
+double g_publish_hz = 0;                  // Rate cap of published poses, 0 = every update
+size_t g_history_size = 60000; // Frames, e.g. 2 minutes at 500 Hz
+
+// Per-client send queue limits (bytes), see connection::set_send_limits()
+size_t g_ws_high_water = 1 << 20;
+size_t g_ws_max_queue = 64 << 20;
 bool g_z_up = false;
 bool g_debug = false;
+bool g_trace = false; // Trace spans always on, not only during /debug/trace
+bool g_delta_updates = false; // Send scene_delta instead of full scene_update
+bool g_ws_deflate = true;     // Accept permessage-deflate on /ws
+int g_json_precision = 6;     // Decimals of poses in JSON messages, -1 = shortest round-trip
 std::atomic<bool> g_running{true};
 bool g_use_embedded_resources = true;  // Use embedded resources by default
 
+// Embedded static files by path under /static/, hashed and gzipped at startup
+std::map<std::string, std::shared_ptr<const webkin::CachedBody>, std::less<>> g_static_bodies;
+
 // Paths
 fs::path g_base_dir;
 fs::path g_static_dir;
 fs::path g_config_dir;
-fs::path g_axis_overrides_file;
-
-// K3D loader
-std::unique_ptr<webkin::K3DLoader> g_k3d_loader;
-
-// Axis overrides: {axis_name: {axis_offset, axis_scale, slider_min, slider_max}}
-std::map<std::string, std::map<std::string, double>> g_axis_overrides;
+// Writes axis overrides off the request path, at most one file per burst
+webkin::debounced_writer g_config_writer{std::chrono::milliseconds(250), std::chrono::seconds(2)};
+// Served on /metrics; every robot registers its metrics in start_robot()
+webkin::MetricsRegistry g_metrics;
 
 // Transport type
 enum class TransportType
 {
     NONE,
     MQTT,
-    CROW
+    CROW,
+    REPLAY,
+    RELAY
 };
 
 // Forward declarations
 std::string read_file(const fs::path &path);
+std::string get_mime_type(const std::string &filename);
 
-// Read static resource (from embedded or file system)
-std::string read_static_resource(const std::string &resource_path)
+void prepare_static_resources()
 {
-    if (g_use_embedded_resources)
+    size_t bytes = 0, gzipped = 0;
+    for (const auto &key : ircc_keys())
+    {
+        if (key.rfind("/static/", 0) != 0)
+            continue;
+        size_t size = 0;
+        const char *data = ircc_c_string(key.c_str(), &size);
+        if (!data)
+            continue;
+        auto body = webkin::make_static_body(std::string_view(data, size), get_mime_type(key), true);
+        bytes += body->content.size();
+        gzipped += body->gzip.empty() ? body->content.size() : body->gzip.size();
+        g_static_bodies[key.substr(8)] = std::move(body);
+    }
+    nos::println("Embedded resources: ", g_static_bodies.size(), " files, ", bytes / 1024, " KiB, ",
+                 gzipped / 1024, " KiB gzipped");
+}
+
+// Embedded static resource, null if missing or not using embedded resources
+std::shared_ptr<const webkin::CachedBody> static_resource(std::string_view resource_path)
+{
+    if (!g_use_embedded_resources)
+        return nullptr;
+    auto it = g_static_bodies.find(resource_path);
+    return it != g_static_bodies.end() ? it->second : nullptr;
+}
+
+// If-Range: the range is served only if the client's copy is current
+bool range_applies(const crowhttp::request &req, const std::string &etag)
+{
+    const std::string &if_range = req.get_header_value("If-Range");
+    return if_range.empty() || (!etag.empty() && if_range == etag);
+}
+
+std::string content_range(const webkin::ByteRange &range, size_t size)
+{
+    return "bytes " + std::to_string(range.offset) + "-" + std::to_string(range.offset + range.length - 1) + "/" +
+           std::to_string(size);
+}
+
+crowhttp::response unsatisfiable_range(size_t size)
+{
+    crowhttp::response res(416);
+    res.set_header("Content-Range", "bytes */" + std::to_string(size));
+    return res;
+}
+
+// Revalidated on every use unless the URL is versioned
+constexpr const char *CACHE_REVALIDATE = "no-cache";
+constexpr const char *CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+
+// 304 if the client has the body, else the gzip variant when accepted.
+// The body is sent as a view owned by `cached`, without copying.
+crowhttp::response cached_response(const crowhttp::request &req, std::shared_ptr<const webkin::CachedBody> cached,
+                                   const char *cache_control)
+{
+    const webkin::CachedBody &body = *cached;
+    crowhttp::response res;
+    // Ranges address the identity body
+    const std::string &range_header = req.get_header_value("Range");
+    const bool gzip = !body.gzip.empty() && range_header.empty() &&
+                      webkin::accepts_gzip(req.get_header_value("Accept-Encoding"));
+    res.set_header("ETag", gzip ? body.gzip_etag : body.etag);
+    res.set_header("Cache-Control", cache_control);
+    res.set_header("Accept-Ranges", "bytes");
+    if (!body.gzip.empty())
+        res.set_header("Vary", "Accept-Encoding");
+    if (body.matches(req.get_header_value("If-None-Match")))
+    {
+        res.code = 304;
+        return res;
+    }
+    res.set_header("Content-Type", body.content_type);
+    if (gzip)
+    {
+        res.set_header("Content-Encoding", "gzip");
+        res.set_body_view(body.gzip, std::move(cached));
+        return res;
+    }
+
+    std::string_view content = body.content;
+    if (!range_header.empty() && range_applies(req, body.etag))
+    {
+        webkin::ByteRange range;
+        switch (webkin::parse_range(range_header, content.size(), range))
+        {
+        case webkin::RangeStatus::Partial:
+            res.code = 206;
+            res.set_header("Content-Range", content_range(range, content.size()));
+            content = content.substr(range.offset, range.length);
+            break;
+        case webkin::RangeStatus::Unsatisfiable:
+            return unsatisfiable_range(content.size());
+        case webkin::RangeStatus::Full:
+            break;
+        }
+    }
+    res.set_body_view(content, std::move(cached));
+    return res;
+}
+
+// A file on disk, streamed by the connection (sendfile) rather than read
+// into memory; the ETag comes from its size and modification time
+crowhttp::response file_response(const crowhttp::request &req, const fs::path &path, const std::string &content_type,
+                                 const char *cache_control)
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return crowhttp::response(404, "Not found");
+    }
+    char etag[64];
+    std::snprintf(etag, sizeof(etag), "W/\"%llx-%llx\"", static_cast<unsigned long long>(st.st_size),
+                  static_cast<unsigned long long>(st.st_mtim.tv_sec) * 1000000000ull + st.st_mtim.tv_nsec);
+
+    crowhttp::response res;
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", cache_control);
+    res.set_header("Accept-Ranges", "bytes");
+    if (webkin::etag_matches(req.get_header_value("If-None-Match"), etag))
+    {
+        res.code = 304;
+        return res;
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+    webkin::ByteRange range;
+    webkin::RangeStatus status = webkin::RangeStatus::Full;
+    const std::string &range_header = req.get_header_value("Range");
+    // Weak validators never match If-Range, so a conditional range gets the full file
+    if (!range_header.empty() && range_applies(req, ""))
+        status = webkin::parse_range(range_header, size, range);
+    if (status == webkin::RangeStatus::Unsatisfiable)
+        return unsatisfiable_range(size);
+
+    res.set_static_file_info_unsafe(path.string(), content_type);
+    if (status == webkin::RangeStatus::Partial && res.code == 200)
     {
-        // Try embedded resource first
-        std::string key = "/static/" + resource_path;
-        std::string content = ircc_string(key.c_str());
-        if (!content.empty())
+        res.code = 206;
+        res.set_header("Content-Range", content_range(range, size));
+        res.set_static_file_range(range.offset, range.length);
+    }
+    return res;
+}
+
+std::string trent_to_json(const nos::trent &t)
+{
+    return nos::json::to_string(t);
+}
+
+void load_axis_overrides(Robot &robot)
+{
+    robot.axis_overrides.clear();
+    if (fs::exists(robot.axis_overrides_file))
+    {
+        try
+        {
+            std::string content = read_file(robot.axis_overrides_file);
+            nos::trent data = nos::json::parse(content);
+            if (data.is_dict())
+            {
+                for (const auto &[name, params] : data.as_dict())
+                {
+                    if (params.is_dict())
+                    {
+                        for (const auto &[key, value] : params.as_dict())
+                        {
+                            robot.axis_overrides[name][key] = value.as_numer_default(0.0);
+                        }
+                    }
+                }
+            }
+            nos::println("Loaded axis overrides: ", robot.axis_overrides.size(), " entries");
+        }
+        catch (const std::exception &e)
+        {
+            nos::println("Failed to load axis overrides: ", e.what());
+        }
+    }
+}
+
+// Queue the overrides for the background writer, which coalesces bursts
+// of edits (e.g. slider drags) into one write. Caller holds robot.mutex.
+void save_axis_overrides(Robot &robot)
+{
+    nos::trent data;
+    data.init(nos::trent::type::dict);
+    for (const auto &[name, params] : robot.axis_overrides)
+    {
+        nos::trent joint_data;
+        joint_data.init(nos::trent::type::dict);
+        for (const auto &[key, value] : params)
+        {
+            joint_data[key] = value;
+        }
+        data[name] = std::move(joint_data);
+    }
+    g_config_writer.submit(robot.axis_overrides_file.string(), nos::json::to_string(data));
+    if (g_debug)
+    {
+        nos::println("[DEBUG] Queued axis overrides: ", robot.axis_overrides.size(), " entries");
+    }
+}
+
+void apply_axis_overrides(Robot &robot)
+{
+    for (const auto &[name, params] : robot.axis_overrides)
+    {
+        if (auto *joint = robot.tree.find_joint(name))
+        {
+            auto offset_it = params.find("axis_offset");
+            if (offset_it != params.end())
+                joint->axis_offset = offset_it->second;
+
+            auto scale_it = params.find("axis_scale");
+            if (scale_it != params.end())
+                joint->axis_scale = scale_it->second;
+
+            auto min_it = params.find("slider_min");
+            if (min_it != params.end())
+                joint->slider_min = min_it->second;
+
+            auto max_it = params.find("slider_max");
+            if (max_it != params.end())
+                joint->slider_max = max_it->second;
+
+            robot.tree.refresh_joint(joint);
+        }
+    }
+}
+
+nos::trent make_scene_init_message(const webkin::SceneSnapshot &scene)
+{
+    nos::trent msg;
+    msg.init(nos::trent::type::dict);
+    msg["type"] = "scene_init";
+    msg["nodes"] = scene.scene_data();
+    msg["joints"] = scene.layout->joint_names;
+    msg["jointsInfo"] = *scene.joints_info;
+    msg["nodeOrder"] = scene.layout->node_order;
+    msg["zUp"] = g_z_up;
+    return msg;
+}
+
+// Serializer of pose messages, one per thread so broadcasts share no buffer.
+// Broadcasts pass their send time to stamp traced messages; cached
+// messages, sent at unknown times later, carry no trace.
+webkin::SceneJsonWriter &scene_json(double send_ts = 0)
+{
+    thread_local webkin::SceneJsonWriter writer;
+    writer.decimals = g_json_precision;
+    writer.send_ts = send_ts;
+    return writer;
+}
+
+// Sent to binary clients, whose pose frames carry no jointsInfo
+nos::trent make_joints_info_message(const webkin::SceneSnapshot &scene)
+{
+    nos::trent msg;
+    msg.init(nos::trent::type::dict);
+    msg["type"] = "joints_info";
+    msg["jointsInfo"] = *scene.joints_info;
+    return msg;
+}
+
+double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(system_clock::now().time_since_epoch()).count();
+}
+
+std::string make_pose_frame(const webkin::SceneSnapshot &scene, uint64_t since,
+                            uint32_t seq, double timestamp, bool full)
+{
+    if (full)
+    {
+        return webkin::encode_pose_frame(scene.poses, seq, timestamp);
+    }
+    static thread_local std::vector<uint32_t> changed;
+    scene.changed_since(since, changed);
+    return webkin::encode_pose_frame(scene.poses, changed, seq, timestamp);
+}
+
+template <typename Build>
+crowhttp::websocket::shared_frame cached_frame(Robot &robot, CachedFrame &cache, uint64_t key, Build &&build)
+{
+    std::lock_guard<std::mutex> lock(robot.cache_mutex);
+    if (!cache.frame || cache.key != key)
+    {
+        cache.frame = build();
+        cache.key = key;
+    }
+    return cache.frame;
+}
+
+// The proximity message of a report, framed once for all clients
+crowhttp::websocket::shared_frame proximity_frame(Robot &robot, const webkin::ProximityReport &report)
+{
+    return cached_frame(robot, robot.proximity_msg, report.version, [&]()
+                        { return crowhttp::websocket::make_text_frame(report.json); });
+}
+
+// Full scene state for a client that has none: the cached scene_init
+// (whose poses may be older than the snapshot), then all current poses
+// and the proximity report. Caller holds robot.clients_mutex.
+void send_scene_state(Robot &robot, crowhttp::websocket::connection &conn, const ClientInfo &info,
+                      const webkin::SceneSnapshot &scene)
+{
+    namespace ws = crowhttp::websocket;
+    uint64_t init_key = (scene.tree_version << 32) | (scene.info_version & 0xffffffff);
+    conn.send_frame(cached_frame(robot, robot.init_frame, init_key, [&]()
+                                 { return ws::make_text_frame(trent_to_json(make_scene_init_message(scene))); }));
+    if (info.binary)
+    {
+        conn.send_frame(cached_frame(robot, robot.poses_binary, scene.version, [&]()
+                                     { return ws::make_binary_frame(
+                                           webkin::encode_pose_frame(scene.poses, robot.frame_sequence, now_ms())); }));
+    }
+    else
+    {
+        conn.send_frame(cached_frame(robot, robot.poses_frame, scene.version, [&]()
+                                     { return ws::make_text_frame(scene_json().scene_delta(scene, 0, false)); }));
+    }
+    if (auto proximity = robot.proximity.current())
+    {
+        conn.send_frame(proximity_frame(robot, *proximity));
+    }
+}
+
+// Choose the subscription groups that get an update in this broadcast,
+// pruning groups without clients. Groups held back by their rate limit
+// schedule another tick. Caller holds robot.clients_mutex.
+bool prepare_client_groups(Robot &robot, const webkin::SceneSnapshot &scene, double now)
+{
+    bool any_due = false;
+    bool held = false;
+    for (auto it = robot.groups.begin(); it != robot.groups.end();)
+    {
+        auto group = it->second.lock();
+        if (!group)
+        {
+            it = robot.groups.erase(it);
+            continue;
+        }
+        ++it;
+
+        group->due = false;
+        if (group->sent_version == scene.version)
+            continue;
+        double rate = group->subscription.max_rate;
+        if (rate > 0 && now - group->last_sent_ms < 1000.0 / rate)
+        {
+            held = true;
+            continue;
+        }
+        if (group->tree_version != scene.tree_version)
+        {
+            group->subscription.select(*scene.layout, group->indices);
+            group->tree_version = scene.tree_version;
+        }
+        group->changed.clear();
+        for (uint32_t i : group->indices)
+        {
+            if (scene.pose_version[i] > group->sent_version)
+                group->changed.push_back(i);
+        }
+        group->info_changed = scene.info_version != group->sent_info_version;
+        group->sent_version = scene.version;
+        group->sent_info_version = scene.info_version;
+        group->last_sent_ms = now;
+        group->text = group->full_text = group->binary = group->full_binary = group->info = nullptr;
+        group->due = true;
+        any_due = true;
+    }
+    if (held && robot.broadcaster.is_running())
+        robot.broadcaster.retry();
+    return any_due;
+}
+
+// Update of a subscribed client: the group's selected nodes that changed,
+// or all of them for a client that lost a frame. Frames are shared within
+// the group. Caller holds robot.clients_mutex.
+void send_group_update(crowhttp::websocket::connection &conn, const ClientInfo &info, ClientGroup &group,
+                       const webkin::SceneSnapshot &scene, bool full, uint32_t seq, double timestamp)
+{
+    namespace ws = crowhttp::websocket;
+    if (!full && group.changed.empty() && !group.info_changed)
+        return;
+
+    const auto &nodes = full ? group.indices : group.changed;
+    if (info.binary)
+    {
+        if (group.info_changed)
+        {
+            if (!group.info)
+                group.info = ws::make_text_frame(trent_to_json(make_joints_info_message(scene)));
+            conn.send_frame(group.info);
+        }
+        if (nodes.empty())
+            return;
+        auto &frame = full ? group.full_binary : group.binary;
+        if (!frame)
+            frame = ws::make_binary_frame(webkin::encode_pose_frame(scene.poses, nodes, seq, timestamp));
+        conn.send_latest(frame);
+    }
+    else
+    {
+        auto &frame = full ? group.full_text : group.text;
+        if (!frame)
+            frame = ws::make_text_frame(scene_json(timestamp).nodes_delta(scene, nodes, group.info_changed));
+        conn.send_latest(frame);
+    }
+}
+
+// Send the current snapshot to all clients: scene_init after a tree load,
+// otherwise a pose update relative to the last broadcast snapshot, or to
+// the group's last update for subscribed clients.
+// Takes robot.clients_mutex only, never the writer lock.
+void broadcast_scene_update(Robot &robot)
+{
+    std::lock_guard<std::mutex> lock(robot.clients_mutex);
+    auto scene = robot.scene.current();
+    double timestamp = now_ms();
+    bool groups_due = prepare_client_groups(robot, *scene, timestamp);
+    bool fresh = scene->version != robot.sent_version;
+    auto proximity = robot.proximity.current();
+    bool proximity_changed = proximity && proximity->version != robot.sent_proximity_version;
+    if (!fresh && !groups_due && !proximity_changed)
+        return;
+
+    uint64_t since = robot.sent_version;
+    bool info_changed = scene->info_version != robot.sent_info_version;
+    bool tree_changed = scene->tree_version != robot.sent_tree_version;
+    robot.sent_version = scene->version;
+    robot.sent_info_version = scene->info_version;
+    robot.sent_tree_version = scene->tree_version;
+    if (proximity)
+        robot.sent_proximity_version = proximity->version;
+
+    if (robot.clients.empty())
+    {
+        if (g_debug)
+        {
+            nos::println("[DEBUG] broadcast_scene_update: no clients");
+        }
+        return;
+    }
+
+    webkin::ScopedTimer fanout_timer(robot.metrics.broadcast);
+    webkin::TraceSpan send_span("send");
+    robot.metrics.broadcasts.add();
+    if (tree_changed)
+    {
+        // scene_init carries everything, so pending deltas are obsolete
+        for (auto &[conn, info] : robot.clients)
+        {
+            send_scene_state(robot, *conn, info, *scene);
+        }
+        return;
+    }
+
+    // Every message is serialized and framed at most once, then shared by
+    // all clients that need it
+    namespace ws = crowhttp::websocket;
+    uint32_t seq = ++robot.frame_sequence;
+    ws::shared_frame text_frame, full_text_frame;
+    ws::shared_frame binary_frame, full_binary_frame;
+    ws::shared_frame info_frame;
+
+    for (auto &[conn, info] : robot.clients)
+    {
+        if (info.group)
+        {
+            if (info.group->due)
+                send_group_update(*conn, info, *info.group, *scene, conn->take_dropped(), seq, timestamp);
+            continue;
+        }
+        if (!fresh)
+            continue;
+
+        // In delta mode a client that lost a frame to backpressure gets the
+        // full state once to resynchronize
+        bool full = !g_delta_updates || conn->take_dropped();
+        if (info.binary)
+        {
+            if (info_changed)
+            {
+                if (!info_frame)
+                {
+                    webkin::ScopedTimer timer(robot.metrics.serialize);
+                    webkin::TraceSpan span("serialize");
+                    info_frame = ws::make_text_frame(trent_to_json(make_joints_info_message(*scene)));
+                }
+                conn->send_frame(info_frame);
+            }
+            auto &frame = full ? full_binary_frame : binary_frame;
+            if (!frame)
+            {
+                webkin::ScopedTimer timer(robot.metrics.serialize);
+                webkin::TraceSpan span("serialize");
+                frame = ws::make_binary_frame(make_pose_frame(*scene, since, seq, timestamp, full));
+            }
+            conn->send_latest(frame);
+        }
+        else
+        {
+            auto &frame = full ? full_text_frame : text_frame;
+            if (!frame)
+            {
+                webkin::ScopedTimer timer(robot.metrics.serialize);
+                webkin::TraceSpan span("serialize");
+                frame = ws::make_text_frame(full ? scene_json(timestamp).scene_update(*scene)
+                                                 : scene_json(timestamp).scene_delta(*scene, since, info_changed));
+            }
+            conn->send_latest(frame);
+        }
+    }
+
+    // Alongside the poses it was computed from; never dropped, a client
+    // must not miss that a warning cleared
+    if (proximity_changed)
+    {
+        auto frame = proximity_frame(robot, *proximity);
+        for (auto &[conn, info] : robot.clients)
+        {
+            conn->send_frame(frame);
+        }
+    }
+
+    if (g_debug)
+    {
+        nos::println("[DEBUG] broadcast_scene_update: sent to ", robot.clients.size(), " clients, msg_len=",
+                     text_frame ? text_frame->size() : (full_text_frame ? full_text_frame->size() : 0),
+                     ", frame_len=",
+                     binary_frame ? binary_frame->size() : (full_binary_frame ? full_binary_frame->size() : 0));
+    }
+}
+
+// Publish the tree's poses as a new snapshot and schedule a broadcast:
+// coalesced by the broadcaster when it runs, otherwise sent immediately.
+// `trace` times the joint message behind the poses, if any.
+// Caller holds robot.mutex.
+void publish_scene_update(Robot &robot, const webkin::SceneTrace &trace = {})
+{
+    if (robot.proximity.enabled())
+    {
+        webkin::ScopedTimer timer(robot.metrics.proximity);
+        webkin::TraceSpan span("proximity");
+        robot.proximity.update(robot.tree.flat);
+    }
+    if (robot.smoother.enabled())
+    {
+        // The received poses are not shown, the next tick publishes the
+        // smoothed ones
+        robot.smoother.record(now_ms(), robot.tree, trace);
+        robot.tree.flat.clear_changed();
+        robot.broadcaster.request();
+        return;
+    }
+    robot.scene.publish(robot.tree, trace);
+    robot.pose_out.request();
+    if (robot.broadcaster.is_running())
+    {
+        robot.broadcaster.request();
+    }
+    else
+    {
+        broadcast_scene_update(robot);
+    }
+}
+
+// Broadcaster tick with --smooth: publish the display coordinates for now,
+// ticking again while they move without new samples
+void publish_smoothed_scene(Robot &robot)
+{
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    bool moving = robot.smoother.evaluate(now_ms(), robot.tree);
+    robot.scene.publish(robot.tree, robot.smoother.display(), robot.smoother.take_trace());
+    robot.pose_out.request();
+    if (moving)
+        robot.broadcaster.retry();
+}
+
+// Map recorded joint names onto the current tree. Caller holds robot.mutex.
+void resolve_replay_joints(Robot &robot)
+{
+    robot.replay_index.clear();
+    for (const auto &name : robot.replay_joints)
+    {
+        robot.replay_index.push_back(robot.tree.joint_index(name));
+    }
+}
+
+// Map the primary's node order onto the current tree. Caller holds robot.mutex.
+void resolve_relay_nodes(Robot &robot)
+{
+    robot.relay_index.clear();
+    for (const auto &name : robot.relay_nodes)
+    {
+        const auto *node = robot.tree.find_node(name);
+        robot.relay_index.push_back(node ? static_cast<uint32_t>(node->index) : UINT32_MAX);
+    }
+}
+
+// Links of a tree for --proximity: nodes with a K3D model, as hull points
+// of the STL in the node frame. Needs no lock, so reloads build them
+// before taking the writer lock.
+std::vector<webkin::LinkShape> proximity_links(const Robot &robot, const webkin::KinematicTree &tree,
+                                               const webkin::K3DLoader *models)
+{
+    std::vector<webkin::LinkShape> links;
+    if (robot.proximity.threshold() > 0 && models)
+    {
+        std::map<std::string, std::vector<float>> meshes; // Models shared by several nodes are parsed once
+        for (const auto *node : tree.nodes)
+        {
+            const nos::trent &model = node->model;
+            std::string path = model["path"].as_string_default("");
+            if (model["type"].as_string_default("") != "stl" || path.rfind(robot.models_url, 0) != 0)
+                continue;
+            std::string filename = path.substr(robot.models_url.size());
+            auto it = meshes.find(filename);
+            if (it == meshes.end())
+            {
+                it = meshes.emplace(filename, std::vector<float>()).first;
+                if (!models->model_triangles(filename, it->second))
+                    nos::println("Proximity: no mesh for ", filename);
+            }
+            const nos::trent &s = model["scale"];
+            webkin::Vec3 scale = s.is_list() ? webkin::Vec3::from_trent(s)
+                                             : webkin::Vec3(1, 1, 1) * s.as_numer_default(1.0);
+            links.push_back({static_cast<uint32_t>(node->index), webkin::hull_points(it->second, scale)});
+        }
+    }
+    return links;
+}
+
+// Caller holds robot.mutex.
+void bind_proximity(Robot &robot, std::vector<webkin::LinkShape> links)
+{
+    std::vector<std::string> names;
+    for (const auto *node : robot.tree.nodes)
+        names.emplace_back(node->name);
+    robot.proximity.reset(robot.tree.flat, std::move(links), std::move(names));
+    if (robot.proximity.enabled())
+        nos::println("Proximity: ", robot.proximity.link_count(), " links of ", robot.id, ", warning at ",
+                     robot.proximity.threshold());
+}
+
+// A tree was (re)loaded from robot.tree_data_json; the next broadcast is a
+// scene_init. Caller holds robot.mutex.
+void publish_scene_init(Robot &robot, std::vector<webkin::LinkShape> links)
+{
+    bind_proximity(robot, std::move(links));
+    robot.joint_schema = webkin::JointSchema::from_tree(robot.tree_data_json, robot.tree);
+    robot.player.request_stop();
+    robot.history.reset(robot.tree);
+    robot.recorder.bind(robot.tree);
+    resolve_replay_joints(robot);
+    resolve_relay_nodes(robot);
+    robot.scene.reset(robot.tree);
+    robot.smoother.reset(robot.tree);
+    publish_scene_update(robot);
+}
+
+// The tree's joint coordinates as one live frame of the history and the
+// --record file. Caller holds robot.mutex.
+void record_joint_frame(Robot &robot, double time_ms)
+{
+    robot.history.record(time_ms, robot.tree);
+    robot.recorder.record(time_ms, robot.tree);
+}
+
+// Live joint data was written to the tree: record it, end any playback and
+// publish. `recorded`: the caller recorded every frame already (queued
+// payloads, joint batches). Caller holds robot.mutex.
+void commit_joint_update(Robot &robot, webkin::SceneTrace trace = {}, bool recorded = false)
+{
+    {
+        webkin::ScopedTimer timer(robot.metrics.fk);
+        webkin::TraceSpan span("fk");
+        robot.tree.update();
+    }
+    double now = now_ms();
+    if (trace.valid())
+        trace.fk_ts = now;
+    if (!recorded)
+        record_joint_frame(robot, now);
+    if (robot.player.is_playing() && !robot.player.stop_requested())
+    {
+        robot.player.request_stop();
+        nos::println("History playback stopped by live joint data");
+    }
+    publish_scene_update(robot, trace);
+}
+
+// One frame of the --replay transport, treated like live joint data
+void on_replay_frame(Robot &robot, double time_ms, const double *coords)
+{
+    (void)time_ms;
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    for (size_t j = 0; j < robot.replay_index.size(); ++j)
+    {
+        if (robot.replay_index[j] != UINT32_MAX && !std::isnan(coords[j]))
+            robot.tree.set_joint_coord_at(robot.replay_index[j], coords[j]);
+    }
+    commit_joint_update(robot);
+}
+
+// Apply one frame of a history window. Runs on the playback thread.
+void apply_history_frame(Robot &robot, const webkin::HistoryWindow &window, size_t i)
+{
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    if (robot.player.stop_requested())
+        return;
+    const double *frame = window.frame(i);
+    for (size_t j = 0; j < window.joints; ++j)
+    {
+        robot.tree.set_joint_coord_at(window.flat_index[j], frame[j]);
+    }
+    robot.tree.update();
+    publish_scene_update(robot);
+}
+
+// Solve an ik_target message and apply the joints like a live update
+nos::trent solve_ik_target(Robot &robot, const nos::trent &message)
+{
+    nos::trent reply;
+    reply.init(nos::trent::type::dict);
+    reply["type"] = "ik_result";
+    std::string name = message["node"].as_string_default("");
+    reply["node"] = name;
+
+    const auto &position = message["position"];
+    if (!position.is_list())
+    {
+        reply["error"] = "Missing target position";
+        return reply;
+    }
+
+    webkin::IkTarget target;
+    target.position = webkin::Vec3::from_trent(position);
+    const auto &orientation = message["orientation"];
+    if (orientation.is_list())
+    {
+        target.orientation = webkin::Quat::from_trent(orientation);
+        target.use_orientation = true;
+    }
+    // Client settings are clamped: the solve runs on the I/O thread under
+    // robot.mutex, so it must stay short
+    webkin::IkOptions options;
+    auto option = [&message](const char *key, double fallback, double lo, double hi)
+    {
+        double value = message[key].as_numer_default(fallback);
+        return std::isfinite(value) ? std::clamp(value, lo, hi) : fallback;
+    };
+    options.max_iterations = static_cast<int>(
+        option("iterations", options.max_iterations, 1, webkin::IK_MAX_ITERATIONS));
+    options.damping = option("damping", options.damping, webkin::IK_MIN_DAMPING, webkin::IK_MAX_DAMPING);
+    options.position_tolerance = option("tolerance", options.position_tolerance,
+                                        webkin::IK_MIN_POSITION_TOLERANCE, webkin::IK_MAX_POSITION_TOLERANCE);
+    options.orientation_tolerance =
+        option("orientation_tolerance", options.orientation_tolerance, webkin::IK_MIN_ORIENTATION_TOLERANCE,
+               webkin::IK_MAX_ORIENTATION_TOLERANCE);
+
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    webkin::KinematicNode *node = robot.tree.find_node(name);
+    if (!node)
+    {
+        reply["error"] = "Unknown node";
+        return reply;
+    }
+
+    webkin::IkResult result = robot.ik.solve(robot.tree, static_cast<uint32_t>(node->index), target, options);
+    for (size_t c = 0; c < robot.ik.joints().size(); ++c)
+    {
+        robot.tree.set_joint_coord_at(robot.ik.joints()[c], robot.ik.coords()[c]);
+    }
+    commit_joint_update(robot);
+
+    reply["converged"] = result.converged;
+    reply["iterations"] = static_cast<double>(result.iterations);
+    reply["position_error"] = result.position_error;
+    reply["orientation_error"] = result.orientation_error;
+    return reply;
+}
+
+// Decimation target of a history query without `points`
+double default_history_points(const Robot &robot)
+{
+    return std::min(500.0, static_cast<double>(robot.history.capacity()));
+}
+
+// `points` of a history query as a count; false unless it is in
+// [0, capacity] (0 means all frames)
+bool history_points(const Robot &robot, double points, size_t &count)
+{
+    if (!(points >= 0 && points <= static_cast<double>(robot.history.capacity())))
+        return false;
+    count = static_cast<size_t>(points);
+    return true;
+}
+
+// Start playback of a history window. Must not be called with robot.mutex held.
+nos::trent start_history_playback(Robot &robot, double from_ms, double to_ms, double speed)
+{
+    webkin::HistoryWindow window = robot.history.copy_window(from_ms, to_ms);
+    nos::trent result;
+    result.init(nos::trent::type::dict);
+    result["frames"] = static_cast<double>(window.size());
+    result["duration_ms"] = window.size() ? window.time.back() - window.time.front() : 0.0;
+    result["speed"] = speed;
+    robot.player.start(std::move(window), speed);
+    result["status"] = robot.player.is_playing() ? "playing" : "empty";
+    return result;
+}
+
+double param_or(const crowhttp::request &req, const char *name, double fallback)
+{
+    const char *value = req.url_params.get(name);
+    return value ? std::atof(value) : fallback;
+}
+
+// A tree built off the writer lock, with what goes with it
+struct LoadedTree
+{
+    nos::trent data;
+    webkin::KinematicTree tree;
+    std::shared_ptr<const webkin::K3DLoader> models; // Null keeps the robot's
+    std::vector<webkin::LinkShape> links;
+};
+
+// Compile the tree and its --proximity links. Takes no lock, so joint
+// ingest keeps running while a large tree is built.
+void prepare_tree(const Robot &robot, LoadedTree &loaded)
+{
+    loaded.tree.load(loaded.data);
+    auto models = loaded.models ? loaded.models : robot.k3d_loader.load();
+    loaded.links = proximity_links(robot, loaded.tree, models.get());
+}
+
+// Swap a prepared tree in. Joints found in both trees keep their
+// coordinates; the next broadcast is a scene_init. The old tree is left
+// in `loaded`, so it is freed after the lock is released. Takes robot.mutex.
+void install_tree(Robot &robot, LoadedTree &loaded, const std::string &origin)
+{
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    for (uint32_t index : loaded.tree.joint_nodes)
+    {
+        if (const auto *joint = robot.tree.find_joint(loaded.tree.nodes[index]->name))
+            loaded.tree.set_joint_coord_at(index, joint->coord);
+    }
+    robot.tree.swap(loaded.tree);
+    robot.tree_data_json = std::move(loaded.data);
+    if (loaded.models)
+        robot.k3d_loader.store(loaded.models);
+    apply_axis_overrides(robot);
+    robot.tree.update();
+    nos::println("Loaded kinematic tree for ", robot.id, " via ", origin, ": ",
+                 robot.tree_data_json["name"].as_string_default("unnamed"));
+    nos::println("Joints: ");
+    for (const auto &name : robot.tree.get_joint_names())
+    {
+        nos::println("  - ", name);
+    }
+    publish_scene_init(robot, std::move(loaded.links));
+}
+
+// Callbacks for transport listeners
+void on_tree_received(Robot &robot, const nos::trent &data)
+{
+    LoadedTree loaded;
+    loaded.data = data;
+    prepare_tree(robot, loaded);
+    install_tree(robot, loaded, "transport");
+}
+
+// A file or upload loaded by robot.loader; runs on its thread
+void on_tree_loaded(Robot &robot, webkin::tree_loader::result &result)
+{
+    LoadedTree loaded;
+    loaded.data = std::move(result.tree);
+    loaded.models = result.models;
+    prepare_tree(robot, loaded);
+    install_tree(robot, loaded, result.source);
+}
+
+// --relay-from: a new tree from the primary and the node order its poses use
+void on_relay_tree(Robot &robot, const nos::trent &data, const std::vector<std::string> &node_order)
+{
+    {
+        std::lock_guard<std::mutex> lock(robot.relay_models_mutex);
+        robot.relay_models.clear();
+    }
+    LoadedTree loaded;
+    loaded.data = data;
+    prepare_tree(robot, loaded);
+    {
+        std::lock_guard<std::mutex> lock(robot.mutex);
+        robot.relay_nodes = node_order;
+    }
+    install_tree(robot, loaded, "relay");
+}
+
+// Poses computed by the primary: published as they are, without FK
+void on_relay_poses(Robot &robot, const std::vector<webkin::PoseRecord> &records)
+{
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    for (const auto &record : records)
+    {
+        if (record.index < robot.relay_index.size() && robot.relay_index[record.index] != UINT32_MAX)
+            robot.tree.flat.set_global_pose(robot.relay_index[record.index], record.pose);
+    }
+    publish_scene_update(robot);
+}
+
+// jointsInfo of the primary, its axis overrides included
+void on_relay_joints_info(Robot &robot, const nos::trent &info)
+{
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    for (const auto &[name, params] : info.as_dict())
+    {
+        webkin::KinematicNode *joint = robot.tree.find_joint(name);
+        if (!joint)
+            continue;
+        joint->slider_min = params["slider_min"].as_numer_default(joint->slider_min);
+        joint->slider_max = params["slider_max"].as_numer_default(joint->slider_max);
+        joint->axis_scale = params["axis_scale"].as_numer_default(joint->axis_scale);
+        joint->axis_offset = params["axis_offset"].as_numer_default(joint->axis_offset);
+    }
+    robot.scene.invalidate_joints_info();
+    publish_scene_update(robot);
+}
+
+// The primary's proximity report, sent to clients with the next broadcast
+void on_relay_proximity(Robot &robot, std::string message)
+{
+    {
+        std::lock_guard<std::mutex> lock(robot.mutex);
+        robot.proximity.publish_message(std::move(message));
+    }
+    if (robot.broadcaster.is_running())
+        robot.broadcaster.request();
+    else
+        broadcast_scene_update(robot);
+}
+
+void connect_relay(Robot &robot, const webkin::relay_config &config)
+{
+    robot.relay.set_tree_callback([&robot](const nos::trent &data, const std::vector<std::string> &node_order)
+                                  { on_relay_tree(robot, data, node_order); });
+    robot.relay.set_poses_callback([&robot](const std::vector<webkin::PoseRecord> &records)
+                                   { on_relay_poses(robot, records); });
+    robot.relay.set_joints_info_callback([&robot](const nos::trent &info)
+                                         { on_relay_joints_info(robot, info); });
+    robot.relay.set_proximity_callback([&robot](std::string message)
+                                       { on_relay_proximity(robot, std::move(message)); });
+    robot.relay.init(config);
+    robot.relay.connect();
+}
+
+// Write the coordinates of a joint message to the tree: "joints" as
+// {name: value}, or "ids" and "values" lists where an id is the position
+// of the joint in scene_init "joints". Returns false if the message has
+// neither. Caller holds robot.mutex.
+bool apply_joint_message(webkin::KinematicTree &tree, const nos::trent &message)
+{
+    const auto &joints_data = message["joints"];
+    if (joints_data.is_dict())
+    {
+        for (const auto &[name, value] : joints_data.as_dict())
+        {
+            tree.set_joint_coord(name, value.as_numer_default(0));
+        }
+        return true;
+    }
+
+    const auto &ids = message["ids"];
+    const auto &values = message["values"];
+    if (ids.is_list() && values.is_list())
+    {
+        size_t count = std::min(ids.as_list().size(), values.as_list().size());
+        for (size_t i = 0; i < count; ++i)
+        {
+            double id = ids.as_list()[i].as_numer_default(-1);
+            if (id >= 0 && id < tree.joint_count())
+                tree.set_joint_coord_by_id(static_cast<uint32_t>(id), values.as_list()[i].as_numer_default(0));
+        }
+        return true;
+    }
+    return false;
+}
+
+// Frames of a joint batch, oldest first, each a joint message with its
+// "ts": written to the tree in order, so the tree is left at the latest.
+// They are recorded on the server clock like every live frame: the batch
+// arrived now, and a frame's "ts" only gives its age relative to the last
+// one (the robot's clock may be off, recorded times never go back). The
+// caller computes and publishes once (commit_joint_update, recorded).
+// Returns the number of frames applied; `stamp` receives the last one's
+// raw stamps, for tracing. Caller holds robot.mutex.
+size_t apply_joint_frames(Robot &robot, const nos::trent &frames, webkin::JointStamp &stamp)
+{
+    if (!frames.is_list())
+        return 0;
+    double last_ts = 0;
+    for (const auto &frame : frames.as_list())
+    {
+        double ts = frame["ts"].as_numer_default(0);
+        if (ts > 0)
+            last_ts = ts;
+    }
+
+    size_t applied = 0;
+    double now = now_ms();
+    for (const auto &frame : frames.as_list())
+    {
+        if (!apply_joint_message(robot.tree, frame))
+            continue;
+        stamp = webkin::joint_stamp(frame);
+        double age = stamp.source_ts > 0 ? std::max(0.0, last_ts - stamp.source_ts) : 0.0;
+        record_joint_frame(robot, now - age);
+        ++applied;
+    }
+    return applied;
+}
+
+void on_joints_received(Robot &robot, const nos::trent &data)
+{
+    if (g_debug)
+    {
+        nos::println("[DEBUG] on_joints_received called");
+    }
+
+    webkin::SceneTrace trace;
+    trace.ingest_ts = now_ms();
+    webkin::JointStamp stamp = webkin::joint_stamp(data);
+    trace.source_ts = stamp.source_ts;
+    trace.seq = stamp.seq;
+
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    if (apply_joint_message(robot.tree, data))
+    {
+        if (g_debug)
+        {
+            nos::println("[DEBUG] joints updated");
+        }
+        commit_joint_update(robot, trace);
+    }
+    else if (g_debug)
+    {
+        nos::println("[DEBUG] on_joints_received: no joints dict or ids/values lists");
+    }
+}
+
+// Write one joint payload to the tree: a binary joint frame, JSON through
+// the fast path, or JSON through the trent parser, which also takes joint
+// batches ({"frames": [...]}, recorded as they are written, `recorded` is
+// set). Returns whether joints were written; `stamp` receives the JSON
+// message's "ts" and "seq". Caller holds robot.mutex.
+bool apply_joint_payload(Robot &robot, std::string_view payload, webkin::JointStamp &stamp, bool &recorded)
+{
+    recorded = false;
+    switch (webkin::apply_joint_frame(payload, robot.joint_schema, robot.tree))
+    {
+    case webkin::JointFrameStatus::NotAFrame:
+        break;
+    case webkin::JointFrameStatus::Applied:
+        return true;
+    case webkin::JointFrameStatus::SchemaMismatch:
+    {
+        // Warn once per schema, the publisher may keep going at full rate
+        if (robot.warned_schema_hash != robot.joint_schema.hash)
+        {
+            robot.warned_schema_hash = robot.joint_schema.hash;
+            nos::println("Dropping joint frames for ", robot.id, " with another schema, expected hash ",
+                         robot.joint_schema.hash_hex());
+        }
+        return false;
+    }
+    case webkin::JointFrameStatus::Malformed:
+        if (g_debug)
+        {
+            nos::println("[DEBUG] apply_joint_payload: malformed joint frame, size=", payload.size());
+        }
+        return false;
+    }
+
+    size_t matched = 0;
+    if (webkin::apply_joint_update(payload, robot.tree, &matched, &stamp))
+    {
+        if (g_debug)
         {
-            return content;
+            nos::println("[DEBUG] apply_joint_payload: ", matched, " joints");
         }
+        return true;
     }
-    // Fall back to file system
-    return read_file(g_static_dir / resource_path);
-}
-
-std::string trent_to_json(const nos::trent &t)
-{
-    return nos::json::to_string(t);
-}
 
-void load_axis_overrides()
-{
-    g_axis_overrides.clear();
-    if (fs::exists(g_axis_overrides_file))
+    if (g_debug)
     {
-        try
+        nos::println("[DEBUG] apply_joint_payload: falling back to JSON parser");
+    }
+    try
+    {
+        nos::trent message = nos::json::parse(std::string(payload));
+        const nos::trent &frames = std::as_const(message)["frames"];
+        if (frames.is_list())
         {
-            std::string content = read_file(g_axis_overrides_file);
-            nos::trent data = nos::json::parse(content);
-            if (data.is_dict())
-            {
-                for (const auto &[name, params] : data.as_dict())
-                {
-                    if (params.is_dict())
-                    {
-                        for (const auto &[key, value] : params.as_dict())
-                        {
-                            g_axis_overrides[name][key] = value.as_numer_default(0.0);
-                        }
-                    }
-                }
-            }
-            nos::println("Loaded axis overrides: ", g_axis_overrides.size(), " entries");
+            recorded = apply_joint_frames(robot, frames, stamp) > 0;
+            return recorded;
         }
-        catch (const std::exception &e)
+        stamp = webkin::joint_stamp(message);
+        return apply_joint_message(robot.tree, message);
+    }
+    catch (const std::exception &e)
+    {
+        if (g_debug)
         {
-            nos::println("Failed to load axis overrides: ", e.what());
+            nos::println("[DEBUG] apply_joint_payload: ", e.what());
         }
+        return false;
     }
 }
 
-void save_axis_overrides()
+// One batch of queued joint payloads: applied in arrival order, each
+// recorded at its arrival so the history and --record keep every state,
+// then computed and published once, traced by the last applied message.
+// Runs on the robot's compute thread.
+void apply_joint_batch(Robot &robot, const std::vector<webkin::ingest_queue::entry> &entries)
 {
-    try
+    webkin::TraceSpan span("ingest");
+    std::lock_guard<std::mutex> lock(robot.mutex);
+    bool applied = false;
+    webkin::SceneTrace trace;
+    for (const auto &entry : entries)
     {
-        fs::create_directories(g_config_dir);
-        nos::trent data;
-        data.init(nos::trent::type::dict);
-        for (const auto &[name, params] : g_axis_overrides)
+        webkin::ScopedTimer timer(robot.metrics.decode);
+        webkin::TraceSpan span("decode");
+        webkin::JointStamp stamp;
+        bool frames = false;
+        if (apply_joint_payload(robot, entry.payload, stamp, frames))
         {
-            nos::trent joint_data;
-            joint_data.init(nos::trent::type::dict);
-            for (const auto &[key, value] : params)
-            {
-                joint_data[key] = value;
-            }
-            data[name] = std::move(joint_data);
+            applied = true;
+            if (!frames) // Joint batches recorded their frames
+                record_joint_frame(robot, entry.received_ms);
+            trace.source_ts = stamp.source_ts;
+            trace.seq = stamp.seq;
+            trace.ingest_ts = entry.received_ms;
         }
-        std::ofstream file(g_axis_overrides_file);
-        file << nos::json::to_string(data);
-        nos::println("Saved axis overrides: ", g_axis_overrides.size(), " entries");
     }
-    catch (const std::exception &e)
+    if (applied)
     {
-        nos::println("Failed to save axis overrides: ", e.what());
+        commit_joint_update(robot, trace, true);
     }
 }
 
-void apply_axis_overrides()
+// Joint payload from a transport thread: queued for the compute thread,
+// so the delivery loop never waits on the tree or on clients
+bool on_joints_payload(Robot &robot, std::string_view payload)
 {
-    for (const auto &[name, params] : g_axis_overrides)
+    if (!robot.ingest.push(payload, now_ms()) && g_debug)
     {
-        auto it = g_tree.joints.find(name);
-        if (it != g_tree.joints.end())
-        {
-            auto *joint = it->second;
-            auto offset_it = params.find("axis_offset");
-            if (offset_it != params.end())
-                joint->axis_offset = offset_it->second;
+        nos::println("[DEBUG] on_joints_payload: ingest queue full, payload dropped");
+    }
+    return true;
+}
 
-            auto scale_it = params.find("axis_scale");
-            if (scale_it != params.end())
-                joint->axis_scale = scale_it->second;
+// Robot addressed by ?robot=<id>, the default robot without the parameter.
+// Null for an unknown id.
+Robot *robot_for(const crowhttp::request &req)
+{
+    const char *id = req.url_params.get("robot");
+    if (!id)
+        return g_default_robot;
+    auto it = g_robots.find(id);
+    return it != g_robots.end() ? it->second.get() : nullptr;
+}
 
-            auto min_it = params.find("slider_min");
-            if (min_it != params.end())
-                joint->slider_min = min_it->second;
+crowhttp::response unknown_robot_response()
+{
+    crowhttp::response res(404, R"({"error": "Unknown robot"})");
+    res.set_header("Content-Type", "application/json");
+    return res;
+}
 
-            auto max_it = params.find("slider_max");
-            if (max_it != params.end())
-                joint->slider_max = max_it->second;
-        }
-    }
+// A change that belongs to the primary was requested from a relay
+std::string relayed_error(const Robot &robot)
+{
+    return "Relay of " + robot.relay.url() + ", change this on the primary";
+}
+
+crowhttp::response relayed_response(const Robot &robot)
+{
+    nos::trent body;
+    body.init(nos::trent::type::dict);
+    body["error"] = relayed_error(robot);
+    crowhttp::response res(409, trent_to_json(body));
+    res.set_header("Content-Type", "application/json");
+    return res;
 }
 
-nos::trent find_original_axis_params(const nos::trent &node, const std::string &joint_name)
+// Body of POST /api/tree, parsed as it arrives instead of buffered
+struct TreeUpload : crowhttp::request_body_stream
+{
+    webkin::JsonStreamParser parser;
+
+    void write(std::string_view chunk) override { parser.feed(chunk); }
+};
+
+// K3D model file of a relayed tree: the tree's URLs are the primary's, so
+// the request is forwarded there once and served from memory afterwards
+crowhttp::response relay_model_response(const crowhttp::request &req, Robot &robot)
 {
-    if (node["name"].as_string_default("") == joint_name)
+    std::shared_ptr<const webkin::CachedBody> body;
     {
-        nos::trent result;
-        result.init(nos::trent::type::dict);
-        std::string jtype = node["type"].as_string_default("transform");
-        double default_min = -180.0, default_max = 180.0;
-        if (jtype == "actuator")
-        {
-            default_min = -1000.0;
-            default_max = 1000.0;
-        }
-        result["axis_offset"] = node["axis_offset"].as_numer_default(0.0);
-        result["axis_scale"] = node["axis_scale"].as_numer_default(1.0);
-        result["slider_min"] = node["slider_min"].as_numer_default(default_min);
-        result["slider_max"] = node["slider_max"].as_numer_default(default_max);
-        return result;
+        std::lock_guard<std::mutex> lock(robot.relay_models_mutex);
+        auto it = robot.relay_models.find(req.raw_url);
+        if (it != robot.relay_models.end())
+            body = it->second;
     }
-    const auto &children = node["children"];
-    if (children.is_list())
+    if (!body)
     {
-        for (const auto &child : children.as_list())
+        std::string data, content_type;
+        int status = robot.relay.fetch(req.raw_url, data, &content_type);
+        if (status != 200)
         {
-            nos::trent result = find_original_axis_params(child, joint_name);
-            if (!result.is_nil())
-            {
-                return result;
-            }
+            return status ? crowhttp::response(status, data) : crowhttp::response(502, "Primary unreachable");
         }
+        body = webkin::make_cached_body(std::move(data), std::move(content_type), true);
+        std::lock_guard<std::mutex> lock(robot.relay_models_mutex);
+        robot.relay_models[req.raw_url] = body;
     }
-    nos::trent empty;
-    return empty;
+    bool versioned = req.url_params.get("v") != nullptr;
+    return cached_response(req, std::move(body), versioned ? CACHE_IMMUTABLE : CACHE_REVALIDATE);
 }
 
-nos::trent make_scene_init_message()
+// K3D model file of a robot's tree, or with ?lod=N its preprocessed mesh
+crowhttp::response model_response(const crowhttp::request &req, Robot &robot, const std::string &filename)
 {
-    nos::trent msg;
-    msg.init(nos::trent::type::dict);
-    msg["type"] = "scene_init";
-    msg["nodes"] = g_tree.get_scene_data();
-    msg["joints"] = g_tree.get_joint_names_trent();
-    msg["jointsInfo"] = g_tree.get_joints_info();
-    msg["zUp"] = g_z_up;
-    return msg;
+    if (robot.relay.is_running())
+    {
+        return relay_model_response(req, robot);
+    }
+    auto models = robot.k3d_loader.load();
+    if (!models || !models->has_models())
+    {
+        return crowhttp::response(404, "No K3D file loaded");
+    }
+
+    if (const char *lod = req.url_params.get("lod"))
+    {
+        auto mesh = models->model_lod(filename, std::strtoul(lod, nullptr, 10));
+        if (!mesh)
+        {
+            return crowhttp::response(404, "No such level of detail: " + filename);
+        }
+        // The URLs of the tree carry the hash, such a level never changes
+        const char *version = req.url_params.get("v");
+        bool versioned = version && mesh->etag == "\"" + std::string(version) + "\"";
+        return cached_response(req, std::move(mesh), versioned ? CACHE_IMMUTABLE : CACHE_REVALIDATE);
+    }
+
+    if (auto content = models->model(filename))
+    {
+        return cached_response(req, std::move(content), CACHE_REVALIDATE);
+    }
+    fs::path file = models->model_file(filename);
+    if (file.empty())
+    {
+        return crowhttp::response(404, "Model not found: " + filename);
+    }
+    return file_response(req, file, "application/octet-stream", CACHE_REVALIDATE);
 }
 
-nos::trent make_scene_update_message()
+Robot &add_robot(const std::string &id, const std::string &topic)
 {
-    nos::trent msg;
-    msg.init(nos::trent::type::dict);
-    msg["type"] = "scene_update";
-    msg["nodes"] = g_tree.get_scene_data();
-    msg["jointsInfo"] = g_tree.get_joints_info();
-    return msg;
+    auto &robot = g_robots[id];
+    robot = std::make_unique<Robot>();
+    robot->id = id;
+    robot->topic = topic;
+    robot->models_url = id == g_default_robot_id ? "/k3d/models/" : "/k3d/" + id + "/models/";
+    robot->loader.set_models_url(robot->models_url);
+    return *robot;
 }
 
-void broadcast_to_clients(const std::string &message)
+// Load a robot's tree from a K3D file or directory, or from a tree JSON
+// file. Runs before the server starts; later loads go through robot.loader.
+void load_tree_file(Robot &robot, const std::string &file)
 {
-    for (auto *conn : g_clients)
+    fs::path path = fs::path(file);
+    // Expand ~ to home directory
+    if (!path.empty() && path.string()[0] == '~')
+    {
+        const char *home = std::getenv("HOME");
+        if (home)
+        {
+            path = fs::path(home) / path.string().substr(2);
+        }
+    }
+    robot.tree_file = path.string(); // Watched even if it appears only later
+
+    if (!fs::exists(path))
     {
-        conn->send_text(message);
+        nos::println("Tree file not found: ", file);
+        return;
     }
-}
 
-void broadcast_scene_update()
-{
-    if (g_clients.empty())
+    try
     {
-        if (g_debug)
+        webkin::tree_loader::result loaded = webkin::tree_loader::load_path(path, robot.models_url);
+        robot.tree_data_json = std::move(loaded.tree);
+        if (loaded.models)
         {
-            nos::println("[DEBUG] broadcast_scene_update: no clients");
+            robot.k3d_loader.store(loaded.models);
+            robot.loader.set_models(loaded.models);
+        }
+        robot.tree.load(robot.tree_data_json);
+        apply_axis_overrides(robot);
+        robot.tree.update();
+        nos::println("Loaded ", file, " for robot ", robot.id);
+        if (robot.tree.flat.compiled)
+            nos::println("Using generated forward kinematics");
+        nos::println("Joints: ");
+        for (const auto &name : robot.tree.get_joint_names())
+        {
+            nos::println("  - ", name);
+        }
+        if (loaded.models && !loaded.models->models_dir().empty())
+        {
+            nos::println("Models dir: ", loaded.models->models_dir().string());
+        }
+        else if (loaded.models && loaded.models->has_models())
+        {
+            nos::println("Models in memory: ", loaded.models->model_count());
         }
-        return;
     }
-    std::string msg = trent_to_json(make_scene_update_message());
-    if (g_debug)
+    catch (const std::exception &e)
     {
-        nos::println("[DEBUG] broadcast_scene_update: sending to ", g_clients.size(), " clients, msg_len=", msg.size());
+        nos::println("Failed to load ", file, ": ", e.what());
     }
-    broadcast_to_clients(msg);
 }
 
-void broadcast_scene_init()
+// Handling time of every HTTP route; validates the app, which run() would
+// do, so the rules are final
+void register_route_metrics(WebApp &app)
 {
-    if (g_clients.empty())
-        return;
-    std::string msg = trent_to_json(make_scene_init_message());
-    broadcast_to_clients(msg);
+    app.validate();
+    app.for_each_rule([](const crowhttp::BaseRule &rule)
+                      {
+        if (dynamic_cast<const crowhttp::WebSocketRule<WebApp> *>(&rule))
+            return; // Upgrades are not handled as requests
+        std::string methods;
+        rule.foreach_method([&methods](unsigned method)
+                            {
+            if (!methods.empty())
+                methods += ',';
+            methods += crowhttp::method_name(static_cast<crowhttp::HTTPMethod>(method)); });
+        auto &histogram = g_route_times[&rule];
+        histogram = std::make_unique<webkin::Histogram>();
+        g_metrics.add_histogram("webkin_http_request_seconds", "Time to handle one HTTP request, by route.",
+                                {{"route", rule.rule()}, {"method", methods}}, *histogram); });
 }
 
-// Callbacks for transport listeners
-void on_tree_received(const nos::trent &data)
-{
-    std::lock_guard<std::mutex> lock(g_mutex);
-    g_tree_data_json = data;
-    g_tree.load(data);
-    apply_axis_overrides();
-    g_tree.update();
-    nos::println("Loaded kinematic tree: ", data["name"].as_string_default("unnamed"));
-    nos::println("Joints: ");
-    for (const auto &name : g_tree.get_joint_names())
+// Export a robot's metrics; values owned by other components are read at
+// scrape time
+void register_robot_metrics(Robot &robot)
+{
+    webkin::MetricLabels labels{{"robot", robot.id}};
+    auto &m = robot.metrics;
+    g_metrics.add_histogram("webkin_ingest_decode_seconds", "Time to decode and apply one joint payload.", labels,
+                            m.decode);
+    g_metrics.add_histogram("webkin_fk_update_seconds", "Time of forward kinematics per applied batch.", labels,
+                            m.fk);
+    g_metrics.add_histogram("webkin_serialize_seconds", "Time to serialize and frame one broadcast message.",
+                            labels, m.serialize);
+    g_metrics.add_histogram("webkin_broadcast_seconds", "Time to fan one broadcast out to all clients.", labels,
+                            m.broadcast);
+    g_metrics.add_histogram("webkin_proximity_seconds", "Time to re-test link proximity per published update.",
+                            labels, m.proximity);
+    for (int i = 0; i < LatencyStats::STAGES; ++i)
     {
-        nos::println("  - ", name);
+        webkin::MetricLabels l{{"robot", robot.id}, {"stage", LatencyStats::NAMES[i]}};
+        g_metrics.add_histogram("webkin_latency_seconds", "End-to-end latency stages reported by frame_ack.", l,
+                                m.latency.stages[i]);
     }
-    broadcast_scene_init();
+    g_metrics.add_counter("webkin_broadcasts_total", "Broadcasts sent to at least one client.", labels,
+                          m.broadcasts);
+
+    auto transport = [&robot](const char *name)
+    { return webkin::MetricLabels{{"robot", robot.id}, {"transport", name}}; };
+    const char *messages_help = "Joint messages received.";
+    g_metrics.add_counter("webkin_joint_messages_total", messages_help, transport("mqtt"), m.mqtt_messages);
+    g_metrics.add_counter("webkin_joint_messages_total", messages_help, transport("crow"), m.crow_messages);
+    g_metrics.add_counter("webkin_joint_messages_total", messages_help, transport("ws"), m.ws_messages);
+
+    g_metrics.add_callback("webkin_poses_published_total", "Pose messages published by --publish-poses.",
+                           "counter", labels, [&robot]()
+                           { return static_cast<double>(robot.pose_out.published()); });
+    g_metrics.add_callback("webkin_poses_publish_failed_total", "Pose messages the transport did not take.",
+                           "counter", labels, [&robot]()
+                           { return static_cast<double>(robot.pose_out.failed()); });
+
+    g_metrics.add_callback("webkin_ingest_queued_total", "Joint payloads queued for the compute thread.",
+                           "counter", labels, [&robot]()
+                           { return static_cast<double>(robot.ingest.pushed()); });
+    g_metrics.add_callback("webkin_ingest_dropped_total", "Joint payloads dropped on a full ingest queue.",
+                           "counter", labels, [&robot]()
+                           { return static_cast<double>(robot.ingest.dropped()); });
+    g_metrics.add_callback("webkin_ingest_batches_total", "Batches applied by the compute thread.", "counter",
+                           labels, [&robot]()
+                           { return static_cast<double>(robot.ingest.batches()); });
+
+    g_metrics.add_callback("webkin_ws_clients", "Connected WebSocket clients.", "gauge", labels, [&robot]()
+                           {
+        std::lock_guard<std::mutex> lock(robot.clients_mutex);
+        return static_cast<double>(robot.clients.size()); });
+    g_metrics.add_callback("webkin_ws_queued_bytes", "Bytes queued for sending, summed over clients.", "gauge",
+                           labels, [&robot]()
+                           {
+        std::lock_guard<std::mutex> lock(robot.clients_mutex);
+        size_t total = 0;
+        for (const auto &[conn, info] : robot.clients)
+            total += conn->queued_bytes();
+        return static_cast<double>(total); });
+    g_metrics.add_callback("webkin_ws_queued_bytes_max", "Bytes queued for sending to the slowest client.",
+                           "gauge", labels, [&robot]()
+                           {
+        std::lock_guard<std::mutex> lock(robot.clients_mutex);
+        size_t most = 0;
+        for (const auto &[conn, info] : robot.clients)
+            most = std::max(most, conn->queued_bytes());
+        return static_cast<double>(most); });
+    g_metrics.add_callback("webkin_ws_dropped_frames_total", "Frames dropped by send queue backpressure.",
+                           "counter", labels, [&robot]()
+                           {
+        std::lock_guard<std::mutex> lock(robot.clients_mutex);
+        uint64_t total = robot.metrics.closed_dropped_frames.value();
+        for (const auto &[conn, info] : robot.clients)
+            total += conn->dropped_frames();
+        return static_cast<double>(total); });
 }
 
-void on_joints_received(const nos::trent &data)
+// First snapshot, which clients get as scene_init on connect, and the
+// robot's broadcaster thread. Runs before transports deliver joints.
+void start_robot(Robot &robot)
 {
-    if (g_debug)
+    register_robot_metrics(robot);
+    robot.proximity.set_threshold(g_proximity);
+    bind_proximity(robot, proximity_links(robot, robot.tree, robot.k3d_loader.load().get()));
+    robot.proximity.update(robot.tree.flat);
+    robot.joint_schema = webkin::JointSchema::from_tree(robot.tree_data_json, robot.tree);
+    robot.history.set_capacity(g_history_size);
+    robot.history.reset(robot.tree);
+    robot.player.set_frame_callback([&robot](const webkin::HistoryWindow &window, size_t i)
+                                    { apply_history_frame(robot, window, i); });
+    robot.ingest.set_batch_callback([&robot](const std::vector<webkin::ingest_queue::entry> &entries)
+                                    { apply_joint_batch(robot, entries); });
+    robot.ingest.start();
+    if (g_smooth_mode != webkin::SmoothMode::Off && g_broadcast_hz > 0)
+        robot.smoother.configure(g_smooth_mode, g_smooth_delay);
+    robot.smoother.reset(robot.tree);
+    robot.scene.reset(robot.tree);
+    robot.scene.publish(robot.tree);
     {
-        nos::println("[DEBUG] on_joints_received called");
+        auto scene = robot.scene.current();
+        robot.sent_version = scene->version;
+        robot.sent_tree_version = scene->tree_version;
+        robot.sent_info_version = scene->info_version;
     }
 
-    std::lock_guard<std::mutex> lock(g_mutex);
-    const auto &joints_data = data["joints"];
-    if (joints_data.is_dict())
+    if (g_broadcast_hz > 0)
     {
-        std::map<std::string, double> joints;
-        for (const auto &[name, value] : joints_data.as_dict())
+        robot.broadcaster.set_tick_callback([&robot]()
+                                            {
+            if (robot.smoother.enabled())
+                publish_smoothed_scene(robot);
+            broadcast_scene_update(robot); });
+        robot.broadcaster.start(g_broadcast_hz);
+    }
+
+    robot.loader.set_ready_callback([&robot](webkin::tree_loader::result &loaded)
+                                    { on_tree_loaded(robot, loaded); });
+    robot.loader.start();
+    if (g_watch && !robot.tree_file.empty())
+        robot.loader.watch(robot.tree_file, std::chrono::seconds(1));
+}
+
+// Subscribe a robot to joints on robot.topic and trees on robot.topic/tree.
+// Every robot has its own listener, connection and delivery thread.
+void connect_robot_transport(Robot &robot, TransportType transport, const std::string &mqtt_broker,
+                             int mqtt_port, const std::string &crowker_addr)
+{
+    auto on_tree = [&robot](const nos::trent &data)
+    { on_tree_received(robot, data); };
+    auto on_joints = [&robot](const nos::trent &data)
+    { on_joints_received(robot, data); };
+    auto on_mqtt_payload = [&robot](std::string_view payload)
+    {
+        robot.metrics.mqtt_messages.add();
+        return on_joints_payload(robot, payload);
+    };
+    auto on_crow_payload = [&robot](std::string_view payload)
+    {
+        robot.metrics.crow_messages.add();
+        return on_joints_payload(robot, payload);
+    };
+    const std::string poses_topic = "robot/" + robot.id + "/poses";
+
+    if (transport == TransportType::MQTT)
+    {
+        webkin::mqtt_config cfg;
+        cfg.broker_host = mqtt_broker;
+        cfg.broker_port = mqtt_port;
+        cfg.client_id = robot.id == g_default_robot_id ? "webkin" : "webkin-" + robot.id;
+        cfg.joints_topic = robot.topic;
+        cfg.tree_topic = robot.topic + "/tree";
+
+        robot.mqtt.set_tree_callback(on_tree);
+        robot.mqtt.set_joints_callback(on_joints);
+        robot.mqtt.set_joints_payload_callback(on_mqtt_payload);
+
+        if (robot.mqtt.init(cfg))
         {
-            joints[name] = value.as_numer_default(0);
+            if (!robot.mqtt.connect())
+            {
+                nos::println("Warning: MQTT connection failed for ", robot.id, ", continuing without transport");
+            }
         }
-        g_tree.set_joint_coords(joints);
-        g_tree.update();
+    }
+    else if (transport == TransportType::CROW)
+    {
+        webkin::crow_config cfg;
+        cfg.crowker_addr = crowker_addr;
+        cfg.joints_topic = robot.topic; // reuse same topic names
+        cfg.tree_topic = robot.topic + "/tree";
+        if (g_publish_poses)
+            cfg.publish_topics.push_back(poses_topic);
 
-        if (g_debug)
+        robot.crow.set_tree_callback(on_tree);
+        robot.crow.set_joints_callback(on_joints);
+        robot.crow.set_joints_payload_callback(on_crow_payload);
+
+        if (robot.crow.init(cfg))
         {
-            nos::println("[DEBUG] joints updated, clients=", g_clients.size());
+            if (!robot.crow.connect())
+            {
+                nos::println("Warning: Crow connection failed for ", robot.id, ", continuing without transport");
+            }
         }
-        broadcast_scene_update();
     }
-    else if (g_debug)
+
+    if (g_publish_poses)
+    {
+        robot.pose_out.configure(poses_topic, g_publish_selection, g_publish_hz);
+        if (transport == TransportType::MQTT)
+            robot.pose_out.set_sink([&robot](const std::string &topic, std::string_view payload, bool retain)
+                                    { return robot.mqtt.publish(topic, payload, retain); });
+        else
+            robot.pose_out.set_sink([&robot](const std::string &topic, std::string_view payload, bool retain)
+                                    { return robot.crow.publish(topic, payload, retain); });
+        robot.pose_out.start(robot.scene);
+        nos::println("Publishing poses of ", robot.id, " on ", robot.pose_out.topic());
+    }
+}
+
+// Move a client into the group of its subscription; an empty subscription
+// restores the full broadcast. The client already has the full scene, so
+// only later updates are narrowed.
+nos::trent subscribe_client(Robot &robot, crowhttp::websocket::connection &conn, const nos::trent &message)
+{
+    nos::trent reply;
+    reply.init(nos::trent::type::dict);
+    reply["type"] = "subscribed";
+
+    webkin::Subscription subscription;
+    std::string error;
+    if (!webkin::Subscription::from_trent(message, subscription, error))
+    {
+        reply["error"] = error;
+        return reply;
+    }
+
+    auto scene = robot.scene.current();
+    std::vector<uint32_t> selected;
+    subscription.select(*scene->layout, selected);
+    reply["nodes"] = static_cast<double>(selected.size());
+    reply["max_rate"] = subscription.max_rate;
+
+    std::lock_guard<std::mutex> lock(robot.clients_mutex);
+    auto client = robot.clients.find(&conn);
+    if (client == robot.clients.end())
+    {
+        reply["error"] = "Not connected";
+        return reply;
+    }
+    if (subscription.is_default())
+    {
+        client->second.group.reset();
+        return reply;
+    }
+
+    auto &slot = robot.groups[subscription.key()];
+    auto group = slot.lock();
+    if (!group)
     {
-        nos::println("[DEBUG] on_joints_received: data[joints] is not dict");
+        group = std::make_shared<ClientGroup>();
+        group->subscription = std::move(subscription);
+        group->indices = std::move(selected);
+        group->tree_version = scene->tree_version;
+        group->sent_version = scene->version;
+        group->sent_info_version = scene->info_version;
+        slot = group;
     }
+    client->second.group = std::move(group);
+    return reply;
+}
+
+// WebSocket endpoint of one robot; every route shares the robot's client set
+void add_ws_route(WebApp &app, const std::string &path, Robot &robot)
+{
+    app.route_dynamic(path)
+        .websocket<WebApp>(&app)
+        .subprotocols({webkin::WS_BINARY_SUBPROTOCOL, webkin::WS_JSON_SUBPROTOCOL})
+        .permessage_deflate(g_ws_deflate)
+        .onopen([&robot](crowhttp::websocket::connection &conn)
+                {
+            std::lock_guard<std::mutex> lock(robot.clients_mutex);
+            ClientInfo info;
+            info.binary = conn.get_subprotocol() == webkin::WS_BINARY_SUBPROTOCOL;
+            info.latency = std::make_shared<LatencyStats>();
+            robot.clients[&conn] = info;
+            conn.set_send_limits(g_ws_high_water, g_ws_max_queue);
+            nos::println("Client connected to ", robot.id, info.binary ? " (binary)" : "",
+                         ". Total: ", robot.clients.size());
+
+            // Send initial scene state
+            send_scene_state(robot, conn, info, *robot.scene.current()); })
+        .onclose([&robot](crowhttp::websocket::connection &conn, const std::string &reason, uint16_t code)
+                 {
+            (void)reason;
+            (void)code;
+            std::lock_guard<std::mutex> lock(robot.clients_mutex);
+            robot.metrics.closed_dropped_frames.add(conn.dropped_frames());
+            robot.clients.erase(&conn);
+            nos::println("Client disconnected from ", robot.id, ". Total: ", robot.clients.size()); })
+        .onmessage([&robot](crowhttp::websocket::connection &conn, const std::string &data, bool is_binary)
+                   {
+            if (is_binary) return;
+
+            nos::trent message = nos::json::parse(data);
+            std::string msg_type = message["type"].as_string_default("");
+
+            if ((msg_type == "joint_update" || msg_type == "joint_batch") && robot.relay.is_running()) {
+                // Joints are the primary's; the new poses come back from there
+                robot.metrics.ws_messages.add();
+                robot.relay.forward(data);
+            }
+            else if (msg_type == "joint_update" || msg_type == "joint_batch") {
+                // Applied by the compute thread with other queued updates
+                robot.metrics.ws_messages.add();
+                robot.ingest.push(data, now_ms());
+            }
+            else if (msg_type == "frame_ack") {
+                // A traced message was rendered; recorded outside the lock
+                double now = now_ms();
+                std::shared_ptr<LatencyStats> latency;
+                {
+                    std::lock_guard<std::mutex> lock(robot.clients_mutex);
+                    auto client = robot.clients.find(&conn);
+                    if (client != robot.clients.end())
+                        latency = client->second.latency;
+                }
+                if (latency)
+                    latency->record(message, now);
+                robot.metrics.latency.record(message, now);
+            }
+            else if (msg_type == "history_request") {
+                size_t points;
+                nos::trent reply;
+                double requested = message["points"].as_numer_default(default_history_points(robot));
+                if (history_points(robot, requested, points))
+                    reply = robot.history.query(message["from"].as_numer_default(-60000),
+                                                message["to"].as_numer_default(0), points);
+                else
+                    reply["error"] = "points must be in [0, " + std::to_string(robot.history.capacity()) + "]";
+                reply["type"] = "history";
+                conn.send_text(trent_to_json(reply));
+            }
+            else if (msg_type == "history_play" && robot.relay.is_running()) {
+                // A local player would fight the poses relayed from the primary
+                nos::trent reply;
+                reply["type"] = "history_playback";
+                reply["error"] = relayed_error(robot);
+                conn.send_text(trent_to_json(reply));
+            }
+            else if (msg_type == "history_play") {
+                nos::trent reply = start_history_playback(robot, message["from"].as_numer_default(-60000),
+                                                          message["to"].as_numer_default(0),
+                                                          message["speed"].as_numer_default(1));
+                reply["type"] = "history_playback";
+                conn.send_text(trent_to_json(reply));
+            }
+            else if (msg_type == "history_stop") {
+                robot.player.stop();
+            }
+            else if (msg_type == "ik_target" && robot.relay.is_running()) {
+                nos::trent reply;
+                reply["type"] = "ik_result";
+                reply["node"] = message["node"].as_string_default("");
+                reply["error"] = "Relay of " + robot.relay.url() + ", solve on the primary";
+                conn.send_text(trent_to_json(reply));
+            }
+            else if (msg_type == "ik_target") {
+                conn.send_text(trent_to_json(solve_ik_target(robot, message)));
+            }
+            else if (msg_type == "subscribe") {
+                conn.send_text(trent_to_json(subscribe_client(robot, conn, message)));
+            } });
 }
 
 std::string read_file(const fs::path &path)
@@ -368,11 +2146,18 @@ int main(int argc, char *argv[])
     std::string host = "0.0.0.0";
     int port = 8000;
     TransportType transport = TransportType::NONE;
+    std::string record_path;
+    webkin::replay_config replay_cfg;
+    webkin::relay_config relay_cfg;
+    std::string relay_url;
     std::string mqtt_broker = "localhost";
     int mqtt_port = 1883;
     std::string mqtt_topic = "robot/joints";
     std::string crowker_addr = ".12.127.0.0.1:10009";
     std::string k3d_file;
+    std::vector<std::pair<std::string, std::string>> robot_args; // --robot ID[=PATH]
+    std::string generate_fk_path;
+    std::string fk_name = "robot";
 
     // Check K3D_FILE environment variable
     if (const char *env_k3d = std::getenv("K3D_FILE"))
@@ -422,17 +2207,150 @@ int main(int argc, char *argv[])
         {
             mqtt_topic = argv[++i];
         }
-        else if (arg == "--crowker" && i + 1 < argc)
+        else if (arg == "--crowker" && i + 1 < argc)
+        {
+            crowker_addr = argv[++i];
+        }
+        else if (arg == "--debug" || arg == "-d")
+        {
+            g_debug = true;
+        }
+        else if (arg == "--broadcast-hz" && i + 1 < argc)
+        {
+            g_broadcast_hz = std::stod(argv[++i]);
+        }
+        else if (arg == "--json-precision" && i + 1 < argc)
+        {
+            g_json_precision = std::stoi(argv[++i]);
+        }
+        else if (arg == "--ws-high-water" && i + 1 < argc)
+        {
+            g_ws_high_water = std::stoul(argv[++i]);
+        }
+        else if (arg == "--ws-max-queue" && i + 1 < argc)
+        {
+            g_ws_max_queue = std::stoul(argv[++i]);
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            record_path = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            transport = TransportType::REPLAY;
+            replay_cfg.path = argv[++i];
+        }
+        else if (arg == "--replay-speed" && i + 1 < argc)
+        {
+            replay_cfg.speed = std::stod(argv[++i]);
+        }
+        else if (arg == "--replay-from" && i + 1 < argc)
+        {
+            replay_cfg.start_offset = std::stod(argv[++i]);
+        }
+        else if (arg == "--replay-loop")
+        {
+            replay_cfg.loop = true;
+        }
+        else if (arg == "--relay-from" && i + 1 < argc)
+        {
+            transport = TransportType::RELAY;
+            relay_url = argv[++i];
+            if (!webkin::parse_relay_url(relay_url, relay_cfg))
+            {
+                nos::println("Invalid --relay-from URL (expected ws://HOST:PORT/ws[/ROBOT]): ", relay_url);
+                return 1;
+            }
+        }
+        else if (arg == "--publish-poses" && i + 1 < argc)
+        {
+            // "all", or node names separated by commas
+            g_publish_poses = true;
+            std::string list = argv[++i];
+            g_publish_selection.nodes.clear();
+            std::stringstream names(list == "all" ? std::string() : list);
+            for (std::string name; std::getline(names, name, ',');)
+            {
+                if (!name.empty())
+                    g_publish_selection.nodes.push_back(name);
+            }
+            std::sort(g_publish_selection.nodes.begin(), g_publish_selection.nodes.end());
+            g_publish_selection.nodes.erase(
+                std::unique(g_publish_selection.nodes.begin(), g_publish_selection.nodes.end()),
+                g_publish_selection.nodes.end());
+        }
+        else if (arg == "--publish-hz" && i + 1 < argc)
+        {
+            g_publish_hz = std::stod(argv[++i]);
+        }
+        else if (arg == "--history-size" && i + 1 < argc)
+        {
+            g_history_size = std::stoul(argv[++i]);
+        }
+        else if (arg == "--proximity" && i + 1 < argc)
+        {
+            g_proximity = std::stod(argv[++i]);
+        }
+        else if (arg == "--smooth" && i + 1 < argc)
+        {
+            if (!webkin::parse_smooth_mode(argv[++i], g_smooth_mode))
+            {
+                nos::println("Unknown smoothing mode: ", argv[i], " (interpolate, extrapolate or off)");
+                return 1;
+            }
+        }
+        else if (arg == "--smooth-delay" && i + 1 < argc)
+        {
+            g_smooth_delay = std::stod(argv[++i]);
+        }
+        else if (arg == "--delta")
+        {
+            g_delta_updates = true;
+        }
+        else if (arg == "--no-ws-deflate")
+        {
+            g_ws_deflate = false;
+        }
+        else if (arg == "--trace")
+        {
+            g_trace = true;
+        }
+        else if (arg == "--k3d" && i + 1 < argc)
+        {
+            k3d_file = argv[++i];
+        }
+        else if (arg == "--watch")
+        {
+            g_watch = true;
+        }
+        else if (arg == "--robot" && i + 1 < argc)
+        {
+            std::string spec = argv[++i];
+            size_t eq = spec.find('=');
+            std::string id = spec.substr(0, eq);
+            if (id.empty() || id.find_first_of("/?#") != std::string::npos)
+            {
+                nos::println("Invalid robot id: ", spec);
+                return 1;
+            }
+            robot_args.emplace_back(id, eq == std::string::npos ? "" : spec.substr(eq + 1));
+        }
+        else if (arg == "--generate-fk" && i + 1 < argc)
         {
-            crowker_addr = argv[++i];
+            generate_fk_path = argv[++i];
         }
-        else if (arg == "--debug" || arg == "-d")
+        else if (arg == "--fk-name" && i + 1 < argc)
         {
-            g_debug = true;
+            fk_name = argv[++i];
+            if (!webkin::is_fk_model_name(fk_name))
+            {
+                nos::println("Invalid model name: ", fk_name, " (a C++ identifier)");
+                return 1;
+            }
         }
-        else if (arg == "--k3d" && i + 1 < argc)
+        else if (arg == "--generic-fk")
         {
-            k3d_file = argv[++i];
+            webkin::fk::set_compiled_fk_enabled(false);
         }
         else if (arg == "--static-dir" && i + 1 < argc)
         {
@@ -447,20 +2365,54 @@ int main(int argc, char *argv[])
             nos::println("  --port PORT        Port to bind (default: 8000)");
             nos::println("  --z-up             Convert Z-up to Y-up");
             nos::println("  --k3d PATH         Load K3D file or directory (env: K3D_FILE)");
+            nos::println("  --watch            Reload the tree files of --k3d and --robot when they change");
             nos::println("  --static-dir DIR   Use external static files directory");
+            nos::println("  --delta            Broadcast only changed node poses (scene_delta)");
+            nos::println("  --no-ws-deflate    Do not compress WebSocket messages (permessage-deflate)");
+            nos::println("  --broadcast-hz HZ  WebSocket update rate, 0 = on every change (default: 60)");
+            nos::println("  --json-precision N Decimals of poses in JSON updates, -1 = shortest round-trip (default: 6)");
+            nos::println("  --ws-high-water B  Per-client queue size above which pose frames are dropped (default: 1 MiB)");
+            nos::println("  --ws-max-queue B   Per-client queue size at which the client is disconnected (default: 64 MiB)");
+            nos::println("  --history-size N   Joint history frames kept for playback, 0 = off (default: 60000)");
+            nos::println("  --proximity DIST   Report links of K3D models closer than DIST (scene units), 0 = off");
+            nos::println("  --smooth MODE      Smooth low-rate joint feeds for display: interpolate or extrapolate");
+            nos::println("  --smooth-delay MS  Display delay of --smooth interpolate (default: 100)");
+            nos::println("  --robot ID[=PATH]  Host another robot: /ws/ID, ?robot=ID, topic robot/ID/joints;");
+            nos::println("                     PATH is a K3D file or directory or a tree JSON file");
+            nos::println("  --trace            Record trace spans all the time, /debug/trace answers at once");
+            nos::println("  --generic-fk       Do not use the generated forward kinematics linked in (fk_models.cpp)");
             nos::println("  --debug, -d        Enable debug output");
             nos::println("");
             nos::println("Transport options:");
             nos::println("  --mqtt             Use MQTT transport");
             nos::println("  --crow             Use Crow protocol transport");
+            nos::println("  --replay PATH      Replay a joint recording made with --record (default robot)");
+            nos::println("  --relay-from URL   Serve the scene of another webkin server, e.g.");
+            nos::println("                     ws://primary:8000/ws or ws://primary:8000/ws/ID (default robot)");
+            nos::println("");
+            nos::println("Recording options:");
+            nos::println("  --record PATH      Append live joint frames of the default robot to a file");
+            nos::println("  --replay-speed X   Replay speed relative to recorded time (default: 1)");
+            nos::println("  --replay-from MS   Start replay MS after the first recorded frame");
+            nos::println("  --replay-loop      Restart replay at the end of the recording");
             nos::println("");
             nos::println("MQTT options:");
             nos::println("  --mqtt-broker HOST MQTT broker host (default: localhost)");
             nos::println("  --mqtt-port PORT   MQTT broker port (default: 1883)");
-            nos::println("  --mqtt-topic TOPIC MQTT topic prefix (default: robot/joints)");
+            nos::println("  --mqtt-topic TOPIC MQTT topic prefix of the default robot (default: robot/joints)");
             nos::println("");
             nos::println("Crow options:");
             nos::println("  --crowker ADDR     Crowker address (default: .12.127.0.0.1:10009)");
+            nos::println("");
+            nos::println("Pose publishing options (with --mqtt or --crow):");
+            nos::println("  --publish-poses N  Publish computed poses on robot/<id>/poses as binary pose frames;");
+            nos::println("                     N is all or node names separated by commas, e.g. tcp");
+            nos::println("  --publish-hz HZ    Rate cap of published poses, 0 = every update (default: 0)");
+            nos::println("");
+            nos::println("Code generation:");
+            nos::println("  --generate-fk PATH Write compile-time forward kinematics of the default robot's tree");
+            nos::println("                     to a C++ header (see fk_model.hpp) and exit");
+            nos::println("  --fk-name NAME     Model struct name of --generate-fk (default: robot)");
             return 0;
         }
     }
@@ -499,14 +2451,30 @@ int main(int argc, char *argv[])
             g_config_dir = "/tmp/webkin";
         }
     }
-    g_axis_overrides_file = g_config_dir / "axis_overrides.json";
+    // Default robot on the legacy topic and endpoints, then --robot ones
+    g_default_robot = &add_robot(g_default_robot_id, mqtt_topic);
+    for (const auto &[id, path] : robot_args)
+    {
+        if (g_robots.count(id))
+        {
+            nos::println("Duplicate robot id: ", id);
+            return 1;
+        }
+        add_robot(id, "robot/" + id + "/joints");
+    }
 
-    // Load axis overrides
-    load_axis_overrides();
+    // Load axis overrides, one file per robot
+    for (auto &[id, robot] : g_robots)
+    {
+        robot->axis_overrides_file =
+            g_config_dir / (id == g_default_robot_id ? "axis_overrides.json" : "axis_overrides." + id + ".json");
+        load_axis_overrides(*robot);
+    }
 
     if (g_use_embedded_resources)
     {
         nos::println("Using embedded resources");
+        prepare_static_resources();
     }
     else
     {
@@ -517,255 +2485,622 @@ int main(int argc, char *argv[])
     // Try to load K3D file if specified
     if (!k3d_file.empty())
     {
-        fs::path k3d_path = fs::path(k3d_file);
-        // Expand ~ to home directory
-        if (!k3d_path.empty() && k3d_path.string()[0] == '~')
-        {
-            const char *home = std::getenv("HOME");
-            if (home)
-            {
-                k3d_path = fs::path(home) / k3d_path.string().substr(2);
-            }
-        }
-
-        if (fs::exists(k3d_path))
-        {
-            try
-            {
-                g_k3d_loader = std::make_unique<webkin::K3DLoader>();
-                if (fs::is_directory(k3d_path))
-                {
-                    g_tree_data_json = g_k3d_loader->load_directory(k3d_path);
-                }
-                else
-                {
-                    g_tree_data_json = g_k3d_loader->load_file(k3d_path);
-                }
-                g_tree.load(g_tree_data_json);
-                apply_axis_overrides();
-                g_tree.update();
-                nos::println("Loaded K3D: ", k3d_file);
-                nos::println("Joints: ");
-                for (const auto &name : g_tree.get_joint_names())
-                {
-                    nos::println("  - ", name);
-                }
-                if (g_k3d_loader->has_models())
-                {
-                    nos::println("Models dir: ", g_k3d_loader->models_dir().string());
-                }
-            }
-            catch (const std::exception &e)
-            {
-                nos::println("Failed to load K3D file ", k3d_file, ": ", e.what());
-            }
-        }
-        else
-        {
-            nos::println("K3D file not found: ", k3d_file);
-        }
+        load_tree_file(*g_default_robot, k3d_file);
+    }
+    for (const auto &[id, path] : robot_args)
+    {
+        if (!path.empty())
+            load_tree_file(*g_robots[id], path);
     }
 
     // Load fallback tree if no K3D loaded
-    if (g_tree_data_json.is_nil())
+    Robot &default_robot = *g_default_robot;
+    if (default_robot.tree_data_json.is_nil())
     {
         fs::path tree_file = g_static_dir / "example_tree.json";
         if (fs::exists(tree_file))
         {
             std::string content = read_file(tree_file);
-            g_tree_data_json = nos::json::parse(content);
-            g_tree.load(g_tree_data_json);
+            default_robot.tree_data_json = nos::json::parse(content);
+            default_robot.tree.load(default_robot.tree_data_json);
+            if (default_robot.tree.flat.compiled)
+                nos::println("Using generated forward kinematics");
             nos::println("Loaded fallback tree with joints: ");
-            for (const auto &name : g_tree.get_joint_names())
+            for (const auto &name : default_robot.tree.get_joint_names())
             {
                 nos::println("  - ", name);
             }
         }
     }
 
-    // Setup transport
-    webkin::mqtt_listener mqtt;
-    webkin::crow_listener crow;
+    if (!generate_fk_path.empty())
+    {
+        if (default_robot.tree_data_json.is_nil())
+        {
+            nos::println("No tree to generate forward kinematics from");
+            return 1;
+        }
+        std::string source = !k3d_file.empty() ? fs::path(k3d_file).filename().string() : "example_tree.json";
+        std::string header = webkin::generate_fk_header(default_robot.tree, fk_name, source);
+        std::ofstream out(generate_fk_path, std::ios::binary);
+        if (!(out << header))
+        {
+            nos::println("Cannot write ", generate_fk_path);
+            return 1;
+        }
+        nos::println("Wrote forward kinematics of ", default_robot.tree.flat.size(), " nodes to ", generate_fk_path);
+        return 0;
+    }
 
-    switch (transport)
+    if (transport == TransportType::RELAY)
     {
-    case TransportType::MQTT:
+        // The primary does both, the relay shows its results
+        if (g_smooth_mode != webkin::SmoothMode::Off)
+            nos::println("Smoothing is done by the primary, --smooth ignored with --relay-from");
+        if (g_proximity > 0)
+            nos::println("Proximity is checked by the primary, --proximity ignored with --relay-from");
+        g_smooth_mode = webkin::SmoothMode::Off;
+        g_proximity = 0;
+    }
+
+    // First snapshots and broadcasters before transports begin delivering joints
+    for (auto &[id, r] : g_robots)
     {
-        nos::println("Using MQTT transport");
-        webkin::mqtt_config cfg;
-        cfg.broker_host = mqtt_broker;
-        cfg.broker_port = mqtt_port;
-        cfg.joints_topic = mqtt_topic;
-        cfg.tree_topic = mqtt_topic + "/tree";
+        start_robot(*r);
+    }
+    if (!record_path.empty() && default_robot.recorder.open(record_path, default_robot.tree.get_joint_names()))
+    {
+        default_robot.recorder.bind(default_robot.tree);
+    }
+    if (g_broadcast_hz > 0)
+    {
+        nos::println("Broadcast rate: ", g_broadcast_hz, " Hz");
+    }
+    else
+    {
+        nos::println("Broadcast rate: on every change");
+    }
+    if (g_smooth_mode != webkin::SmoothMode::Off && g_broadcast_hz <= 0)
+    {
+        nos::println("Smoothing needs a broadcast rate, --smooth ignored with --broadcast-hz 0");
+    }
+    else if (g_smooth_mode == webkin::SmoothMode::Interpolate)
+    {
+        nos::println("Smoothing: interpolate, ", g_smooth_delay, " ms behind");
+    }
+    else if (g_smooth_mode == webkin::SmoothMode::Extrapolate)
+    {
+        nos::println("Smoothing: extrapolate");
+    }
+    if (g_robots.size() > 1)
+    {
+        nos::println("Robots: ", g_robots.size());
+    }
 
-        mqtt.set_tree_callback(on_tree_received);
-        mqtt.set_joints_callback(on_joints_received);
+    if (g_publish_poses && transport != TransportType::MQTT && transport != TransportType::CROW)
+    {
+        nos::println("Publishing poses needs --mqtt or --crow, --publish-poses ignored");
+        g_publish_poses = false;
+    }
+
+    // Setup transport
+    webkin::replay_listener replay;
 
-        if (mqtt.init(cfg))
+    switch (transport)
+    {
+    case TransportType::MQTT:
+    case TransportType::CROW:
+        nos::println(transport == TransportType::MQTT ? "Using MQTT transport" : "Using Crow protocol transport");
+        for (auto &[id, r] : g_robots)
         {
-            if (!mqtt.connect())
-            {
-                nos::println("Warning: MQTT connection failed, continuing without transport");
-            }
+            connect_robot_transport(*r, transport, mqtt_broker, mqtt_port, crowker_addr);
         }
         break;
-    }
-    case TransportType::CROW:
+    case TransportType::REPLAY:
     {
-        nos::println("Using Crow protocol transport");
-        webkin::crow_config cfg;
-        cfg.crowker_addr = crowker_addr;
-        cfg.joints_topic = mqtt_topic; // reuse same topic names
-        cfg.tree_topic = mqtt_topic + "/tree";
-
-        crow.set_tree_callback(on_tree_received);
-        crow.set_joints_callback(on_joints_received);
-
-        if (crow.init(cfg))
+        nos::println("Using replay transport");
+        replay.set_frame_callback([&default_robot](double time_ms, const double *coords)
+                                  { on_replay_frame(default_robot, time_ms, coords); });
+        if (replay.init(replay_cfg))
         {
-            if (!crow.connect())
             {
-                nos::println("Warning: Crow connection failed, continuing without transport");
+                std::lock_guard<std::mutex> lock(default_robot.mutex);
+                default_robot.replay_joints = replay.names();
+                resolve_replay_joints(default_robot);
             }
+            replay.connect();
+        }
+        else
+        {
+            nos::println("Warning: cannot replay ", replay_cfg.path, ", continuing without transport");
         }
         break;
     }
+    case TransportType::RELAY:
+        nos::println("Using relay transport");
+        connect_relay(default_robot, relay_cfg);
+        break;
     case TransportType::NONE:
-        nos::println("No transport configured (use --mqtt or --crow to enable)");
+        nos::println("No transport configured (use --mqtt, --crow, --replay or --relay-from to enable)");
         break;
     }
 
+    if (g_trace)
+    {
+        webkin::trace::retain();
+    }
+
     // Create Crow HTTP app
-    crowhttp::SimpleApp app;
+    WebApp app;
 
     // Main page
     CROW_ROUTE(app, "/")
-    ([]()
+    ([](const crowhttp::request &req)
      {
-        std::string content = read_static_resource("index.html");
-        if (content.empty()) {
-            return crowhttp::response(404, "Not found");
+        if (auto content = static_resource("index.html")) {
+            return cached_response(req, std::move(content), CACHE_REVALIDATE);
         }
-        crowhttp::response res(200, content);
-        res.set_header("Content-Type", "text/html");
-        return res; });
+        return file_response(req, g_static_dir / "index.html", "text/html", CACHE_REVALIDATE); });
 
     // Static files
     CROW_ROUTE(app, "/static/<path>")
-    ([](const std::string &path)
+    ([](const crowhttp::request &req, std::string_view path)
      {
         // Security: prevent directory traversal
         if (path.find("..") != std::string::npos) {
             return crowhttp::response(403, "Forbidden");
         }
 
-        std::string content = read_static_resource(path);
-        if (content.empty()) {
-            return crowhttp::response(404, "Not found");
+        if (auto content = static_resource(path)) {
+            return cached_response(req, std::move(content), CACHE_REVALIDATE);
         }
+        // Not embedded: from the static dir, read per request so edits show up
+        return file_response(req, g_static_dir / path, get_mime_type(std::string(path)), CACHE_REVALIDATE); });
 
-        crowhttp::response res(200, content);
-        res.set_header("Content-Type", get_mime_type(path));
-        return res; });
-
-    // K3D model files
+    // K3D model files of the default robot, then of any robot
     CROW_ROUTE(app, "/k3d/models/<path>")
-    ([](const std::string &filename)
+    ([](const crowhttp::request &req, const std::string &filename)
+     { return model_response(req, *g_default_robot, filename); });
+
+    CROW_ROUTE(app, "/k3d/<string>/models/<path>")
+    ([](const crowhttp::request &req, const std::string &id, const std::string &filename)
+     {
+        auto it = g_robots.find(id);
+        if (it == g_robots.end() && g_default_robot->relay.is_running())
+        {
+            // Relaying a robot of the primary that has an id there
+            return relay_model_response(req, *g_default_robot);
+        }
+        if (it == g_robots.end())
+        {
+            return crowhttp::response(404, "Unknown robot: " + id);
+        }
+        return model_response(req, *it->second, filename); });
+
+    // REST API: Get tree
+    CROW_ROUTE(app, "/api/tree")
+    ([](const crowhttp::request &req)
      {
-        if (!g_k3d_loader || !g_k3d_loader->has_models())
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        std::shared_ptr<const webkin::CachedBody> body;
         {
-            return crowhttp::response(404, "No K3D file loaded");
+            std::lock_guard<std::mutex> cache_lock(robot->tree_body_mutex);
+            if (robot->tree_body_version != robot->scene.current()->tree_version)
+            {
+                // Tree version is stable while the writer lock is held
+                std::lock_guard<std::mutex> lock(robot->mutex);
+                robot->tree_body_version = robot->scene.current()->tree_version;
+                robot->tree_body.reset();
+                if (!robot->tree_data_json.is_nil())
+                    robot->tree_body = webkin::make_cached_body(trent_to_json(robot->tree_data_json),
+                                                                "application/json", true);
+            }
+            body = robot->tree_body;
+        }
+        if (!body) {
+            return crowhttp::response(200, R"({"error": "No tree loaded"})");
         }
+        // Shared by every client until the tree changes, sent without a copy
+        return cached_response(req, std::move(body), CACHE_REVALIDATE); });
+
+    // REST API: Get scene
+    CROW_ROUTE(app, "/api/scene")
+    ([](const crowhttp::request &req)
+     {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        auto scene = robot->scene.current();
+        crowhttp::response res(200, trent_to_json(scene->scene_data()));
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
+    // REST API: Joint order and hash of binary joint frames
+    CROW_ROUTE(app, "/api/joint_schema")
+    ([](const crowhttp::request &req)
+     {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        std::lock_guard<std::mutex> lock(robot->mutex);
+        crowhttp::response res(200, trent_to_json(robot->joint_schema.to_trent()));
+        res.set_header("Content-Type", "application/json");
+        return res; });
 
-        fs::path model_path = g_k3d_loader->get_model_path(filename);
-        if (model_path.empty())
+    // REST API: Forward kinematics for many joint configurations (format in
+    // src/fk_batch.hpp). Evaluated on a copy of the flat tree outside the writer lock.
+    CROW_ROUTE(app, "/api/fk/batch").methods("POST"_method)([](const crowhttp::request &req)
+                                                            {
+        auto error_response = [](int code, const std::string &message)
+        {
+            nos::trent error;
+            error.init(nos::trent::type::dict);
+            error["error"] = message;
+            crowhttp::response res(code, trent_to_json(error));
+            res.set_header("Content-Type", "application/json");
+            return res;
+        };
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+
+        bool binary_request = webkin::is_fk_batch_binary(req.body);
+        nos::trent body;
+        if (!binary_request)
+            body = nos::json::parse(req.body);
+
+        webkin::FkBatch batch;
+        webkin::FlatTree flat;
+        std::vector<std::string> names;
+        std::string error;
         {
-            return crowhttp::response(404, "Model not found: " + filename);
+            std::lock_guard<std::mutex> lock(robot->mutex);
+            bool ok = binary_request ? webkin::decode_fk_batch(req.body, robot->joint_schema, batch, error)
+                                     : webkin::decode_fk_batch(body, robot->tree, batch, error);
+            if (!ok)
+                return error_response(400, error);
+            if (batch.count * robot->tree.flat.size() > webkin::FK_BATCH_MAX_POSES)
+                return error_response(413, "Batch too large");
+            flat = robot->tree.flat;
+            for (const auto *node : robot->tree.nodes)
+                names.emplace_back(node->name);
         }
 
-        std::string content = read_file(model_path);
-        if (content.empty())
+        std::vector<webkin::Pose> poses(batch.count * flat.size());
+        flat.evaluate_batch(batch.joints, batch.coords.data(), batch.count, poses.data());
+
+        if (binary_request || req.get_header_value("Accept").find("application/octet-stream") != std::string::npos)
         {
-            return crowhttp::response(404, "Failed to read model");
+            crowhttp::response res(200, webkin::encode_fk_poses(poses, batch.count, flat.size()));
+            res.set_header("Content-Type", "application/octet-stream");
+            return res;
         }
+        crowhttp::response res(200, trent_to_json(webkin::fk_poses_to_trent(poses, batch.count, names)));
+        res.set_header("Content-Type", "application/json");
+        return res; });
 
-        crowhttp::response res(200, content);
-        res.set_header("Content-Type", "application/octet-stream");
+    // REST API: Joint history window, ?from=&to= (ms, <= 0 relative to the
+    // newest frame) and ?points= (decimation target, 0 = all frames)
+    CROW_ROUTE(app, "/api/history")
+    ([](const crowhttp::request &req)
+     {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        size_t points;
+        if (!history_points(*robot, param_or(req, "points", default_history_points(*robot)), points))
+            return crowhttp::response(400, "{\"error\": \"points must be in [0, " +
+                                               std::to_string(robot->history.capacity()) + "]\"}");
+        nos::trent history = robot->history.query(param_or(req, "from", -60000), param_or(req, "to", 0), points);
+        crowhttp::response res(200, trent_to_json(history));
+        res.set_header("Content-Type", "application/json");
         return res; });
 
-    // REST API: Get tree
-    CROW_ROUTE(app, "/api/tree")
-    ([]()
+    // REST API: Play a history window back through the broadcast path
+    CROW_ROUTE(app, "/api/history/play").methods("POST"_method)([](const crowhttp::request &req)
+                                                                {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+        nos::trent body = req.body.empty() ? nos::trent() : nos::json::parse(req.body);
+        nos::trent result = start_history_playback(*robot, body["from"].as_numer_default(-60000),
+                                                   body["to"].as_numer_default(0),
+                                                   body["speed"].as_numer_default(1));
+        crowhttp::response res(200, trent_to_json(result));
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
+    CROW_ROUTE(app, "/api/history/stop").methods("POST"_method)([](const crowhttp::request &req)
+                                                                {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        robot->player.stop();
+        crowhttp::response res(200, R"({"status": "ok"})");
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
+    // REST API: Replay transport state; times are ms from the first frame
+    CROW_ROUTE(app, "/api/replay")
+    ([&replay]()
      {
-        std::lock_guard<std::mutex> lock(g_mutex);
-        if (g_tree_data_json.is_nil()) {
-            return crowhttp::response(200, R"({"error": "No tree loaded"})");
+        nos::trent state;
+        state.init(nos::trent::type::dict);
+        state["active"] = replay.is_connected();
+        state["frames"] = static_cast<double>(replay.frames());
+        state["duration_ms"] = replay.end_time() - replay.start_time();
+        state["position_ms"] = replay.is_connected() ? replay.position() - replay.start_time() : 0.0;
+        crowhttp::response res(200, trent_to_json(state));
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
+    // REST API: Seek the replay, {"offset_ms": ms from the first frame}
+    CROW_ROUTE(app, "/api/replay/seek").methods("POST"_method)([&replay](const crowhttp::request &req)
+                                                               {
+        nos::trent body = nos::json::parse(req.body);
+        if (!replay.is_connected())
+        {
+            crowhttp::response res(409, R"({"error": "Replay is not running"})");
+            res.set_header("Content-Type", "application/json");
+            return res;
         }
-        crowhttp::response res(200, trent_to_json(g_tree_data_json));
+        replay.seek(replay.start_time() + body["offset_ms"].as_numer_default(0));
+        crowhttp::response res(200, R"({"status": "ok"})");
         res.set_header("Content-Type", "application/json");
         return res; });
 
-    // REST API: Get scene
-    CROW_ROUTE(app, "/api/scene")
+    // Trace spans of the last ?seconds= (default 10) as Chrome trace-event
+    // JSON. Without --trace, records for that long first; the response is
+    // finished by a timer, so the connection's thread keeps serving.
+    CROW_ROUTE(app, "/debug/trace")
+    ([](const crowhttp::request &req, crowhttp::response &res)
+     {
+        double seconds = 10;
+        if (const char *s = req.url_params.get("seconds"))
+            seconds = std::atof(s);
+        if (!(seconds > 0 && seconds <= 60))
+        {
+            res = crowhttp::response(400, "seconds must be in (0, 60]");
+            res.end();
+            return;
+        }
+        auto finish = [&res, seconds]()
+        {
+            res.body = webkin::trace::chrome_json(seconds * 1000);
+            res.set_header("Content-Type", "application/json");
+            res.end();
+        };
+        if (g_trace)
+        {
+            finish();
+            return;
+        }
+        webkin::trace::retain();
+        auto timer = std::make_shared<asio::steady_timer>(
+            *req.io_context, std::chrono::duration_cast<asio::steady_timer::duration>(
+                                 std::chrono::duration<double>(seconds)));
+        timer->async_wait([timer, finish](const auto &)
+                          {
+            webkin::trace::release();
+            finish(); }); });
+
+    // Prometheus metrics of all robots
+    CROW_ROUTE(app, "/metrics")
     ([]()
      {
-        std::lock_guard<std::mutex> lock(g_mutex);
-        nos::trent scene = g_tree.get_scene_data();
-        crowhttp::response res(200, trent_to_json(scene));
+        crowhttp::response res(200, g_metrics.render());
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res; });
+
+    // REST API: Connected WebSocket clients and their send queues
+    CROW_ROUTE(app, "/api/clients")
+    ([](const crowhttp::request &req)
+     {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        std::lock_guard<std::mutex> lock(robot->clients_mutex);
+        nos::trent clients;
+        clients.init(nos::trent::type::list);
+        for (const auto &[conn, info] : robot->clients)
+        {
+            nos::trent client;
+            client.init(nos::trent::type::dict);
+            client["address"] = conn->get_remote_ip();
+            client["binary"] = info.binary;
+            client["queued_bytes"] = static_cast<double>(conn->queued_bytes());
+            client["dropped_frames"] = static_cast<double>(conn->dropped_frames());
+            if (info.latency)
+                client["latency"] = info.latency->to_trent();
+            clients.push_back(std::move(client));
+        }
+        nos::trent response;
+        response.init(nos::trent::type::dict);
+        response["clients"] = std::move(clients);
+        crowhttp::response res(200, trent_to_json(response));
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
+    // REST API: Links closer than the --proximity distance
+    CROW_ROUTE(app, "/api/proximity")
+    ([](const crowhttp::request &req)
+     {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        auto proximity = robot->proximity.current();
+        if (!proximity)
+            return crowhttp::response(404, "Proximity checking is off (--proximity)");
+        crowhttp::response res(200, proximity->json);
         res.set_header("Content-Type", "application/json");
         return res; });
 
     // REST API: Set joints
     CROW_ROUTE(app, "/api/joints").methods("POST"_method)([](const crowhttp::request &req)
                                                           {
-        std::lock_guard<std::mutex> lock(g_mutex);
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+        {
+            // Joints are the primary's; the new poses come back from there
+            nos::trent message;
+            message["type"] = "joint_update";
+            message["joints"] = nos::json::parse(req.body);
+            if (!robot->relay.forward(trent_to_json(message)))
+                return crowhttp::response(503, R"({"error": "Primary unreachable"})");
+            crowhttp::response res(200, R"({"status": "ok"})");
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
+        if (!nos::json::parse(req.body).is_dict())
+            return crowhttp::response(400, R"({"error": "Expected {\"name\": value, ...}"})");
+        // Applied by the compute thread in order with the other transports
+        std::string payload = R"({"joints":)" + req.body + "}";
+        if (!robot->ingest.push(payload, now_ms()))
+            return crowhttp::response(503, R"({"error": "Ingest queue full"})");
+
+        crowhttp::response res(200, R"({"status": "ok"})");
+        res.set_header("Content-Type", "application/json");
+        return res; });
 
+    // REST API: Set joints from a batch of timestamped frames,
+    // {"frames": [{"ts": ms, "joints": {...}}, ...]}: all go to the history,
+    // the latest is computed and broadcast once
+    CROW_ROUTE(app, "/api/joints/batch").methods("POST"_method)([](const crowhttp::request &req)
+                                                                {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
         nos::trent body = nos::json::parse(req.body);
-        std::map<std::string, double> joints;
+        const nos::trent &frames = std::as_const(body)["frames"];
+        if (!frames.is_list())
+            return crowhttp::response(400, R"({"error": "Expected {\"frames\": [...]}"})");
+        if (robot->relay.is_running())
+        {
+            body["type"] = "joint_batch";
+            if (!robot->relay.forward(trent_to_json(body)))
+                return crowhttp::response(503, R"({"error": "Primary unreachable"})");
+            crowhttp::response res(200, R"({"status": "ok"})");
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
 
-        if (body.is_dict()) {
-            for (const auto& [name, value] : body.as_dict()) {
-                joints[name] = value.as_numer_default(0);
+        size_t applied;
+        {
+            std::lock_guard<std::mutex> lock(robot->mutex);
+            webkin::JointStamp stamp;
+            applied = apply_joint_frames(*robot, frames, stamp);
+            if (applied)
+            {
+                webkin::SceneTrace trace;
+                trace.ingest_ts = now_ms();
+                trace.source_ts = stamp.source_ts;
+                trace.seq = stamp.seq;
+                commit_joint_update(*robot, trace, true);
             }
         }
 
-        g_tree.set_joint_coords(joints);
-        g_tree.update();
-        broadcast_scene_update();
-
-        crowhttp::response res(200, R"({"status": "ok"})");
+        nos::trent response;
+        response.init(nos::trent::type::dict);
+        response["status"] = "ok";
+        response["frames"] = static_cast<double>(applied);
+        crowhttp::response res(200, trent_to_json(response));
         res.set_header("Content-Type", "application/json");
         return res; });
 
     // REST API: Load tree
-    CROW_ROUTE(app, "/api/tree").methods("POST"_method)([](const crowhttp::request &req)
-                                                        {
-        std::lock_guard<std::mutex> lock(g_mutex);
-
-        g_tree_data_json = nos::json::parse(req.body);
-        g_tree.load(g_tree_data_json);
-
-        nos::println("Loaded tree via REST: ", g_tree_data_json["name"].as_string_default("unnamed"));
-        nos::println("Joints: ");
-        for (const auto& name : g_tree.get_joint_names()) {
-            nos::println("  - ", name);
+    CROW_ROUTE(app, "/api/tree").methods("POST"_method).stream_body<TreeUpload>()([](const crowhttp::request &req)
+                                                                                  {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+
+        auto &upload = static_cast<TreeUpload &>(*req.body_stream);
+        if (!upload.parser.finish())
+        {
+            nos::trent error;
+            error.init(nos::trent::type::dict);
+            error["error"] = "Bad tree JSON: " + upload.parser.error();
+            crowhttp::response res(400, trent_to_json(error));
+            res.set_header("Content-Type", "application/json");
+            return res;
         }
 
-        broadcast_scene_init();
+        // Built on this thread, only the swap takes the writer lock
+        LoadedTree loaded;
+        loaded.data = std::move(upload.parser.result());
+        prepare_tree(*robot, loaded);
 
         nos::trent response;
         response.init(nos::trent::type::dict);
         response["status"] = "ok";
-        response["joints"] = g_tree.get_joint_names_trent();
+        response["joints"] = loaded.tree.get_joint_names_trent();
+
+        install_tree(*robot, loaded, "REST");
 
         crowhttp::response res(200, trent_to_json(response));
         res.set_header("Content-Type", "application/json");
         return res; });
 
+    // REST API: Load a .k3d archive, the request body, in the background.
+    // Clients get a scene_init once it is swapped in; GET /api/k3d tells
+    // the progress.
+    CROW_ROUTE(app, "/api/k3d").methods("POST"_method)([](const crowhttp::request &req)
+                                                       {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+        if (req.body.empty())
+        {
+            crowhttp::response res(400, R"({"error": "Expected a .k3d archive as the body"})");
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }
+        robot->loader.load_archive(req.body);
+        crowhttp::response res(202, R"({"status": "loading"})");
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
+    // REST API: State of background tree loading
+    CROW_ROUTE(app, "/api/k3d")
+    ([](const crowhttp::request &req)
+     {
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        webkin::tree_loader::state state = robot->loader.status();
+        auto models = robot->k3d_loader.load();
+        nos::trent result;
+        result.init(nos::trent::type::dict);
+        result["source"] = state.source;
+        result["loading"] = state.loading;
+        result["loads"] = static_cast<double>(state.loads);
+        result["watching"] = g_watch && !robot->tree_file.empty();
+        result["models"] = static_cast<double>(models ? models->model_count() : 0);
+        if (!state.error.empty())
+            result["error"] = state.error;
+        crowhttp::response res(200, trent_to_json(result));
+        res.set_header("Content-Type", "application/json");
+        return res; });
+
     // REST API: Set zero offset for a joint
     CROW_ROUTE(app, "/api/offset/set_zero").methods("POST"_method)([](const crowhttp::request &req)
                                                                    {
-        std::lock_guard<std::mutex> lock(g_mutex);
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+        std::lock_guard<std::mutex> lock(robot->mutex);
 
         nos::trent body = nos::json::parse(req.body);
         std::string joint_name = body["joint_name"].as_string_default("");
@@ -777,8 +3112,8 @@ int main(int argc, char *argv[])
             return res;
         }
 
-        auto it = g_tree.joints.find(joint_name);
-        if (it == g_tree.joints.end())
+        webkin::KinematicNode *joint = robot->tree.find_joint(joint_name);
+        if (!joint)
         {
             crowhttp::response res(404, R"({"error": "Joint not found"})");
             res.set_header("Content-Type", "application/json");
@@ -786,13 +3121,15 @@ int main(int argc, char *argv[])
         }
 
         // Set offset so that current position becomes zero
-        double new_offset = -it->second->coord;
-        g_axis_overrides[joint_name]["axis_offset"] = new_offset;
-        it->second->axis_offset = new_offset;
+        double new_offset = -joint->coord;
+        robot->axis_overrides[joint_name]["axis_offset"] = new_offset;
+        joint->axis_offset = new_offset;
+        robot->tree.refresh_joint(joint);
+        robot->scene.invalidate_joints_info();
 
-        save_axis_overrides();
-        g_tree.update();
-        broadcast_scene_update();
+        save_axis_overrides(*robot);
+        robot->tree.update();
+        publish_scene_update(*robot);
 
         nos::trent response;
         response.init(nos::trent::type::dict);
@@ -807,7 +3144,12 @@ int main(int argc, char *argv[])
     // REST API: Set axis override (POST /api/axis/override)
     CROW_ROUTE(app, "/api/axis/override").methods("POST"_method)([](const crowhttp::request &req)
                                                                  {
-        std::lock_guard<std::mutex> lock(g_mutex);
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+        std::lock_guard<std::mutex> lock(robot->mutex);
 
         nos::trent body = nos::json::parse(req.body);
         std::string joint_name = body["joint_name"].as_string_default("");
@@ -819,8 +3161,8 @@ int main(int argc, char *argv[])
             return res;
         }
 
-        auto it = g_tree.joints.find(joint_name);
-        if (it == g_tree.joints.end())
+        webkin::KinematicNode *joint = robot->tree.find_joint(joint_name);
+        if (!joint)
         {
             crowhttp::response res(404, R"({"error": "Joint not found"})");
             res.set_header("Content-Type", "application/json");
@@ -831,35 +3173,37 @@ int main(int argc, char *argv[])
         if (body["axis_offset"].is_numer())
         {
             double val = body["axis_offset"].as_numer();
-            g_axis_overrides[joint_name]["axis_offset"] = val;
-            it->second->axis_offset = val;
+            robot->axis_overrides[joint_name]["axis_offset"] = val;
+            joint->axis_offset = val;
             nos::println("Set axis_offset for ", joint_name, " = ", val);
         }
         if (body["axis_scale"].is_numer())
         {
             double val = body["axis_scale"].as_numer();
-            g_axis_overrides[joint_name]["axis_scale"] = val;
-            it->second->axis_scale = val;
+            robot->axis_overrides[joint_name]["axis_scale"] = val;
+            joint->axis_scale = val;
             nos::println("Set axis_scale for ", joint_name, " = ", val);
         }
         if (body["slider_min"].is_numer())
         {
             double val = body["slider_min"].as_numer();
-            g_axis_overrides[joint_name]["slider_min"] = val;
-            it->second->slider_min = val;
+            robot->axis_overrides[joint_name]["slider_min"] = val;
+            joint->slider_min = val;
             nos::println("Set slider_min for ", joint_name, " = ", val);
         }
         if (body["slider_max"].is_numer())
         {
             double val = body["slider_max"].as_numer();
-            g_axis_overrides[joint_name]["slider_max"] = val;
-            it->second->slider_max = val;
+            robot->axis_overrides[joint_name]["slider_max"] = val;
+            joint->slider_max = val;
             nos::println("Set slider_max for ", joint_name, " = ", val);
         }
+        robot->tree.refresh_joint(joint);
+        robot->scene.invalidate_joints_info();
 
-        save_axis_overrides();
-        g_tree.update();
-        broadcast_scene_update();
+        save_axis_overrides(*robot);
+        robot->tree.update();
+        publish_scene_update(*robot);
         nos::println("Applied axis override for ", joint_name, ", broadcasted update");
 
         nos::trent response;
@@ -873,13 +3217,16 @@ int main(int argc, char *argv[])
 
     // REST API: Get axis overrides
     CROW_ROUTE(app, "/api/axis/overrides")
-    ([]()
+    ([](const crowhttp::request &req)
      {
-        std::lock_guard<std::mutex> lock(g_mutex);
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        std::lock_guard<std::mutex> lock(robot->mutex);
 
         nos::trent overrides;
         overrides.init(nos::trent::type::dict);
-        for (const auto &[name, params] : g_axis_overrides)
+        for (const auto &[name, params] : robot->axis_overrides)
         {
             nos::trent joint_params;
             joint_params.init(nos::trent::type::dict);
@@ -899,56 +3246,52 @@ int main(int argc, char *argv[])
         return res; });
 
     // REST API: Clear all axis overrides
-    CROW_ROUTE(app, "/api/axis/overrides").methods("DELETE"_method)([]()
+    CROW_ROUTE(app, "/api/axis/overrides").methods("DELETE"_method)([](const crowhttp::request &req)
                                                                     {
-        std::lock_guard<std::mutex> lock(g_mutex);
-
-        g_axis_overrides.clear();
-        save_axis_overrides();
-
-        // Reload tree to restore original values
-        if (!g_tree_data_json.is_nil())
-        {
-            g_tree.load(g_tree_data_json);
-            g_tree.update();
-            broadcast_scene_update();
-        }
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+        std::lock_guard<std::mutex> lock(robot->mutex);
+
+        robot->axis_overrides.clear();
+        save_axis_overrides(*robot);
+
+        // Restore the loaded values in place; coordinates are kept
+        robot->tree.reset_axes();
+        robot->tree.update();
+        robot->scene.invalidate_joints_info();
+        publish_scene_update(*robot);
 
         crowhttp::response res(200, R"({"status": "ok"})");
         res.set_header("Content-Type", "application/json");
         return res; });
 
     // REST API: Clear axis overrides for specific joint
-    CROW_ROUTE(app, "/api/axis/overrides/<string>").methods("DELETE"_method)([](const std::string &joint_name)
+    CROW_ROUTE(app, "/api/axis/overrides/<string>").methods("DELETE"_method)([](const crowhttp::request &req,
+                                                                                 const std::string &joint_name)
                                                                               {
-        std::lock_guard<std::mutex> lock(g_mutex);
-
-        auto it = g_axis_overrides.find(joint_name);
-        if (it != g_axis_overrides.end())
+        Robot *robot = robot_for(req);
+        if (!robot)
+            return unknown_robot_response();
+        if (robot->relay.is_running())
+            return relayed_response(*robot);
+        std::lock_guard<std::mutex> lock(robot->mutex);
+
+        auto it = robot->axis_overrides.find(joint_name);
+        if (it != robot->axis_overrides.end())
         {
-            g_axis_overrides.erase(it);
-            save_axis_overrides();
+            robot->axis_overrides.erase(it);
+            save_axis_overrides(*robot);
 
             // Restore original values
-            if (!g_tree_data_json.is_nil())
+            if (auto *joint = robot->tree.find_joint(joint_name))
             {
-                auto joint_it = g_tree.joints.find(joint_name);
-                if (joint_it != g_tree.joints.end())
-                {
-                    nos::trent original = find_original_axis_params(g_tree_data_json, joint_name);
-                    if (!original.is_nil())
-                    {
-                        joint_it->second->axis_offset = original["axis_offset"].as_numer_default(0.0);
-                        joint_it->second->axis_scale = original["axis_scale"].as_numer_default(1.0);
-                        std::string jtype = joint_it->second->type;
-                        double default_min = (jtype == "actuator") ? -1000.0 : -180.0;
-                        double default_max = (jtype == "actuator") ? 1000.0 : 180.0;
-                        joint_it->second->slider_min = original["slider_min"].as_numer_default(default_min);
-                        joint_it->second->slider_max = original["slider_max"].as_numer_default(default_max);
-                        g_tree.update();
-                        broadcast_scene_update();
-                    }
-                }
+                robot->tree.reset_axis(joint);
+                robot->scene.invalidate_joints_info();
+                robot->tree.update();
+                publish_scene_update(*robot);
             }
         }
 
@@ -956,57 +3299,63 @@ int main(int argc, char *argv[])
         res.set_header("Content-Type", "application/json");
         return res; });
 
-    // WebSocket endpoint
-    CROW_WEBSOCKET_ROUTE(app, "/ws")
-        .onopen([](crowhttp::websocket::connection &conn)
-                {
-            std::lock_guard<std::mutex> lock(g_mutex);
-            g_clients.insert(&conn);
-            nos::println("Client connected. Total: ", g_clients.size());
-
-            // Send initial scene state
-            std::string msg = trent_to_json(make_scene_init_message());
-            conn.send_text(msg); })
-        .onclose([](crowhttp::websocket::connection &conn, const std::string &reason, uint16_t code)
-                 {
-            (void)reason;
-            (void)code;
-            std::lock_guard<std::mutex> lock(g_mutex);
-            g_clients.erase(&conn);
-            nos::println("Client disconnected. Total: ", g_clients.size()); })
-        .onmessage([](crowhttp::websocket::connection &conn, const std::string &data, bool is_binary)
-                   {
-            (void)conn;
-            if (is_binary) return;
-
-            std::lock_guard<std::mutex> lock(g_mutex);
-
-            nos::trent message = nos::json::parse(data);
-            std::string msg_type = message["type"].as_string_default("");
+    // REST API: Hosted robots
+    CROW_ROUTE(app, "/api/robots")
+    ([]()
+     {
+        nos::trent robots;
+        robots.init(nos::trent::type::list);
+        for (const auto &[id, robot] : g_robots)
+        {
+            nos::trent entry;
+            entry.init(nos::trent::type::dict);
+            entry["id"] = id;
+            entry["topic"] = robot->topic;
+            entry["default"] = robot.get() == g_default_robot;
+            entry["joints"] = static_cast<double>(robot->scene.current()->layout->joint_names.as_list().size());
+            {
+                std::lock_guard<std::mutex> lock(robot->clients_mutex);
+                entry["clients"] = static_cast<double>(robot->clients.size());
+            }
+            robots.push_back(std::move(entry));
+        }
+        nos::trent response;
+        response.init(nos::trent::type::dict);
+        response["robots"] = std::move(robots);
+        crowhttp::response res(200, trent_to_json(response));
+        res.set_header("Content-Type", "application/json");
+        return res; });
 
-            if (msg_type == "joint_update") {
-                const auto& joints_data = message["joints"];
-                if (joints_data.is_dict()) {
-                    std::map<std::string, double> joints;
-                    for (const auto& [name, value] : joints_data.as_dict()) {
-                        joints[name] = value.as_numer_default(0);
-                    }
-                    g_tree.set_joint_coords(joints);
-                    g_tree.update();
-                    broadcast_scene_update();
-                }
-            } });
+    // WebSocket endpoints: /ws for the default robot, /ws/<id> for every robot
+    add_ws_route(app, "/ws", *g_default_robot);
+    for (auto &[id, robot] : g_robots)
+    {
+        add_ws_route(app, "/ws/" + id, *robot);
+    }
 
     nos::println("");
     nos::println("Server starting on http://", host, ":", port);
     nos::println("Press Ctrl+C to stop.");
     nos::println("");
 
+    register_route_metrics(app);
     app.bindaddr(host).port(port).multithreaded().run();
 
     // Cleanup
-    mqtt.disconnect();
-    crow.disconnect();
+    replay.disconnect();
+    for (auto &[id, robot] : g_robots)
+    {
+        robot->loader.stop();
+        robot->relay.disconnect();
+        robot->pose_out.stop();
+        robot->mqtt.disconnect();
+        robot->crow.disconnect();
+        robot->ingest.stop();
+        robot->player.stop();
+        robot->broadcaster.stop();
+        robot->recorder.close();
+    }
+    g_config_writer.flush();
 
     nos::println("Goodbye!");
     return 0;
@@ -0,0 +1,337 @@
+/**
+ * STL parsing, vertex indexing, clustering decimation and WKM1 encoding
+ */
+
+#include "mesh_lod.hpp"
+#include "fnv.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <unordered_map>
+#include <unordered_set>
+
+static_assert(std::endian::native == std::endian::little,
+              "meshes are encoded by memcpy and require a little-endian host");
+
+namespace webkin
+{
+
+namespace
+{
+    constexpr size_t STL_HEADER_SIZE = 84;
+    constexpr size_t STL_TRIANGLE_SIZE = 50;
+
+    struct Bounds
+    {
+        std::array<float, 3> min{0, 0, 0};
+        std::array<float, 3> max{0, 0, 0};
+    };
+
+    Bounds bounds_of(const std::vector<float> &xyz)
+    {
+        Bounds b;
+        if (xyz.empty())
+            return b;
+        b.min = b.max = {xyz[0], xyz[1], xyz[2]};
+        for (size_t i = 0; i < xyz.size(); i += 3)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                b.min[a] = std::min(b.min[a], xyz[i + a]);
+                b.max[a] = std::max(b.max[a], xyz[i + a]);
+            }
+        }
+        return b;
+    }
+
+    bool parse_binary_stl(std::string_view data, std::vector<float> &triangles)
+    {
+        uint32_t count;
+        std::memcpy(&count, data.data() + 80, 4);
+        triangles.resize(size_t(count) * 9);
+        for (size_t t = 0; t < count; ++t)
+        {
+            // Skip the stored facet normal, it is recomputed
+            const char *p = data.data() + STL_HEADER_SIZE + t * STL_TRIANGLE_SIZE + 12;
+            std::memcpy(triangles.data() + t * 9, p, 36);
+        }
+        return true;
+    }
+
+    bool parse_ascii_stl(std::string_view data, std::vector<float> &triangles)
+    {
+        triangles.clear();
+        const char *end = data.data() + data.size();
+        for (size_t pos = data.find("vertex"); pos != std::string_view::npos; pos = data.find("vertex", pos))
+        {
+            pos += 6;
+            const char *p = data.data() + pos;
+            for (int a = 0; a < 3; ++a)
+            {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                    ++p;
+                float value;
+                auto [next, ec] = std::from_chars(p, end, value);
+                if (ec != std::errc())
+                    return false;
+                triangles.push_back(value);
+                p = next;
+            }
+            pos = p - data.data();
+        }
+        return !triangles.empty() && triangles.size() % 9 == 0;
+    }
+
+    // Face normal scaled by twice the triangle area
+    std::array<float, 3> face_normal(const float *a, const float *b, const float *c)
+    {
+        float ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+        float vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+        return {uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx};
+    }
+
+    float length(const std::array<float, 3> &v)
+    {
+        return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+
+    template <class T> void append(std::string &out, const T *values, size_t count)
+    {
+        out.append(reinterpret_cast<const char *>(values), count * sizeof(T));
+    }
+}
+
+bool parse_stl(std::string_view data, std::vector<float> &triangles)
+{
+    // Binary files may start with "solid" too, so the size decides first
+    if (data.size() >= STL_HEADER_SIZE)
+    {
+        uint32_t count;
+        std::memcpy(&count, data.data() + 80, 4);
+        if (data.size() == STL_HEADER_SIZE + size_t(count) * STL_TRIANGLE_SIZE)
+            return parse_binary_stl(data, triangles);
+    }
+    return parse_ascii_stl(data, triangles);
+}
+
+IndexedMesh index_triangles(const std::vector<float> &triangles, float crease_deg)
+{
+    IndexedMesh mesh;
+    if (triangles.empty())
+        return mesh;
+
+    // Positions are merged on a 21-bit grid over the bounding box, which
+    // absorbs float noise between corners written separately
+    const Bounds b = bounds_of(triangles);
+    float extent = std::max({b.max[0] - b.min[0], b.max[1] - b.min[1], b.max[2] - b.min[2]});
+    const float inv = extent > 0 ? float((1u << 21) - 1) / extent : 0;
+    auto key_of = [&](const float *p)
+    {
+        uint64_t key = 0;
+        for (int a = 0; a < 3; ++a)
+            key = (key << 21) | uint64_t(std::lround((p[a] - b.min[a]) * inv));
+        return key;
+    };
+
+    const float cos_crease = std::cos(crease_deg * std::numbers::pi_v<float> / 180);
+    std::unordered_map<uint64_t, uint32_t> first; // Position key -> first vertex there
+    std::vector<uint32_t> next;                   // Next vertex at the same position
+    std::vector<std::array<float, 3>> reference;  // Unit normal of the face that created the vertex
+    const size_t count = triangles.size() / 9;
+    first.reserve(count);
+    mesh.indices.reserve(count * 3);
+
+    for (size_t t = 0; t < count; ++t)
+    {
+        const float *corner[3] = {&triangles[t * 9], &triangles[t * 9 + 3], &triangles[t * 9 + 6]};
+        uint64_t keys[3] = {key_of(corner[0]), key_of(corner[1]), key_of(corner[2])};
+        if (keys[0] == keys[1] || keys[1] == keys[2] || keys[0] == keys[2])
+            continue;
+        std::array<float, 3> n = face_normal(corner[0], corner[1], corner[2]);
+        float len = length(n);
+        if (!(len > 0))
+            continue;
+        std::array<float, 3> unit = {n[0] / len, n[1] / len, n[2] / len};
+
+        for (int c = 0; c < 3; ++c)
+        {
+            auto [it, inserted] = first.try_emplace(keys[c], UINT32_MAX);
+            uint32_t v = it->second;
+            uint32_t last = UINT32_MAX;
+            for (; v != UINT32_MAX; last = v, v = next[v])
+            {
+                const auto &r = reference[v];
+                if (r[0] * unit[0] + r[1] * unit[1] + r[2] * unit[2] >= cos_crease)
+                    break;
+            }
+            if (v == UINT32_MAX)
+            {
+                v = static_cast<uint32_t>(next.size());
+                next.push_back(UINT32_MAX);
+                reference.push_back(unit);
+                mesh.positions.insert(mesh.positions.end(), corner[c], corner[c] + 3);
+                mesh.normals.insert(mesh.normals.end(), {0.0f, 0.0f, 0.0f});
+                if (last == UINT32_MAX)
+                    it->second = v;
+                else
+                    next[last] = v;
+            }
+            // Area weighted, so slivers do not tilt the vertex normal
+            for (int a = 0; a < 3; ++a)
+                mesh.normals[v * 3 + a] += n[a];
+            mesh.indices.push_back(v);
+        }
+    }
+
+    for (size_t v = 0; v < mesh.vertices(); ++v)
+    {
+        float *n = &mesh.normals[v * 3];
+        float len = length({n[0], n[1], n[2]});
+        for (int a = 0; a < 3; ++a)
+            n[a] = len > 0 ? n[a] / len : reference[v][a];
+    }
+    return mesh;
+}
+
+std::vector<float> cluster_triangles(const IndexedMesh &mesh, uint32_t cells)
+{
+    std::vector<float> soup;
+    if (mesh.indices.empty() || cells == 0)
+        return soup;
+
+    const Bounds b = bounds_of(mesh.positions);
+    float extent = std::max({b.max[0] - b.min[0], b.max[1] - b.min[1], b.max[2] - b.min[2]});
+    const float inv = extent > 0 ? cells / extent : 0;
+    auto cell_of = [&](const float *p)
+    {
+        uint64_t key = 0;
+        for (int a = 0; a < 3; ++a)
+            key = (key << 21) | uint64_t(std::min<float>((p[a] - b.min[a]) * inv, cells - 1));
+        return key;
+    };
+
+    // Every vertex moves to the mean of its cell
+    std::unordered_map<uint64_t, uint32_t> cluster_of;
+    std::vector<uint32_t> cluster(mesh.vertices());
+    std::vector<double> sum;
+    std::vector<uint32_t> members;
+    for (size_t v = 0; v < mesh.vertices(); ++v)
+    {
+        const float *p = &mesh.positions[v * 3];
+        auto [it, inserted] = cluster_of.try_emplace(cell_of(p), static_cast<uint32_t>(members.size()));
+        if (inserted)
+        {
+            sum.insert(sum.end(), {0.0, 0.0, 0.0});
+            members.push_back(0);
+        }
+        uint32_t c = it->second;
+        cluster[v] = c;
+        for (int a = 0; a < 3; ++a)
+            sum[c * 3 + a] += p[a];
+        ++members[c];
+    }
+
+    // Collapsed triangles vanish; coincident ones are kept once per winding
+    std::unordered_set<uint64_t> seen;
+    for (size_t t = 0; t < mesh.triangles(); ++t)
+    {
+        uint32_t c[3] = {cluster[mesh.indices[t * 3]], cluster[mesh.indices[t * 3 + 1]],
+                         cluster[mesh.indices[t * 3 + 2]]};
+        if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2])
+            continue;
+        int lowest = c[0] < c[1] ? (c[0] < c[2] ? 0 : 2) : (c[1] < c[2] ? 1 : 2);
+        uint64_t key = 0;
+        for (int k = 0; k < 3; ++k)
+            key = (key << 21) | c[(lowest + k) % 3];
+        if (members.size() < (1u << 21) && !seen.insert(key).second)
+            continue;
+        for (uint32_t v : c)
+            for (int a = 0; a < 3; ++a)
+                soup.push_back(static_cast<float>(sum[v * 3 + a] / members[v]));
+    }
+    return soup;
+}
+
+std::string encode_mesh(const IndexedMesh &mesh)
+{
+    const Bounds b = bounds_of(mesh.positions);
+    float step[3];
+    for (int a = 0; a < 3; ++a)
+        step[a] = (b.max[a] - b.min[a]) / 65535;
+
+    const uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices());
+    const uint32_t index_count = static_cast<uint32_t>(mesh.indices.size());
+    const uint32_t flags = vertex_count > 0xffff ? MESH_FLAG_INDEX32 : 0;
+
+    std::string out;
+    out.reserve(MESH_HEADER_SIZE + vertex_count * 12 + index_count * (flags ? 4 : 2));
+    out.append(MESH_MAGIC, 4);
+    append(out, &vertex_count, 1);
+    append(out, &index_count, 1);
+    append(out, &flags, 1);
+    append(out, b.min.data(), 3);
+    append(out, step, 3);
+
+    std::vector<uint16_t> q(mesh.positions.size());
+    for (size_t i = 0; i < q.size(); ++i)
+    {
+        int a = i % 3;
+        q[i] = step[a] > 0 ? static_cast<uint16_t>(std::lround((mesh.positions[i] - b.min[a]) / step[a])) : 0;
+    }
+    append(out, q.data(), q.size());
+
+    std::vector<int16_t> n(mesh.normals.size());
+    for (size_t i = 0; i < n.size(); ++i)
+        n[i] = static_cast<int16_t>(std::lround(std::clamp(mesh.normals[i], -1.0f, 1.0f) * 32767));
+    append(out, n.data(), n.size());
+
+    if (flags & MESH_FLAG_INDEX32)
+    {
+        append(out, mesh.indices.data(), mesh.indices.size());
+    }
+    else
+    {
+        std::vector<uint16_t> idx(mesh.indices.begin(), mesh.indices.end());
+        append(out, idx.data(), idx.size());
+    }
+    return out;
+}
+
+std::vector<MeshLod> build_mesh_lods(std::string_view stl)
+{
+    std::vector<MeshLod> lods;
+    std::vector<float> triangles;
+    if (!parse_stl(stl, triangles))
+        return lods;
+
+    IndexedMesh full = index_triangles(triangles);
+    if (full.indices.empty())
+        return lods;
+
+    auto add = [&lods](const IndexedMesh &mesh)
+    {
+        MeshLod lod;
+        lod.data = encode_mesh(mesh);
+        lod.triangles = static_cast<uint32_t>(mesh.triangles());
+        lod.hash = hash_hex(fnv1a64(lod.data));
+        lods.push_back(std::move(lod));
+    };
+    add(full);
+
+    // Coarser grids over the full mesh; a level must save at least 40%
+    for (uint32_t cells : {48u, 12u})
+    {
+        IndexedMesh coarse = index_triangles(cluster_triangles(full, cells));
+        if (coarse.indices.empty() || coarse.triangles() > lods.back().triangles * 0.6)
+            continue;
+        add(coarse);
+    }
+    return lods;
+}
+
+} // namespace webkin
@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * STL preprocessing into compact indexed meshes with levels of detail.
+ *
+ * STL files (binary or ASCII) are triangle soups: every corner repeats
+ * its position and there is no vertex sharing. build_mesh_lods() turns
+ * one into shared vertices with smooth normals, split only across creases
+ * so hard edges stay hard, and derives coarser levels by vertex
+ * clustering on a grid. Each level is encoded as a WKM1 mesh:
+ *
+ *   char[4]  "WKM1"
+ *   uint32   vertex_count
+ *   uint32   index_count
+ *   uint32   flags           (bit 0: indices are uint32, else uint16)
+ *   float32  origin[3]
+ *   float32  step[3]         (position = origin + q * step)
+ *   uint16   q[3 * vertex_count]
+ *   int16    normal[3 * vertex_count]  (snorm, / 32767)
+ *   uint16/uint32 indices[index_count]
+ *
+ * All values are little-endian. The header is 40 bytes and a vertex takes
+ * 12, so every array is aligned to its element size and clients can view
+ * the payload with typed arrays directly.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+constexpr const char *MESH_MAGIC = "WKM1";
+constexpr size_t MESH_HEADER_SIZE = 40;
+constexpr uint32_t MESH_FLAG_INDEX32 = 1;
+
+/// Parse a binary or ASCII STL into 9 floats per triangle.
+bool parse_stl(std::string_view data, std::vector<float> &triangles);
+
+struct IndexedMesh
+{
+    std::vector<float> positions; // xyz per vertex
+    std::vector<float> normals;   // Unit xyz per vertex
+    std::vector<uint32_t> indices;
+
+    size_t vertices() const { return positions.size() / 3; }
+    size_t triangles() const { return indices.size() / 3; }
+};
+
+/**
+ * Share vertices between triangles. Corners at one position whose faces
+ * differ by more than `crease_deg` get separate vertices. Degenerate
+ * triangles are dropped.
+ */
+IndexedMesh index_triangles(const std::vector<float> &triangles, float crease_deg = 60);
+
+/// Vertex clustering on a grid of `cells` along the longest side of the
+/// bounding box; returns the surviving triangles as a soup.
+std::vector<float> cluster_triangles(const IndexedMesh &mesh, uint32_t cells);
+
+/// Encode as WKM1 with 16-bit quantized positions and normals.
+std::string encode_mesh(const IndexedMesh &mesh);
+
+struct MeshLod
+{
+    std::string data;   // WKM1 mesh
+    uint32_t triangles = 0;
+    std::string hash;   // FNV-1a 64 of data, hex
+};
+
+/// Levels of detail of an STL file, finest first. Coarser levels are kept
+/// only if they have clearly fewer triangles. Empty if the STL is invalid.
+std::vector<MeshLod> build_mesh_lods(std::string_view stl);
+
+} // namespace webkin
@@ -0,0 +1,221 @@
+/**
+ * Metrics registry and Prometheus text rendering
+ */
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+
+namespace webkin
+{
+
+size_t Histogram::index(uint64_t ns)
+{
+    if (ns < SUB_COUNT)
+        return static_cast<size_t>(ns);
+    int exponent = 63 - std::countl_zero(ns);
+    if (exponent > MAX_EXPONENT)
+        return BUCKETS - 1;
+    size_t sub = (ns >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+    return static_cast<size_t>(exponent - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+uint64_t Histogram::lower(size_t index)
+{
+    if (index < SUB_COUNT)
+        return index;
+    size_t group = index / SUB_COUNT;
+    size_t sub = index % SUB_COUNT;
+    return (SUB_COUNT + sub) << (group - 1);
+}
+
+uint64_t Histogram::quantile(double q) const
+{
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return 0;
+
+    auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+    rank = std::clamp<uint64_t>(rank, 1, total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return lower(i) + (lower(i + 1) - lower(i)) / 2; // Bucket midpoint
+    }
+    return lower(BUCKETS - 1);
+}
+
+namespace
+{
+
+std::string render_labels(const MetricLabels &labels)
+{
+    std::string out;
+    for (const auto &[key, value] : labels)
+    {
+        if (!out.empty())
+            out += ',';
+        out += key;
+        out += "=\"";
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (c == '\n')
+                out += "\\n";
+            else
+                out += c;
+        }
+        out += '"';
+    }
+    return out;
+}
+
+void append_number(std::string &out, double value)
+{
+    if (!std::isfinite(value))
+    {
+        out += std::isnan(value) ? "NaN" : (value > 0 ? "+Inf" : "-Inf");
+        return;
+    }
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr);
+}
+
+void append_number(std::string &out, uint64_t value)
+{
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr);
+}
+
+void append_sample(std::string &out, const std::string &name, const char *suffix, const std::string &labels,
+                   const char *extra_label = nullptr)
+{
+    out += name;
+    out += suffix;
+    if (!labels.empty() || extra_label)
+    {
+        out += '{';
+        out += labels;
+        if (extra_label)
+        {
+            if (!labels.empty())
+                out += ',';
+            out += extra_label;
+        }
+        out += '}';
+    }
+    out += ' ';
+}
+
+} // namespace
+
+MetricsRegistry::Family &MetricsRegistry::family(const std::string &name, const std::string &help,
+                                                 const char *type)
+{
+    auto &f = _families[name];
+    if (f.type.empty())
+    {
+        f.help = help;
+        f.type = type;
+    }
+    return f;
+}
+
+void MetricsRegistry::add_counter(const std::string &name, const std::string &help, MetricLabels labels,
+                                  const Counter &counter)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Series s;
+    s.labels = render_labels(labels);
+    s.counter = &counter;
+    family(name, help, "counter").series.push_back(std::move(s));
+}
+
+void MetricsRegistry::add_histogram(const std::string &name, const std::string &help, MetricLabels labels,
+                                    const Histogram &histogram)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Series s;
+    s.labels = render_labels(labels);
+    s.histogram = &histogram;
+    family(name, help, "summary").series.push_back(std::move(s));
+}
+
+void MetricsRegistry::add_callback(const std::string &name, const std::string &help, const char *type,
+                                   MetricLabels labels, std::function<double()> value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Series s;
+    s.labels = render_labels(labels);
+    s.value = std::move(value);
+    family(name, help, type).series.push_back(std::move(s));
+}
+
+std::string MetricsRegistry::render() const
+{
+    static constexpr std::pair<double, const char *> QUANTILES[] = {
+        {0.5, "quantile=\"0.5\""},
+        {0.9, "quantile=\"0.9\""},
+        {0.99, "quantile=\"0.99\""},
+        {0.999, "quantile=\"0.999\""},
+    };
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::string out;
+    out.reserve(4096);
+    for (const auto &[name, f] : _families)
+    {
+        out += "# HELP " + name + ' ' + f.help + '\n';
+        out += "# TYPE " + name + ' ' + f.type + '\n';
+        for (const auto &s : f.series)
+        {
+            if (s.counter)
+            {
+                append_sample(out, name, "", s.labels);
+                append_number(out, s.counter->value());
+                out += '\n';
+            }
+            else if (s.histogram)
+            {
+                for (const auto &[q, label] : QUANTILES)
+                {
+                    append_sample(out, name, "", s.labels, label);
+                    append_number(out, static_cast<double>(s.histogram->quantile(q)) / 1e9);
+                    out += '\n';
+                }
+                append_sample(out, name, "_sum", s.labels);
+                append_number(out, static_cast<double>(s.histogram->sum_ns()) / 1e9);
+                out += '\n';
+                append_sample(out, name, "_count", s.labels);
+                append_number(out, s.histogram->count());
+                out += '\n';
+            }
+            else if (s.value)
+            {
+                append_sample(out, name, "", s.labels);
+                append_number(out, s.value());
+                out += '\n';
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace webkin
@@ -0,0 +1,140 @@
+#pragma once
+
+/**
+ * Always-on metrics in the Prometheus text format (GET /metrics).
+ *
+ * Recording is a few relaxed atomic increments and never locks, so the
+ * ingest and broadcast paths keep their metrics on in production.
+ *
+ * Histogram is log-linear in the manner of HDR histograms: every power of
+ * two of nanoseconds is split into 8 buckets, which bounds the error of a
+ * quantile to 12.5% over the whole range from 1 ns to about 18 minutes.
+ * Histograms are exported as summaries (quantiles, _sum, _count) over the
+ * process lifetime.
+ *
+ * Metric objects are owned by their users (e.g. one set per robot) and
+ * registered by reference with labels; values computed at scrape time,
+ * like client queue depths, are registered as callbacks. Registration and
+ * rendering take the registry's mutex, recording does not.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace webkin
+{
+
+class Counter
+{
+public:
+    void add(uint64_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> _value{0};
+};
+
+class Histogram
+{
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int MAX_EXPONENT = 40; // 2^40 ns, larger values are clamped
+    static constexpr size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT;
+
+    void record(uint64_t ns)
+    {
+        _buckets[index(ns)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    }
+
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t sum_ns() const { return _sum_ns.load(std::memory_order_relaxed); }
+
+    /// Value (ns) below which fraction q of the recorded values lie; 0 if empty.
+    uint64_t quantile(double q) const;
+
+    static size_t index(uint64_t ns);
+    /// Lowest value of a bucket; bucket i covers [lower(i), lower(i + 1)).
+    static uint64_t lower(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> _buckets{};
+    std::atomic<uint64_t> _count{0};
+    std::atomic<uint64_t> _sum_ns{0};
+};
+
+/// Records the lifetime of the scope into a histogram.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram &histogram)
+        : _histogram(histogram), _start(std::chrono::steady_clock::now())
+    {
+    }
+    ~ScopedTimer() { _histogram.record(std::chrono::steady_clock::now() - _start); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Histogram &_histogram;
+    std::chrono::steady_clock::time_point _start;
+};
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class MetricsRegistry
+{
+public:
+    void add_counter(const std::string &name, const std::string &help, MetricLabels labels,
+                     const Counter &counter);
+    /// Histogram of nanoseconds, exported in seconds; `name` should end in _seconds.
+    void add_histogram(const std::string &name, const std::string &help, MetricLabels labels,
+                       const Histogram &histogram);
+    /// A value computed at scrape time; `type` is "counter" or "gauge".
+    void add_callback(const std::string &name, const std::string &help, const char *type, MetricLabels labels,
+                      std::function<double()> value);
+
+    /// All metrics in the Prometheus text exposition format.
+    std::string render() const;
+
+private:
+    struct Series
+    {
+        std::string labels; // Rendered, without braces
+        const Counter *counter = nullptr;
+        const Histogram *histogram = nullptr;
+        std::function<double()> value;
+    };
+
+    struct Family
+    {
+        std::string help;
+        std::string type;
+        std::vector<Series> series;
+    };
+
+    Family &family(const std::string &name, const std::string &help, const char *type);
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Family> _families;
+};
+
+} // namespace webkin
@@ -29,7 +29,7 @@ bool mqtt_listener::init(const mqtt_config &config)
 
 #ifdef HAVE_MOSQUITTO
     mosquitto_lib_init();
-    _mosq = mosquitto_new("webkin", true, this);
+    _mosq = mosquitto_new(_config.client_id.c_str(), true, this);
     if (!_mosq)
     {
         nos::println("MQTT: failed to create mosquitto client");
@@ -105,6 +105,23 @@ void mqtt_listener::disconnect()
 #endif
 }
 
+bool mqtt_listener::publish(const std::string &topic, std::string_view payload, bool retain)
+{
+#ifdef HAVE_MOSQUITTO
+    if (!_connected || !_mosq)
+        return false;
+    // QoS 0: a lost pose is superseded by the next one
+    int rc = mosquitto_publish(static_cast<mosquitto *>(_mosq), nullptr, topic.c_str(),
+                               static_cast<int>(payload.size()), payload.data(), 0, retain);
+    return rc == MOSQ_ERR_SUCCESS;
+#else
+    (void)topic;
+    (void)payload;
+    (void)retain;
+    return false;
+#endif
+}
+
 #ifdef HAVE_MOSQUITTO
 
 void mqtt_listener::on_connect(struct mosquitto *mosq, void *userdata, int rc)
@@ -137,8 +154,15 @@ void mqtt_listener::on_message(struct mosquitto *mosq, void *userdata, const str
     if (!msg->payload || msg->payloadlen == 0)
         return;
 
-    std::string topic(msg->topic);
-    std::string payload(static_cast<char *>(msg->payload), msg->payloadlen);
+    std::string_view topic(msg->topic);
+    std::string_view raw(static_cast<const char *>(msg->payload), msg->payloadlen);
+
+    // Joint updates are decoded in place when possible
+    if (topic == self->_config.joints_topic && self->_on_joints_payload &&
+        self->_on_joints_payload(raw))
+        return;
+
+    std::string payload(raw);
 
     try
     {
@@ -3,10 +3,12 @@
 /**
  * MQTT Listener for WebKin
  *
- * Receives kinematic tree configuration and joint updates via MQTT.
+ * Receives kinematic tree configuration and joint updates via MQTT, and
+ * publishes on the same connection.
  */
 
 #include <string>
+#include <string_view>
 #include <functional>
 #include <atomic>
 #include <thread>
@@ -24,6 +26,7 @@ struct mqtt_config
     bool enabled = true;
     std::string broker_host = "localhost";
     int broker_port = 1883;
+    std::string client_id = "webkin"; // Unique per connection to the broker
     std::string joints_topic = "robot/joints";
     std::string tree_topic = "robot/joints/tree";
 };
@@ -33,6 +36,8 @@ class mqtt_listener
 public:
     using tree_callback_t = std::function<void(const nos::trent &)>;
     using joints_callback_t = std::function<void(const nos::trent &)>;
+    // Raw joints payload; returns false to fall back to the trent callback
+    using joints_payload_callback_t = std::function<bool(std::string_view)>;
 
     mqtt_listener() = default;
     ~mqtt_listener();
@@ -43,6 +48,11 @@ public:
 
     void set_tree_callback(tree_callback_t cb) { _on_tree = std::move(cb); }
     void set_joints_callback(joints_callback_t cb) { _on_joints = std::move(cb); }
+    void set_joints_payload_callback(joints_payload_callback_t cb) { _on_joints_payload = std::move(cb); }
+
+    /// Publish on the listener's connection; false if not connected.
+    /// Safe from any thread.
+    bool publish(const std::string &topic, std::string_view payload, bool retain = false);
 
     bool is_connected() const { return _connected; }
 
@@ -55,6 +65,7 @@ private:
 
     tree_callback_t _on_tree;
     joints_callback_t _on_joints;
+    joints_payload_callback_t _on_joints_payload;
 
 #ifdef HAVE_MOSQUITTO
     static void on_connect(struct mosquitto *mosq, void *userdata, int rc);
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * Interned names.
+ *
+ * A NameTable assigns dense ids (0, 1, 2, ... in insertion order) to
+ * distinct strings. Lookups probe an open-addressing table of 32-bit
+ * slots with linear probing; the table is kept at most half full, and the
+ * full hash of each name is stored next to it so probes rarely compare
+ * strings. Lookups take std::string_view and never allocate. The table
+ * only grows: it is rebuilt when a tree is loaded.
+ */
+
+#include "fnv.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+class NameTable
+{
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /// Id of `name`, adding it if new.
+    uint32_t intern(std::string_view name)
+    {
+        if ((_names.size() + 1) * 2 > _slots.size())
+            grow();
+        uint64_t h = hash(name);
+        size_t mask = _slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            uint32_t id = _slots[i];
+            if (id == npos)
+            {
+                id = static_cast<uint32_t>(_names.size());
+                _names.emplace_back(name);
+                _hashes.push_back(h);
+                _slots[i] = id;
+                return id;
+            }
+            if (_hashes[id] == h && _names[id] == name)
+                return id;
+        }
+    }
+
+    /// Id of `name`, or npos.
+    uint32_t find(std::string_view name) const
+    {
+        if (_slots.empty())
+            return npos;
+        uint64_t h = hash(name);
+        size_t mask = _slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            uint32_t id = _slots[i];
+            if (id == npos || (_hashes[id] == h && _names[id] == name))
+                return id;
+        }
+    }
+
+    const std::string &name(uint32_t id) const { return _names[id]; }
+    size_t size() const { return _names.size(); }
+
+    void clear()
+    {
+        _names.clear();
+        _hashes.clear();
+        _slots.clear();
+    }
+
+    /// FNV-1a 64.
+    static uint64_t hash(std::string_view s) { return fnv1a64(s); }
+
+private:
+    void grow()
+    {
+        _slots.assign(_slots.empty() ? 16 : _slots.size() * 2, npos);
+        size_t mask = _slots.size() - 1;
+        for (uint32_t id = 0; id < _names.size(); ++id)
+        {
+            size_t i = _hashes[id] & mask;
+            while (_slots[i] != npos)
+                i = (i + 1) & mask;
+            _slots[i] = id;
+        }
+    }
+
+    std::vector<std::string> _names; // By id
+    std::vector<uint64_t> _hashes;   // By id
+    std::vector<uint32_t> _slots;    // Ids, npos for empty; size is a power of two
+};
+
+} // namespace webkin
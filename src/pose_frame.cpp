@@ -0,0 +1,93 @@
+/**
+ * Binary pose frame encoding
+ */
+
+#include "pose_frame.hpp"
+
+#include <bit>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little,
+              "pose frames are encoded by memcpy and require a little-endian host");
+
+namespace webkin
+{
+
+namespace
+{
+    void write_header(char *out, uint32_t sequence, uint32_t count, double timestamp_ms)
+    {
+        std::memcpy(out, &sequence, 4);
+        std::memcpy(out + 4, &count, 4);
+        std::memcpy(out + 8, &timestamp_ms, 8);
+    }
+
+    void write_record(char *out, uint32_t index, const Pose &pose)
+    {
+        float values[7] = {
+            static_cast<float>(pose.position.x),
+            static_cast<float>(pose.position.y),
+            static_cast<float>(pose.position.z),
+            static_cast<float>(pose.orientation.x),
+            static_cast<float>(pose.orientation.y),
+            static_cast<float>(pose.orientation.z),
+            static_cast<float>(pose.orientation.w)};
+        std::memcpy(out, &index, 4);
+        std::memcpy(out + 4, values, sizeof(values));
+    }
+}
+
+std::string encode_pose_frame(const std::vector<Pose> &poses, uint32_t sequence, double timestamp_ms)
+{
+    uint32_t count = static_cast<uint32_t>(poses.size());
+    std::string frame(POSE_FRAME_HEADER_SIZE + count * POSE_FRAME_RECORD_SIZE, '\0');
+    write_header(frame.data(), sequence, count, timestamp_ms);
+
+    char *out = frame.data() + POSE_FRAME_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; ++i, out += POSE_FRAME_RECORD_SIZE)
+    {
+        write_record(out, i, poses[i]);
+    }
+    return frame;
+}
+
+std::string encode_pose_frame(const std::vector<Pose> &poses, const std::vector<uint32_t> &indices,
+                              uint32_t sequence, double timestamp_ms)
+{
+    uint32_t count = static_cast<uint32_t>(indices.size());
+    std::string frame(POSE_FRAME_HEADER_SIZE + count * POSE_FRAME_RECORD_SIZE, '\0');
+    write_header(frame.data(), sequence, count, timestamp_ms);
+
+    char *out = frame.data() + POSE_FRAME_HEADER_SIZE;
+    for (uint32_t i : indices)
+    {
+        write_record(out, i, poses[i]);
+        out += POSE_FRAME_RECORD_SIZE;
+    }
+    return frame;
+}
+
+bool decode_pose_frame(std::string_view frame, std::vector<PoseRecord> &records)
+{
+    records.clear();
+    if (frame.size() < POSE_FRAME_HEADER_SIZE)
+        return false;
+    uint32_t count;
+    std::memcpy(&count, frame.data() + 4, 4);
+    if (frame.size() != POSE_FRAME_HEADER_SIZE + size_t(count) * POSE_FRAME_RECORD_SIZE)
+        return false;
+
+    records.resize(count);
+    const char *in = frame.data() + POSE_FRAME_HEADER_SIZE;
+    for (PoseRecord &record : records)
+    {
+        float values[7];
+        std::memcpy(&record.index, in, 4);
+        std::memcpy(values, in + 4, sizeof(values));
+        record.pose = Pose(Vec3(values[0], values[1], values[2]), Quat(values[3], values[4], values[5], values[6]));
+        in += POSE_FRAME_RECORD_SIZE;
+    }
+    return true;
+}
+
+} // namespace webkin
@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * Binary pose frames for the /ws endpoint.
+ *
+ * Clients opt in by requesting the "webkin.binary.v1" WebSocket
+ * subprotocol. They still receive scene_init (with "nodeOrder") and other
+ * control messages as JSON text; pose updates arrive as binary frames.
+ *
+ * Frame layout (little-endian):
+ *
+ *   uint32  sequence
+ *   uint32  record_count
+ *   float64 timestamp        (ms since Unix epoch)
+ *   record_count x {
+ *       uint32  node_index   (index into scene_init "nodeOrder")
+ *       float32 px, py, pz
+ *       float32 qx, qy, qz, qw
+ *   }
+ *
+ * The header is 16 bytes and every record is 32 bytes, so the payload
+ * after the header maps directly onto Float32Array/Uint32Array views.
+ */
+
+#include "kinematic.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+constexpr const char *WS_BINARY_SUBPROTOCOL = "webkin.binary.v1";
+constexpr const char *WS_JSON_SUBPROTOCOL = "webkin.json";
+
+constexpr size_t POSE_FRAME_HEADER_SIZE = 16;
+constexpr size_t POSE_FRAME_RECORD_SIZE = 32;
+
+/// Encode all poses, indexed by position (flat tree order).
+std::string encode_pose_frame(const std::vector<Pose> &poses, uint32_t sequence, double timestamp_ms);
+
+/// Encode poses of the given node indices only.
+std::string encode_pose_frame(const std::vector<Pose> &poses, const std::vector<uint32_t> &indices,
+                              uint32_t sequence, double timestamp_ms);
+
+struct PoseRecord
+{
+    uint32_t index = 0; // Into "nodeOrder"
+    Pose pose;
+};
+
+/// Decode a frame into `records`; false if it is not a complete frame.
+bool decode_pose_frame(std::string_view frame, std::vector<PoseRecord> &records);
+
+} // namespace webkin
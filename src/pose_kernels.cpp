@@ -0,0 +1,345 @@
+/**
+ * Vectorized pose kernels
+ */
+
+#include "pose_kernels.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define WEBKIN_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define WEBKIN_ALWAYS_INLINE inline
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define WEBKIN_HAVE_AVX2_KERNEL 1
+#endif
+
+// Vector values never cross a non-inlined call, the ABI note does not apply
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace webkin
+{
+
+namespace
+{
+    // GCC/Clang vector extension of N doubles. With N matching the
+    // register width it maps to plain SSE2/NEON (N = 2) or AVX (N = 4)
+    // instructions.
+    template <size_t N> struct Lanes
+    {
+        typedef double type __attribute__((vector_size(N * sizeof(double))));
+        typedef int64_t mask __attribute__((vector_size(N * sizeof(double))));
+    };
+
+    // Explicit alignment: without AVX enabled GCC aligns 32-byte vectors to
+    // 16 bytes only, and the AVX2 kernel must agree with the allocator
+    template <size_t N> struct alignas(N * sizeof(double)) PoseLanes
+    {
+        typename Lanes<N>::type px, py, pz, qx, qy, qz, qw;
+    };
+
+    template <size_t N> WEBKIN_ALWAYS_INLINE typename Lanes<N>::type splat(double v)
+    {
+        return typename Lanes<N>::type{} + v;
+    }
+
+    template <size_t N> WEBKIN_ALWAYS_INLINE PoseLanes<N> splat_pose(const Pose &p)
+    {
+        return {splat<N>(p.position.x), splat<N>(p.position.y), splat<N>(p.position.z),
+                splat<N>(p.orientation.x), splat<N>(p.orientation.y), splat<N>(p.orientation.z),
+                splat<N>(p.orientation.w)};
+    }
+
+    // Angles beyond this use libm: k * PIO2_1 stops being exact
+    constexpr double SINCOS_MAX_ARG = 1e5;
+
+    /**
+     * sin and cos of every lane for |x| <= SINCOS_MAX_ARG: Cody-Waite
+     * reduction by pi/2, then the fdlibm polynomials on [-pi/4, pi/4].
+     */
+    template <size_t N>
+    WEBKIN_ALWAYS_INLINE void sincos_lanes(const typename Lanes<N>::type &x, typename Lanes<N>::type &s,
+                                           typename Lanes<N>::type &c)
+    {
+        using lanes_t = typename Lanes<N>::type;
+        using mask_t = typename Lanes<N>::mask;
+        constexpr double PIO2_1 = 1.57079632673412561417e+00;
+        constexpr double PIO2_2 = 6.07710050630396597660e-11;
+        constexpr double PIO2_3 = 2.02226624871116645580e-21;
+        constexpr double ROUND = 0x1.8p52; // Adding it leaves the nearest integer in the low mantissa bits
+
+        lanes_t shifted = x * 0.636619772367581343076 + ROUND;
+        lanes_t k = shifted - ROUND;
+        lanes_t r = x - k * PIO2_1;
+        r = r - k * PIO2_2;
+        r = r - k * PIO2_3;
+
+        lanes_t r2 = r * r;
+        lanes_t sp = r + r * r2 *
+                             (-1.66666666666666324348e-01 +
+                              r2 * (8.33333333332248946124e-03 +
+                                    r2 * (-1.98412698298579493134e-04 +
+                                          r2 * (2.75573137070700676789e-06 +
+                                                r2 * (-2.50507602534068634195e-08 + r2 * 1.58969099521155010221e-10)))));
+        lanes_t cp = 1 - 0.5 * r2 +
+                     r2 * r2 *
+                         (4.16666666666666019037e-02 +
+                          r2 * (-1.38888888888741095749e-03 +
+                                r2 * (2.48015872894767294178e-05 +
+                                      r2 * (-2.75573143513906633035e-07 +
+                                            r2 * (2.08757232129817482790e-09 + r2 * -1.13596475577881948265e-11)))));
+
+        // Quadrant k mod 4: odd swaps sin and cos, then the signs follow
+        mask_t q = (mask_t)shifted;
+        mask_t swap = -(q & 1);
+        mask_t sin_sign = (q & 2) << 62;
+        mask_t cos_sign = ((q + 1) & 2) << 62;
+        mask_t sb = (mask_t)sp, cb = (mask_t)cp;
+        s = (lanes_t)(((sb & ~swap) | (cb & swap)) ^ sin_sign);
+        c = (lanes_t)(((cb & ~swap) | (sb & swap)) ^ cos_sign);
+    }
+
+    template <size_t N>
+    WEBKIN_ALWAYS_INLINE void quat_mul(const PoseLanes<N> &a, const typename Lanes<N>::type &bx,
+                                       const typename Lanes<N>::type &by, const typename Lanes<N>::type &bz,
+                                       const typename Lanes<N>::type &bw, PoseLanes<N> &out)
+    {
+        // out may alias a
+        auto x = a.qw * bx + a.qx * bw + a.qy * bz - a.qz * by;
+        auto y = a.qw * by - a.qx * bz + a.qy * bw + a.qz * bx;
+        auto z = a.qw * bz + a.qx * by - a.qy * bx + a.qz * bw;
+        auto w = a.qw * bw - a.qx * bx - a.qy * by - a.qz * bz;
+        out.qx = x;
+        out.qy = y;
+        out.qz = z;
+        out.qw = w;
+    }
+
+    // a * b, as Pose::operator*
+    template <size_t N> WEBKIN_ALWAYS_INLINE PoseLanes<N> compose(const PoseLanes<N> &a, const PoseLanes<N> &b)
+    {
+        PoseLanes<N> r;
+        auto tx = 2 * (a.qy * b.pz - a.qz * b.py);
+        auto ty = 2 * (a.qz * b.px - a.qx * b.pz);
+        auto tz = 2 * (a.qx * b.py - a.qy * b.px);
+        r.px = a.px + b.px + a.qw * tx + (a.qy * tz - a.qz * ty);
+        r.py = a.py + b.py + a.qw * ty + (a.qz * tx - a.qx * tz);
+        r.pz = a.pz + b.pz + a.qw * tz + (a.qx * ty - a.qy * tx);
+        quat_mul<N>(a, b.qx, b.qy, b.qz, b.qw, r);
+        return r;
+    }
+
+    // Rows [first, first + N) into out; rows >= end repeat the last row
+    // and are not stored. c holds coord[node][lane].
+    template <size_t N>
+    WEBKIN_ALWAYS_INLINE void evaluate_block(const FlatTree &flat, const std::vector<uint32_t> &joints,
+                                             const double *coords, size_t first, size_t end, Pose *out,
+                                             std::vector<double> &c, std::vector<PoseLanes<N>> &global)
+    {
+        using lanes_t = typename Lanes<N>::type;
+        const size_t nodes = flat.size();
+        const size_t width = joints.size();
+        const size_t lanes = std::min(N, end - first);
+
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            for (size_t l = 0; l < N; ++l)
+                c[i * N + l] = flat.coord[i];
+        }
+        for (size_t l = 0; l < N; ++l)
+        {
+            const double *row = coords + (first + std::min(l, lanes - 1)) * width;
+            for (size_t j = 0; j < width; ++j)
+            {
+                if (joints[j] != UINT32_MAX)
+                    c[joints[j] * N + l] = row[j];
+            }
+        }
+
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            const Pose &lp = flat.local_pose[i];
+            PoseLanes<N> local = splat_pose<N>(lp);
+
+            lanes_t eff;
+            std::memcpy(&eff, c.data() + i * N, sizeof(eff));
+            eff = (eff + flat.axis_offset[i]) * flat.axis_scale[i];
+
+            switch (flat.joint_type[i])
+            {
+            case JointType::Rotator:
+            {
+                // Local orientation times the axis-angle quaternion of every lane
+                const Vec3 &axis = flat.axis[i];
+                lanes_t half = eff * 0.5, s, co;
+                double h[N];
+                std::memcpy(h, &half, sizeof(h));
+                bool in_range = true;
+                for (size_t l = 0; l < N; ++l)
+                    in_range = in_range && std::abs(h[l]) <= SINCOS_MAX_ARG;
+                if (in_range)
+                {
+                    sincos_lanes<N>(half, s, co);
+                }
+                else
+                {
+                    double sv[N], cv[N];
+                    for (size_t l = 0; l < N; ++l)
+                    {
+                        sv[l] = std::sin(h[l]);
+                        cv[l] = std::cos(h[l]);
+                    }
+                    std::memcpy(&s, sv, sizeof(s));
+                    std::memcpy(&co, cv, sizeof(co));
+                }
+                quat_mul<N>(local, axis.x * s, axis.y * s, axis.z * s, co, local);
+                break;
+            }
+            case JointType::Actuator:
+            {
+                // Translation along the axis, rotated into the parent frame once
+                Vec3 axis = lp.orientation.rotate_vec(flat.axis[i]);
+                local.px += axis.x * eff;
+                local.py += axis.y * eff;
+                local.pz += axis.z * eff;
+                break;
+            }
+            case JointType::Transform:
+                break;
+            }
+
+            int32_t p = flat.parent[i];
+            global[i] = p < 0 ? local : compose<N>(global[p], local);
+
+            // Back to row-major Pose records
+            double g[7][N];
+            std::memcpy(g, &global[i], sizeof(g));
+            for (size_t l = 0; l < lanes; ++l)
+            {
+                out[(first + l) * nodes + i] = Pose(Vec3(g[0][l], g[1][l], g[2][l]),
+                                                    Quat(g[3][l], g[4][l], g[5][l], g[6][l]));
+            }
+        }
+    }
+
+    template <size_t N>
+    WEBKIN_ALWAYS_INLINE void evaluate_rows_impl(const FlatTree &flat, const std::vector<uint32_t> &joints,
+                                                 const double *coords, size_t begin, size_t end, Pose *out)
+    {
+        std::vector<double> c(flat.size() * N);
+        std::vector<PoseLanes<N>> global(flat.size());
+        for (size_t first = begin; first < end; first += N)
+        {
+            evaluate_block<N>(flat, joints, coords, first, end, out, c, global);
+        }
+    }
+
+    // SSE2 and NEON registers hold two doubles
+    void evaluate_rows_baseline(const FlatTree &flat, const std::vector<uint32_t> &joints,
+                                const double *coords, size_t begin, size_t end, Pose *out)
+    {
+        evaluate_rows_impl<2>(flat, joints, coords, begin, end, out);
+    }
+
+#ifdef WEBKIN_HAVE_AVX2_KERNEL
+    __attribute__((target("avx2,fma"))) void evaluate_rows_avx2(const FlatTree &flat,
+                                                                const std::vector<uint32_t> &joints,
+                                                                const double *coords, size_t begin,
+                                                                size_t end, Pose *out)
+    {
+        evaluate_rows_impl<4>(flat, joints, coords, begin, end, out);
+    }
+#endif
+
+    using rows_fn = void (*)(const FlatTree &, const std::vector<uint32_t> &, const double *, size_t, size_t,
+                             Pose *);
+
+    struct Kernel
+    {
+        const char *name;
+        rows_fn fn;
+    };
+
+#if defined(__x86_64__)
+    constexpr const char *BASELINE_NAME = "sse2";
+#elif defined(__aarch64__)
+    constexpr const char *BASELINE_NAME = "neon";
+#else
+    constexpr const char *BASELINE_NAME = "generic";
+#endif
+
+    std::vector<Kernel> available_kernels()
+    {
+        std::vector<Kernel> kernels;
+#ifdef WEBKIN_HAVE_AVX2_KERNEL
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            kernels.push_back({"avx2", evaluate_rows_avx2});
+#endif
+        kernels.push_back({BASELINE_NAME, evaluate_rows_baseline});
+        return kernels;
+    }
+
+    const std::vector<Kernel> &kernels()
+    {
+        static const std::vector<Kernel> list = available_kernels();
+        return list;
+    }
+
+    std::atomic<const Kernel *> &current_kernel()
+    {
+        static std::atomic<const Kernel *> current = []()
+        {
+            const char *forced = std::getenv("WEBKIN_POSE_KERNEL");
+            for (const auto &k : kernels())
+            {
+                if (forced && std::string_view(forced) == k.name)
+                    return &k;
+            }
+            return &kernels().front();
+        }();
+        return current;
+    }
+}
+
+void evaluate_rows(const FlatTree &flat, const std::vector<uint32_t> &joints, const double *coords,
+                   size_t begin, size_t end, Pose *out)
+{
+    current_kernel().load()->fn(flat, joints, coords, begin, end, out);
+}
+
+const char *pose_kernel_name()
+{
+    return current_kernel().load()->name;
+}
+
+std::vector<const char *> pose_kernel_names()
+{
+    std::vector<const char *> names;
+    for (const auto &k : kernels())
+        names.push_back(k.name);
+    return names;
+}
+
+bool select_pose_kernel(std::string_view name)
+{
+    for (const auto &k : kernels())
+    {
+        if (name == k.name)
+        {
+            current_kernel() = &k;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace webkin
@@ -0,0 +1,38 @@
+#pragma once
+
+/**
+ * Vectorized pose kernels for batch forward kinematics.
+ *
+ * FlatTree::evaluate_batch() runs POSE_LANES configurations at a time in
+ * structure-of-arrays form: for every node the seven pose components of
+ * all lanes sit in one vector, so a single instruction composes the same
+ * node for several configurations. Parents precede children in the flat
+ * layout, so a block is still one linear pass over the nodes.
+ *
+ * The kernel is compiled for the baseline ISA (SSE2 on x86-64, NEON on
+ * AArch64) and, on x86-64, once more for AVX2+FMA. The variant is chosen
+ * on first use from the CPU features; WEBKIN_POSE_KERNEL=<name> in the
+ * environment overrides the choice.
+ */
+
+#include "kinematic.hpp"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+constexpr size_t POSE_LANES = 4;
+
+/// Name of the kernel in use: "avx2", "sse2", "neon" or "generic".
+const char *pose_kernel_name();
+
+/// Kernels this build and CPU can run, best first.
+std::vector<const char *> pose_kernel_names();
+
+/// Switch to the named kernel. Returns false if it is not available.
+bool select_pose_kernel(std::string_view name);
+
+} // namespace webkin
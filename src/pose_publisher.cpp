@@ -0,0 +1,142 @@
+/**
+ * Outbound pose publishing implementation
+ */
+
+#include "pose_publisher.hpp"
+#include "pose_frame.hpp"
+
+#include <nos/print.h>
+#include <nos/trent/json.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace webkin
+{
+
+namespace
+{
+
+// Node list republished this often while poses are sent
+constexpr std::chrono::seconds NODES_INTERVAL{5};
+
+double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+pose_publisher::~pose_publisher()
+{
+    stop();
+}
+
+void pose_publisher::configure(std::string topic, Subscription selection, double max_rate)
+{
+    _topic = std::move(topic);
+    _selection = std::move(selection);
+    _max_rate = max_rate;
+}
+
+void pose_publisher::start(const ScenePublisher &scene)
+{
+    if (_running || !_sink)
+        return;
+    _scene = &scene;
+    _running = true;
+    _thread = std::thread([this]()
+                          { loop(); });
+}
+
+void pose_publisher::stop()
+{
+    if (!_running.exchange(false))
+        return;
+    _signal.fetch_add(1, std::memory_order_release);
+    _signal.notify_one();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void pose_publisher::loop()
+{
+    using clock = std::chrono::steady_clock;
+    const auto period = _max_rate > 0 ? std::chrono::duration_cast<clock::duration>(
+                                            std::chrono::duration<double>(1.0 / _max_rate))
+                                      : clock::duration::zero();
+    auto next = clock::now();
+    auto nodes_due = next + NODES_INTERVAL;
+
+    uint32_t seen = _signal.load(std::memory_order_acquire);
+    publish(*_scene->current());
+    while (_running)
+    {
+        _signal.wait(seen, std::memory_order_acquire);
+        // Rate cap: later requests coalesce into the snapshot loaded below
+        for (auto now = clock::now(); _running && now < next; now = clock::now())
+            std::this_thread::sleep_for(std::min<clock::duration>(next - now, std::chrono::milliseconds(50)));
+        if (!_running)
+            break;
+        seen = _signal.load(std::memory_order_acquire);
+
+        auto now = clock::now();
+        next = now + period;
+        if (now >= nodes_due)
+        {
+            nodes_due = now + NODES_INTERVAL;
+            if (!_nodes_json.empty())
+                send(_topic + "/nodes", _nodes_json, true);
+        }
+        publish(*_scene->current());
+    }
+}
+
+void pose_publisher::publish(const SceneSnapshot &scene)
+{
+    bool full = false;
+    if (scene.tree_version != _tree_version)
+    {
+        _tree_version = scene.tree_version;
+        _selection.select(*scene.layout, _indices);
+        nos::trent message;
+        message.init(nos::trent::type::dict);
+        nos::trent &nodes = message["nodes"];
+        nodes.init(nos::trent::type::list);
+        for (uint32_t i : _indices)
+            nodes.push_back(scene.layout->names[i]);
+        message["tree_version"] = static_cast<double>(scene.tree_version);
+        _nodes_json = nos::json::to_string(message);
+        send(_topic + "/nodes", _nodes_json, true);
+        full = true;
+    }
+    if (!full && scene.version == _sent_version)
+        return;
+
+    // Records index the published node list, not the tree
+    _changed.clear();
+    for (uint32_t k = 0; k < _indices.size(); ++k)
+    {
+        if (full || scene.pose_version[_indices[k]] > _sent_version)
+            _changed.push_back(k);
+    }
+    _sent_version = scene.version;
+    if (_changed.empty())
+        return;
+
+    _poses.resize(_indices.size());
+    for (uint32_t k : _changed)
+        _poses[k] = scene.poses[_indices[k]];
+    send(_topic, encode_pose_frame(_poses, _changed, ++_sequence, now_ms()), false);
+}
+
+void pose_publisher::send(const std::string &topic, std::string_view payload, bool retain)
+{
+    if (_sink(topic, payload, retain))
+        _published.fetch_add(1, std::memory_order_relaxed);
+    else
+        _failed.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace webkin
@@ -0,0 +1,94 @@
+#pragma once
+
+/**
+ * Outbound publishing of computed global poses.
+ *
+ * Other services get the link poses from the transport instead of polling
+ * /api/scene. The writer only calls request() after publishing a scene
+ * snapshot, which bumps an atomic and never waits; the publisher thread
+ * loads the latest snapshot, so bursts of updates coalesce into one
+ * message, and sends the selected nodes that changed as a binary pose
+ * frame (see pose_frame.hpp) on `topic`. Record indices refer to the node
+ * list published as JSON on `topic`/nodes:
+ *
+ *   {"nodes": ["base", "tcp"], "tree_version": 3}
+ *
+ * which is sent again after a tree load and every few seconds for late
+ * subscribers. max_rate caps the messages per second, 0 publishes every
+ * snapshot.
+ */
+
+#include "scene_snapshot.hpp"
+#include "subscription.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+class pose_publisher
+{
+public:
+    // Publish `payload` on `topic`, retained if the transport supports it;
+    // returns false if it was not sent
+    using sink_t = std::function<bool(const std::string &topic, std::string_view payload, bool retain)>;
+
+    pose_publisher() = default;
+    ~pose_publisher();
+
+    /// Nodes to publish (Subscription::select), and the rate cap in Hz.
+    void configure(std::string topic, Subscription selection, double max_rate);
+    void set_sink(sink_t sink) { _sink = std::move(sink); }
+
+    void start(const ScenePublisher &scene);
+    void stop();
+
+    /// A new snapshot was published. Safe from any thread, never blocks.
+    void request()
+    {
+        if (_running.load(std::memory_order_relaxed))
+        {
+            _signal.fetch_add(1, std::memory_order_release);
+            _signal.notify_one();
+        }
+    }
+
+    bool is_running() const { return _running.load(std::memory_order_acquire); }
+    const std::string &topic() const { return _topic; }
+    uint64_t published() const { return _published.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return _failed.load(std::memory_order_relaxed); }
+
+private:
+    std::string _topic;
+    Subscription _selection;
+    double _max_rate = 0;
+    sink_t _sink;
+    const ScenePublisher *_scene = nullptr;
+
+    std::atomic<uint32_t> _signal{0};
+    std::atomic<bool> _running{false};
+    std::atomic<uint64_t> _published{0};
+    std::atomic<uint64_t> _failed{0};
+    std::thread _thread;
+
+    // Publisher thread state
+    uint64_t _tree_version = UINT64_MAX;
+    uint64_t _sent_version = 0;
+    uint32_t _sequence = 0;
+    std::vector<uint32_t> _indices;
+    std::vector<uint32_t> _changed; // Positions in _indices
+    std::vector<Pose> _poses;       // Of the selected nodes
+    std::string _nodes_json;
+
+    void loop();
+    void publish(const SceneSnapshot &scene);
+    void send(const std::string &topic, std::string_view payload, bool retain);
+};
+
+} // namespace webkin
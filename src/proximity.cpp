@@ -0,0 +1,618 @@
+/**
+ * Link proximity: BVH broad phase and GJK distance
+ */
+
+#include "proximity.hpp"
+#include "scene_json.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace webkin
+{
+
+namespace
+{
+    Vec3 sub(const Vec3 &a, const Vec3 &b)
+    {
+        return Vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+    }
+
+    double dot(const Vec3 &a, const Vec3 &b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    Vec3 cross(const Vec3 &a, const Vec3 &b)
+    {
+        return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    Quat conjugate(const Quat &q)
+    {
+        return Quat(-q.x, -q.y, -q.z, q.w);
+    }
+
+    // Point of the hull farthest along world direction `d`, in world frame
+    Vec3 support(const std::vector<Vec3> &points, const Pose &pose, const Vec3 &d)
+    {
+        Vec3 local = conjugate(pose.orientation).rotate_vec(d);
+        size_t best = 0;
+        double best_dot = dot(points[0], local);
+        for (size_t i = 1; i < points.size(); ++i)
+        {
+            double v = dot(points[i], local);
+            if (v > best_dot)
+            {
+                best_dot = v;
+                best = i;
+            }
+        }
+        return pose.position + pose.orientation.rotate_vec(points[best]);
+    }
+
+    // Point of the Minkowski difference A - B with its two source points
+    struct Vertex
+    {
+        Vec3 w, a, b;
+    };
+
+    // GJK simplex; solve() replaces it with the smallest face that holds the
+    // point closest to the origin and sets the barycentric weights
+    struct Simplex
+    {
+        Vertex v[4];
+        double lambda[4] = {1, 0, 0, 0};
+        int n = 0;
+
+        Vec3 point() const
+        {
+            Vec3 p;
+            for (int i = 0; i < n; ++i)
+                p = p + v[i].w * lambda[i];
+            return p;
+        }
+
+        void keep(std::initializer_list<std::pair<int, double>> kept)
+        {
+            Vertex copy[4] = {v[0], v[1], v[2], v[3]};
+            n = 0;
+            for (auto [i, weight] : kept)
+            {
+                v[n] = copy[i];
+                lambda[n] = weight;
+                ++n;
+            }
+        }
+
+        void solve_segment()
+        {
+            Vec3 ab = sub(v[1].w, v[0].w);
+            double len = dot(ab, ab);
+            double t = len > 0 ? -dot(v[0].w, ab) / len : 0;
+            if (t <= 0)
+                keep({{0, 1}});
+            else if (t >= 1)
+                keep({{1, 1}});
+            else
+                keep({{0, 1 - t}, {1, t}});
+        }
+
+        // Closest point of triangle (0, 1, 2) to the origin, Voronoi regions
+        // as in Ericson, Real-Time Collision Detection 5.1.5
+        void solve_triangle()
+        {
+            const Vec3 &a = v[0].w, &b = v[1].w, &c = v[2].w;
+            Vec3 ab = sub(b, a), ac = sub(c, a);
+            double d1 = -dot(ab, a), d2 = -dot(ac, a);
+            if (d1 <= 0 && d2 <= 0)
+                return keep({{0, 1}});
+            double d3 = -dot(ab, b), d4 = -dot(ac, b);
+            if (d3 >= 0 && d4 <= d3)
+                return keep({{1, 1}});
+            double vc = d1 * d4 - d3 * d2;
+            if (vc <= 0 && d1 >= 0 && d3 <= 0)
+            {
+                double t = d1 / (d1 - d3);
+                return keep({{0, 1 - t}, {1, t}});
+            }
+            double d5 = -dot(ab, c), d6 = -dot(ac, c);
+            if (d6 >= 0 && d5 <= d6)
+                return keep({{2, 1}});
+            double vb = d5 * d2 - d1 * d6;
+            if (vb <= 0 && d2 >= 0 && d6 <= 0)
+            {
+                double t = d2 / (d2 - d6);
+                return keep({{0, 1 - t}, {2, t}});
+            }
+            double va = d3 * d6 - d5 * d4;
+            if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+            {
+                double t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                return keep({{1, 1 - t}, {2, t}});
+            }
+            double sum = va + vb + vc;
+            if (!(sum > 0))
+            {
+                // Degenerate: the longest edge spans it
+                Vec3 bc = sub(c, b);
+                double lab = dot(ab, ab), lac = dot(ac, ac), lbc = dot(bc, bc);
+                if (lab >= lac && lab >= lbc)
+                    keep({{0, 0}, {1, 0}});
+                else if (lac >= lbc)
+                    keep({{0, 0}, {2, 0}});
+                else
+                    keep({{1, 0}, {2, 0}});
+                return solve_segment();
+            }
+            keep({{0, va / sum}, {1, vb / sum}, {2, vc / sum}});
+        }
+
+        // False if the origin is inside the tetrahedron
+        bool solve_tetrahedron()
+        {
+            static const int FACES[4][4] = {{0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}};
+            Simplex best;
+            double best_dist = INFINITY;
+            bool outside = false;
+            for (const auto &f : FACES)
+            {
+                const Vec3 &p = v[f[0]].w;
+                Vec3 normal = cross(sub(v[f[1]].w, p), sub(v[f[2]].w, p));
+                double origin_side = -dot(normal, p);
+                double opposite_side = dot(normal, sub(v[f[3]].w, p));
+                // Outside this face, or a flat tetrahedron
+                if (origin_side * opposite_side > 0 && std::abs(opposite_side) > 1e-12 * dot(normal, normal))
+                    continue;
+                outside = true;
+                Simplex face;
+                face.v[0] = v[f[0]];
+                face.v[1] = v[f[1]];
+                face.v[2] = v[f[2]];
+                face.n = 3;
+                face.solve_triangle();
+                Vec3 q = face.point();
+                double dist = dot(q, q);
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = face;
+                }
+            }
+            if (!outside)
+                return false;
+            *this = best;
+            return true;
+        }
+
+        bool solve()
+        {
+            switch (n)
+            {
+            case 2:
+                solve_segment();
+                break;
+            case 3:
+                solve_triangle();
+                break;
+            case 4:
+                return solve_tetrahedron();
+            }
+            return true;
+        }
+    };
+
+    double area(const Vec3 &lo, const Vec3 &hi)
+    {
+        Vec3 e = sub(hi, lo);
+        return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+}
+
+std::vector<Vec3> hull_points(const std::vector<float> &triangles, const Vec3 &scale, size_t directions)
+{
+    size_t count = triangles.size() / 3;
+    if (count == 0 || directions == 0)
+        return {};
+
+    // Directions spread evenly over the sphere (Fibonacci lattice)
+    std::vector<Vec3> dirs(directions);
+    const double golden = M_PI * (3 - std::sqrt(5.0));
+    for (size_t i = 0; i < directions; ++i)
+    {
+        double z = 1 - 2 * (i + 0.5) / directions;
+        double r = std::sqrt(1 - z * z);
+        dirs[i] = Vec3(r * std::cos(golden * i), r * std::sin(golden * i), z);
+    }
+
+    std::vector<double> best(directions, -INFINITY);
+    std::vector<size_t> best_index(directions, 0);
+    for (size_t v = 0; v < count; ++v)
+    {
+        Vec3 p(triangles[3 * v] * scale.x, triangles[3 * v + 1] * scale.y, triangles[3 * v + 2] * scale.z);
+        for (size_t i = 0; i < directions; ++i)
+        {
+            double d = dot(p, dirs[i]);
+            if (d > best[i])
+            {
+                best[i] = d;
+                best_index[i] = v;
+            }
+        }
+    }
+
+    std::vector<Vec3> points;
+    for (size_t i = 0; i < directions; ++i)
+    {
+        size_t v = best_index[i];
+        Vec3 p(triangles[3 * v] * scale.x, triangles[3 * v + 1] * scale.y, triangles[3 * v + 2] * scale.z);
+        if (std::find(points.begin(), points.end(), p) == points.end())
+            points.push_back(p);
+    }
+    return points;
+}
+
+double hull_distance(const std::vector<Vec3> &a, const Pose &pose_a, const std::vector<Vec3> &b,
+                     const Pose &pose_b, Vec3 *point_a, Vec3 *point_b)
+{
+    if (a.empty() || b.empty())
+        return INFINITY;
+
+    auto vertex = [&](const Vec3 &d)
+    {
+        Vertex v;
+        v.a = support(a, pose_a, d);
+        v.b = support(b, pose_b, d * -1.0);
+        v.w = sub(v.a, v.b);
+        return v;
+    };
+
+    Simplex s;
+    s.v[0] = vertex(sub(pose_b.position, pose_a.position));
+    s.n = 1;
+    Vec3 v = s.v[0].w;
+    double dist = dot(v, v);
+    bool intersect = false;
+    for (int iter = 0; iter < 64; ++iter)
+    {
+        if (dist <= 1e-18)
+        {
+            intersect = true;
+            break;
+        }
+        Vertex w = vertex(v * -1.0);
+        // No support point gets closer to the origin than v
+        if (dist - dot(v, w.w) <= 1e-10 * dist)
+            break;
+        bool repeated = false;
+        for (int i = 0; i < s.n; ++i)
+            repeated |= s.v[i].w == w.w;
+        if (repeated)
+            break;
+
+        Simplex next = s;
+        next.v[next.n++] = w;
+        if (!next.solve())
+        {
+            intersect = true;
+            break;
+        }
+        Vec3 p = next.point();
+        double next_dist = dot(p, p);
+        if (next_dist >= dist)
+            break; // Rounding: no more progress
+        s = next;
+        v = p;
+        dist = next_dist;
+    }
+
+    Vec3 pa, pb;
+    for (int i = 0; i < s.n; ++i)
+    {
+        pa = pa + s.v[i].a * s.lambda[i];
+        pb = pb + s.v[i].b * s.lambda[i];
+    }
+    if (point_a)
+        *point_a = pa;
+    if (point_b)
+        *point_b = intersect ? pa : pb;
+    return intersect ? 0.0 : std::sqrt(dist);
+}
+
+void ProximityMonitor::reset(const FlatTree &flat, std::vector<LinkShape> links, std::vector<std::string> names)
+{
+    _links.clear();
+    _link_of.assign(flat.size(), -1);
+    _names = std::move(names);
+    for (auto &shape : links)
+    {
+        if (shape.node >= flat.size() || shape.points.empty())
+            continue;
+        Link link;
+        link.node = shape.node;
+        link.body = flat.kind[shape.node] != JointKind::Fixed ? static_cast<int32_t>(shape.node)
+                                                              : flat.anchor[shape.node];
+        link.points = std::move(shape.points);
+        link.local.lo = link.local.hi = link.points[0];
+        for (const Vec3 &p : link.points)
+        {
+            link.local.lo = Vec3(std::min(link.local.lo.x, p.x), std::min(link.local.lo.y, p.y),
+                                 std::min(link.local.lo.z, p.z));
+            link.local.hi = Vec3(std::max(link.local.hi.x, p.x), std::max(link.local.hi.y, p.y),
+                                 std::max(link.local.hi.z, p.z));
+        }
+        _link_of[shape.node] = static_cast<int32_t>(_links.size());
+        _links.push_back(std::move(link));
+    }
+    for (Link &link : _links)
+    {
+        int32_t p = flat.parent[link.node];
+        while (p >= 0 && _link_of[p] < 0)
+            p = flat.parent[p];
+        link.parent_link = p >= 0 ? _link_of[p] : -1;
+    }
+    _is_moved.assign(_links.size(), 0);
+    _bvh.clear();
+    _pairs.clear();
+    _stale = true;
+    if (enabled())
+        publish();
+    else
+        _current.store(nullptr, std::memory_order_release);
+}
+
+bool ProximityMonitor::update(const FlatTree &flat)
+{
+    if (!enabled() || flat.size() != _link_of.size())
+        return false;
+
+    _moved.clear();
+    if (_stale)
+    {
+        for (uint32_t i = 0; i < _links.size(); ++i)
+            _moved.push_back(i);
+    }
+    else
+    {
+        for (uint32_t node : flat.changed_list)
+        {
+            if (_link_of[node] >= 0)
+                _moved.push_back(static_cast<uint32_t>(_link_of[node]));
+        }
+    }
+    if (_moved.empty())
+        return false;
+
+    // World AABB of the local box: center moved, extents through |R|
+    for (uint32_t m : _moved)
+    {
+        Link &link = _links[m];
+        const Pose &pose = flat.global_pose[link.node];
+        const Quat &q = pose.orientation;
+        double r[3][3] = {
+            {1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y - q.z * q.w), 2 * (q.x * q.z + q.y * q.w)},
+            {2 * (q.x * q.y + q.z * q.w), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z - q.x * q.w)},
+            {2 * (q.x * q.z - q.y * q.w), 2 * (q.y * q.z + q.x * q.w), 1 - 2 * (q.x * q.x + q.y * q.y)}};
+        Vec3 c = (link.local.lo + link.local.hi) * 0.5;
+        Vec3 e = sub(link.local.hi, link.local.lo) * 0.5;
+        Vec3 center = pose.position + q.rotate_vec(c);
+        double ext[3];
+        for (int i = 0; i < 3; ++i)
+            ext[i] = std::abs(r[i][0]) * e.x + std::abs(r[i][1]) * e.y + std::abs(r[i][2]) * e.z;
+        link.world.lo = Vec3(center.x - ext[0], center.y - ext[1], center.z - ext[2]);
+        link.world.hi = Vec3(center.x + ext[0], center.y + ext[1], center.z + ext[2]);
+        _is_moved[m] = 1;
+    }
+
+    if (_bvh.empty())
+    {
+        build();
+    }
+    else
+    {
+        for (uint32_t m : _moved)
+            refit(m);
+        if (internal_area() > 2 * _built_area)
+            build();
+    }
+
+    std::vector<ProximityPair> previous = _pairs;
+    _pairs.erase(std::remove_if(_pairs.begin(), _pairs.end(), [&](const ProximityPair &p)
+                                { return _is_moved[_link_of[p.a]] || _is_moved[_link_of[p.b]]; }),
+                 _pairs.end());
+    for (uint32_t m : _moved)
+    {
+        // Pairs of two moved links are tested from the lower one
+        Link &link = _links[m];
+        Vec3 margin(_threshold, _threshold, _threshold);
+        Box box{sub(link.world.lo, margin), link.world.hi + margin};
+        _stack.assign(1, 0);
+        while (!_stack.empty())
+        {
+            const BvhNode &n = _bvh[_stack.back()];
+            _stack.pop_back();
+            if (n.box.lo.x > box.hi.x || n.box.hi.x < box.lo.x || n.box.lo.y > box.hi.y || n.box.hi.y < box.lo.y ||
+                n.box.lo.z > box.hi.z || n.box.hi.z < box.lo.z)
+                continue;
+            if (n.left >= 0)
+            {
+                _stack.push_back(n.left);
+                _stack.push_back(n.right);
+                continue;
+            }
+            uint32_t other = static_cast<uint32_t>(n.link);
+            if (other == m || (_is_moved[other] && other < m) || excluded(m, other))
+                continue;
+            const Link &o = _links[other];
+            ProximityPair pair;
+            pair.distance = hull_distance(link.points, flat.global_pose[link.node], o.points,
+                                          flat.global_pose[o.node], &pair.point_a, &pair.point_b);
+            if (!(pair.distance < _threshold))
+                continue;
+            pair.a = link.node;
+            pair.b = o.node;
+            if (pair.a > pair.b)
+            {
+                std::swap(pair.a, pair.b);
+                std::swap(pair.point_a, pair.point_b);
+            }
+            _pairs.push_back(pair);
+        }
+    }
+    std::sort(_pairs.begin(), _pairs.end(), [](const ProximityPair &x, const ProximityPair &y)
+              { return x.a != y.a ? x.a < y.a : x.b < y.b; });
+
+    for (uint32_t m : _moved)
+        _is_moved[m] = 0;
+    _stale = false;
+
+    bool same = previous.size() == _pairs.size() &&
+                std::equal(previous.begin(), previous.end(), _pairs.begin(), [](const auto &x, const auto &y)
+                           { return x.a == y.a && x.b == y.b && x.distance == y.distance; });
+    if (same)
+        return false;
+    publish();
+    return true;
+}
+
+void ProximityMonitor::build()
+{
+    _bvh.clear();
+    _bvh.reserve(2 * _links.size());
+    std::vector<uint32_t> order(_links.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    build_range(order, 0, order.size(), -1);
+    _built_area = internal_area();
+}
+
+// Top-down: split at the median of the box centers along the longest axis
+int32_t ProximityMonitor::build_range(std::vector<uint32_t> &links, size_t begin, size_t end, int32_t parent)
+{
+    int32_t index = static_cast<int32_t>(_bvh.size());
+    _bvh.emplace_back();
+    _bvh[index].parent = parent;
+    if (end - begin == 1)
+    {
+        Link &link = _links[links[begin]];
+        _bvh[index].box = link.world;
+        _bvh[index].link = static_cast<int32_t>(links[begin]);
+        link.leaf = index;
+        return index;
+    }
+
+    Vec3 lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+    auto center = [&](uint32_t l)
+    { return (_links[l].world.lo + _links[l].world.hi) * 0.5; };
+    for (size_t i = begin; i < end; ++i)
+    {
+        Vec3 c = center(links[i]);
+        lo = Vec3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+        hi = Vec3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+    }
+    Vec3 e = sub(hi, lo);
+    int axis = e.x >= e.y && e.x >= e.z ? 0 : (e.y >= e.z ? 1 : 2);
+    auto key = [&](uint32_t l)
+    {
+        Vec3 c = center(l);
+        return axis == 0 ? c.x : (axis == 1 ? c.y : c.z);
+    };
+    size_t mid = begin + (end - begin) / 2;
+    std::nth_element(links.begin() + begin, links.begin() + mid, links.begin() + end,
+                     [&](uint32_t x, uint32_t y)
+                     { return key(x) < key(y); });
+
+    int32_t left = build_range(links, begin, mid, index);
+    int32_t right = build_range(links, mid, end, index);
+    BvhNode &node = _bvh[index];
+    node.left = left;
+    node.right = right;
+    node.box.lo = Vec3(std::min(_bvh[left].box.lo.x, _bvh[right].box.lo.x),
+                       std::min(_bvh[left].box.lo.y, _bvh[right].box.lo.y),
+                       std::min(_bvh[left].box.lo.z, _bvh[right].box.lo.z));
+    node.box.hi = Vec3(std::max(_bvh[left].box.hi.x, _bvh[right].box.hi.x),
+                       std::max(_bvh[left].box.hi.y, _bvh[right].box.hi.y),
+                       std::max(_bvh[left].box.hi.z, _bvh[right].box.hi.z));
+    return index;
+}
+
+// Leaf box of a moved link, then its ancestors
+void ProximityMonitor::refit(uint32_t link)
+{
+    int32_t index = _links[link].leaf;
+    _bvh[index].box = _links[link].world;
+    for (index = _bvh[index].parent; index >= 0; index = _bvh[index].parent)
+    {
+        BvhNode &node = _bvh[index];
+        const Box &l = _bvh[node.left].box, &r = _bvh[node.right].box;
+        node.box.lo = Vec3(std::min(l.lo.x, r.lo.x), std::min(l.lo.y, r.lo.y), std::min(l.lo.z, r.lo.z));
+        node.box.hi = Vec3(std::max(l.hi.x, r.hi.x), std::max(l.hi.y, r.hi.y), std::max(l.hi.z, r.hi.z));
+    }
+}
+
+double ProximityMonitor::internal_area() const
+{
+    double total = 0;
+    for (const BvhNode &node : _bvh)
+    {
+        if (node.left >= 0)
+            total += area(node.box.lo, node.box.hi);
+    }
+    return total;
+}
+
+bool ProximityMonitor::excluded(uint32_t a, uint32_t b) const
+{
+    return _links[a].body == _links[b].body || _links[b].parent_link == static_cast<int32_t>(a) ||
+           _links[a].parent_link == static_cast<int32_t>(b);
+}
+
+void ProximityMonitor::publish_message(std::string json)
+{
+    auto report = std::make_shared<ProximityReport>();
+    report->version = ++_version;
+    report->json = std::move(json);
+    _current.store(std::move(report), std::memory_order_release);
+}
+
+void ProximityMonitor::publish()
+{
+    auto report = std::make_shared<ProximityReport>();
+    report->version = ++_version;
+    report->pairs = _pairs;
+
+    std::string &out = report->json;
+    out = "{\"type\":\"proximity\",\"threshold\":";
+    append_json_number(out, _threshold, 6);
+    out += ",\"pairs\":[";
+    for (size_t i = 0; i < _pairs.size(); ++i)
+    {
+        const ProximityPair &p = _pairs[i];
+        if (i > 0)
+            out += ',';
+        out += "{\"a\":";
+        append_json_string(out, _names[p.a]);
+        out += ",\"b\":";
+        append_json_string(out, _names[p.b]);
+        out += ",\"distance\":";
+        append_json_number(out, p.distance, 3);
+        out += ",\"points\":[";
+        for (const Vec3 *v : {&p.point_a, &p.point_b})
+        {
+            if (v == &p.point_b)
+                out += ',';
+            out += '[';
+            append_json_number(out, v->x, 3);
+            out += ',';
+            append_json_number(out, v->y, 3);
+            out += ',';
+            append_json_number(out, v->z, 3);
+            out += ']';
+        }
+        out += "]}";
+    }
+    out += "]}";
+    _current.store(std::move(report), std::memory_order_release);
+}
+
+} // namespace webkin
@@ -0,0 +1,150 @@
+#pragma once
+
+/**
+ * Proximity checking between links of a kinematic tree.
+ *
+ * A link is a node with a mesh (and cell fixtures are simply links that
+ * never move). Each link is reduced to a convex point set in its node
+ * frame: the mesh vertices extreme along a fixed set of directions, whose
+ * hull lies slightly inside the link's convex hull. Concave links are
+ * treated as their hull.
+ *
+ * Broad phase: a bounding volume hierarchy over the links' world AABBs,
+ * built top-down once per tree and refitted from the leaves of the links
+ * whose global pose changed (FlatTree::changed_list, filled by the dirty
+ * subtree update). It is rebuilt when refitting has grown it too much.
+ *
+ * Narrow phase: GJK distance between the two hulls, with the closest
+ * points. Only pairs with a moved link are re-tested, results of the other
+ * pairs are kept. Links on one rigid body, which cannot move relative to
+ * each other, and a link and the nearest link above it in the tree, which
+ * touch at their joint by construction, are never tested.
+ *
+ * The writer thread calls update() under its lock; the report of pairs
+ * closer than the threshold is published like a scene snapshot, and
+ * current() is safe from any thread.
+ */
+
+#include "kinematic.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace webkin
+{
+
+/// Convex point set of the mesh of node `node`, in the node frame.
+struct LinkShape
+{
+    uint32_t node = 0;
+    std::vector<Vec3> points;
+};
+
+/// Reduce a triangle soup (9 floats per triangle) to its points extreme
+/// along `directions` directions, scaled per axis.
+std::vector<Vec3> hull_points(const std::vector<float> &triangles, const Vec3 &scale, size_t directions = 128);
+
+struct ProximityPair
+{
+    uint32_t a = 0; // Flat indices, a < b
+    uint32_t b = 0;
+    double distance = 0; // 0 if the hulls intersect
+    Vec3 point_a;        // Closest points, world frame
+    Vec3 point_b;
+};
+
+/// Closest points of the convex hulls of two point sets placed at poses.
+/// Returns the distance, 0 if they intersect.
+double hull_distance(const std::vector<Vec3> &a, const Pose &pose_a, const std::vector<Vec3> &b,
+                     const Pose &pose_b, Vec3 *point_a = nullptr, Vec3 *point_b = nullptr);
+
+struct ProximityReport
+{
+    uint64_t version = 0;
+    std::vector<ProximityPair> pairs; // Sorted by (a, b)
+    std::string json;                 // The proximity message
+};
+
+class ProximityMonitor
+{
+public:
+    /// Pairs closer than `distance` scene units are reported; 0 turns checking off.
+    void set_threshold(double distance) { _threshold = distance; }
+    double threshold() const { return _threshold; }
+    bool enabled() const { return _threshold > 0 && !_links.empty(); }
+
+    /// A new tree was loaded: its links and node names. Every pair is
+    /// tested with the next update().
+    void reset(const FlatTree &flat, std::vector<LinkShape> links, std::vector<std::string> names);
+
+    /// Re-test the pairs of links in flat.changed_list (call before the
+    /// change set is consumed). Publishes a new report if the result
+    /// changed and returns true in that case.
+    bool update(const FlatTree &flat);
+
+    /// Publish a proximity message computed elsewhere (a relay's primary)
+    /// as the current report; its pairs are not parsed.
+    void publish_message(std::string json);
+
+    /// Latest report, null while checking is off
+    std::shared_ptr<const ProximityReport> current() const
+    {
+        return _current.load(std::memory_order_acquire);
+    }
+
+    size_t link_count() const { return _links.size(); }
+
+private:
+    struct Box
+    {
+        Vec3 lo, hi;
+    };
+
+    struct BvhNode
+    {
+        Box box;
+        int32_t left = -1; // Children, or -1 for a leaf
+        int32_t right = -1;
+        int32_t parent = -1;
+        int32_t link = -1; // Leaf link
+    };
+
+    struct Link
+    {
+        uint32_t node = 0;
+        int32_t body = -1;        // Node whose joint moves the link, -1 for the world
+        int32_t parent_link = -1; // Nearest link above it in the tree, -1 if none
+        std::vector<Vec3> points;
+        Box local; // AABB in the node frame
+        Box world;
+        int32_t leaf = -1; // BvhNode
+    };
+
+    double _threshold = 0;
+    std::vector<Link> _links;
+    std::vector<int32_t> _link_of; // By flat index, -1 if not a link
+    std::vector<std::string> _names;
+
+    std::vector<BvhNode> _bvh;
+    double _built_area = 0; // Total area of the internal boxes when built
+    bool _stale = true;     // All pairs need testing
+
+    std::vector<ProximityPair> _pairs;
+    std::vector<uint32_t> _moved; // Links, scratch of update()
+    std::vector<uint8_t> _is_moved;
+    std::vector<int32_t> _stack;
+    uint64_t _version = 0;
+    std::atomic<std::shared_ptr<const ProximityReport>> _current;
+
+    void build();
+    int32_t build_range(std::vector<uint32_t> &links, size_t begin, size_t end, int32_t parent);
+    void refit(uint32_t link);
+    double internal_area() const;
+    bool excluded(uint32_t a, uint32_t b) const;
+    void publish();
+};
+
+} // namespace webkin
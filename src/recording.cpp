@@ -0,0 +1,458 @@
+/**
+ * On-disk joint recordings
+ */
+
+#include "recording.hpp"
+#include "joint_decoder.hpp"
+
+#include <nos/print.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static_assert(std::endian::native == std::endian::little,
+              "recordings are written by memcpy and require a little-endian host");
+
+namespace webkin
+{
+
+namespace
+{
+    constexpr size_t FILE_HEADER_FIXED_SIZE = 32;
+    constexpr size_t WRITER_CHUNK_BUFFERS = 8;
+
+    std::string make_file_header(const std::vector<std::string> &names, uint32_t chunk_frames)
+    {
+        size_t names_size = 0;
+        for (const auto &name : names)
+            names_size += name.size() + 1;
+        size_t size = (FILE_HEADER_FIXED_SIZE + names_size + 7) & ~size_t(7);
+
+        std::string header(size, '\0');
+        uint32_t header_size = static_cast<uint32_t>(size);
+        uint32_t joints = static_cast<uint32_t>(names.size());
+        uint64_t hash = JointSchema::compute_hash(names);
+        std::memcpy(header.data(), RECORDING_MAGIC, 8);
+        std::memcpy(header.data() + 8, &header_size, 4);
+        std::memcpy(header.data() + 12, &joints, 4);
+        std::memcpy(header.data() + 16, &chunk_frames, 4);
+        std::memcpy(header.data() + 24, &hash, 8);
+
+        char *out = header.data() + FILE_HEADER_FIXED_SIZE;
+        for (const auto &name : names)
+        {
+            std::memcpy(out, name.data(), name.size());
+            out += name.size() + 1;
+        }
+        return header;
+    }
+
+    size_t chunk_size_for(size_t joints, size_t chunk_frames)
+    {
+        return RECORDING_CHUNK_HEADER_SIZE + 8 * chunk_frames * (joints + 1);
+    }
+
+    bool write_all(int fd, const char *data, size_t size, uint64_t offset)
+    {
+        while (size > 0)
+        {
+            ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+}
+
+// ----------------------------------------------------------------------
+// recording_writer
+
+recording_writer::~recording_writer()
+{
+    close();
+}
+
+bool recording_writer::open(const std::filesystem::path &path, const std::vector<std::string> &names,
+                            uint32_t chunk_frames)
+{
+    close();
+    if (names.empty() || chunk_frames == 0)
+    {
+        nos::println("Recording: no joints to record");
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        nos::println("Recording: cannot open ", path.string(), ": ", std::strerror(errno));
+        return false;
+    }
+
+    std::string header = make_file_header(names, chunk_frames);
+    size_t chunk_size = chunk_size_for(names.size(), chunk_frames);
+
+    struct stat st;
+    ::fstat(fd, &st);
+    uint64_t file_size = static_cast<uint64_t>(st.st_size);
+    if (file_size == 0)
+    {
+        if (!write_all(fd, header.data(), header.size(), 0))
+        {
+            nos::println("Recording: cannot write header: ", std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+        _next_offset = header.size();
+    }
+    else
+    {
+        // Append only to a recording of the same joints and chunk layout;
+        // a torn chunk at the end (crash) is overwritten
+        std::string existing(header.size(), '\0');
+        if (file_size < header.size() ||
+            ::pread(fd, existing.data(), existing.size(), 0) != static_cast<ssize_t>(existing.size()) ||
+            existing != header)
+        {
+            nos::println("Recording: ", path.string(), " exists with another joint layout, not appending");
+            ::close(fd);
+            return false;
+        }
+        _next_offset = header.size() + (file_size - header.size()) / chunk_size * chunk_size;
+    }
+
+    _fd = fd;
+    _names = names;
+    _joints = static_cast<uint32_t>(names.size());
+    _chunk_frames = chunk_frames;
+    _chunk_size = chunk_size;
+    _flat_index.assign(_joints, UINT32_MAX);
+    _recorded = 0;
+    _dropped = 0;
+
+    _free.clear();
+    _full.clear();
+    _filling.reset();
+    for (size_t i = 0; i < WRITER_CHUNK_BUFFERS; ++i)
+    {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->data.resize(size_t(_chunk_frames) * (_joints + 1));
+        _free.push_back(std::move(chunk));
+    }
+
+    _running = true;
+    _thread = std::thread([this]()
+                          { loop(); });
+    nos::println("Recording joints to ", path.string(), " (", _joints, " joints, ",
+                 _chunk_frames, " frames per chunk)");
+    return true;
+}
+
+void recording_writer::close()
+{
+    if (_fd < 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_filling && _filling->count > 0)
+            _full.push_back(std::move(_filling));
+        _running = false;
+    }
+    _cv.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+
+    ::fsync(_fd);
+    ::close(_fd);
+    _fd = -1;
+    nos::println("Recording closed: ", _recorded, " frames, ", _dropped, " dropped");
+}
+
+void recording_writer::bind(const KinematicTree &tree)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t j = 0; j < _names.size(); ++j)
+    {
+        _flat_index[j] = tree.joint_index(_names[j]);
+    }
+}
+
+void recording_writer::record(double time_ms, const KinematicTree &tree)
+{
+    if (_fd < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_filling)
+    {
+        if (_free.empty())
+        {
+            ++_dropped;
+            return;
+        }
+        _filling = std::move(_free.back());
+        _free.pop_back();
+        _filling->count = 0;
+    }
+
+    Chunk &chunk = *_filling;
+    size_t i = chunk.count;
+    double *time = chunk.data.data();
+    if (i > 0)
+        time_ms = std::max(time_ms, time[i - 1]);
+    time[i] = time_ms;
+    for (size_t j = 0; j < _joints; ++j)
+    {
+        uint32_t index = _flat_index[j];
+        time[_chunk_frames * (j + 1) + i] =
+            index != UINT32_MAX ? tree.flat.coord[index] : std::numeric_limits<double>::quiet_NaN();
+    }
+    ++_recorded;
+
+    if (++chunk.count == _chunk_frames)
+    {
+        _full.push_back(std::move(_filling));
+        _cv.notify_one();
+    }
+}
+
+void recording_writer::loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this]()
+                 { return !_full.empty() || !_running; });
+        if (_full.empty())
+        {
+            if (!_running)
+                break;
+            continue;
+        }
+
+        std::unique_ptr<Chunk> chunk = std::move(_full.front());
+        _full.pop_front();
+        lock.unlock();
+        write_chunk(*chunk);
+        lock.lock();
+        _free.push_back(std::move(chunk));
+    }
+}
+
+void recording_writer::write_chunk(const Chunk &chunk)
+{
+    char header[RECORDING_CHUNK_HEADER_SIZE];
+    std::memcpy(header, RECORDING_CHUNK_MAGIC, 4);
+    std::memcpy(header + 4, &chunk.count, 4);
+    std::memcpy(header + 8, &chunk.data[0], 8);
+
+    // A partial chunk still occupies chunk_size bytes; unused slots are
+    // whatever the buffer held and are ignored by readers
+    iovec iov[2] = {
+        {header, sizeof(header)},
+        {const_cast<double *>(chunk.data.data()), chunk.data.size() * sizeof(double)}};
+    size_t total = sizeof(header) + chunk.data.size() * sizeof(double);
+    ssize_t n = ::pwritev(_fd, iov, 2, static_cast<off_t>(_next_offset));
+    if (n != static_cast<ssize_t>(total))
+    {
+        nos::println("Recording: write failed: ", std::strerror(errno));
+        return;
+    }
+    _next_offset += total;
+}
+
+// ----------------------------------------------------------------------
+// recording_reader
+
+recording_reader::~recording_reader()
+{
+    close();
+}
+
+bool recording_reader::open(const std::filesystem::path &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        nos::println("Replay: cannot open ", path.string(), ": ", std::strerror(errno));
+        return false;
+    }
+    struct stat st;
+    ::fstat(fd, &st);
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < FILE_HEADER_FIXED_SIZE)
+    {
+        nos::println("Replay: ", path.string(), " is not a recording");
+        ::close(fd);
+        return false;
+    }
+
+    void *map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        nos::println("Replay: mmap failed: ", std::strerror(errno));
+        return false;
+    }
+    _data = static_cast<const char *>(map);
+    _size = size;
+
+    uint32_t header_size, joints, chunk_frames;
+    std::memcpy(&header_size, _data + 8, 4);
+    std::memcpy(&joints, _data + 12, 4);
+    std::memcpy(&chunk_frames, _data + 16, 4);
+    if (std::memcmp(_data, RECORDING_MAGIC, 8) != 0 || header_size < FILE_HEADER_FIXED_SIZE ||
+        header_size > _size || chunk_frames == 0)
+    {
+        nos::println("Replay: ", path.string(), " is not a recording");
+        close();
+        return false;
+    }
+
+    const char *name = _data + FILE_HEADER_FIXED_SIZE;
+    const char *names_end = _data + header_size;
+    for (uint32_t j = 0; j < joints && name < names_end; ++j)
+    {
+        size_t len = strnlen(name, names_end - name);
+        _names.emplace_back(name, len);
+        name += len + 1;
+    }
+    if (_names.size() != joints)
+    {
+        nos::println("Replay: corrupt header in ", path.string());
+        close();
+        return false;
+    }
+
+    _header_size = header_size;
+    _joints = joints;
+    _chunk_frames = chunk_frames;
+    _chunk_size = chunk_size_for(joints, chunk_frames);
+    _chunks = (_size - _header_size) / _chunk_size;
+
+    // Ignore trailing chunks that were never completed
+    while (_chunks > 0 && (std::memcmp(chunk(_chunks - 1), RECORDING_CHUNK_MAGIC, 4) != 0 ||
+                           chunk_count(_chunks - 1) == 0))
+        --_chunks;
+
+    ::madvise(const_cast<char *>(_data), _size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void recording_reader::close()
+{
+    if (_data)
+    {
+        ::munmap(const_cast<char *>(_data), _size);
+    }
+    _data = nullptr;
+    _size = 0;
+    _chunks = 0;
+    _names.clear();
+}
+
+uint32_t recording_reader::chunk_count(size_t k) const
+{
+    uint32_t count;
+    std::memcpy(&count, chunk(k) + 4, 4);
+    return std::min<uint32_t>(count, static_cast<uint32_t>(_chunk_frames));
+}
+
+double recording_reader::chunk_time(size_t k, size_t i) const
+{
+    double t;
+    std::memcpy(&t, chunk(k) + RECORDING_CHUNK_HEADER_SIZE + i * 8, 8);
+    return t;
+}
+
+uint64_t recording_reader::frames() const
+{
+    if (_chunks == 0)
+        return 0;
+    // Every appended session ends with a partial chunk, so count each one
+    uint64_t total = 0;
+    for (size_t k = 0; k < _chunks; ++k)
+        total += chunk_count(k);
+    return total;
+}
+
+double recording_reader::start_time() const
+{
+    return _chunks ? chunk_time(0, 0) : 0.0;
+}
+
+double recording_reader::end_time() const
+{
+    return _chunks ? chunk_time(_chunks - 1, chunk_count(_chunks - 1) - 1) : 0.0;
+}
+
+recording_reader::position recording_reader::seek(double time_ms) const
+{
+    // Last chunk whose first frame is <= time_ms
+    size_t lo = 0, hi = _chunks;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (chunk_time(mid, 0) <= time_ms)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return begin();
+    size_t k = lo - 1;
+
+    // First frame in it with time >= time_ms
+    uint32_t first = 0, last = chunk_count(k);
+    while (first < last)
+    {
+        uint32_t mid = (first + last) / 2;
+        if (chunk_time(k, mid) < time_ms)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    if (first == chunk_count(k))
+        return {k + 1, 0};
+    return {k, first};
+}
+
+recording_reader::position recording_reader::next(position pos) const
+{
+    if (++pos.index >= chunk_count(pos.chunk))
+    {
+        pos.index = 0;
+        ++pos.chunk;
+    }
+    return pos;
+}
+
+double recording_reader::time(position pos) const
+{
+    return chunk_time(pos.chunk, pos.index);
+}
+
+void recording_reader::coords(position pos, double *out) const
+{
+    const char *columns = chunk(pos.chunk) + RECORDING_CHUNK_HEADER_SIZE + _chunk_frames * 8;
+    for (size_t j = 0; j < _joints; ++j)
+    {
+        std::memcpy(out + j, columns + (j * _chunk_frames + pos.index) * 8, 8);
+    }
+}
+
+} // namespace webkin
@@ -0,0 +1,165 @@
+#pragma once
+
+/**
+ * On-disk joint recordings (--record / --replay).
+ *
+ * Append-only file of fixed-size columnar chunks (little-endian):
+ *
+ *   File header
+ *     char[8] magic            "WKREC001"
+ *     uint32  header_size      bytes, including names and padding
+ *     uint32  joints           J
+ *     uint32  chunk_frames     F
+ *     uint32  reserved
+ *     uint64  schema_hash      JointSchema::compute_hash(names)
+ *     names                    J zero-terminated strings, padded to 8
+ *
+ *   Chunk k at header_size + k * chunk_size,
+ *   chunk_size = 16 + 8 * F * (J + 1)
+ *     char[4] magic            "WKCH"
+ *     uint32  count            frames used, <= F
+ *     float64 first_time       time[0], the chunk's index entry
+ *     float64 time[F]          ms since Unix epoch, non-decreasing
+ *     float64 coords[J][F]     one column per joint
+ *
+ * Fixed-size chunks make the chunk headers a time index: a timestamp is
+ * found by binary search over the chunks, then within one chunk, without
+ * reading the rest of the file.
+ */
+
+#include "kinematic.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+constexpr char RECORDING_MAGIC[8] = {'W', 'K', 'R', 'E', 'C', '0', '0', '1'};
+constexpr char RECORDING_CHUNK_MAGIC[4] = {'W', 'K', 'C', 'H'};
+constexpr size_t RECORDING_CHUNK_HEADER_SIZE = 16;
+
+/**
+ * Background recorder. record() only copies into a preallocated chunk
+ * buffer; full chunks are written by a dedicated thread. If the disk
+ * falls behind and no free buffer is left, frames are dropped and
+ * counted instead of blocking ingest.
+ */
+class recording_writer
+{
+public:
+    recording_writer() = default;
+    ~recording_writer();
+
+    /**
+     * Create the file, or append to it if its header matches `names` and
+     * `chunk_frames`. Starts the writer thread.
+     */
+    bool open(const std::filesystem::path &path, const std::vector<std::string> &names,
+              uint32_t chunk_frames = 1024);
+
+    /// Write the partial chunk and stop the writer thread.
+    void close();
+
+    bool is_open() const { return _fd >= 0; }
+
+    /// Resolve the recorded joint names against a (re)loaded tree.
+    void bind(const KinematicTree &tree);
+
+    /// Append the tree's current coordinates. Joints missing from the tree are NaN.
+    void record(double time_ms, const KinematicTree &tree);
+
+    uint64_t frames_recorded() const { return _recorded; }
+    uint64_t frames_dropped() const { return _dropped; }
+
+private:
+    struct Chunk
+    {
+        std::vector<double> data; // time[F], then coords[J][F]
+        uint32_t count = 0;
+    };
+
+    int _fd = -1;
+    uint32_t _joints = 0;
+    uint32_t _chunk_frames = 0;
+    size_t _chunk_size = 0;
+    uint64_t _next_offset = 0;
+    std::vector<std::string> _names;
+    std::vector<uint32_t> _flat_index; // Per joint; UINT32_MAX if missing
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::unique_ptr<Chunk> _filling;
+    std::deque<std::unique_ptr<Chunk>> _full;
+    std::vector<std::unique_ptr<Chunk>> _free;
+    bool _running = false;
+    std::thread _thread;
+    std::atomic<uint64_t> _recorded{0};
+    std::atomic<uint64_t> _dropped{0};
+
+    void loop();
+    void write_chunk(const Chunk &chunk);
+};
+
+/// Read-only view of a recording through mmap.
+class recording_reader
+{
+public:
+    /// Position of a frame: chunk number and index within the chunk.
+    struct position
+    {
+        size_t chunk = 0;
+        uint32_t index = 0;
+    };
+
+    recording_reader() = default;
+    ~recording_reader();
+    recording_reader(const recording_reader &) = delete;
+    recording_reader &operator=(const recording_reader &) = delete;
+
+    bool open(const std::filesystem::path &path);
+    void close();
+
+    const std::vector<std::string> &names() const { return _names; }
+    size_t joints() const { return _joints; }
+    size_t chunks() const { return _chunks; }
+    uint64_t frames() const;
+
+    double start_time() const;
+    double end_time() const;
+
+    /// First frame with time >= time_ms (O(log n)); end() if none.
+    position seek(double time_ms) const;
+    position begin() const { return {}; }
+    position end() const { return {_chunks, 0}; }
+    bool at_end(position pos) const { return pos.chunk >= _chunks; }
+    position next(position pos) const;
+
+    double time(position pos) const;
+    /// Copy the coordinates of one frame into out[joints()].
+    void coords(position pos, double *out) const;
+
+private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+    size_t _header_size = 0;
+    size_t _joints = 0;
+    size_t _chunk_frames = 0;
+    size_t _chunk_size = 0;
+    size_t _chunks = 0;
+    std::vector<std::string> _names;
+
+    const char *chunk(size_t k) const { return _data + _header_size + k * _chunk_size; }
+    uint32_t chunk_count(size_t k) const;
+    double chunk_time(size_t k, size_t i) const;
+};
+
+} // namespace webkin
@@ -0,0 +1,298 @@
+/**
+ * Relay Listener implementation
+ */
+
+#include "relay_listener.hpp"
+
+#include <nos/print.h>
+#include <nos/trent/json.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace webkin
+{
+
+namespace
+{
+
+// Value of a response header, empty if missing; `headers` is lowercase
+std::string header_value(const std::string &headers, const std::string &lower, const std::string &name)
+{
+    const std::string field = "\r\n" + name + ":";
+    size_t at = lower.find(field);
+    if (at == std::string::npos)
+        return {};
+    size_t begin = headers.find_first_not_of(' ', at + field.size());
+    size_t end = headers.find("\r\n", begin);
+    return headers.substr(begin, end - begin);
+}
+
+} // namespace
+
+bool parse_relay_url(const std::string &url, relay_config &config)
+{
+    const std::string scheme = "ws://";
+    if (url.compare(0, scheme.size(), scheme) != 0)
+        return false;
+    size_t host_begin = scheme.size();
+    size_t path_begin = url.find('/', host_begin);
+    std::string authority = url.substr(host_begin, path_begin - host_begin);
+    std::string path = path_begin == std::string::npos ? "/ws" : url.substr(path_begin);
+
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos)
+    {
+        config.host = authority.substr(0, colon);
+        config.port = std::atoi(authority.c_str() + colon + 1);
+    }
+    else
+    {
+        config.host = authority;
+        config.port = 80;
+    }
+    if (config.host.empty() || config.port <= 0)
+        return false;
+
+    if (path == "/ws" || path == "/ws/")
+        config.robot.clear();
+    else if (path.compare(0, 4, "/ws/") == 0 && path.find('/', 4) == std::string::npos)
+        config.robot = path.substr(4);
+    else
+        return false;
+    return true;
+}
+
+relay_listener::~relay_listener()
+{
+    disconnect();
+}
+
+bool relay_listener::init(const relay_config &config)
+{
+    _config = config;
+    _ws_path = _config.robot.empty() ? "/ws" : "/ws/" + _config.robot;
+    nos::println("Relay: from ", url());
+    return true;
+}
+
+std::string relay_listener::url() const
+{
+    return "ws://" + _config.host + ":" + std::to_string(_config.port) + _ws_path;
+}
+
+bool relay_listener::connect()
+{
+    if (_running)
+        return false;
+    _running = true;
+    _thread = std::thread([this]()
+                          { loop(); });
+    return true;
+}
+
+void relay_listener::disconnect()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+        if (_ws)
+            _ws->shutdown();
+    }
+    _cv.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+bool relay_listener::forward(std::string_view message)
+{
+    std::shared_ptr<ws_client> ws;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ws = _ws;
+    }
+    return ws && _connected && ws->send_text(message);
+}
+
+int relay_listener::fetch(const std::string &target, std::string &body, std::string *content_type) const
+{
+    body.clear();
+    int fd = tcp_connect(_config.host, _config.port);
+    if (fd < 0)
+        return 0;
+    timeval timeout{10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string request = "GET " + target + " HTTP/1.1\r\nHost: " + _config.host + ":" +
+                          std::to_string(_config.port) + "\r\nConnection: close\r\n\r\n";
+    bool sent = ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size());
+
+    // Read to the end: the connection closes after the response
+    std::string response;
+    char buf[65536];
+    ssize_t n;
+    while (sent && (n = ::recv(fd, buf, sizeof(buf), 0)) > 0)
+        response.append(buf, static_cast<size_t>(n));
+    ::close(fd);
+
+    size_t end = response.find("\r\n\r\n");
+    if (end == std::string::npos || response.compare(0, 5, "HTTP/") != 0)
+        return 0;
+    size_t space = response.find(' ');
+    int status = space < end ? std::atoi(response.c_str() + space + 1) : 0;
+
+    std::string headers = response.substr(0, end + 2);
+    std::string lower = headers;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    body = response.substr(end + 4);
+    std::string length = header_value(headers, lower, "content-length");
+    if (!length.empty())
+    {
+        size_t expected = std::strtoull(length.c_str(), nullptr, 10);
+        if (body.size() < expected)
+            return 0; // Cut short
+        body.resize(expected);
+    }
+    if (content_type)
+        *content_type = header_value(headers, lower, "content-type");
+    return status;
+}
+
+void relay_listener::loop()
+{
+    bool warned = false;
+    while (_running)
+    {
+        auto ws = std::make_shared<ws_client>();
+        bool ok = ws->connect(_config.host, _config.port, _ws_path, WS_BINARY_SUBPROTOCOL) &&
+                  ws->subprotocol() == WS_BINARY_SUBPROTOCOL;
+        if (ok)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_running)
+                break;
+            _ws = ws;
+        }
+        else
+        {
+            if (!warned)
+                nos::println("Relay: cannot connect to ", url(), ", retrying");
+            warned = true;
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait_for(lock, std::chrono::seconds(1), [this]()
+                         { return !_running; });
+            continue;
+        }
+
+        nos::println("Relay: connected to ", url());
+        warned = false;
+        _connected = true;
+        auto on_message = [this](std::string_view payload, bool binary)
+        {
+            if (!binary)
+            {
+                handle_text(payload);
+                return;
+            }
+            if (decode_pose_frame(payload, _records) && _on_poses)
+            {
+                ++_frames;
+                _on_poses(_records);
+            }
+        };
+        while (_running && ws->read(on_message))
+        {
+        }
+        _connected = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ws.reset();
+        }
+        if (_running)
+            nos::println("Relay: connection to ", url(), " lost, reconnecting");
+    }
+}
+
+void relay_listener::handle_text(std::string_view text)
+{
+    // Proximity reports, the frequent text message, are passed on as they
+    // are (ProximityMonitor writes the type first)
+    if (text.substr(0, 20) == R"({"type":"proximity",)")
+    {
+        if (_on_proximity)
+            _on_proximity(std::string(text));
+        return;
+    }
+
+    nos::trent message;
+    try
+    {
+        message = nos::json::parse(std::string(text));
+    }
+    catch (const std::exception &e)
+    {
+        nos::println("Relay: bad message: ", e.what());
+        return;
+    }
+    const nos::trent &msg = message;
+    std::string type = msg["type"].as_string_default("");
+    if (type == "scene_init")
+        handle_scene_init(msg);
+    if (_on_joints_info && msg["jointsInfo"].is_dict())
+        _on_joints_info(msg["jointsInfo"]);
+}
+
+// A scene_init follows every (re)connect and every tree change on the
+// primary; the tree is installed only if it or the node order differs
+void relay_listener::handle_scene_init(const nos::trent &message)
+{
+    std::vector<std::string> order;
+    const nos::trent &node_order = message["nodeOrder"];
+    if (node_order.is_list())
+    {
+        for (const auto &name : node_order.as_list())
+            order.push_back(name.as_string_default(""));
+    }
+
+    std::string target = "/api/tree";
+    if (!_config.robot.empty())
+        target += "?robot=" + _config.robot;
+    std::string body;
+    int status = fetch(target, body);
+    if (status != 200)
+    {
+        nos::println("Relay: cannot fetch the tree from ", _config.host, ":", _config.port, target,
+                     status ? " (status " + std::to_string(status) + ")" : std::string());
+        return;
+    }
+    if (body == _tree_body && order == _node_order)
+        return;
+
+    nos::trent tree;
+    try
+    {
+        tree = nos::json::parse(body);
+    }
+    catch (const std::exception &e)
+    {
+        nos::println("Relay: bad tree: ", e.what());
+        return;
+    }
+    if (!std::as_const(tree)["error"].is_nil())
+        return; // No tree on the primary yet
+
+    _tree_body = std::move(body);
+    _node_order = std::move(order);
+    if (_on_tree)
+        _on_tree(tree, _node_order);
+}
+
+} // namespace webkin
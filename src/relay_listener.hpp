@@ -0,0 +1,108 @@
+#pragma once
+
+/**
+ * Relay Listener for WebKin
+ *
+ * Subscribes to the /ws stream of another webkin server, the primary, as a
+ * binary client (webkin.binary.v1) and hands on what it receives: the
+ * tree, fetched from the primary's /api/tree whenever a scene_init
+ * announces a new one, the poses of the binary frames, jointsInfo and
+ * proximity messages. The relay computes no kinematics; it serves the
+ * received scene to its own clients. Reconnects while the primary is
+ * unreachable.
+ */
+
+#include "pose_frame.hpp"
+#include "ws_client.hpp"
+
+#include <nos/trent/trent.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+struct relay_config
+{
+    std::string host = "127.0.0.1";
+    int port = 8000;
+    std::string robot; // Robot id on the primary, empty for its default robot
+};
+
+/// Parse ws://HOST[:PORT]/ws[/ROBOT]; false if malformed.
+bool parse_relay_url(const std::string &url, relay_config &config);
+
+class relay_listener
+{
+public:
+    // Tree JSON and the primary's node order, which pose indices refer to
+    using tree_callback_t = std::function<void(const nos::trent &, const std::vector<std::string> &)>;
+    using poses_callback_t = std::function<void(const std::vector<PoseRecord> &)>;
+    using joints_info_callback_t = std::function<void(const nos::trent &)>;
+    using proximity_callback_t = std::function<void(std::string)>;
+
+    relay_listener() = default;
+    ~relay_listener();
+
+    bool init(const relay_config &config);
+    bool connect();
+    void disconnect();
+
+    void set_tree_callback(tree_callback_t cb) { _on_tree = std::move(cb); }
+    void set_poses_callback(poses_callback_t cb) { _on_poses = std::move(cb); }
+    void set_joints_info_callback(joints_info_callback_t cb) { _on_joints_info = std::move(cb); }
+    void set_proximity_callback(proximity_callback_t cb) { _on_proximity = std::move(cb); }
+
+    /// Send a client message (e.g. joint_update) to the primary; false
+    /// while not connected.
+    bool forward(std::string_view message);
+
+    /**
+     * HTTP GET of `target` (path and query) on the primary. Returns the
+     * status code, 0 if the request failed; the body and Content-Type go
+     * to `body` and `content_type`.
+     */
+    int fetch(const std::string &target, std::string &body, std::string *content_type = nullptr) const;
+
+    const relay_config &config() const { return _config; }
+    std::string url() const;
+
+    bool is_running() const { return _running; }
+    bool is_connected() const { return _connected; }
+    uint64_t frames() const { return _frames; }
+
+private:
+    relay_config _config;
+    std::string _ws_path;
+    std::atomic<bool> _running{false};
+    std::atomic<bool> _connected{false};
+    std::atomic<uint64_t> _frames{0}; // Binary pose frames received
+    std::thread _thread;
+
+    std::mutex _mutex; // Guards _ws and wakes reconnect waits
+    std::condition_variable _cv;
+    std::shared_ptr<ws_client> _ws;
+
+    std::string _tree_body; // Last tree fetched, to skip unchanged ones
+    std::vector<std::string> _node_order;
+    std::vector<PoseRecord> _records;
+
+    tree_callback_t _on_tree;
+    poses_callback_t _on_poses;
+    joints_info_callback_t _on_joints_info;
+    proximity_callback_t _on_proximity;
+
+    void loop();
+    void handle_text(std::string_view text);
+    void handle_scene_init(const nos::trent &message);
+};
+
+} // namespace webkin
@@ -0,0 +1,130 @@
+/**
+ * Replay Listener implementation
+ */
+
+#include "replay_listener.hpp"
+
+#include <nos/print.h>
+
+#include <chrono>
+
+namespace webkin
+{
+
+replay_listener::~replay_listener()
+{
+    disconnect();
+}
+
+bool replay_listener::init(const replay_config &config)
+{
+    _config = config;
+    if (_config.speed <= 0)
+        _config.speed = 1.0;
+    if (!_reader.open(_config.path))
+        return false;
+
+    _frames = _reader.frames();
+    nos::println("Replay: ", _config.path, ", ", _frames, " frames, ",
+                 (_reader.end_time() - _reader.start_time()) / 1000.0, " s, ",
+                 _reader.joints(), " joints");
+    return _frames > 0;
+}
+
+bool replay_listener::connect()
+{
+    if (_running || _frames == 0)
+        return false;
+    _running = true;
+    _thread = std::thread([this]()
+                          { loop(); });
+    return true;
+}
+
+void replay_listener::disconnect()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _cv.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void replay_listener::seek(double time_ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _seek_pending = true;
+        _seek_time = time_ms;
+    }
+    _cv.notify_all();
+}
+
+void replay_listener::loop()
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<double> coords(_reader.joints());
+
+    auto pos = _reader.seek(_reader.start_time() + _config.start_offset);
+    // Wall clock time at which the frame recorded at `origin` is due
+    auto wall_origin = clock::now();
+    double origin = _reader.at_end(pos) ? 0.0 : _reader.time(pos);
+    auto restart = [&](recording_reader::position p)
+    {
+        pos = p;
+        wall_origin = clock::now();
+        origin = _reader.time(pos);
+    };
+
+    while (_running)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_reader.at_end(pos))
+        {
+            if (_config.loop)
+            {
+                restart(_reader.begin());
+            }
+            else
+            {
+                // Stay at the last frame until a seek or shutdown
+                nos::println("Replay: end of recording");
+                _cv.wait(lock, [this]()
+                         { return !_running || _seek_pending; });
+            }
+        }
+        else
+        {
+            auto due = wall_origin + std::chrono::duration_cast<clock::duration>(
+                                         std::chrono::duration<double, std::milli>(
+                                             (_reader.time(pos) - origin) / _config.speed));
+            _cv.wait_until(lock, due, [this]()
+                           { return !_running || _seek_pending; });
+        }
+        if (!_running)
+            break;
+        if (_seek_pending)
+        {
+            _seek_pending = false;
+            auto target = _reader.seek(_seek_time);
+            if (_reader.at_end(target))
+                target = _reader.seek(_reader.end_time()); // Clamp to the last frame
+            restart(target);
+            continue;
+        }
+        lock.unlock();
+
+        if (_reader.at_end(pos))
+            continue;
+        double t = _reader.time(pos);
+        _reader.coords(pos, coords.data());
+        _position = t;
+        if (_on_frame)
+            _on_frame(t, coords.data());
+        pos = _reader.next(pos);
+    }
+}
+
+} // namespace webkin
@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * Replay Listener for WebKin
+ *
+ * Plays a joint recording (see recording.hpp) back as if the frames were
+ * arriving from a robot. The file is memory-mapped, so recordings larger
+ * than RAM replay without being loaded.
+ */
+
+#include "recording.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+struct replay_config
+{
+    std::string path;
+    double speed = 1.0;        // Relative to recorded time
+    double start_offset = 0.0; // ms after the first recorded frame
+    bool loop = false;         // Restart from the beginning at the end
+};
+
+class replay_listener
+{
+public:
+    // One frame: time (ms since epoch) and coords in names() order
+    using frame_callback_t = std::function<void(double, const double *)>;
+
+    replay_listener() = default;
+    ~replay_listener();
+
+    bool init(const replay_config &config);
+    bool connect();
+    void disconnect();
+
+    void set_frame_callback(frame_callback_t cb) { _on_frame = std::move(cb); }
+
+    /// Continue playback from the first frame at or after time_ms.
+    void seek(double time_ms);
+
+    const std::vector<std::string> &names() const { return _reader.names(); }
+    double start_time() const { return _reader.start_time(); }
+    double end_time() const { return _reader.end_time(); }
+    double position() const { return _position; }
+    uint64_t frames() const { return _frames; }
+
+    bool is_connected() const { return _running; }
+
+private:
+    replay_config _config;
+    recording_reader _reader;
+    uint64_t _frames = 0;
+    std::atomic<bool> _running{false};
+    std::atomic<double> _position{0.0};
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _seek_pending = false;
+    double _seek_time = 0.0;
+
+    frame_callback_t _on_frame;
+
+    void loop();
+};
+
+} // namespace webkin
@@ -0,0 +1,189 @@
+/**
+ * Streaming JSON for scene messages
+ */
+
+#include "scene_json.hpp"
+
+#include <charconv>
+#include <cmath>
+
+namespace webkin
+{
+
+void append_json_string(std::string &out, std::string_view s)
+{
+    static const char *hex = "0123456789abcdef";
+    out += '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                out += "\\u00";
+                out += hex[(c >> 4) & 0xf];
+                out += hex[c & 0xf];
+            }
+            else
+                out += c;
+        }
+    }
+    out += '"';
+}
+
+void append_json_number(std::string &out, double value, int decimals)
+{
+    if (!std::isfinite(value))
+    {
+        out += '0';
+        return;
+    }
+    char buf[64];
+    char *end = buf;
+    if (decimals >= 0)
+    {
+        auto res = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, decimals);
+        if (res.ec == std::errc())
+        {
+            end = res.ptr;
+            if (decimals > 0)
+            {
+                while (end[-1] == '0')
+                    --end;
+                if (end[-1] == '.')
+                    --end;
+            }
+            // Rounded to zero from below
+            if (end - buf == 2 && buf[0] == '-' && buf[1] == '0')
+            {
+                out += '0';
+                return;
+            }
+        }
+    }
+    // Shortest form, also for values too large for fixed notation
+    if (end == buf)
+        end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+    out.append(buf, end);
+}
+
+void SceneJsonWriter::begin(const char *type)
+{
+    _out.clear();
+    _out += "{\"type\":\"";
+    _out += type;
+    _out += "\",\"nodes\":{";
+}
+
+void SceneJsonWriter::node(const SceneSnapshot &scene, uint32_t index, bool with_model)
+{
+    const Pose &pose = scene.poses[index];
+    if (_out.back() != '{')
+        _out += ',';
+    _out += scene.layout->keys[index];
+    _out += "{\"pose\":{\"position\":[";
+    append_json_number(_out, pose.position.x, decimals);
+    _out += ',';
+    append_json_number(_out, pose.position.y, decimals);
+    _out += ',';
+    append_json_number(_out, pose.position.z, decimals);
+    _out += "],\"orientation\":[";
+    append_json_number(_out, pose.orientation.x, decimals);
+    _out += ',';
+    append_json_number(_out, pose.orientation.y, decimals);
+    _out += ',';
+    append_json_number(_out, pose.orientation.z, decimals);
+    _out += ',';
+    append_json_number(_out, pose.orientation.w, decimals);
+    _out += "]}";
+    if (with_model)
+    {
+        _out += ",\"model\":";
+        _out += scene.layout->models_json[index];
+    }
+    _out += '}';
+}
+
+void SceneJsonWriter::end(const SceneSnapshot &scene, bool with_info)
+{
+    _out += '}';
+    if (with_info)
+    {
+        _out += ",\"jointsInfo\":";
+        _out += *scene.joints_info_json;
+    }
+    if (send_ts > 0 && scene.trace.valid())
+    {
+        const SceneTrace &trace = scene.trace;
+        _out += ",\"trace\":{";
+        if (trace.seq >= 0)
+        {
+            _out += "\"seq\":";
+            _out += std::to_string(trace.seq);
+            _out += ',';
+        }
+        if (trace.source_ts > 0)
+        {
+            _out += "\"source_ts\":";
+            append_json_number(_out, trace.source_ts, 3);
+            _out += ',';
+        }
+        _out += "\"ingest_ts\":";
+        append_json_number(_out, trace.ingest_ts, 3);
+        _out += ",\"fk_ts\":";
+        append_json_number(_out, trace.fk_ts, 3);
+        _out += ",\"send_ts\":";
+        append_json_number(_out, send_ts, 3);
+        _out += '}';
+    }
+    _out += '}';
+}
+
+std::string_view SceneJsonWriter::scene_update(const SceneSnapshot &scene)
+{
+    begin("scene_update");
+    for (uint32_t i = 0; i < scene.size(); ++i)
+        node(scene, i, true);
+    end(scene, true);
+    return _out;
+}
+
+std::string_view SceneJsonWriter::scene_delta(const SceneSnapshot &scene, uint64_t since, bool with_info)
+{
+    begin("scene_delta");
+    for (uint32_t i = 0; i < scene.size(); ++i)
+    {
+        if (scene.pose_version[i] > since)
+            node(scene, i, false);
+    }
+    end(scene, with_info);
+    return _out;
+}
+
+std::string_view SceneJsonWriter::nodes_delta(const SceneSnapshot &scene, const std::vector<uint32_t> &nodes,
+                                              bool with_info)
+{
+    begin("scene_delta");
+    for (uint32_t i : nodes)
+        node(scene, i, false);
+    end(scene, with_info);
+    return _out;
+}
+
+} // namespace webkin
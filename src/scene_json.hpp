@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Scene messages serialized straight from snapshots.
+ *
+ * Broadcasts used to build a nos::trent dict per message, allocating a
+ * map node and a key string for every field of every pose before
+ * printing it. SceneJsonWriter appends the pose arrays of a SceneSnapshot
+ * directly into a reused buffer instead. Node names, models and jointsInfo
+ * do not change between pose updates, so the publisher serializes them
+ * once (SceneLayout::keys, SceneLayout::models_json and
+ * SceneSnapshot::joints_info_json) and the writer only copies them.
+ */
+
+#include "scene_snapshot.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace webkin
+{
+
+/// Append `s` as a quoted JSON string.
+void append_json_string(std::string &out, std::string_view s);
+
+/**
+ * Append a number rounded to `decimals` digits after the point, trailing
+ * zeros dropped; with decimals < 0 the shortest text that round-trips.
+ * Non-finite values, which JSON cannot represent, are written as 0.
+ */
+void append_json_number(std::string &out, double value, int decimals);
+
+class SceneJsonWriter
+{
+public:
+    explicit SceneJsonWriter(int decimals = 6) : decimals(decimals) {}
+
+    int decimals; // Precision of pose numbers, see append_json_number()
+
+    // Send time (ms since the epoch) of the next messages. When set, the
+    // snapshot's SceneTrace is appended as "trace" with it.
+    double send_ts = 0;
+
+    /// scene_update: pose and model of every node, and jointsInfo.
+    std::string_view scene_update(const SceneSnapshot &scene);
+
+    /// scene_delta with the poses changed after version `since`.
+    std::string_view scene_delta(const SceneSnapshot &scene, uint64_t since, bool with_info);
+
+    /// scene_delta with the poses of the given nodes.
+    std::string_view nodes_delta(const SceneSnapshot &scene, const std::vector<uint32_t> &nodes, bool with_info);
+
+private:
+    void begin(const char *type);
+    void node(const SceneSnapshot &scene, uint32_t index, bool with_model);
+    void end(const SceneSnapshot &scene, bool with_info);
+
+    std::string _out;
+};
+
+} // namespace webkin
@@ -0,0 +1,122 @@
+/**
+ * Scene snapshot publishing
+ */
+
+#include "scene_snapshot.hpp"
+#include "scene_json.hpp"
+
+#include <nos/trent/json_print.h>
+
+namespace webkin
+{
+
+nos::trent SceneSnapshot::scene_data() const
+{
+    nos::trent result;
+    result.init(nos::trent::type::dict);
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        nos::trent node_data;
+        node_data.init(nos::trent::type::dict);
+        node_data["pose"] = poses[i].to_trent();
+        node_data["model"] = layout->models[i];
+        result[layout->names[i]] = std::move(node_data);
+    }
+    return result;
+}
+
+void SceneSnapshot::changed_since(uint64_t since, std::vector<uint32_t> &out) const
+{
+    out.clear();
+    for (size_t i = 0; i < pose_version.size(); ++i)
+    {
+        if (pose_version[i] > since)
+            out.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+ScenePublisher::ScenePublisher()
+{
+    auto layout = std::make_shared<SceneLayout>();
+    layout->joint_names.init(nos::trent::type::list);
+    layout->node_order.init(nos::trent::type::list);
+    _layout = std::move(layout);
+
+    auto info = std::make_shared<nos::trent>();
+    info->init(nos::trent::type::dict);
+    _joints_info = std::move(info);
+    _joints_info_json = std::make_shared<const std::string>("{}");
+
+    auto snapshot = std::make_shared<SceneSnapshot>();
+    snapshot->layout = _layout;
+    snapshot->joints_info = _joints_info;
+    snapshot->joints_info_json = _joints_info_json;
+    _current.store(std::move(snapshot), std::memory_order_release);
+}
+
+void ScenePublisher::reset(const KinematicTree &tree)
+{
+    auto layout = std::make_shared<SceneLayout>();
+    layout->names.reserve(tree.nodes.size());
+    layout->models.reserve(tree.nodes.size());
+    for (const auto *node : tree.nodes)
+    {
+        layout->names.emplace_back(node->name);
+        layout->models.push_back(node->model);
+        std::string key;
+        append_json_string(key, node->name);
+        key += ':';
+        layout->keys.push_back(std::move(key));
+        layout->models_json.push_back(nos::json::to_string(node->model));
+    }
+    layout->parents = tree.flat.parent;
+    layout->joint_names = tree.get_joint_names_trent();
+    layout->node_order = tree.get_node_order_trent();
+    _layout = std::move(layout);
+
+    _pose_version.assign(tree.nodes.size(), 0);
+    ++_tree_version;
+    _info_dirty = true;
+    _poses_dirty = true;
+}
+
+void ScenePublisher::publish(const KinematicTree &tree, FlatTree &poses, const SceneTrace &trace)
+{
+    ++_version;
+
+    if (_poses_dirty || _pose_version.size() != poses.size())
+    {
+        _pose_version.assign(poses.size(), _version);
+        _poses_dirty = false;
+    }
+    else
+    {
+        for (uint32_t i : poses.changed_list)
+        {
+            _pose_version[i] = _version;
+        }
+    }
+    poses.clear_changed();
+
+    if (_info_dirty)
+    {
+        _joints_info = std::make_shared<const nos::trent>(tree.get_joints_info());
+        _joints_info_json = std::make_shared<const std::string>(nos::json::to_string(*_joints_info));
+        ++_info_version;
+        _info_dirty = false;
+    }
+
+    auto snapshot = std::make_shared<SceneSnapshot>();
+    snapshot->version = _version;
+    snapshot->tree_version = _tree_version;
+    snapshot->info_version = _info_version;
+    snapshot->layout = _layout;
+    snapshot->joints_info = _joints_info;
+    snapshot->joints_info_json = _joints_info_json;
+    snapshot->poses = poses.global_pose;
+    snapshot->pose_version = _pose_version;
+    snapshot->trace = trace;
+    _current.store(std::move(snapshot), std::memory_order_release);
+}
+
+} // namespace webkin
@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+ * Immutable scene snapshots.
+ *
+ * The ingest side (transport callbacks, REST and WebSocket handlers) owns
+ * the KinematicTree under the writer lock. After every update it publishes
+ * a SceneSnapshot: a read-only copy of the global poses plus version
+ * counters. Readers (/api/scene, the broadcaster, scene_init on connect)
+ * load the current snapshot with an atomic pointer read and never take the
+ * writer lock. A snapshot lives until its last reader drops it.
+ */
+
+#include "kinematic.hpp"
+
+#include <nos/trent/trent.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace webkin
+{
+
+/// Per-tree data that does not change between pose updates.
+struct SceneLayout
+{
+    std::vector<std::string> names; // Node names in flat index order
+    std::vector<nos::trent> models; // Node "model" passthrough, same order
+    std::vector<int32_t> parents;   // Parent flat index, -1 for roots
+    nos::trent joint_names;         // List of joint names
+    nos::trent node_order;          // names as a trent list
+    std::vector<std::string> keys;        // JSON-quoted names followed by ':'
+    std::vector<std::string> models_json; // models serialized as JSON
+};
+
+/// Timing of the joint message behind a snapshot, in ms since the epoch.
+struct SceneTrace
+{
+    double source_ts = 0; // Robot timestamp; 0 if the message had none
+    int64_t seq = -1;     // Robot sequence number; -1 if none
+    double ingest_ts = 0; // Received by the server; 0 if not from a joint message
+    double fk_ts = 0;     // Forward kinematics done
+
+    bool valid() const { return ingest_ts > 0; }
+};
+
+struct SceneSnapshot
+{
+    uint64_t version = 0;      // Increments with every publish
+    uint64_t tree_version = 0; // Increments when a tree is loaded
+    uint64_t info_version = 0; // Increments when jointsInfo changes
+
+    std::shared_ptr<const SceneLayout> layout;
+    std::shared_ptr<const nos::trent> joints_info;
+    std::shared_ptr<const std::string> joints_info_json; // joints_info serialized
+    std::vector<Pose> poses;            // Global poses in flat index order
+    std::vector<uint64_t> pose_version; // Version at which each pose last changed
+    SceneTrace trace;
+
+    size_t size() const { return poses.size(); }
+
+    /// {name: {pose, model}} for all nodes.
+    nos::trent scene_data() const;
+
+    /// Indices of the nodes whose pose changed after version `since`.
+    void changed_since(uint64_t since, std::vector<uint32_t> &out) const;
+};
+
+/**
+ * Single-writer publisher. reset(), invalidate_*() and publish() are
+ * called by the writer under its lock; current() is safe from any thread.
+ */
+class ScenePublisher
+{
+public:
+    ScenePublisher();
+
+    /// A new tree was loaded: rebuild the layout and bump tree_version.
+    void reset(const KinematicTree &tree);
+
+    /// Joint limits or axis parameters changed.
+    void invalidate_joints_info() { _info_dirty = true; }
+
+    /// Every pose counts as changed with the next publish.
+    void invalidate_poses() { _poses_dirty = true; }
+
+    /// Publish the tree's current poses. Consumes tree.flat's change set.
+    void publish(KinematicTree &tree, const SceneTrace &trace = {}) { publish(tree, tree.flat, trace); }
+
+    /// Publish the poses of `poses`, a copy of tree.flat evaluated at other
+    /// coordinates (see JointSmoother). Consumes its change set.
+    void publish(const KinematicTree &tree, FlatTree &poses, const SceneTrace &trace = {});
+
+    std::shared_ptr<const SceneSnapshot> current() const
+    {
+        return _current.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<std::shared_ptr<const SceneSnapshot>> _current;
+    std::shared_ptr<const SceneLayout> _layout;
+    std::shared_ptr<const nos::trent> _joints_info;
+    std::shared_ptr<const std::string> _joints_info_json;
+    std::vector<uint64_t> _pose_version;
+    uint64_t _version = 0;
+    uint64_t _tree_version = 0;
+    uint64_t _info_version = 0;
+    bool _info_dirty = false;
+    bool _poses_dirty = false;
+};
+
+} // namespace webkin
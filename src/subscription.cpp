@@ -0,0 +1,99 @@
+/**
+ * WebSocket client subscriptions
+ */
+
+#include "subscription.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace webkin
+{
+
+namespace
+{
+    bool read_names(const nos::trent &list, const char *field, std::vector<std::string> &out,
+                    std::string &error)
+    {
+        out.clear();
+        if (list.is_nil())
+            return true;
+        if (!list.is_list())
+        {
+            error = std::string(field) + " must be a list of node names";
+            return false;
+        }
+        for (const auto &name : list.as_list())
+        {
+            if (!name.is_string())
+            {
+                error = std::string(field) + " must be a list of node names";
+                return false;
+            }
+            out.push_back(name.as_string());
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return true;
+    }
+
+    void append_names(std::string &key, const std::vector<std::string> &names)
+    {
+        for (const auto &name : names)
+        {
+            key += std::to_string(name.size());
+            key += ':';
+            key += name;
+        }
+        key += '|';
+    }
+}
+
+bool Subscription::from_trent(const nos::trent &message, Subscription &out, std::string &error)
+{
+    if (!read_names(message["nodes"], "nodes", out.nodes, error) ||
+        !read_names(message["subtrees"], "subtrees", out.subtrees, error))
+        return false;
+    out.max_rate = message["max_rate"].as_numer_default(0);
+    if (!std::isfinite(out.max_rate) || out.max_rate < 0)
+    {
+        error = "max_rate must be a non-negative number";
+        return false;
+    }
+    return true;
+}
+
+std::string Subscription::key() const
+{
+    std::string key;
+    append_names(key, nodes);
+    append_names(key, subtrees);
+    key += std::to_string(max_rate);
+    return key;
+}
+
+void Subscription::select(const SceneLayout &layout, std::vector<uint32_t> &out) const
+{
+    out.clear();
+    const size_t n = layout.names.size();
+    if (nodes.empty() && subtrees.empty())
+    {
+        for (size_t i = 0; i < n; ++i)
+            out.push_back(static_cast<uint32_t>(i));
+        return;
+    }
+
+    // Parents precede children, so one pass marks whole subtrees
+    std::vector<uint8_t> in_subtree(n, 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const std::string &name = layout.names[i];
+        int32_t parent = layout.parents[i];
+        in_subtree[i] = (parent >= 0 && in_subtree[parent]) ||
+                        std::binary_search(subtrees.begin(), subtrees.end(), name);
+        if (in_subtree[i] || std::binary_search(nodes.begin(), nodes.end(), name))
+            out.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+} // namespace webkin
@@ -0,0 +1,47 @@
+#pragma once
+
+/**
+ * WebSocket client subscriptions.
+ *
+ * A client narrows its updates with
+ *
+ *   {"type": "subscribe", "nodes": ["tcp"], "subtrees": ["wrist"], "max_rate": 5}
+ *
+ * nodes are selected by name, subtrees by their root (the root and all
+ * its descendants); without either every node is selected. max_rate caps
+ * the updates per second, 0 keeps the broadcast rate. Clients with equal
+ * subscriptions form one group, whose payloads are built once per
+ * broadcast; key() identifies the group.
+ */
+
+#include "scene_snapshot.hpp"
+
+#include <nos/trent/trent.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace webkin
+{
+
+struct Subscription
+{
+    std::vector<std::string> nodes;    // Sorted, unique
+    std::vector<std::string> subtrees; // Sorted, unique
+    double max_rate = 0;               // Hz, 0 = every broadcast
+
+    /// Parse a subscribe message. Returns false with `error` set if malformed.
+    static bool from_trent(const nos::trent &message, Subscription &out, std::string &error);
+
+    /// Everything at the broadcast rate, i.e. no subscription at all.
+    bool is_default() const { return nodes.empty() && subtrees.empty() && max_rate <= 0; }
+
+    std::string key() const;
+
+    /// Flat indices of the selected nodes in ascending order. Unknown names
+    /// select nothing.
+    void select(const SceneLayout &layout, std::vector<uint32_t> &out) const;
+};
+
+} // namespace webkin
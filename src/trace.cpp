@@ -0,0 +1,179 @@
+/**
+ * Per-thread trace rings and Chrome trace-event export
+ */
+
+#include "trace.hpp"
+#include "scene_json.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace webkin
+{
+
+namespace trace
+{
+
+std::atomic<int> g_holders{0};
+
+namespace
+{
+    constexpr size_t DETAIL_WORDS = TRACE_DETAIL_SIZE / sizeof(uint64_t);
+
+    struct Slot
+    {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> duration{0};
+        std::atomic<uint64_t> detail[DETAIL_WORDS]{};
+    };
+
+    // Written by its thread only. `claimed` is bumped before a slot is
+    // rewritten and `head` after, so a reader sees which slots it may
+    // have copied half-written.
+    struct ThreadRing
+    {
+        uint32_t tid = 0;
+        std::atomic<uint64_t> claimed{0};
+        std::atomic<uint64_t> head{0};
+        std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(TRACE_RING_SIZE);
+    };
+
+    std::mutex g_rings_mutex;
+    std::vector<std::shared_ptr<ThreadRing>> g_rings; // Kept after their thread exits
+
+    // Allocated on the thread's first span
+    ThreadRing &thread_ring()
+    {
+        thread_local std::shared_ptr<ThreadRing> ring = []()
+        {
+            auto r = std::make_shared<ThreadRing>();
+            std::lock_guard<std::mutex> lock(g_rings_mutex);
+            r->tid = static_cast<uint32_t>(g_rings.size() + 1);
+            g_rings.push_back(r);
+            return r;
+        }();
+        return *ring;
+    }
+
+    struct Event
+    {
+        const char *name;
+        uint64_t start;
+        uint64_t duration;
+        uint64_t detail[DETAIL_WORDS];
+    };
+
+    void append_us(std::string &out, uint64_t ns)
+    {
+        append_json_number(out, static_cast<double>(ns) / 1000.0, 3);
+    }
+}
+
+void retain()
+{
+    g_holders.fetch_add(1, std::memory_order_relaxed);
+}
+
+void release()
+{
+    g_holders.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void record(const char *name, uint64_t start_ns, uint64_t end_ns, std::string_view detail)
+{
+    ThreadRing &ring = thread_ring();
+    uint64_t index = ring.head.load(std::memory_order_relaxed);
+    ring.claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Slot &slot = ring.slots[index & (TRACE_RING_SIZE - 1)];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start_ns, std::memory_order_relaxed);
+    slot.duration.store(end_ns - start_ns, std::memory_order_relaxed);
+    uint64_t words[DETAIL_WORDS] = {};
+    std::memcpy(words, detail.data(), std::min(detail.size(), TRACE_DETAIL_SIZE));
+    for (size_t i = 0; i < DETAIL_WORDS; ++i)
+        slot.detail[i].store(words[i], std::memory_order_relaxed);
+
+    ring.head.store(index + 1, std::memory_order_release);
+}
+
+std::string chrome_json(double window_ms)
+{
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        rings = g_rings;
+    }
+
+    uint64_t now = now_ns();
+    uint64_t window = static_cast<uint64_t>(std::max(0.0, window_ms) * 1e6);
+    uint64_t cutoff = now > window ? now - window : 0;
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::vector<Event> events;
+    for (const auto &ring : rings)
+    {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t from = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        events.clear();
+        for (uint64_t i = from; i < head; ++i)
+        {
+            const Slot &slot = ring->slots[i & (TRACE_RING_SIZE - 1)];
+            Event e;
+            e.name = slot.name.load(std::memory_order_relaxed);
+            e.start = slot.start.load(std::memory_order_relaxed);
+            e.duration = slot.duration.load(std::memory_order_relaxed);
+            for (size_t w = 0; w < DETAIL_WORDS; ++w)
+                e.detail[w] = slot.detail[w].load(std::memory_order_relaxed);
+            events.push_back(e);
+        }
+        // Slot i is rewritten by span i + TRACE_RING_SIZE
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t claimed = ring->claimed.load(std::memory_order_relaxed);
+        size_t skip = claimed > from + TRACE_RING_SIZE ? claimed - from - TRACE_RING_SIZE : 0;
+
+        bool named = false;
+        for (size_t k = skip; k < events.size(); ++k)
+        {
+            const Event &e = events[k];
+            if (!e.name || e.start < cutoff)
+                continue;
+            if (!first)
+                out += ',';
+            first = false;
+            if (!named)
+            {
+                out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(ring->tid) +
+                       ",\"args\":{\"name\":\"thread " + std::to_string(ring->tid) + "\"}},";
+                named = true;
+            }
+            out += "{\"name\":";
+            append_json_string(out, e.name);
+            out += ",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(ring->tid) + ",\"ts\":";
+            append_us(out, e.start);
+            out += ",\"dur\":";
+            append_us(out, e.duration);
+            const char *detail = reinterpret_cast<const char *>(e.detail);
+            size_t detail_size = strnlen(detail, TRACE_DETAIL_SIZE);
+            if (detail_size > 0)
+            {
+                out += ",\"args\":{\"detail\":";
+                append_json_string(out, std::string_view(detail, detail_size));
+                out += '}';
+            }
+            out += '}';
+        }
+    }
+    out += "]}";
+    return out;
+}
+
+} // namespace trace
+
+} // namespace webkin
@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * In-process trace spans, exported as Chrome trace-event JSON
+ * (GET /debug/trace, opened in chrome://tracing or Perfetto).
+ *
+ * TraceSpan marks a stage (ingest, FK, serialize, send, an HTTP request)
+ * on the calling thread. While tracing is off a span costs one relaxed
+ * atomic load. While it is on, every thread writes its spans into its own
+ * ring buffer of the last TRACE_RING_SIZE spans: no lock and no
+ * allocation, the single writer just overwrites the oldest slot. Slots
+ * are relaxed atomics, so the exporter may copy them concurrently and
+ * only drops the slots overwritten during the copy.
+ *
+ * Tracing is on while at least one holder has retained it: --trace keeps
+ * it on for the whole run, a /debug/trace capture for its window.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace webkin
+{
+
+namespace trace
+{
+
+constexpr size_t TRACE_RING_SIZE = 1 << 14; // Spans per thread
+constexpr size_t TRACE_DETAIL_SIZE = 32;    // Bytes of detail text kept per span
+
+extern std::atomic<int> g_holders;
+
+inline bool active() { return g_holders.load(std::memory_order_relaxed) > 0; }
+
+/// Turn tracing on until the matching release().
+void retain();
+void release();
+
+/// Trace clock: steady nanoseconds.
+inline uint64_t now_ns()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/// Record a finished span on this thread. `name` must outlive the trace
+/// (a string literal); `detail`, e.g. a URL, is copied and truncated.
+void record(const char *name, uint64_t start_ns, uint64_t end_ns, std::string_view detail = {});
+
+/// Spans of all threads that started within the last `window_ms`, as
+/// {"traceEvents": [...]} with complete ("X") events in microseconds.
+std::string chrome_json(double window_ms);
+
+} // namespace trace
+
+/// Records the lifetime of the scope as a span if tracing is active.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name) : _name(name), _start(trace::active() ? trace::now_ns() : 0) {}
+    ~TraceSpan()
+    {
+        if (_start)
+            trace::record(_name, _start, trace::now_ns());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *_name;
+    uint64_t _start;
+};
+
+} // namespace webkin
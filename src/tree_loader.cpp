@@ -0,0 +1,236 @@
+/**
+ * Background loading of a robot's tree
+ */
+
+#include "tree_loader.hpp"
+
+#include <nos/print.h>
+#include <nos/trent/json.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace webkin
+{
+
+tree_loader::~tree_loader()
+{
+    stop();
+}
+
+void tree_loader::set_models(std::shared_ptr<const K3DLoader> models)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _models = std::move(models);
+}
+
+void tree_loader::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_thread.joinable())
+        return;
+    _stop = false;
+    _thread = std::thread([this]()
+                          { loop(); });
+}
+
+void tree_loader::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void tree_loader::load_file(const std::filesystem::path &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = true;
+        _pending_path = path;
+        _pending_archive.clear();
+    }
+    _wake.notify_all();
+}
+
+void tree_loader::load_archive(std::string data)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = true;
+        _pending_path.clear();
+        _pending_archive = std::move(data);
+    }
+    _wake.notify_all();
+}
+
+void tree_loader::watch(const std::filesystem::path &path, std::chrono::milliseconds interval)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _watched = path;
+        _interval = interval;
+        _seen = stamp_of(path);
+        _settling = false;
+    }
+    _wake.notify_all();
+}
+
+tree_loader::state tree_loader::status() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _state;
+}
+
+tree_loader::result tree_loader::load_path(const std::filesystem::path &path, const std::string &models_url,
+                                           const K3DLoader *previous)
+{
+    if (!std::filesystem::exists(path))
+    {
+        throw std::runtime_error("Tree file not found: " + path.string());
+    }
+
+    result loaded;
+    loaded.source = path.string();
+    if (path.extension() == ".json")
+    {
+        std::ifstream file(path);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        loaded.tree = nos::json::parse(buffer.str());
+        return loaded;
+    }
+
+    auto models = std::make_shared<K3DLoader>();
+    models->set_models_url(models_url);
+    if (std::filesystem::is_directory(path))
+        loaded.tree = models->load_directory(path);
+    else
+        loaded.tree = models->load_file(path, previous);
+    loaded.models = std::move(models);
+    return loaded;
+}
+
+tree_loader::Stamp tree_loader::stamp_of(const std::filesystem::path &path)
+{
+    std::filesystem::path file = path;
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+        file /= "k3d.json";
+
+    Stamp stamp;
+    stamp.time = std::filesystem::last_write_time(file, ec);
+    if (ec)
+        return {};
+    stamp.size = std::filesystem::file_size(file, ec);
+    return ec ? Stamp{} : stamp;
+}
+
+// Caller holds _mutex
+void tree_loader::poll_watched()
+{
+    Stamp now = stamp_of(_watched);
+    if (now == Stamp{} || now == _seen)
+    {
+        // Missing (e.g. replaced by a rename right now) or unchanged
+        _settling = false;
+        return;
+    }
+    if (_settling && now == _changed)
+    {
+        _seen = now;
+        _settling = false;
+        if (!_pending)
+        {
+            _pending = true;
+            _pending_path = _watched;
+            _pending_archive.clear();
+            nos::println("Tree file changed: ", _watched.string());
+        }
+        return;
+    }
+    _changed = now;
+    _settling = true;
+}
+
+void tree_loader::loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop)
+    {
+        if (!_pending)
+        {
+            if (_watched.empty())
+                _wake.wait(lock, [this]()
+                           { return _stop || _pending; });
+            else
+                _wake.wait_for(lock, _interval, [this]()
+                               { return _stop || _pending; });
+            if (_stop)
+                break;
+            if (!_watched.empty())
+                poll_watched();
+            if (!_pending)
+                continue;
+        }
+
+        std::filesystem::path path = std::move(_pending_path);
+        std::string archive = std::move(_pending_archive);
+        _pending = false;
+        _pending_path.clear();
+        _pending_archive.clear();
+        std::shared_ptr<const K3DLoader> previous = _models;
+        _state.source = path.empty() ? "upload" : path.string();
+        _state.loading = true;
+        lock.unlock();
+
+        result loaded;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            if (!path.empty())
+            {
+                loaded = load_path(path, _models_url, previous.get());
+            }
+            else
+            {
+                auto models = std::make_shared<K3DLoader>();
+                models->set_models_url(_models_url);
+                loaded.tree = models->load_archive(archive, previous.get());
+                loaded.models = std::move(models);
+                loaded.source = "upload";
+            }
+            if (_ready)
+                _ready(loaded);
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        _state.loading = false;
+        _state.error = error;
+        if (error.empty())
+        {
+            ++_state.loads;
+            if (loaded.models)
+                _models = std::move(loaded.models);
+            nos::println("Reloaded tree from ", _state.source, " in ", seconds, " s");
+        }
+        else
+        {
+            nos::println("Failed to load tree from ", _state.source, ": ", error);
+        }
+    }
+}
+
+} // namespace webkin
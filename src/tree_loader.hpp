@@ -0,0 +1,118 @@
+#pragma once
+
+/**
+ * Background loading of a robot's tree.
+ *
+ * load_file() and load_archive() queue a K3D archive, a K3D directory or a
+ * tree JSON file and return at once. A loader thread extracts and parses
+ * it and preprocesses the models without any robot lock, then hands the
+ * result to the ready callback, which swaps it in; joint ingest keeps
+ * running meanwhile. Of several sources queued during one load only the
+ * latest is loaded. Archive models whose bytes did not change since the
+ * previous load keep their meshes, levels of detail and hashes, so their
+ * URLs, and the copies clients already have, stay valid.
+ *
+ * watch() polls a file (for a directory, its k3d.json) and loads it again
+ * once it has changed and then stayed the same for one poll interval, so
+ * a file still being written is not read.
+ */
+
+#include "k3d_loader.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <nos/trent/trent.h>
+
+namespace webkin
+{
+
+class tree_loader
+{
+public:
+    struct result
+    {
+        nos::trent tree;                         // webkin tree JSON
+        std::shared_ptr<const K3DLoader> models; // Null for a tree JSON file
+        std::string source;                      // Path, or "upload"
+    };
+
+    struct state
+    {
+        std::string source; // Of the latest load
+        bool loading = false;
+        uint64_t loads = 0; // Successful ones
+        std::string error;  // Of the latest load, empty if it succeeded
+    };
+
+    using ready_callback = std::function<void(result &)>;
+
+    ~tree_loader();
+
+    void set_models_url(const std::string &prefix) { _models_url = prefix; }
+
+    /// Runs on the loader thread for every successful load.
+    void set_ready_callback(ready_callback callback) { _ready = std::move(callback); }
+
+    /// Models of a tree loaded before start(), to be reused by the next load.
+    void set_models(std::shared_ptr<const K3DLoader> models);
+
+    void start();
+    void stop();
+
+    void load_file(const std::filesystem::path &path);
+    void load_archive(std::string data);
+
+    /// Reload `path` whenever it changes; polled every `interval`.
+    void watch(const std::filesystem::path &path, std::chrono::milliseconds interval);
+
+    state status() const;
+
+    /**
+     * Load a source synchronously: a K3D archive or directory, or with a
+     * .json extension a tree JSON file. Throws on errors.
+     */
+    static result load_path(const std::filesystem::path &path, const std::string &models_url,
+                            const K3DLoader *previous = nullptr);
+
+private:
+    struct Stamp
+    {
+        std::filesystem::file_time_type time{};
+        uintmax_t size = 0;
+        bool operator==(const Stamp &) const = default;
+    };
+
+    std::string _models_url = "/k3d/models/";
+    ready_callback _ready;
+    std::shared_ptr<const K3DLoader> _models; // Of the latest archive, reused
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _pending = false;
+    std::filesystem::path _pending_path;
+    std::string _pending_archive; // Used if _pending_path is empty
+
+    std::filesystem::path _watched;
+    std::chrono::milliseconds _interval{1000};
+    Stamp _seen;         // Of the watched file when last loaded
+    Stamp _changed;      // Differs from _seen, waiting to settle
+    bool _settling = false;
+
+    state _state;
+    bool _stop = false;
+    std::thread _thread;
+
+    void loop();
+    void poll_watched();
+    static Stamp stamp_of(const std::filesystem::path &path);
+};
+
+} // namespace webkin
@@ -0,0 +1,96 @@
+/**
+ * Persistent worker pool implementation
+ */
+
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+namespace webkin
+{
+
+WorkerPool::WorkerPool(unsigned workers)
+{
+    _threads.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i)
+        _threads.emplace_back([this]()
+                              { loop(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto &thread : _threads)
+        thread.join();
+}
+
+WorkerPool &WorkerPool::shared()
+{
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void WorkerPool::run(unsigned parts, const std::function<void(unsigned)> &fn)
+{
+    if (parts <= 1 || _threads.empty())
+    {
+        for (unsigned part = 0; part < parts; ++part)
+            fn(part);
+        return;
+    }
+
+    Job job{&fn, parts};
+    std::unique_lock<std::mutex> lock(_mutex);
+    _jobs.push_back(&job);
+    _wake.notify_all();
+
+    // Help with our own job, then wait for the parts the workers took
+    while (job.next < job.parts)
+    {
+        unsigned part = job.next++;
+        if (job.next == job.parts)
+            _jobs.erase(std::find(_jobs.begin(), _jobs.end(), &job));
+        lock.unlock();
+        fn(part);
+        lock.lock();
+        ++job.done;
+    }
+    _done.wait(lock, [&job]()
+               { return job.done == job.parts; });
+}
+
+bool WorkerPool::claim(std::unique_lock<std::mutex> &lock, Job *&job, unsigned &part)
+{
+    _wake.wait(lock, [this]()
+               { return _stop || !_jobs.empty(); });
+    if (_stop)
+        return false;
+    job = _jobs.front();
+    part = job->next++;
+    if (job->next == job->parts)
+        _jobs.pop_front();
+    return true;
+}
+
+void WorkerPool::loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    Job *job;
+    unsigned part;
+    while (claim(lock, job, part))
+    {
+        lock.unlock();
+        (*job->fn)(part);
+        lock.lock();
+        // The caller may return once done reaches parts: job is not
+        // touched after this
+        if (++job->done == job->parts)
+            _done.notify_all();
+    }
+}
+
+} // namespace webkin
@@ -0,0 +1,62 @@
+#pragma once
+
+/**
+ * Persistent worker threads for data-parallel work.
+ *
+ * One shared pool of hardware_concurrency() - 1 threads serves every
+ * caller, so a batch request costs no thread creation and concurrent
+ * requests share the cores instead of each starting its own set. The
+ * calling thread works on its own job too, and jobs from several callers
+ * are served in arrival order.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace webkin
+{
+
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned workers);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /// Threads that can work on one job: the workers and the caller.
+    unsigned concurrency() const { return static_cast<unsigned>(_threads.size()) + 1; }
+
+    /// Run fn(part) for every part in [0, parts) and return when all are
+    /// done. Safe from any thread; fn must not throw.
+    void run(unsigned parts, const std::function<void(unsigned)> &fn);
+
+    /// The process-wide pool.
+    static WorkerPool &shared();
+
+private:
+    struct Job
+    {
+        const std::function<void(unsigned)> *fn;
+        unsigned parts;
+        unsigned next = 0; // Next part to claim, under _mutex
+        unsigned done = 0; // Under _mutex
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _wake; // Workers: a job was queued or stop
+    std::condition_variable _done; // Callers: a part finished
+    std::deque<Job *> _jobs;       // With unclaimed parts, oldest first
+    bool _stop = false;
+    std::vector<std::thread> _threads;
+
+    // Claim a part of the oldest job; the job leaves the queue with its last part
+    bool claim(std::unique_lock<std::mutex> &lock, Job *&job, unsigned &part);
+    void loop();
+};
+
+} // namespace webkin
@@ -0,0 +1,157 @@
+/**
+ * Minimal blocking WebSocket client
+ */
+
+#include "ws_client.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace webkin
+{
+
+int tcp_connect(const std::string &host, int port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addrs = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs) != 0)
+        return -1;
+    int fd = -1;
+    for (addrinfo *a = addrs; a && fd < 0; a = a->ai_next)
+    {
+        fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    if (fd >= 0)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+ws_client::~ws_client()
+{
+    if (_fd >= 0)
+        ::close(_fd);
+}
+
+bool ws_client::connect(const std::string &host, int port, const std::string &path, const std::string &subprotocol)
+{
+    _fd = tcp_connect(host, port);
+    if (_fd < 0)
+        return false;
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + ":" + std::to_string(port) +
+                          "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n";
+    if (!subprotocol.empty())
+        request += "Sec-WebSocket-Protocol: " + subprotocol + "\r\n";
+    request += "\r\n";
+    if (!write_all(request.data(), request.size()))
+        return false;
+
+    // Response headers; bytes after them are the first frames
+    size_t end;
+    while ((end = _in.find("\r\n\r\n")) == std::string::npos)
+    {
+        if (!receive())
+            return false;
+    }
+    bool upgraded = _in.compare(0, 12, "HTTP/1.1 101") == 0;
+
+    std::string headers = _in.substr(0, end + 2);
+    std::transform(headers.begin(), headers.end(), headers.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    const std::string field = "\r\nsec-websocket-protocol:";
+    size_t at = headers.find(field);
+    if (at != std::string::npos)
+    {
+        size_t begin = _in.find_first_not_of(' ', at + field.size());
+        _subprotocol = _in.substr(begin, _in.find("\r\n", begin) - begin);
+    }
+
+    _in.erase(0, end + 4);
+    return upgraded;
+}
+
+void ws_client::shutdown()
+{
+    if (_fd >= 0)
+        ::shutdown(_fd, SHUT_RDWR);
+}
+
+bool ws_client::receive()
+{
+    char buf[65536];
+    ssize_t n = ::recv(_fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+    {
+        _open = false;
+        return false;
+    }
+    _in.append(buf, static_cast<size_t>(n));
+    return true;
+}
+
+bool ws_client::write_all(const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::send(_fd, data, size, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Client frames are masked (RFC 6455, 5.3)
+bool ws_client::send_frame(uint8_t opcode, std::string_view payload)
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    _out.clear();
+    _out += static_cast<char>(0x80 | opcode);
+    size_t len = payload.size();
+    if (len < 126)
+    {
+        _out += static_cast<char>(0x80 | len);
+    }
+    else if (len < 65536)
+    {
+        _out += static_cast<char>(0x80 | 126);
+        _out += static_cast<char>(len >> 8);
+        _out += static_cast<char>(len & 0xff);
+    }
+    else
+    {
+        _out += static_cast<char>(0x80 | 127);
+        for (int i = 7; i >= 0; --i)
+            _out += static_cast<char>((uint64_t(len) >> (8 * i)) & 0xff);
+    }
+    uint32_t key = _rng();
+    char mask[4];
+    std::memcpy(mask, &key, 4);
+    _out.append(mask, 4);
+    for (size_t i = 0; i < len; ++i)
+        _out += static_cast<char>(payload[i] ^ mask[i % 4]);
+    return write_all(_out.data(), _out.size());
+}
+
+} // namespace webkin
@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+ * Minimal blocking WebSocket client (RFC 6455): text and binary messages,
+ * fragments, ping/pong and close; no extensions. One thread reads, sends
+ * are serialized, so another thread may send meanwhile. Used by relays
+ * (relay_listener.hpp) and the load generator.
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace webkin
+{
+
+/// Connected TCP socket with TCP_NODELAY, -1 on failure.
+int tcp_connect(const std::string &host, int port);
+
+class ws_client
+{
+public:
+    ws_client() = default;
+    ~ws_client();
+
+    ws_client(const ws_client &) = delete;
+    ws_client &operator=(const ws_client &) = delete;
+
+    /// Connect and upgrade to a WebSocket on `path`, offering
+    /// `subprotocol` if not empty.
+    bool connect(const std::string &host, int port, const std::string &path, const std::string &subprotocol = "");
+
+    /// Subprotocol the server chose, empty if none
+    const std::string &subprotocol() const { return _subprotocol; }
+
+    int fd() const { return _fd; }
+
+    bool send_text(std::string_view payload) { return send_frame(0x1, payload); }
+
+    /// Close the connection from another thread, waking a blocked read().
+    void shutdown();
+
+    // Hand complete messages to on_message(payload, binary), reading from
+    // the socket (blocking) if none is buffered. False once the connection
+    // is closed.
+    template <class F> bool read(F &&on_message)
+    {
+        if (parse(on_message) > 0)
+            return _open;
+        if (!receive())
+            return false;
+        parse(on_message);
+        return _open;
+    }
+
+private:
+    int _fd = -1;
+    bool _open = true;
+    std::string _subprotocol;
+    std::string _in;
+    std::string _message; // Fragments of an unfinished message
+    bool _message_binary = false;
+    std::mutex _send_mutex; // Guards _out and _rng
+    std::string _out;
+    std::mt19937 _rng{std::random_device{}()};
+
+    // Consume the complete frames of _in; returns their number
+    template <class F> size_t parse(F &on_message)
+    {
+        size_t frames = 0;
+        size_t pos = 0;
+        for (;;)
+        {
+            size_t avail = _in.size() - pos;
+            if (avail < 2)
+                break;
+            auto *p = reinterpret_cast<const uint8_t *>(_in.data() + pos);
+            bool fin = (p[0] & 0x80) != 0;
+            uint8_t opcode = p[0] & 0x0f;
+            uint64_t len = p[1] & 0x7f;
+            size_t header = 2;
+            if (len == 126)
+            {
+                if (avail < 4)
+                    break;
+                len = (uint64_t(p[2]) << 8) | p[3];
+                header = 4;
+            }
+            else if (len == 127)
+            {
+                if (avail < 10)
+                    break;
+                len = 0;
+                for (int i = 0; i < 8; ++i)
+                    len = (len << 8) | p[2 + i];
+                header = 10;
+            }
+            if (avail < header + len)
+                break;
+
+            std::string_view payload(_in.data() + pos + header, len);
+            if ((opcode == 0x1 || opcode == 0x2) && fin)
+            {
+                on_message(payload, opcode == 0x2);
+            }
+            else if (opcode == 0x1 || opcode == 0x2)
+            {
+                _message.assign(payload);
+                _message_binary = opcode == 0x2;
+            }
+            else if (opcode == 0x0)
+            {
+                _message.append(payload);
+                if (fin)
+                {
+                    on_message(std::string_view(_message), _message_binary);
+                    _message.clear();
+                }
+            }
+            else if (opcode == 0x9)
+            {
+                send_frame(0xA, payload);
+            }
+            else if (opcode == 0x8)
+            {
+                _open = false;
+            }
+            pos += header + len;
+            ++frames;
+        }
+        _in.erase(0, pos);
+        return frames;
+    }
+
+    bool receive();
+    bool write_all(const char *data, size_t size);
+    bool send_frame(uint8_t opcode, std::string_view payload);
+};
+
+} // namespace webkin
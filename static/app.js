@@ -9,6 +9,26 @@ let jointNames = [];
 let jointsInfo = {};  // Joint metadata: {name: {type, slider_min, slider_max, axis_scale, axis_offset}}
 let manualMode = false;  // false = server control, true = local manual control
 let axisOverrides = {};  // Track which joints have axis overrides
+let nodeOrder = [];  // Node names by index, for binary pose frames
+let pendingTrace = null;  // Trace of the latest pose message, acked once rendered
+
+// Binary pose frames are opt-in: open the page with ?binary=1
+const pageParams = new URLSearchParams(window.location.search);
+const useBinaryFrames = pageParams.get('binary') === '1';
+
+// Robot to show when the server hosts several: open the page with ?robot=<id>
+const robotId = pageParams.get('robot');
+
+// Preprocessed K3D meshes load coarse first and are refined up to level 0;
+// weak machines can stop at a coarser level with ?lod=<level>
+SceneNode.finestLod = parseInt(pageParams.get('lod'), 10) || 0;
+
+function apiUrl(path) {
+    return robotId ? `${path}?robot=${encodeURIComponent(robotId)}` : path;
+}
+
+const POSE_FRAME_HEADER_SIZE = 16;
+const POSE_FRAME_RECORD_WORDS = 8;
 
 function init() {
     // Scene setup
@@ -107,7 +127,7 @@ function setupClearOverridesButton() {
     const btn = document.getElementById('clear-overrides');
     btn.addEventListener('click', async () => {
         try {
-            const response = await fetch('/api/axis/overrides', { method: 'DELETE' });
+            const response = await fetch(apiUrl('/api/axis/overrides'), { method: 'DELETE' });
             if (response.ok) {
                 axisOverrides = {};
                 updateOverrideButtons();
@@ -121,7 +141,7 @@ function setupClearOverridesButton() {
 
 async function loadAxisOverrides() {
     try {
-        const response = await fetch('/api/axis/overrides');
+        const response = await fetch(apiUrl('/api/axis/overrides'));
         const data = await response.json();
         axisOverrides = data.overrides || {};
         updateOverrideButtons();
@@ -164,7 +184,7 @@ function updateOverrideButtons() {
 
 async function setZeroOffset(jointName) {
     try {
-        const response = await fetch('/api/offset/set_zero', {
+        const response = await fetch(apiUrl('/api/offset/set_zero'), {
             method: 'POST',
             headers: { 'Content-Type': 'application/json' },
             body: JSON.stringify({ joint_name: jointName })
@@ -241,7 +261,7 @@ async function applyAxisSettings(jointName) {
     }
 
     try {
-        const response = await fetch('/api/axis/override', {
+        const response = await fetch(apiUrl('/api/axis/override'), {
             method: 'POST',
             headers: { 'Content-Type': 'application/json' },
             body: JSON.stringify(params)
@@ -299,7 +319,7 @@ function toggleAxisSettings(jointName) {
 
 async function loadTreeData() {
     try {
-        const response = await fetch('/api/tree');
+        const response = await fetch(apiUrl('/api/tree'));
         const data = await response.json();
         if (!data.error) {
             kinematicScene.setTreeData(data);
@@ -312,9 +332,12 @@ async function loadTreeData() {
 
 function connectWebSocket() {
     const protocol = window.location.protocol === 'https:' ? 'wss:' : 'ws:';
-    const wsUrl = `${protocol}//${window.location.host}/ws`;
+    const wsUrl = `${protocol}//${window.location.host}/ws${robotId ? '/' + encodeURIComponent(robotId) : ''}`;
 
-    ws = new WebSocket(wsUrl);
+    ws = useBinaryFrames
+        ? new WebSocket(wsUrl, ['webkin.binary.v1', 'webkin.json'])
+        : new WebSocket(wsUrl);
+    ws.binaryType = 'arraybuffer';
 
     ws.onopen = () => {
         console.log('WebSocket connected');
@@ -330,6 +353,10 @@ function connectWebSocket() {
     };
 
     ws.onmessage = (event) => {
+        if (event.data instanceof ArrayBuffer) {
+            handlePoseFrame(event.data);
+            return;
+        }
         try {
             const message = JSON.parse(event.data);
             handleMessage(message);
@@ -343,6 +370,19 @@ function connectWebSocket() {
     };
 }
 
+function handlePoseFrame(buffer) {
+    // Header: uint32 sequence, uint32 count, float64 timestamp
+    const header = new DataView(buffer, 0, POSE_FRAME_HEADER_SIZE);
+    const count = header.getUint32(4, true);
+    const words = count * POSE_FRAME_RECORD_WORDS;
+    const indices = new Uint32Array(buffer, POSE_FRAME_HEADER_SIZE, words);
+    const values = new Float32Array(buffer, POSE_FRAME_HEADER_SIZE, words);
+
+    if (!manualMode) {
+        kinematicScene.updateFromPoseFrame(nodeOrder, indices, values, count);
+    }
+}
+
 function handleMessage(message) {
     console.log(`Received message: ${message.type}`);
 
@@ -364,6 +404,7 @@ function handleMessage(message) {
             kinematicScene.initFromSceneData(message.nodes);
             jointNames = message.joints || [];
             jointsInfo = message.jointsInfo || {};
+            nodeOrder = message.nodeOrder || [];
             createJointSliders(jointNames);
 
             // Reload tree data for local calculations
@@ -376,24 +417,43 @@ function handleMessage(message) {
             break;
 
         case 'scene_update':
-            // Update poses from server (only if not in manual mode)
+        case 'scene_delta':
+            // Both carry {name: {pose}}; scene_delta only lists nodes whose
+            // pose changed and omits jointsInfo unless it changed
             if (!manualMode) {
                 kinematicScene.updateFromSceneData(message.nodes);
             }
-            // Update jointsInfo if provided (e.g., after axis override change)
-            if (message.jointsInfo) {
-                const jointsInfoChanged = JSON.stringify(jointsInfo) !== JSON.stringify(message.jointsInfo);
-                jointsInfo = message.jointsInfo;
-                updateSliderAttributes();
-                // If axis params changed, force update even in manual mode
-                if (jointsInfoChanged && manualMode) {
-                    kinematicScene.updateFromSceneData(message.nodes);
-                }
+            if (message.trace) {
+                pendingTrace = message.trace;
             }
+            applyJointsInfo(message);
+            break;
+
+        case 'joints_info':
+            // Binary clients get jointsInfo changes separately from pose frames
+            applyJointsInfo(message);
+            break;
+
+        case 'proximity':
+            // Links closer than the server's --proximity distance
+            kinematicScene.setProximity(message.pairs || []);
             break;
     }
 }
 
+function applyJointsInfo(message) {
+    // Update jointsInfo if provided (e.g., after axis override change)
+    if (!message.jointsInfo) return;
+
+    const jointsInfoChanged = JSON.stringify(jointsInfo) !== JSON.stringify(message.jointsInfo);
+    jointsInfo = message.jointsInfo;
+    updateSliderAttributes();
+    // If axis params changed, force update even in manual mode
+    if (jointsInfoChanged && manualMode && message.nodes) {
+        kinematicScene.updateFromSceneData(message.nodes);
+    }
+}
+
 function createJointSliders(joints) {
     const container = document.getElementById('joint-sliders');
     container.innerHTML = '';
@@ -499,6 +559,21 @@ function animate() {
     requestAnimationFrame(animate);
     controls.update();
     renderer.render(scene, camera);
+    if (pendingTrace) {
+        sendFrameAck(pendingTrace);
+        pendingTrace = null;
+    }
+}
+
+// Report when a traced pose message reached the screen, for the server's
+// latency statistics. Messages superseded before a render are not acked.
+function sendFrameAck(trace) {
+    if (!ws || ws.readyState !== WebSocket.OPEN) return;
+    ws.send(JSON.stringify({
+        ...trace,
+        type: 'frame_ack',
+        render_ts: performance.timeOrigin + performance.now()
+    }));
 }
 
 // Start
@@ -3,12 +3,85 @@
  * Only renders - all calculations done on server
  */
 
+/**
+ * Decode a WKM1 mesh (see src/mesh_lod.hpp) into a BufferGeometry
+ */
+function decodeMesh(buffer) {
+    const view = new DataView(buffer);
+    const magic = String.fromCharCode(...new Uint8Array(buffer, 0, 4));
+    if (magic !== 'WKM1') {
+        throw new Error('Not a WKM1 mesh');
+    }
+    const vertexCount = view.getUint32(4, true);
+    const indexCount = view.getUint32(8, true);
+    const index32 = (view.getUint32(12, true) & 1) !== 0;
+    const origin = [0, 1, 2].map((a) => view.getFloat32(16 + a * 4, true));
+    const step = [0, 1, 2].map((a) => view.getFloat32(28 + a * 4, true));
+
+    const q = new Uint16Array(buffer, 40, vertexCount * 3);
+    const positions = new Float32Array(vertexCount * 3);
+    for (let i = 0; i < positions.length; i++) {
+        const a = i % 3;
+        positions[i] = origin[a] + q[i] * step[a];
+    }
+    const normals = new Int16Array(buffer, 40 + vertexCount * 6, vertexCount * 3);
+    const indexOffset = 40 + vertexCount * 12;
+    const indices = index32
+        ? new Uint32Array(buffer, indexOffset, indexCount)
+        : new Uint16Array(buffer, indexOffset, indexCount);
+
+    const geometry = new THREE.BufferGeometry();
+    geometry.setAttribute('position', new THREE.BufferAttribute(positions, 3));
+    geometry.setAttribute('normal', new THREE.BufferAttribute(normals, 3, true));
+    geometry.setIndex(new THREE.BufferAttribute(indices, 1));
+    geometry.computeBoundingSphere();
+    return geometry;
+}
+
 class SceneNode {
+    // Finest level of detail to load (0 is full detail), set from ?lod=
+    static finestLod = 0;
+
+    // WKM1 meshes (promises of ArrayBuffers) by URL. Level URLs carry the
+    // content hash, so a reloaded tree reuses unchanged meshes unfetched
+    static meshes = new Map();
+
+    static fetchMesh(url) {
+        let mesh = SceneNode.meshes.get(url);
+        if (!mesh) {
+            mesh = fetch(url).then((response) => {
+                if (!response.ok) {
+                    throw new Error(`HTTP ${response.status}`);
+                }
+                return response.arrayBuffer();
+            });
+            mesh.catch(() => SceneNode.meshes.delete(url));
+            SceneNode.meshes.set(url, mesh);
+        }
+        return mesh;
+    }
+
+    // Drop the meshes no node of the scene data refers to
+    static pruneMeshes(sceneData) {
+        const used = new Set();
+        for (const data of Object.values(sceneData)) {
+            for (const lod of (data.model && data.model.lods) || []) {
+                used.add(lod.path);
+            }
+        }
+        for (const url of SceneNode.meshes.keys()) {
+            if (!used.has(url)) {
+                SceneNode.meshes.delete(url);
+            }
+        }
+    }
+
     constructor(name, modelData) {
         this.name = name;
         this.group = new THREE.Group();
         this.group.name = name;
         this.mesh = null;
+        this.warning = false;  // Close to another link (proximity message)
 
         if (modelData) {
             this.createMesh(modelData);
@@ -75,50 +148,98 @@ class SceneNode {
         const url = path.startsWith('/') ? path : `/static/models/${path}`;
         const extension = path.split('.').pop().toLowerCase();
 
-        if (extension === 'stl') {
+        if (modelData.lods && modelData.lods.length > 0) {
+            this.loadMeshLods(modelData);
+        } else if (extension === 'stl') {
             const loader = new THREE.STLLoader();
             loader.load(
                 url,
                 (geometry) => {
-                    const material = new THREE.MeshPhongMaterial({
-                        color: modelData.color || 0x9e9e9e,
-                        flatShading: false
-                    });
-                    const mesh = new THREE.Mesh(geometry, material);
-
-                    if (modelData.scale) {
-                        if (Array.isArray(modelData.scale)) {
-                            mesh.scale.set(modelData.scale[0], modelData.scale[1], modelData.scale[2]);
-                        } else {
-                            mesh.scale.setScalar(modelData.scale);
-                        }
-                    }
+                    this.setModelGeometry(geometry, modelData);
+                    console.log(`Loaded STL: ${path}`);
+                },
+                undefined,
+                (error) => console.error(`Failed to load STL ${path}:`, error)
+            );
+        }
+    }
 
-                    if (modelData.rotation) {
-                        const r = modelData.rotation;
-                        mesh.rotation.set(
-                            r[0] * Math.PI / 180,
-                            r[1] * Math.PI / 180,
-                            r[2] * Math.PI / 180
-                        );
-                    }
+    /**
+     * Preprocessed meshes: the coarsest level first, then finer ones up to
+     * SceneNode.finestLod, each replacing the previous one when loaded.
+     * A level an earlier tree already loaded is used right away.
+     */
+    loadMeshLods(modelData) {
+        const lods = modelData.lods;
+        const finest = Math.min(Math.max(SceneNode.finestLod, 0), lods.length - 1);
+        let start = lods.length - 1;
+        for (let level = finest; level < lods.length; level++) {
+            if (SceneNode.meshes.has(lods[level].path)) {
+                start = level;
+                break;
+            }
+        }
 
-                    if (modelData.offset) {
-                        mesh.position.set(modelData.offset[0], modelData.offset[1], modelData.offset[2]);
+        const load = (level) => {
+            SceneNode.fetchMesh(lods[level].path)
+                .then((buffer) => {
+                    this.setModelGeometry(decodeMesh(buffer), modelData);
+                    console.log(`Loaded mesh: ${modelData.path} level ${level} (${lods[level].triangles} triangles)`);
+                    if (level > finest) {
+                        load(level - 1);
                     }
+                })
+                .catch((error) => console.error(`Failed to load mesh ${lods[level].path}:`, error));
+        };
+        load(start);
+    }
 
-                    if (this.mesh) {
-                        this.group.remove(this.mesh);
-                    }
-                    this.mesh = mesh;
-                    this.group.add(mesh);
+    setModelGeometry(geometry, modelData) {
+        const material = new THREE.MeshPhongMaterial({
+            color: modelData.color || 0x9e9e9e,
+            flatShading: false
+        });
+        const mesh = new THREE.Mesh(geometry, material);
 
-                    console.log(`Loaded STL: ${path}`);
-                },
-                undefined,
-                (error) => console.error(`Failed to load STL ${path}:`, error)
+        if (modelData.scale) {
+            if (Array.isArray(modelData.scale)) {
+                mesh.scale.set(modelData.scale[0], modelData.scale[1], modelData.scale[2]);
+            } else {
+                mesh.scale.setScalar(modelData.scale);
+            }
+        }
+
+        if (modelData.rotation) {
+            const r = modelData.rotation;
+            mesh.rotation.set(
+                r[0] * Math.PI / 180,
+                r[1] * Math.PI / 180,
+                r[2] * Math.PI / 180
             );
         }
+
+        if (modelData.offset) {
+            mesh.position.set(modelData.offset[0], modelData.offset[1], modelData.offset[2]);
+        }
+
+        if (this.mesh) {
+            this.group.remove(this.mesh);
+            this.mesh.geometry.dispose();
+        }
+        this.mesh = mesh;
+        this.group.add(mesh);
+        this.applyWarning();
+    }
+
+    setWarning(warning) {
+        this.warning = warning;
+        this.applyWarning();
+    }
+
+    applyWarning() {
+        if (this.mesh && this.mesh.material.emissive) {
+            this.mesh.material.emissive.setHex(this.warning ? 0xaa2200 : 0x000000);
+        }
     }
 
     setPose(pose) {
@@ -164,6 +285,7 @@ class KinematicScene {
     initFromSceneData(sceneData) {
         const nodeNames = Object.keys(sceneData);
         console.log(`initFromSceneData: creating ${nodeNames.length} nodes:`, nodeNames);
+        SceneNode.pruneMeshes(sceneData);
 
         // Create nodes from scene data
         for (const [name, data] of Object.entries(sceneData)) {
@@ -208,6 +330,30 @@ class KinematicScene {
         }
     }
 
+    // Highlight the links of the pairs of a proximity message
+    setProximity(pairs) {
+        const near = new Set();
+        for (const pair of pairs) {
+            near.add(pair.a);
+            near.add(pair.b);
+        }
+        for (const [name, node] of Object.entries(this.nodes)) {
+            node.setWarning(near.has(name));
+        }
+    }
+
+    // Records of a binary pose frame: [index, px, py, pz, qx, qy, qz, qw]
+    // viewed both as Uint32Array (index) and Float32Array (pose)
+    updateFromPoseFrame(nodeOrder, indices, values, count) {
+        for (let r = 0; r < count; r++) {
+            const o = r * 8;
+            const node = this.nodes[nodeOrder[indices[o]]];
+            if (!node) continue;
+            node.group.position.set(values[o + 1], values[o + 2], values[o + 3]);
+            node.group.quaternion.set(values[o + 4], values[o + 5], values[o + 6], values[o + 7]);
+        }
+    }
+
     // Local calculation methods
     setLocalJointCoord(name, value) {
         if (this.jointCoords.hasOwnProperty(name)) {